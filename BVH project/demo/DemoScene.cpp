@@ -23,10 +23,10 @@
 #include "stats.hpp"
 #include "ImGui.hpp"
 
-#include <filesystem>
 #include <fmt/format.h>
 #include <imgui.h>
 #include <memory>
+#include <numeric>
 #include <vector>
 #include <random>
 
@@ -63,19 +63,15 @@ namespace {
     void LoadPrimitivesAndScene(std::vector<CS350::CS350PrimitiveData>& allPrimitives,
                                 std::vector<CS350::CS350SceneObject>&   objects,
                                 std::vector<CS350::Aabb>&               worldBvs,
-                                char const*                             sceneFile) {
-        // Load all models
-        allPrimitives.clear();
-        size_t lastIndex = 0;
-        auto   assetPath = fmt::format(cAssetPath, lastIndex);
-        while (std::filesystem::exists(assetPath)) {
-            allPrimitives.push_back(CS350::LoadCS350Binary(assetPath));
-            lastIndex++;
-            assetPath = fmt::format(cAssetPath, lastIndex);
-        }
+                                char const*                             sceneFile,
+                                CS350::CS350LoadStats&                  loadStats) {
+        // Load all models, identical ones are shared
+        std::vector<int> fileToPrimitive;
+        allPrimitives = CS350::LoadCS350Primitives(cAssetPath, fileToPrimitive, &loadStats);
 
         // Load the scene
         objects = CS350::LoadCS350Scene(sceneFile);
+        CS350::RemapCS350Scene(objects, fileToPrimitive);
 
         // Process bvs
         worldBvs.clear();
@@ -105,6 +101,11 @@ namespace CS350 {
         mOptions.drawCalls              = 0;
         Stats::Instance().frustumVsAabb = 0;
 
+        // Time sliced build, the previous tree is used until the last step replaces it
+        if (mBvh.Building() && mBvh.Step(static_cast<unsigned>(mOptions.buildBudgetUs))) {
+            mOptions.Clear();
+        }
+
 
 		//Do this to prevent crash when applicaation is minimized
         if (mCamera.display_h > 0.f || mAuxCamera.display_h > 0.f) {
@@ -122,15 +123,19 @@ namespace CS350 {
     }
 
     void DemoScene::LoadScene() {
-        // Clear
+        // Clear, the tree first as it still links the old objects
+        mBvh.Clear();
+        mOptions.Clear();
         mObjects.clear();
+        mSceneIndices.clear();
         mPrimitives.clear();
+        mModelBvs.clear();
         std::vector<Aabb> bvs;
 
         // Load
         std::vector<CS350PrimitiveData> primitives;
         std::vector<CS350SceneObject>   sceneObjects;
-        LoadPrimitivesAndScene(primitives, sceneObjects, bvs, cSceneNormal);
+        LoadPrimitivesAndScene(primitives, sceneObjects, bvs, cSceneNormal, mLoadStats);
 
         // Primitives
         for (auto const& primitiveData : primitives) {
@@ -138,20 +143,26 @@ namespace CS350 {
             mModelBvs.push_back({ primitiveData.bvMin, primitiveData.bvMax });
         }
 
-        // Objects
+        // Objects, allocated in Morton order so the objects of a leaf or of the visible set are close in memory
+        if (mOptions.mortonOrder) {
+            mSceneIndices = MortonOrder(bvs);
+        } else {
+            mSceneIndices.resize(sceneObjects.size());
+            std::iota(mSceneIndices.begin(), mSceneIndices.end(), 0u);
+        }
         std::vector<Object*> objPtrs;
-        for (auto const& obj : sceneObjects) {
+        for (unsigned sceneIndex : mSceneIndices) {
+            auto const& obj    = sceneObjects.at(sceneIndex);
             auto gameObj       = std::make_shared<Object>();
-            gameObj->bv        = mModelBvs.at(obj.primitiveIndex).transform(obj.m2w);
+            gameObj->bv        = bvs.at(sceneIndex);
             gameObj->meshIndex = obj.primitiveIndex;
             gameObj->m2w       = obj.m2w;
-            gameObj->id        = static_cast<int>(objPtrs.size());
+            gameObj->id        = static_cast<unsigned>(objPtrs.size());
             mObjects.push_back(gameObj);
             objPtrs.push_back(gameObj.get());
         }
 
         // BVH
-        mBvh.Clear();
         mBvh.BuildTopDown(objPtrs.begin(), objPtrs.end(), mOptions.config);
     }
 
@@ -176,7 +187,7 @@ namespace CS350 {
             if (!mOptions.frustumCulling) {
                 // Draw all
                 for (auto const& obj : mObjects) {
-                    set_uniform(cUniformM2w, obj->m2w);
+                    set_uniform(cUniformM2w, obj->m2w.matrix());
                     set_uniform(cUniformColor, vec4(1, 1, 1, 0.1f));
                     mPrimitives.at(obj->meshIndex)->draw(GL_TRIANGLES);
                     mOptions.drawCalls++;
@@ -186,7 +197,7 @@ namespace CS350 {
                     // Frustum vs all
                     for (auto const& obj : mObjects) {
                         if (frustum.classify(obj->bv) != eOUTSIDE) {
-                            set_uniform(cUniformM2w, obj->m2w);
+                            set_uniform(cUniformM2w, obj->m2w.matrix());
                             set_uniform(cUniformColor, vec4(1, 1, 1, 0.1f));
                             mPrimitives.at(obj->meshIndex)->draw(GL_TRIANGLES);
                             mOptions.drawCalls++;
@@ -197,7 +208,7 @@ namespace CS350 {
                     visible = mBvh.Query(frustum);
                     for (auto objIdx : visible) {
                         auto obj = mObjects.at(objIdx);
-                        set_uniform(cUniformM2w, obj->m2w);
+                        set_uniform(cUniformM2w, obj->m2w.matrix());
                         set_uniform(cUniformColor, vec4(1, 1, 1, 0.1f));
                         mPrimitives.at(obj->meshIndex)->draw(GL_TRIANGLES);
                         mOptions.drawCalls++;
@@ -286,6 +297,11 @@ namespace CS350 {
             ImGui::Text("ray_intersected_nodes: %lu", mOptions.ray_intersected_nodes.size());
             ImGui::Text("ray_all_intersected_objects: %lu", mOptions.ray_all_intersected_objects.size());
             ImGui::Text("Draw calls: %u", mOptions.drawCalls);
+            ImGui::Text("Primitives: %zu of %zu files, %.01fKB shared, loaded in %.02fms",
+                        mLoadStats.primitives,
+                        mLoadStats.files,
+                        static_cast<double>(mLoadStats.bytesSaved) / 1024.0,
+                        mLoadStats.loadMs);
             ImGui::Checkbox("frustumCulling", &mOptions.frustumCulling);
             ImGui::Checkbox("usingBvh", &mOptions.usingBvh);
             ImGui::Checkbox("debugDrawAllOutline", &mOptions.debugDrawAllOutline);
@@ -341,10 +357,25 @@ namespace CS350 {
                 }
             }
 
+            if (ImGui::Button("Build sliced")) {
+                std::vector<Object*> objPtrs;
+                for (auto const& obj : mObjects) {
+                    objPtrs.push_back(obj.get());
+                }
+                mBvh.BeginBuild(objPtrs.begin(), objPtrs.end(), mOptions.config);
+            }
+            ImGui::DragInt("Build budget (us)", &mOptions.buildBudgetUs, 10.0f, 1, 100000);
+            if (mBvh.Building()) {
+                ImGui::Text("Building: %.0f%%", static_cast<double>(mBvh.buildProgress() * 100.0f));
+            }
+
             if (ImGui::Button("Clear")) {
                 mBvh.Clear();
                 mOptions.Clear();
             }
+            if (ImGui::Checkbox("Morton order (reloads)", &mOptions.mortonOrder)) {
+                LoadScene();
+            }
 
             if (mOptions.debugNode && mOptions.debugBvh) {
                 ImguiBvhNode(mOptions.debugNode);
@@ -418,11 +449,11 @@ namespace CS350 {
             auto recordFn = [this](Object const* object) {
                 // Debug draw boxes on top of the leaf objects
                 auto& bv = object->bv;
-                ImGui::Selectable(fmt::format("Object: {}\n\tmin: {}\n\tmax: {}\n", object->id, bv.min, bv.max).c_str());
+                ImGui::Selectable(fmt::format("Object: {} (scene {})\n\tmin: {}\n\tmax: {}\n", object->id, mSceneIndices.at(object->id), bv.min, bv.max).c_str());
 
                 glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
                 if (ImGui::IsItemHovered()) {
-                    mDebug.draw_primitive(mCamera.vp, object->m2w, mPrimitives.at(object->meshIndex).get(), { 1, 0, 1, 1 });
+                    mDebug.draw_primitive(mCamera.vp, object->m2w.matrix(), mPrimitives.at(object->meshIndex).get(), { 1, 0, 1, 1 });
                 }
             };
             if (ImGui::BeginListBox("Objects")) {
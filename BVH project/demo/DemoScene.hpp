@@ -17,6 +17,7 @@
 #define DEMOSCENE_HPP
 
 #include "bvh.hpp"
+#include "cs350_loader.hpp"
 #include "debug_renderer.hpp"
 #include "camera.hpp"
 #include <vector>
@@ -36,7 +37,7 @@ namespace CS350 {
             unsigned    id; // Object identification
             CS350::Aabb bv; // Bounding volume of the object
             int         meshIndex;
-            mat4        m2w;
+            Affine      m2w; // 48 bytes, see transform.hpp
 
             // Bvh information
             struct
@@ -75,6 +76,8 @@ namespace CS350 {
             bool                        debugDrawFustrum   = true;
 
             CS350::BvhBuildConfig config;
+            int                   buildBudgetUs = 2000; // Per frame, for the time sliced build
+            bool                  mortonOrder   = true; // Objects stored in Morton order of their bv centers, see LoadScene
 
             void Clear() {
                 debugNode = nullptr;
@@ -95,8 +98,10 @@ namespace CS350 {
         BvhObject     mBvh;
 
         std::vector<std::shared_ptr<Primitive>> mPrimitives;
-        std::vector<std::shared_ptr<Object>>    mObjects;
+        std::vector<std::shared_ptr<Object>>    mObjects;      // Id == index
+        std::vector<unsigned>                   mSceneIndices; // Object id -> object of the scene file
         std::vector<Aabb>                       mModelBvs;
+        CS350LoadStats                          mLoadStats; // Of mPrimitives, duplicated files are shared
         std::shared_ptr<Shader>                 mShader;
 
       public:
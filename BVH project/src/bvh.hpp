@@ -26,38 +26,155 @@
 #include <queue>
 #include <ostream>
 #include <functional> // Debug
+#include <atomic>
+#include <bit>
+#include <memory>
+#include <concepts>
+#include <type_traits>
 
 
 namespace CS350 {
 
+    /**
+     * @brief
+     *  How Insert picks where an object goes
+     */
+    enum class InsertPolicy {
+        eVolume,      // Greedy descent by volume growth, then the cheapest node of that path
+        eSurfaceArea, // Branch and bound search of the sibling with the least surface area cost (Bittner et al.)
+    };
+
+    /**
+     * @brief
+     *  Where top-down builds split a node
+     */
+    enum class SplitPolicy {
+        eMedian, // Half of the objects on each side, sorted along the longest axis of the node
+        eSah,    // Binned surface area heuristic over the object centers of every axis, slower to build
+    };
+
     /**
      * @brief
      *  Some rules for Bvh construction. Not all rules apply to all methods.
      *  Feel free to add more rules.
      */
     struct BvhBuildConfig {
-        unsigned maxDepth   = std::numeric_limits<unsigned>::max();
-        unsigned minObjects = 10; // Nodes should have more than this amount of objects to be split
-        float    minVolume  = 0; // Nodes with smaller volume than this will not be splitted
+        unsigned     maxDepth     = std::numeric_limits<unsigned>::max();
+        unsigned     minObjects   = 10; // Nodes should have more than this amount of objects to be split
+        float        minVolume    = 0; // Nodes with smaller volume than this will not be splitted
+        InsertPolicy insertPolicy = InsertPolicy::eVolume; // Insert only, eSurfaceArea ignores minVolume
+        SplitPolicy  splitPolicy  = SplitPolicy::eMedian;  // BuildTopDown, BeginBuild and BuildLazy only
+    };
+
+    /**
+     * @brief
+     *  Categories of an object, such as static, enemy or a render layer. One bit each.
+     */
+    using LayerMask                = uint32_t;
+    constexpr LayerMask cAllLayers = ~LayerMask{};
+
+    /**
+     * @brief
+     *  Layers of an object, taken from T::layers when it has one. Objects without it are in every layer.
+     */
+    template <typename T>
+    LayerMask ObjectLayers(T const& object) {
+        if constexpr (requires { object->layers; }) {
+            return static_cast<LayerMask>(object->layers);
+        } else {
+            return cAllLayers;
+        }
+    }
+
+    /**
+     * @brief
+     *  Which objects a query returns. The default filter returns every object, including the ones
+     *  in no layer at all.
+     */
+    struct QueryFilter {
+        LayerMask include = cAllLayers; // Objects need at least one of these layers
+        LayerMask exclude = 0;          // Objects with any of these layers are skipped
+
+        bool IsEmpty() const { return include == cAllLayers && exclude == 0; }
+        bool Accepts(LayerMask layers) const { return (layers & include) != 0 && (layers & exclude) == 0; }
+
+        /**
+         * @brief
+         *  False when no object of a subtree can be accepted
+         * @param subtreeLayers
+         *  Union of the layers of every object in the subtree
+         */
+        bool AcceptsAny(LayerMask subtreeLayers) const { return (subtreeLayers & include) != 0 && (subtreeLayers & ~exclude) != 0; }
+    };
+
+    /**
+     * @brief
+     *  Line of sight between every pair of agents, one bit per ordered pair. Rows are padded to
+     *  whole words so threads can fill different rows at once.
+     */
+    class VisibilityMatrix {
+      public:
+        VisibilityMatrix() = default;
+        explicit VisibilityMatrix(size_t count) : mCount(count), mWordsPerRow((count + 63) / 64), mBits(count * mWordsPerRow, 0) {}
+
+        bool   Visible(size_t from, size_t to) const { return (mBits[from * mWordsPerRow + to / 64] >> (to % 64) & 1u) != 0; }
+        void   SetVisible(size_t from, size_t to) { mBits[from * mWordsPerRow + to / 64] |= uint64_t{ 1 } << (to % 64); }
+        size_t count() const { return mCount; }
+
+        /**
+         * @brief
+         *  Calls func(size_t to) for every agent seen from the given one
+         */
+        template <typename Fn>
+        void ForEachVisible(size_t from, Fn&& func) const {
+            for (size_t w = 0; w < mWordsPerRow; ++w) {
+                for (uint64_t bits = mBits[from * mWordsPerRow + w]; bits != 0; bits &= bits - 1) {
+                    func(w * 64 + static_cast<size_t>(std::countr_zero(bits)));
+                }
+            }
+        }
+
+      private:
+        size_t                mCount       = 0;
+        size_t                mWordsPerRow = 0;
+        std::vector<uint64_t> mBits;
     };
 
 
 
     /**
      * @brief
-     *  Bounding Volume Hierarchy for type T
+     *  Bounding volume of the Bvh nodes, Aabb, Sphere or Kdop<K>. Built around the Aabb of the objects
+     *  and merged up the tree, queries without a test of their own use the Aabb around it.
+     */
+    template <typename BV>
+    concept BoundingVolume = requires(BV const& bv, Aabb const& aabb, Plane const& plane, Ray const& ray) {
+        BV(aabb);    // Around an object
+        BV(bv, bv);  // Merge
+        { bv.surface_area() } -> std::convertible_to<float>;
+        { bv.volume() } -> std::convertible_to<float>;
+        { plane.classify(bv) } -> std::same_as<SideResult>;
+        { ray.intersect(bv) } -> std::same_as<float>;
+        { bv.bounds() } -> std::same_as<Aabb>;
+    };
+
+    /**
+     * @brief
+     *  Bounding Volume Hierarchy for type T, with BV node bounding volumes
      *  Requires the following members of T.
      *      Aabb T::bv
      *      unsigned T::id
      *      T T::bvhInfo.next
      *      T T::bvhInfo.prev
      *      Node* T::bvhInfo.node
+     *  And optionally
+     *      LayerMask T::layers, used by query filters
      */
-    template <typename T>
+    template <typename T, BoundingVolume BV = Aabb>
     class Bvh {
       public: // Public for testing reasons
         struct Node {
-			Node(Aabb boundingVolume) :
+			Node(BV boundingVolume) :
 				bv(boundingVolume),
 				firstObject(nullptr),
 				lastObject(nullptr) {
@@ -65,10 +182,14 @@ namespace CS350 {
 				children[1] = nullptr;
 			}
 
-            Aabb  bv;          // Node bounding volume
-            Node* children[2]; // Both children
-            T     firstObject; //
-            T     lastObject;  //
+            BV                bv;                // Node bounding volume
+            Node*             children[2];       // Both children
+            T                 firstObject;       //
+            T                 lastObject;        //
+            std::atomic<bool> locked{ false };   // Used by InsertConcurrent and lazy expansion
+            std::atomic<bool> pending{ false };  // BuildLazy: holds every object of the subtree, not split yet
+            uint16_t          level = 0;         // BuildLazy: depth of the node, split up to config.maxDepth
+            LayerMask         layers = 0;        // Union of the layers of every object below
 
             /**
              * @brief
@@ -132,8 +253,46 @@ namespace CS350 {
         };
 
       private:
-        Node*    mRoot;
-        unsigned mObjectCount;
+        Node*             mRoot;
+        unsigned          mObjectCount;
+        std::atomic<bool> mRootLocked{ false }; // Guards root swaps of InsertConcurrent
+        unsigned          mBuildLevel  = 0;     // BuildTopDown: level of the nodes created by the current call
+        unsigned          mBuildHeight = 0;     // BuildTopDown: height of the tree built so far, mRoot->Depth() without walking it
+        bool              mLazy        = false; // BuildLazy: nodes may still be pending
+        BvhBuildConfig    mLazyConfig;          // BuildLazy: rules of the pending splits
+
+        // BeginBuild: tree being built by Step, not visible to queries until it is done
+        struct SlicedBuild {
+            // Range of objects still to be turned into a node
+            struct Task {
+                Node*    parent;
+                unsigned side;
+                size_t   first;
+                size_t   last;
+                unsigned level;
+            };
+
+            // Objects are linked to the leaves at the end
+            struct Leaf {
+                Node*  node;
+                size_t first;
+                size_t last;
+            };
+
+            std::vector<T>     objects;    // Reordered by the splits, leaves are ranges of it
+            std::vector<Task>  tasks;      // Depth first, the last one is the next
+            std::vector<Leaf>  leaves;     //
+            std::vector<Node*> internals;  // In creation order, parents before children
+            Node*              root   = nullptr;
+            unsigned           height = 0; // Same as mBuildHeight of BuildTopDown
+            size_t             placed = 0; // Objects already in a leaf
+            BvhBuildConfig     config;
+
+            // Insert and InsertConcurrent while building, inserted again in the new tree at the end
+            std::vector<std::pair<T, BvhBuildConfig>> inserted;
+            std::atomic<bool>                         insertedLocked{ false };
+        };
+        std::unique_ptr<SlicedBuild> mSlicedBuild;
 
       public:
         /**
@@ -166,6 +325,77 @@ namespace CS350 {
 
         template <typename IT> void BuildBottomUp(IT begin, IT end, BvhBuildConfig const& config);
 
+		/**
+		 * @brief
+		 *  Builds only the root, holding every object of the range. A node is split like BuildTopDown
+		 *  splits it the first time a query descends into it, so the build cost follows the region
+		 *  actually queried. The stop rules differ on depth only: a lazy node stops at its own
+		 *  level maxDepth, BuildTopDown stops every later node once any branch reached it, so fully
+		 *  expanded trees are identical only when maxDepth is never reached. Queries may run from
+		 *  several threads at once, a node is expanded under its lock by the first one to reach it
+		 *  and the others wait for it.
+		 *  Depth, Size, the traversals and the debug functions show the tree expanded so far.
+		 *  Insert, Refit and InsertConcurrent must not run while nodes may still be expanded.
+		 * @param begin
+		 *  The beginning of the range
+		 * @param end
+		 *  The end of the range
+		 * @param config
+		 *  Configuration of every later split, maxDepth counts from the root
+		 */
+        template <typename IT> void BuildLazy(IT begin, IT end, BvhBuildConfig const& config);
+
+		/**
+		 * @brief
+		 *  Starts a BuildTopDown of the range done a few nodes at a time by Step, spreading the build
+		 *  of a large scene over several frames. Queries keep using the current tree until the last
+		 *  Step replaces it with a tree identical to the one BuildTopDown would build. A build already
+		 *  in progress is dropped.
+		 *  The objects must stay alive until then, they are only linked to the new tree at the end.
+		 *  Objects moving in the meantime may be left outside their node, Refit after it is done.
+		 *  Objects added with Insert or InsertConcurrent meanwhile go to the current tree and are
+		 *  inserted again in the new one when it replaces it, with the config they were given.
+		 *  Clear, BuildLazy and a BuildTopDown of the whole tree drop the build, their tree is kept.
+		 * @param begin
+		 *  The beginning of the range
+		 * @param end
+		 *  The end of the range
+		 * @param config
+		 *  Configuration for the Bvh build
+		 */
+        template <typename IT> void BeginBuild(IT begin, IT end, BvhBuildConfig const& config);
+
+		/**
+		 * @brief
+		 *  Continues the build started by BeginBuild. Nodes are split until the budget runs out, at
+		 *  least one per call, so a call can take as long as the split of the largest node left (the
+		 *  first one sorts every object). The call that finishes it frees the current tree and links
+		 *  every object to the new one.
+		 * @param budgetUs
+		 *  Time to spend, in microseconds
+		 * @return
+		 *  True if the new tree replaced the current one in this call
+		 */
+        bool                        Step(unsigned budgetUs);
+
+		/**
+		 * @brief
+		 *  Drops the build started by BeginBuild, the current tree is kept
+		 */
+        void                        CancelBuild();
+
+		/**
+		 * @brief
+		 *  Checks if a BeginBuild is still waiting for Step calls
+		 */
+        bool                        Building() const { return mSlicedBuild != nullptr; }
+
+		/**
+		 * @brief
+		 *  Fraction of the objects of the build in progress already placed in a leaf, 0 when not building
+		 */
+        float                       buildProgress() const;
+
 		/**
 		 * @brief
 		 *  Inserts a range of objects into the Bvh using the incremental approach
@@ -180,7 +410,7 @@ namespace CS350 {
 
 		/**
 		 * @brief
-		 *  Inserts an object into the Bvh using the incremental approach
+		 *  Inserts an object into the Bvh using the incremental approach, see InsertPolicy
 		 * @param object
 		 *  The object to be inserted
 		 * @param config
@@ -190,7 +420,36 @@ namespace CS350 {
 
 		/**
 		 * @brief
-		 *  Clears the Bvh tree and resets the object count
+		 *  Inserts a range of objects, see InsertConcurrent(T, BvhBuildConfig const&)
+		 */
+        template <typename IT> void InsertConcurrent(IT begin, IT end, BvhBuildConfig const& config);
+
+		/**
+		 * @brief
+		 *  Inserts an object like Insert, but can be called from several threads at once.
+		 *  The path is planned without locks, then locked down from the root holding at most a node
+		 *  and its parent (lock coupling), checking it did not change in between. Nodes are only
+		 *  expanded while locked, and new parents and roots are created while holding the node they
+		 *  go above, so they always contain every object inserted below it.
+		 *  No other member, including queries, may run while objects are inserted concurrently.
+		 *  Only for Aabb nodes, they are expanded one atomic component at a time.
+		 * @param object
+		 *  The object to be inserted, not shared with other inserting threads
+		 * @param config
+		 *  Configuration for the Bvh build
+		 */
+        void                        InsertConcurrent(T object, BvhBuildConfig const& config);
+
+		/**
+		 * @brief
+		 *  Recomputes every node bounding volume and layers from the objects it holds, keeping the structure.
+		 *  Used after objects moved or changed layers, cheaper than a rebuild while they do not move far.
+		 */
+        void                        Refit();
+
+		/**
+		 * @brief
+		 *  Clears the Bvh tree and resets the object count, dropping a build in progress
 		 */
         void                        Clear();
 
@@ -218,6 +477,16 @@ namespace CS350 {
 		 */
         int                         Size() const;
 
+		/**
+		 * @brief
+		 *  Surface area heuristic cost of the tree, to compare the quality of trees over the same objects.
+		 *  Internal nodes cost their surface area and leaves their area times their objects, relative
+		 *  to the area of the root.
+		 * @return
+		 *  Expected nodes and objects tested by a random ray hitting the root, 0 if empty
+		 */
+        float                       SurfaceAreaCost() const;
+
         /**
          * @brief
 		 *  Access the root of the Bvh tree
@@ -229,10 +498,91 @@ namespace CS350 {
 		/**
 		 * @brief
 		 *  Peforms frustum vs Bvh 
+		 * @param filter
+		 *  Only objects accepted by it are returned, subtrees without any are skipped
 		 * @return
 		 *  Vector of unsigned integers representing the object ids tha are visible in the frustum
 		 */
-        std::vector<unsigned>       Query(Frustum const& frustum) const;
+        std::vector<unsigned>       Query(Frustum const& frustum, QueryFilter const& filter = {}) const;
+
+		/**
+		 * @brief
+		 *  Frustum vs Bvh returning the objects roughly near to far, for front to back rendering.
+		 *  Children are visited closest to the eye first and the objects of each leaf are sorted,
+		 *  so only objects of different leaves can be out of order.
+		 * @param eye
+		 *  Position the distances are measured from, usually the camera
+		 * @param filter
+		 *  Only objects accepted by it are returned
+		 * @return
+		 *  Same objects as Query(frustum, filter)
+		 */
+        std::vector<unsigned>       QueryOrdered(Frustum const& frustum, vec3 const& eye, QueryFilter const& filter = {}) const;
+
+		/**
+		 * @brief
+		 *  Frustum vs Bvh on several threads, for wide frustums over large scenes. The upper tree is
+		 *  culled until there are enough independent subtrees, which workers cull into their own output
+		 *  chunks. The chunks are joined in the order the serial query visits them, so the result is
+		 *  identical to Query(frustum, filter). Stats of the workers are added to the calling thread.
+		 * @param threadCount
+		 *  Threads culling, including the calling one. 0 uses every cpu.
+		 * @param filter
+		 *  Only objects accepted by it are returned
+		 * @return
+		 *  Same ids in the same order as Query(frustum, filter)
+		 */
+        std::vector<unsigned>       QueryParallel(Frustum const& frustum, unsigned threadCount = 0, QueryFilter const& filter = {}) const;
+
+		/**
+		 * @brief
+		 *  Line of sight between every pair of agents. A pair sees each other if no object bounding
+		 *  volume touches the segment between them. Each pair is traced once, agents are swept along
+		 *  x so pairs beyond the cutoff are skipped, and the segments sharing an origin traverse the
+		 *  tree together: a node is only entered by the segments still unblocked that cross it.
+		 *  Origins are spread over threads.
+		 *  An object containing an agent blocks all of its lines, exclude such objects (e.g. the
+		 *  agents themselves) with the filter.
+		 * @param positions
+		 *  Eye position of every agent
+		 * @param maxDistance
+		 *  Pairs further apart never see each other and are not traced
+		 * @param threadCount
+		 *  Threads tracing, including the calling one. 0 uses every cpu.
+		 * @param filter
+		 *  Only objects accepted by it block the sight
+		 * @return
+		 *  Symmetric matrix, the diagonal is left clear. Stats of the workers are added to the calling thread.
+		 */
+        VisibilityMatrix            QueryLineOfSight(std::span<vec3 const> positions, float maxDistance = std::numeric_limits<float>::max(), unsigned threadCount = 0, QueryFilter const& filter = {}) const;
+
+		/**
+		 * @brief
+		 *  Peforms convex volume vs Bvh, for light volumes, portals or clip regions. Like the frustum
+		 *  query, children only test the planes their parent straddles and fully inside subtrees are
+		 *  emitted without further tests.
+		 * @param planes
+		 *  Planes bounding the volume with the normals pointing outwards, at most cMaxConvexPlanes
+		 * @param filter
+		 *  Only objects accepted by it are returned
+		 * @return
+		 *  Vector of unsigned integers representing the object ids that are inside or intersect the volume
+		 */
+        std::vector<unsigned>       Query(std::span<Plane const> planes, QueryFilter const& filter = {}) const;
+
+		/**
+		 * @brief
+		 *  Peforms cone vs Bvh, for vision cones, spotlights or area of effect. Nodes use the cheap
+		 *  conservative test of Cone::classify, fully inside subtrees are emitted without further
+		 *  tests, objects of the leaves reached use the exact Cone::intersects.
+		 * @param cone
+		 *  Half angle in (0, pi/2], range at least 0
+		 * @param filter
+		 *  Only objects accepted by it are returned
+		 * @return
+		 *  Vector of unsigned integers representing the object ids whose bv overlaps the cone
+		 */
+        std::vector<unsigned>       Query(Cone const& cone, QueryFilter const& filter = {}) const;
 
 		/**
 		 * @brief
@@ -245,10 +595,88 @@ namespace CS350 {
 		 *  Vector to store all intersected objects
 		 * @param debug_tested_nodes
 		 *  Vector to store all nodes that were tested during the query
+		 * @param filter
+		 *  Only objects accepted by it are hit
 		 * @return
 		 *  Optional unsigned representing the id of the closest intersected object
 		 */
-        std::optional<unsigned>     QueryDebug(Ray const& ray, bool closest_only, std::vector<unsigned>& allIntersectedObjects, std::vector<Node const*>& debug_tested_nodes) const;
+        std::optional<unsigned>     QueryDebug(Ray const& ray, bool closest_only, std::vector<unsigned>& allIntersectedObjects, std::vector<Node const*>& debug_tested_nodes, QueryFilter const& filter = {}) const;
+
+		/**
+		 * @brief
+		 *  Peforms ray vs Bvh query for the closest object only, without debug information
+		 * @param ray
+		 *  Ray to be tested against the Bvh
+		 * @param filter
+		 *  Only objects accepted by it are hit, others do not block the ray
+		 * @return
+		 *  Optional unsigned representing the id of the closest intersected object
+		 */
+        std::optional<unsigned>     Query(Ray const& ray, QueryFilter const& filter = {}) const;
+
+		/**
+		 * @brief
+		 *  Closest hit against the exact geometry of the objects in a single traversal. Objects whose
+		 *  bv the ray misses or enters after tMax are skipped, the others go to the leaf functor, which
+		 *  stores its own payload (normal, triangle, uv...) on a hit. Nodes entered after the closest
+		 *  accepted hit are pruned.
+		 * @param ray
+		 *  Ray to be tested against the Bvh
+		 * @param tMax
+		 *  Nodes and objects entered later are skipped. The leaf functor shrinks it on every accepted
+		 *  hit, so it is the time of the closest one on return.
+		 * @param intersect
+		 *  bool(T object, float& tMax), returns true and lowers tMax to the exact hit time, or false to
+		 *  reject the object. Missing the geometry, a hit at or past tMax or an ignored object are all rejections.
+		 * @param filter
+		 *  Only objects accepted by it reach the functor
+		 * @return
+		 *  Id of the object of the last accepted hit
+		 */
+        template <typename Fn>
+        std::optional<unsigned>     QueryExact(Ray const& ray, float& tMax, Fn&& intersect, QueryFilter const& filter = {}) const;
+
+		/**
+		 * @brief
+		 *  Peforms aabb vs Bvh overlap query
+		 * @param aabb
+		 *  Bounding volume to be tested against the Bvh
+		 * @param filter
+		 *  Only objects accepted by it are returned
+		 * @return
+		 *  Vector of unsigned integers representing the object ids whose bounding volume overlaps the aabb
+		 */
+        std::vector<unsigned>       Query(Aabb const& aabb, QueryFilter const& filter = {}) const;
+
+		/**
+		 * @brief
+		 *  Closest object hit by each ray of a batch. Equivalent to calling Query(ray) on every ray, but
+		 *  several rays are traversed at once: each one advances by a single node and prefetches the next
+		 *  nodes it needs before switching to another ray, hiding memory latency on large trees.
+		 * @param rays
+		 *  Rays to be tested against the Bvh
+		 * @param count
+		 *  Amount of rays
+		 * @param closestObjects
+		 *  Output array of `count` elements, id of the closest object hit by each ray
+		 * @param filter
+		 *  Same filter for every ray
+		 */
+        void                        QueryBatch(Ray const* rays, size_t count, std::optional<unsigned>* closestObjects, QueryFilter const& filter = {}) const;
+
+		/**
+		 * @brief
+		 *  Objects containing each point of a batch, interleaving the traversals like the ray batch
+		 * @param points
+		 *  Points to be tested against the Bvh
+		 * @param count
+		 *  Amount of points
+		 * @param objectsIds
+		 *  Resized to `count`, ids of the objects whose bounding volume contains each point
+		 * @param filter
+		 *  Same filter for every point
+		 */
+        void                        QueryBatch(vec3 const* points, size_t count, std::vector<std::vector<unsigned>>& objectsIds, QueryFilter const& filter = {}) const;
 
         // Debug functions
 		/**
@@ -329,37 +757,130 @@ namespace CS350 {
              */
             NodeCosts(Node* _node, T object, float costToNode, unsigned int _level);
 
+            /**
+             * @brief
+             *  Same as above, using a copy of the node bounding volume that was read atomically
+             */
+            NodeCosts(Node* _node, BV const& nodeBv, T object, float costToNode, unsigned int _level);
+
             Node* node = nullptr;
             float rootToNewParentCost;
             float rootToNodeCost;
             unsigned int level;
 
-            Aabb newAabb;
+            BV newBv;
             float newGeometrics;
             float newGeometricsChange;
         };
+
+        /**
+         * @brief
+         *  Links the object following a path planned by InsertConcurrent
+         * @param path
+         *  Planned path from the root
+         * @param target
+         *  Index of the node that receives the object or gets a new parent
+         * @param leafCandidate
+         *  Target is the leaf and the object goes in it, unless the leaf is full
+         * @return
+         *  False if the path changed since it was planned, nothing was linked
+         */
+        bool                        InsertConcurrentCommit(T object, std::vector<NodeCosts> const& path, size_t target, bool leafCandidate, BvhBuildConfig const& config);
+
+        /**
+         * @brief
+         *  Insert with InsertPolicy::eSurfaceArea. The sibling is the node whose merge with the object
+         *  adds the least area, counting the growth of its ancestors (the inherited cost). Nodes are
+         *  visited cheapest inherited cost first, a subtree is skipped once the area of the object
+         *  plus its inherited cost, a lower bound of any node below, is not better than the best found.
+         *  The object joins the sibling if it is a leaf with room or at config.maxDepth, otherwise
+         *  both get a new parent.
+         */
+        void                        InsertSurfaceArea(T object, BvhBuildConfig const& config);
+
+        /**
+         * @brief
+         *  Shared traversal of the frustum and convex volume queries
+         * @param classify
+         *  SideResult(Aabb const& bv, uint32_t& planeMask), clears the planes the bv is inside of
+         * @param start
+         *  Root of the subtree to query
+         * @param planeMask
+         *  Planes tested at the start node
+         * @param filter
+         *  Objects to return
+         * @param eye
+         *  Visits near to far from it when not null
+         * @param objectsIds
+         *  Ids of the visible objects are appended to it
+         * @param overlapsObject
+         *  bool(Aabb const& bv), exact test of the objects of the leaves reached when given,
+         *  otherwise they are classified like the nodes
+         */
+        template <typename Fn, typename ObjectFn = std::nullptr_t>
+        void                        QueryPlanes(Fn const& classify, Node* start, uint32_t planeMask, QueryFilter const& filter, vec3 const* eye, std::vector<unsigned>& objectsIds, ObjectFn const& overlapsObject = nullptr) const;
+
+        /**
+         * @brief
+         *  Appends every object of a subtree accepted by the filter, skipping subtrees without any
+         * @param eye
+         *  If not null, objects are appended near to far from it like QueryOrdered
+         */
+        void                        AppendObjects(Node const* node, QueryFilter const& filter, vec3 const* eye, std::vector<unsigned>& objectsIds) const;
+
+        /**
+         * @brief
+         *  Top-down builds: orders the objects of a node along the axis of its split, see SplitPolicy
+         * @param box
+         *  Bounds of the objects
+         * @return
+         *  Objects of the left child, at the front of the range
+         */
+        template <typename IT> static size_t SplitObjects(IT first, IT last, Aabb const& box, BvhBuildConfig const& config);
+
+        /**
+         * @brief
+         *  Splits a node left pending by BuildLazy before a query reads its children or objects.
+         *  Cheap for every other node, a single load.
+         * @return
+         *  The same node
+         */
+        Node const*                 Expand(Node const* node) const;
+
+        /**
+         * @brief
+         *  BuildLazy: whether a node of `count` objects is split, same rules as BuildTopDown except
+         *  that maxDepth is checked against the level of the node, not the height of the whole tree
+         */
+        bool                        IsLazySplit(Node const* node, size_t count) const;
+
+        /**
+         * @brief
+         *  Insert and InsertConcurrent during a sliced build, remembers the object for the new tree
+         */
+        void                        RecordBuildInsert(T object, BvhBuildConfig const& config);
     };
 
     /**
      * @brief
      *  Prints information about the BVH in a readable way
      */
-    template <typename T>
-    void Bvh<T>::DumpInfo(std::ostream& os) const {
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::DumpInfo(std::ostream& os) const {
         os << std::fixed;
         os << "GENERAL INFO: \n"
            << std::setw(20) << "Depth: " << Depth() << "\n"
            << std::setw(20) << "Size: " << Size() << "\n"
            << std::endl;
-        TraverseLevelOrder([&](Bvh<T>::Node const* n) { DumpInfo(os, n); });
+        TraverseLevelOrder([&](Bvh<T, BV>::Node const* n) { DumpInfo(os, n); });
     }
 
     /**
      * @brief
      *  Shows information about the node in a readable way
      */
-    template <typename T>
-    void Bvh<T>::DumpInfo(std::ostream& os, Node const* n) const {
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::DumpInfo(std::ostream& os, Node const* n) const {
         if (!n) {
             return;
         }
@@ -368,7 +889,7 @@ namespace CS350 {
         // Node info
         auto const& bv = n->bv;
         os << "NODE [" << n << "] \n"
-           << std::setw(20) << "BV: " << bv << "\n"
+           << std::setw(20) << "BV: " << bv.bounds() << "\n"
            << std::setw(20) << "Volume: " << bv.volume() << "\n"
            << std::setw(20) << "Surface area: " << bv.surface_area() << "\n";
 
@@ -392,22 +913,23 @@ namespace CS350 {
         os << std::endl;
     }
 
-    template <typename T>
-    void Bvh<T>::DumpGraph(std::ostream& os) const {
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::DumpGraph(std::ostream& os) const {
         os << "digraph bvh {\n";
         os << "\tnode[group=\"\", shape=none, style=\"rounded,filled\", fontcolor=\"#101010\"]\n";
         // Create all nodes
         int                                  lastNodeId = 0;
         std::unordered_map<Node const*, int> nodeIds;
-        TraverseLevelOrder([&](Bvh<T>::Node const* node) {
+        TraverseLevelOrder([&](Bvh<T, BV>::Node const* node) {
             nodeIds[node]     = lastNodeId;
-            std::string label = fmt::format("[{:.02f},{:.02f},{:.02f}]\\n[{:.02f},{:.02f},{:.02f}]\\nSA: {:.02f}\\nVOL: {:.02f}",
-                                            node->bv.min.x,
-                                            node->bv.min.y,
-                                            node->bv.min.z,
-                                            node->bv.max.x,
-                                            node->bv.max.y,
-                                            node->bv.max.z,
+            Aabb        bounds = node->bv.bounds();
+            std::string label  = fmt::format("[{:.02f},{:.02f},{:.02f}]\\n[{:.02f},{:.02f},{:.02f}]\\nSA: {:.02f}\\nVOL: {:.02f}",
+                                            bounds.min.x,
+                                            bounds.min.y,
+                                            bounds.min.z,
+                                            bounds.max.x,
+                                            bounds.max.y,
+                                            bounds.max.z,
                                             node->bv.surface_area(),
                                             node->bv.volume());
             if (node->IsLeaf()) {
@@ -418,7 +940,7 @@ namespace CS350 {
         });
 
         // Create all links
-        TraverseLevelOrder([&](Bvh<T>::Node const* node) {
+        TraverseLevelOrder([&](Bvh<T, BV>::Node const* node) {
             auto nodeId = nodeIds.at(node);
             if (!node->IsLeaf()) {
                 auto nodeLeft = nodeIds.at(node->children[0]);
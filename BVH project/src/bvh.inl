@@ -17,24 +17,174 @@
 #include "bvh.hpp"
 #include "shapes.hpp"
 #include "logging.hpp"
+#include "stats.hpp"
 
 #include <array>
 #include <iomanip>
+#include <chrono>
 #include <cstring>
+#include <deque>
 #include <limits>
 #include <type_traits>
 #include <unordered_map>
 #include <algorithm>
 #include <stack>
+#include <thread>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h> // _mm_prefetch
+#endif
 
 
 
 namespace CS350 {
 
-    constexpr float cEpsilon3 = 1e-3f;
+    constexpr float  cEpsilon3       = 1e-3f;
+    constexpr size_t cBatchLanes     = 16; // Queries traversed at once by QueryBatch
+    constexpr size_t cTasksPerThread = 8;  // Subtrees per thread of QueryParallel, evens out unbalanced subtrees
+
+    /**
+     * @brief
+     *  Hints the cpu to start loading `address` into the cache, without waiting for it
+     */
+    inline void Prefetch(void const* address) {
+#if defined(__GNUC__) || defined(__clang__)
+        __builtin_prefetch(address);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        _mm_prefetch(static_cast<char const*>(address), _MM_HINT_T0);
+#else
+        (void)address;
+#endif
+    }
+
+    /**
+     * @brief
+     *  Reads a bounding volume that other threads may be expanding, one component at a time
+     */
+    inline Aabb LoadAabb(Aabb const& bv) {
+        Aabb& shared = const_cast<Aabb&>(bv); // atomic_ref needs a non const reference, only loads are done
+        Aabb  result;
+        for (int i = 0; i < 3; i++) {
+            result.min[i] = std::atomic_ref<float>(shared.min[i]).load(std::memory_order_relaxed);
+            result.max[i] = std::atomic_ref<float>(shared.max[i]).load(std::memory_order_relaxed);
+        }
+        return result;
+    }
+
+    /**
+     * @brief
+     *  Writes a bounding volume that other threads may be reading with LoadAabb
+     */
+    inline void StoreAabb(Aabb& bv, Aabb const& value) {
+        for (int i = 0; i < 3; i++) {
+            std::atomic_ref<float>(bv.min[i]).store(value.min[i], std::memory_order_relaxed);
+            std::atomic_ref<float>(bv.max[i]).store(value.max[i], std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * @brief
+     *  Reads a node pointer published by another thread with StorePointer
+     */
+    template <typename N>
+    N* LoadPointer(N* const& pointer) {
+        return std::atomic_ref<N*>(const_cast<N*&>(pointer)).load(std::memory_order_acquire);
+    }
+
+    /**
+     * @brief
+     *  Publishes a node pointer, everything written to the node before is visible to LoadPointer
+     */
+    template <typename N>
+    void StorePointer(N*& pointer, N* value) {
+        std::atomic_ref<N*>(pointer).store(value, std::memory_order_release);
+    }
+
+    inline void SpinLock(std::atomic<bool>& lock) {
+        while (lock.exchange(true, std::memory_order_acquire)) {
+            while (lock.load(std::memory_order_relaxed)) {
+                std::this_thread::yield();
+            }
+        }
+    }
+
+    inline void SpinUnlock(std::atomic<bool>& lock) {
+        lock.store(false, std::memory_order_release);
+    }
+
+    /**
+     * @brief
+     *  Appends the ids of a leaf bucket sorted by their distance, and empties the bucket
+     */
+    inline void AppendNearToFar(std::vector<std::pair<float, unsigned>>& bucket, std::vector<unsigned>& objectsIds) {
+        std::sort(bucket.begin(), bucket.end());
+        for (auto const& [distance, id] : bucket) {
+            objectsIds.push_back(id);
+        }
+        bucket.clear();
+    }
+
+    /**
+     * @brief
+     *  Any bounding volume against the planes of the mask, one plane at a time. Planes the volume is
+     *  inside of are cleared from the mask.
+     */
+    template <typename BV>
+    SideResult ClassifyPlaneMask(Plane const* planes, BV const& bv, uint32_t& planeMask) {
+        uint32_t remaining = planeMask;
+        while (remaining != 0) {
+            int index = std::countr_zero(remaining);
+            remaining &= remaining - 1u;
+
+            SideResult result;
+            if constexpr (std::is_same_v<BV, Sphere>) {
+                // Frustum planes are not normalized, the radius has to be scaled like the distance
+                Plane const& plane = planes[index];
+                result             = plane.classify(Sphere(bv.center, bv.radius * glm::length(plane.normal)));
+            } else {
+                result = planes[index].classify(bv);
+            }
+            if (result == SideResult::eOUTSIDE) {
+                return SideResult::eOUTSIDE;
+            }
+            if (result == SideResult::eINSIDE) {
+                planeMask &= ~(1u << index);
+            }
+        }
+        return planeMask == 0 ? SideResult::eINSIDE : SideResult::eINTERSECTING;
+    }
+
+    /**
+     * @brief
+     *  Frustum::classify for any bounding volume, counted the same
+     */
+    template <typename BV>
+    SideResult ClassifyFrustum(Frustum const& frustum, BV const& bv, uint32_t& planeMask) {
+        if constexpr (std::is_same_v<BV, Aabb>) {
+            return frustum.classify(bv, planeMask);
+        } else {
+            Stats::Instance().frustumVsAabb++;
+            return ClassifyPlaneMask(frustum.planes.data(), bv, planeMask);
+        }
+    }
 
-    template <typename T>
-    void Bvh<T>::Node::AddObject(T object) {
+    /**
+     * @brief
+     *  ClassifyConvex for any bounding volume, counted the same
+     */
+    template <typename BV>
+    SideResult ClassifyConvexVolume(std::span<Plane const> planes, BV const& bv, uint32_t& planeMask) {
+        if constexpr (std::is_same_v<BV, Aabb>) {
+            return ClassifyConvex(planes, bv, planeMask);
+        } else {
+            Stats::Instance().convexVsAabb++;
+            planeMask &= FullPlaneMask(planes.size());
+            return ClassifyPlaneMask(planes.data(), bv, planeMask);
+        }
+    }
+
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::Node::AddObject(T object) {
         //check if node already inside 
         if (object->bvhInfo.node == this) {
             return;
@@ -73,12 +223,14 @@ namespace CS350 {
         //set last object to be the new object
         lastObject = object;
 
+        layers |= ObjectLayers(object);
+
 
         
     }
 
-    template <typename T>
-    int Bvh<T>::Node::Depth() const { 
+    template <typename T, BoundingVolume BV>
+    int Bvh<T, BV>::Node::Depth() const { 
 
 		//recurse down the tree until we reach a leaf node
         if (IsLeaf()) {
@@ -93,8 +245,8 @@ namespace CS350 {
         return 1 + glm::max(child0Depth, child1Depth);
     }
 
-    template <typename T>
-    int Bvh<T>::Node::Size() const {
+    template <typename T, BoundingVolume BV>
+    int Bvh<T, BV>::Node::Size() const {
 
 		//recurse down the tree until we reach a leaf node
         if ( IsLeaf()) {
@@ -109,15 +261,15 @@ namespace CS350 {
         return count;
     }
     
-    template <typename T>
-    bool Bvh<T>::Node::IsLeaf() const {
+    template <typename T, BoundingVolume BV>
+    bool Bvh<T, BV>::Node::IsLeaf() const {
         //If children 0 is null, children 1 will also be null
 		//Since children 0 is always created before children 1
         return children[0] ? false : true;
     }
 
-    template <typename T>
-    unsigned Bvh<T>::Node::ObjectCount() const {
+    template <typename T, BoundingVolume BV>
+    unsigned Bvh<T, BV>::Node::ObjectCount() const {
         unsigned int count = 0;
         
         T object = firstObject;
@@ -128,9 +280,9 @@ namespace CS350 {
         return count;
     }
 
-    template <typename T>
+    template <typename T, BoundingVolume BV>
     template <typename Fn> 
-    void Bvh<T>::Node::TraverseLevelOrder(Fn func) const {
+    void Bvh<T, BV>::Node::TraverseLevelOrder(Fn func) const {
 
         std::queue<const Node*> queue;
         queue.push(this);
@@ -153,9 +305,9 @@ namespace CS350 {
 
     }
 
-    template <typename T>
+    template <typename T, BoundingVolume BV>
     template <typename Fn>
-    void Bvh<T>::Node::TraverseLevelOrderObjects(Fn func) const {
+    void Bvh<T, BV>::Node::TraverseLevelOrderObjects(Fn func) const {
 
 
         std::queue<const Node*> queue;
@@ -190,30 +342,35 @@ namespace CS350 {
     }
 
 
-    template <typename T>
-    Bvh<T>::Bvh() :
+    template <typename T, BoundingVolume BV>
+    Bvh<T, BV>::Bvh() :
         mRoot{nullptr},
         mObjectCount{0}
     {}
 
-    template <typename T>
-    Bvh<T>::~Bvh() {
-        if (mRoot != nullptr) {
+    template <typename T, BoundingVolume BV>
+    Bvh<T, BV>::~Bvh() {
+        if (mRoot != nullptr || mSlicedBuild != nullptr) {
 
             Clear();
         }
 
     }
 
-    template <typename T>
+    template <typename T, BoundingVolume BV>
     template <typename IT> 
-    void Bvh<T>::BuildTopDown(IT begin, IT end, BvhBuildConfig const& config, Node* parentNode) {
+    void Bvh<T, BV>::BuildTopDown(IT begin, IT end, BvhBuildConfig const& config, Node* parentNode) {
 
         //check if iterator is valid
         if (begin == end || *begin == nullptr) {
             return;
         }
 
+        // A new whole tree wins over a sliced build still in progress
+        if (parentNode == nullptr) {
+            CancelBuild();
+        }
+
 		std::vector<T> objects;
 
         
@@ -234,7 +391,16 @@ namespace CS350 {
         }
 
 
-        Node* workingNode = new Node(Aabb(minPoint, maxPoint));
+        // The union of the object volumes is tighter than the volume around their aabb
+        Aabb box(minPoint, maxPoint);
+        BV   boundingVolume(box);
+        if constexpr (!std::is_same_v<BV, Aabb>) {
+            boundingVolume = BV((*begin)->bv);
+            for (auto it = begin + 1; it != end; it++) {
+                boundingVolume = BV(boundingVolume, BV((*it)->bv));
+            }
+        }
+        Node* workingNode = new Node(boundingVolume);
 
         //check if object is already inside node
         if (parentNode != nullptr) {
@@ -255,8 +421,12 @@ namespace CS350 {
 
         }
         else {
-            mRoot = workingNode;
+            mRoot        = workingNode;
+            mBuildLevel  = 0;
+            mBuildHeight = 0;
+            mLazy        = false;
         }
+        mBuildHeight = std::max(mBuildHeight, mBuildLevel);
 
         // if node is root, update object count
         if (workingNode == mRoot) {
@@ -264,7 +434,7 @@ namespace CS350 {
         }
 
         //stop if config condition met
-		unsigned int currentDepth = static_cast<unsigned int>(mRoot->Depth());
+		unsigned int currentDepth = mBuildHeight;
         if ((countObject <= config.minObjects) ||
             (workingNode->bv.volume() <= config.minVolume) ||
             (currentDepth >= config.maxDepth)) {
@@ -288,35 +458,184 @@ namespace CS350 {
 
 
 
-        //find the greatest axis
-        int axis = workingNode->bv.longest_axis();
-
-		std::sort(objects.begin(), objects.end(),[&](const T& lhs, const T& rhs) {
-				return lhs->bv.get_center()[axis] < rhs->bv.get_center()[axis];
-			});
-
-		//split object in the mean
-		int splitIndex = static_cast<int>(static_cast<float>(objects.size()) * 0.5f);
+		//split object in the mean, or where the config says
+		auto splitIndex = static_cast<std::ptrdiff_t>(SplitObjects(objects.begin(), objects.end(), box, config));
 
         std::vector<T> split1(objects.begin(), objects.begin() + splitIndex);
         std::vector<T> split2(objects.begin() + splitIndex, objects.end());
         //recurse
+        ++mBuildLevel;
         BuildTopDown(split1.begin(), split1.end(), config, workingNode);
         BuildTopDown(split2.begin(), split2.end(), config, workingNode);
+        --mBuildLevel;
+
+        workingNode->layers = workingNode->children[0]->layers | workingNode->children[1]->layers;
 
 
     }
 
-    template <typename T>
+    template <typename T, BoundingVolume BV>
     template <typename IT> 
-    void Bvh<T>::BuildBottomUp(IT begin, IT end, BvhBuildConfig const& config) {
+    void Bvh<T, BV>::BuildBottomUp(IT begin, IT end, BvhBuildConfig const& config) {
         
     }
 
 
-    template <typename T>
+    template <typename T, BoundingVolume BV>
+    template <typename IT>
+    void Bvh<T, BV>::BuildLazy(IT begin, IT end, BvhBuildConfig const& config) {
+        Clear();
+        if (begin == end) {
+            return;
+        }
+
+        BV boundingVolume((*begin)->bv);
+        for (auto it = begin + 1; it != end; it++) {
+            boundingVolume = BV(boundingVolume, BV((*it)->bv));
+        }
+        mRoot       = new Node(boundingVolume);
+        mLazy       = true;
+        mLazyConfig = config;
+        for (auto it = begin; it != end; it++) {
+            (*it)->bvhInfo = {};
+            mRoot->AddObject(*it);
+            ++mObjectCount;
+        }
+        mRoot->pending.store(IsLazySplit(mRoot, mObjectCount), std::memory_order_release);
+    }
+
+    template <typename T, BoundingVolume BV>
+    template <typename IT>
+    void Bvh<T, BV>::BeginBuild(IT begin, IT end, BvhBuildConfig const& config) {
+        CancelBuild();
+        if (begin == end) {
+            return;
+        }
+
+        mSlicedBuild         = std::make_unique<SlicedBuild>();
+        mSlicedBuild->objects.assign(begin, end);
+        mSlicedBuild->config = config;
+        mSlicedBuild->tasks.push_back({ nullptr, 0, 0, mSlicedBuild->objects.size(), 0 });
+    }
+
+    template <typename T, BoundingVolume BV>
+    bool Bvh<T, BV>::Step(unsigned budgetUs) {
+        if (mSlicedBuild == nullptr) {
+            return false;
+        }
+
+        auto         deadline = std::chrono::steady_clock::now() + std::chrono::microseconds(budgetUs);
+        SlicedBuild& build    = *mSlicedBuild;
+        do {
+            if (build.tasks.empty()) {
+                break;
+            }
+            auto task = build.tasks.back();
+            build.tasks.pop_back();
+
+            // Same node BuildTopDown creates for the range
+            auto first = build.objects.begin() + static_cast<std::ptrdiff_t>(task.first);
+            auto last  = build.objects.begin() + static_cast<std::ptrdiff_t>(task.last);
+            vec3 maxPoint{ (*first)->bv.max };
+            vec3 minPoint{ (*first)->bv.min };
+            for (auto it = first + 1; it != last; it++) {
+                maxPoint = glm::max(maxPoint, (*it)->bv.max);
+                minPoint = glm::min(minPoint, (*it)->bv.min);
+            }
+            Aabb box(minPoint, maxPoint);
+            BV   boundingVolume(box);
+            if constexpr (!std::is_same_v<BV, Aabb>) {
+                boundingVolume = BV((*first)->bv);
+                for (auto it = first + 1; it != last; it++) {
+                    boundingVolume = BV(boundingVolume, BV((*it)->bv));
+                }
+            }
+            Node* node = new Node(boundingVolume);
+            if (task.parent != nullptr) {
+                task.parent->children[task.side] = node;
+            } else {
+                build.root = node;
+            }
+            build.height = std::max(build.height, task.level);
+
+            size_t count = task.last - task.first;
+            if (count <= build.config.minObjects ||
+                node->bv.volume() <= build.config.minVolume ||
+                build.height >= build.config.maxDepth ||
+                count < 2) {
+                build.leaves.push_back({ node, task.first, task.last });
+                build.placed += count;
+                continue;
+            }
+
+            size_t splitIndex = SplitObjects(first, last, box, build.config);
+
+            // The left half is built first, like the recursion of BuildTopDown
+            build.internals.push_back(node);
+            build.tasks.push_back({ node, 1, task.first + splitIndex, task.last, task.level + 1 });
+            build.tasks.push_back({ node, 0, task.first, task.first + splitIndex, task.level + 1 });
+        } while (std::chrono::steady_clock::now() < deadline);
+
+        if (!build.tasks.empty()) {
+            return false;
+        }
+
+        // Done, the objects leave the current tree for the new one
+        std::unique_ptr<SlicedBuild> done = std::move(mSlicedBuild);
+        Clear();
+        for (T object : done->objects) {
+            object->bvhInfo = {};
+        }
+        for (auto const& leaf : done->leaves) {
+            for (size_t i = leaf.first; i < leaf.last; ++i) {
+                leaf.node->AddObject(done->objects[i]);
+            }
+        }
+        for (auto it = done->internals.rbegin(); it != done->internals.rend(); ++it) {
+            (*it)->layers = (*it)->children[0]->layers | (*it)->children[1]->layers;
+        }
+        mRoot        = done->root;
+        mObjectCount = static_cast<unsigned>(done->objects.size());
+        mBuildHeight = done->height;
+
+        // Objects inserted during the build, unless they were part of it
+        for (auto const& [object, config] : done->inserted) {
+            if (object->bvhInfo.node == nullptr) {
+                Insert(object, config);
+            }
+        }
+        return true;
+    }
+
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::RecordBuildInsert(T object, BvhBuildConfig const& config) {
+        SpinLock(mSlicedBuild->insertedLocked);
+        mSlicedBuild->inserted.emplace_back(object, config);
+        SpinUnlock(mSlicedBuild->insertedLocked);
+    }
+
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::CancelBuild() {
+        if (mSlicedBuild == nullptr) {
+            return;
+        }
+        if (mSlicedBuild->root != nullptr) {
+            mSlicedBuild->root->TraverseLevelOrder([](Node const* node) { delete node; });
+        }
+        mSlicedBuild.reset();
+    }
+
+    template <typename T, BoundingVolume BV>
+    float Bvh<T, BV>::buildProgress() const {
+        if (mSlicedBuild == nullptr) {
+            return 0.0f;
+        }
+        return static_cast<float>(mSlicedBuild->placed) / static_cast<float>(mSlicedBuild->objects.size());
+    }
+
+    template <typename T, BoundingVolume BV>
     template <typename IT>
-    void Bvh<T>::Insert(IT begin, IT end, BvhBuildConfig const& config) {
+    void Bvh<T, BV>::Insert(IT begin, IT end, BvhBuildConfig const& config) {
         for (auto it = begin; it != end; it++) {
 
             Insert(*it, config);
@@ -326,16 +645,23 @@ namespace CS350 {
     }
 
 
-    template <typename T>
-    void Bvh<T>::Insert(T object, BvhBuildConfig const& config) {
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::Insert(T object, BvhBuildConfig const& config) {
+        if (mSlicedBuild != nullptr) {
+            RecordBuildInsert(object, config);
+        }
 
         ++mObjectCount;
         if (mRoot == nullptr) {
-            mRoot = new Node(object->bv);
+            mRoot = new Node(BV(object->bv));
             mRoot->AddObject(object);
 
             return;
         }
+        if (config.insertPolicy == InsertPolicy::eSurfaceArea) {
+            InsertSurfaceArea(object, config);
+            return;
+        }
         
 
         
@@ -400,7 +726,8 @@ namespace CS350 {
                 // Priority to check if leaf less than min object or leaf node hits max depth, insert object into leaf node
                 if (leafNode->node->ObjectCount() < config.minObjects || leafNode->level >= config.maxDepth) {
                     for (auto& nodeCost : cheapestPath) {
-                        nodeCost.node->bv = nodeCost.newAabb;
+                        nodeCost.node->bv = nodeCost.newBv;
+                        nodeCost.node->layers |= ObjectLayers(object);
                     }
 
                     leafNode->node->AddObject(object);
@@ -410,12 +737,13 @@ namespace CS350 {
 
                 //leaf node is larger than min volume, and wants to continue to expand, create new node instead
                 //Do this as some object may be larger than min volume
-                if (leafNode->newAabb.volume() >= config.minVolume && leafNode->newGeometricsChange > 0.f) {
+                if (leafNode->newBv.volume() >= config.minVolume && leafNode->newGeometricsChange > 0.f) {
                     smallestCostIndex = static_cast<int>(cheapestPath.size()) - 1;
                 }
                 else{
                     for (auto& nodeCost : cheapestPath) {
-                        nodeCost.node->bv = nodeCost.newAabb;
+                        nodeCost.node->bv = nodeCost.newBv;
+                        nodeCost.node->layers |= ObjectLayers(object);
                     }
 
                     leafNode->node->AddObject(object);
@@ -432,16 +760,18 @@ namespace CS350 {
 
         // check if smallest cose node is root, aka index 0
          if (cheapestPath[smallestCostIndex].node == mRoot) {
-            mRoot = new Node(cheapestPath[smallestCostIndex].newAabb);
+            mRoot = new Node(cheapestPath[smallestCostIndex].newBv);
             mRoot->children[0] = cheapestPath[smallestCostIndex].node;
-            mRoot->children[1] = new Node(object->bv);
+            mRoot->children[1] = new Node(BV(object->bv));
             mRoot->children[1]->AddObject(object);
+            mRoot->layers = mRoot->children[0]->layers | mRoot->children[1]->layers;
             return;
         }
 
         //expand the size of all nodes except for smallesCost node
         for (int n{}; n < smallestCostIndex; n++) {
-            cheapestPath[n].node->bv = cheapestPath[n].newAabb;
+            cheapestPath[n].node->bv = cheapestPath[n].newBv;
+            cheapestPath[n].node->layers |= ObjectLayers(object);
         }
 
 
@@ -454,17 +784,278 @@ namespace CS350 {
         }
 
        
-        parentNode->children[child] = new Node(cheapestPath[smallestCostIndex].newAabb);
+        parentNode->children[child] = new Node(cheapestPath[smallestCostIndex].newBv);
 
         parentNode->children[child]->children[child] = cheapestPath[smallestCostIndex].node;
-        parentNode->children[child]->children[child^1] = new Node(object->bv);
+        parentNode->children[child]->children[child^1] = new Node(BV(object->bv));
         parentNode->children[child]->children[child^1]->AddObject(object);
+        parentNode->children[child]->layers = cheapestPath[smallestCostIndex].node->layers | ObjectLayers(object);
 
      
     }
 
-    template <typename T>
-    void Bvh<T>::Clear() {
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::InsertSurfaceArea(T object, BvhBuildConfig const& config) {
+        BV    objectBv(object->bv);
+        float objectArea = objectBv.surface_area();
+
+        // Nodes reached by the search, with the one they were reached from to walk the path back
+        struct Candidate {
+            Node*    node;
+            size_t   parent;
+            unsigned level;
+            float    inheritedCost; // Growth of the area of every ancestor
+        };
+        std::vector<Candidate> candidates{ { mRoot, 0, 0, 0.f } };
+        auto                   cheapest = [&](size_t lhs, size_t rhs) { return candidates[lhs].inheritedCost > candidates[rhs].inheritedCost; };
+        std::priority_queue<size_t, std::vector<size_t>, decltype(cheapest)> queue(cheapest);
+        queue.push(0);
+
+        size_t best     = 0;
+        float  bestCost = std::numeric_limits<float>::max();
+        while (!queue.empty()) {
+            Candidate candidate = candidates[queue.top()];
+            size_t    index     = queue.top();
+            queue.pop();
+
+            // Cheapest first, nothing left can beat the best
+            if (candidate.inheritedCost + objectArea >= bestCost) {
+                break;
+            }
+
+            float mergedArea = BV(candidate.node->bv, objectBv).surface_area();
+            float cost       = mergedArea + candidate.inheritedCost;
+            if (cost < bestCost) {
+                bestCost = cost;
+                best     = index;
+            }
+
+            if (candidate.node->IsLeaf()) {
+                continue;
+            }
+            float childInheritedCost = candidate.inheritedCost + mergedArea - candidate.node->bv.surface_area();
+            if (childInheritedCost + objectArea < bestCost) {
+                for (Node* child : candidate.node->children) {
+                    candidates.push_back({ child, index, candidate.level + 1, childInheritedCost });
+                    queue.push(candidates.size() - 1);
+                }
+            }
+        }
+
+        // Every ancestor of the sibling grows to hold the object
+        for (size_t i = best; i != 0;) {
+            i          = candidates[i].parent;
+            Node* node = candidates[i].node;
+            node->bv   = BV(node->bv, objectBv);
+            node->layers |= ObjectLayers(object);
+        }
+
+        Candidate const& target = candidates[best];
+        Node*            sibling = target.node;
+        if (sibling->IsLeaf() && (sibling->ObjectCount() < config.minObjects || target.level >= config.maxDepth)) {
+            sibling->bv = BV(sibling->bv, objectBv);
+            sibling->AddObject(object);
+            return;
+        }
+
+        Node* leaf = new Node(objectBv);
+        leaf->AddObject(object);
+        Node* parent        = new Node(BV(sibling->bv, objectBv));
+        parent->children[0] = sibling;
+        parent->children[1] = leaf;
+        parent->layers      = sibling->layers | leaf->layers;
+        if (best == 0) {
+            mRoot = parent;
+        } else {
+            Node* grandParent = candidates[target.parent].node;
+            grandParent->children[grandParent->children[0] == sibling ? 0 : 1] = parent;
+        }
+    }
+
+    template <typename T, BoundingVolume BV>
+    template <typename IT>
+    void Bvh<T, BV>::InsertConcurrent(IT begin, IT end, BvhBuildConfig const& config) {
+        for (auto it = begin; it != end; it++) {
+            InsertConcurrent(*it, config);
+        }
+    }
+
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::InsertConcurrent(T object, BvhBuildConfig const& config) {
+        static_assert(std::is_same_v<BV, Aabb>, "bvh.inl: concurrent insertion expands Aabb nodes one atomic component at a time");
+
+        if (mSlicedBuild != nullptr) {
+            RecordBuildInsert(object, config);
+        }
+        std::atomic_ref<unsigned>(mObjectCount).fetch_add(1, std::memory_order_relaxed);
+
+        std::vector<NodeCosts> path;
+        for (;;) {
+            Node* root = LoadPointer(mRoot);
+            if (root == nullptr) {
+                SpinLock(mRootLocked);
+                bool created = LoadPointer(mRoot) == nullptr;
+                if (created) {
+                    Node* node = new Node(BV(object->bv));
+                    node->AddObject(object);
+                    StorePointer(mRoot, node);
+                }
+                SpinUnlock(mRootLocked);
+                if (created) {
+                    return;
+                }
+                continue;
+            }
+
+            // Plan without locks, same greedy descent and costs as Insert
+            path.clear();
+            size_t smallestCostIndex = 0;
+            Node*  node              = root;
+            float  costToNode        = 0.f;
+            for (unsigned level = 0;; level++) {
+                path.emplace_back(node, LoadAabb(node->bv), object, costToNode, level);
+                if (path.back().rootToNewParentCost <= path[smallestCostIndex].rootToNewParentCost + cEpsilon3) {
+                    smallestCostIndex = path.size() - 1;
+                }
+
+                Node* firstChild  = LoadPointer(node->children[0]);
+                Node* secondChild = LoadPointer(node->children[1]);
+                if (firstChild == nullptr) {
+                    break;
+                }
+
+                //continue in the child whose volume grows the least
+                NodeCosts first(firstChild, LoadAabb(firstChild->bv), object, 0.f, 0);
+                NodeCosts second(secondChild, LoadAabb(secondChild->bv), object, 0.f, 0);
+                node       = second.newGeometricsChange < first.newGeometricsChange ? secondChild : firstChild;
+                costToNode = path.back().rootToNodeCost;
+            }
+
+            // The leaf object count needs the leaf lock, the commit decides between filling and splitting it
+            bool   leafCandidate = path.back().rootToNodeCost < path[smallestCostIndex].rootToNewParentCost;
+            size_t target        = leafCandidate ? path.size() - 1 : smallestCostIndex;
+            if (InsertConcurrentCommit(object, path, target, leafCandidate, config)) {
+                return;
+            }
+        }
+    }
+
+    template <typename T, BoundingVolume BV>
+    bool Bvh<T, BV>::InsertConcurrentCommit(T object, std::vector<NodeCosts> const& path, size_t target, bool leafCandidate, BvhBuildConfig const& config) {
+
+        // The parent of the target is held until the end, the root lock stands for the parent of the root
+        if (target == 0) {
+            SpinLock(mRootLocked);
+        }
+        SpinLock(path[0].node->locked);
+        if (LoadPointer(mRoot) != path[0].node) {
+            SpinUnlock(path[0].node->locked);
+            if (target == 0) {
+                SpinUnlock(mRootLocked);
+            }
+            return false;
+        }
+
+        // Lock coupling down to the target, expanding every node above it. Ends holding the target and its parent
+        Node* parent = nullptr;
+        for (size_t i = 0; i < target; i++) {
+            Node* node = path[i].node;
+            Node* next = path[i + 1].node;
+            if (node->children[0] != next && node->children[1] != next) {
+                SpinUnlock(node->locked);
+                if (parent != nullptr) {
+                    SpinUnlock(parent->locked);
+                }
+                return false;
+            }
+
+            StoreAabb(node->bv, Aabb(node->bv, object->bv));
+            node->layers |= ObjectLayers(object);
+            SpinLock(next->locked);
+            if (parent != nullptr) {
+                SpinUnlock(parent->locked);
+            }
+            parent = node;
+        }
+
+        auto unlockAll = [&](Node* node) {
+            SpinUnlock(node->locked);
+            if (parent != nullptr) {
+                SpinUnlock(parent->locked);
+            } else {
+                SpinUnlock(mRootLocked);
+            }
+        };
+
+        Node* node  = path[target].node;
+        bool  split = !leafCandidate;
+        if (leafCandidate) {
+            // Same rules as Insert, with the leaf as it is now
+            NodeCosts leaf(node, node->bv, object, 0.f, path[target].level);
+            bool      full = node->ObjectCount() >= config.minObjects && leaf.level < config.maxDepth;
+            split          = full && leaf.newBv.volume() >= config.minVolume && leaf.newGeometricsChange > 0.f;
+        }
+
+        if (!split) {
+            StoreAabb(node->bv, Aabb(node->bv, object->bv));
+            node->AddObject(object);
+            unlockAll(node);
+            return true;
+        }
+
+        // New parent above the target, its volume includes every expansion done to the target so far
+        Node* leaf = new Node(BV(object->bv));
+        leaf->AddObject(object);
+        Node* newParent = new Node(BV(node->bv, BV(object->bv)));
+        newParent->layers = node->layers | leaf->layers;
+        if (parent == nullptr) {
+            newParent->children[0] = node;
+            newParent->children[1] = leaf;
+            StorePointer(mRoot, newParent);
+        } else {
+            unsigned child                 = parent->children[0] == node ? 0u : 1u;
+            newParent->children[child]     = node;
+            newParent->children[child ^ 1] = leaf;
+            StorePointer(parent->children[child], newParent);
+        }
+        unlockAll(node);
+        return true;
+    }
+
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::Refit() {
+        if (mRoot == nullptr) {
+            return;
+        }
+
+        // Children first, parents are the union of their children
+        auto refitNode = [](auto self, Node* node) -> void {
+            if (node->IsLeaf()) {
+                T object = node->firstObject;
+                if (object == nullptr) {
+                    return;
+                }
+                node->bv     = BV(object->bv);
+                node->layers = ObjectLayers(object);
+                for (object = object->bvhInfo.next; object != nullptr; object = object->bvhInfo.next) {
+                    node->bv = BV(node->bv, BV(object->bv));
+                    node->layers |= ObjectLayers(object);
+                }
+                return;
+            }
+
+            self(self, node->children[0]);
+            self(self, node->children[1]);
+            node->bv     = BV(node->children[0]->bv, node->children[1]->bv);
+            node->layers = node->children[0]->layers | node->children[1]->layers;
+        };
+        refitNode(refitNode, mRoot);
+    }
+
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::Clear() {
+        CancelBuild();
+
         // clear all object prev, next, node
         if (mRoot == nullptr) {
             return;
@@ -488,16 +1079,17 @@ namespace CS350 {
         mRoot->TraverseLevelOrder(lamdaClearNode);
         mRoot = nullptr;
         mObjectCount = 0;
+        mLazy = false;
     }
 
-    template <typename T>
-    bool Bvh<T>::Empty() const {
+    template <typename T, BoundingVolume BV>
+    bool Bvh<T, BV>::Empty() const {
 
         return (mRoot == nullptr && mObjectCount == 0);
     }
 
-    template <typename T>
-    int Bvh<T>::Depth() const {
+    template <typename T, BoundingVolume BV>
+    int Bvh<T, BV>::Depth() const {
  
         if (mRoot == nullptr) {
             return -1;
@@ -506,37 +1098,332 @@ namespace CS350 {
         return mRoot->Depth();
     }
 
-    template <typename T>
-    int Bvh<T>::Size() const {
+    template <typename T, BoundingVolume BV>
+    int Bvh<T, BV>::Size() const {
         if (mRoot == nullptr) {
             return 0;
         }
         return mRoot->Size();
     }
 
-    template <typename T>
-    Bvh<T>::Node const* Bvh<T>::root() const {
+    template <typename T, BoundingVolume BV>
+    float Bvh<T, BV>::SurfaceAreaCost() const {
+        if (mRoot == nullptr || mRoot->bv.surface_area() <= 0.f) {
+            return 0.f;
+        }
+
+        double rootArea = mRoot->bv.surface_area();
+        double cost     = 0.0;
+        TraverseLevelOrder([&](Node const* node) {
+            double area = node->bv.surface_area() / rootArea;
+            cost += node->IsLeaf() ? area * node->ObjectCount() : area;
+        });
+        return static_cast<float>(cost);
+    }
+
+    template <typename T, BoundingVolume BV>
+    Bvh<T, BV>::Node const* Bvh<T, BV>::root() const {
         return this->mRoot;
     }
 
 
-    template <typename T>
-    std::vector<unsigned> Bvh<T>::Query(Frustum const& frustum) const {
+    template <typename T, BoundingVolume BV>
+    std::vector<unsigned> Bvh<T, BV>::Query(Frustum const& frustum, QueryFilter const& filter) const {
+
+        std::vector<unsigned> objectsIds;
+        QueryPlanes([&](auto const& bv, uint32_t& planeMask) { return ClassifyFrustum(frustum, bv, planeMask); },
+                    mRoot,
+                    FullPlaneMask(frustum.planes.size()),
+                    filter,
+                    nullptr,
+                    objectsIds);
+        return objectsIds;
+    }
+
+    template <typename T, BoundingVolume BV>
+    std::vector<unsigned> Bvh<T, BV>::QueryOrdered(Frustum const& frustum, vec3 const& eye, QueryFilter const& filter) const {
+
+        std::vector<unsigned> objectsIds;
+        QueryPlanes([&](auto const& bv, uint32_t& planeMask) { return ClassifyFrustum(frustum, bv, planeMask); },
+                    mRoot,
+                    FullPlaneMask(frustum.planes.size()),
+                    filter,
+                    &eye,
+                    objectsIds);
+        return objectsIds;
+    }
+
+    template <typename T, BoundingVolume BV>
+    std::vector<unsigned> Bvh<T, BV>::QueryParallel(Frustum const& frustum, unsigned threadCount, QueryFilter const& filter) const {
+
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        auto classify = [&](auto const& bv, uint32_t& planeMask) { return ClassifyFrustum(frustum, bv, planeMask); };
+
+        // Subtree to cull, nodes already found inside only have to emit their objects
+        struct Task {
+            Node*    node;
+            uint32_t planeMask;
+            bool     inside = false;
+        };
+
+        // Culls the upper tree level by level into tasks, keeping the order the serial query visits them
+        size_t            targetTasks = static_cast<size_t>(threadCount) * cTasksPerThread;
+        std::vector<Task> tasks;
+        if (mRoot != nullptr) {
+            tasks.push_back({ mRoot, FullPlaneMask(frustum.planes.size()) });
+        }
+        bool expanded = threadCount > 1;
+        while (expanded && tasks.size() < targetTasks) {
+            expanded = false;
+            std::vector<Task> next;
+            next.reserve(tasks.size() * 2);
+            for (Task task : tasks) {
+                if (task.inside || Expand(task.node)->IsLeaf()) {
+                    next.push_back(task);
+                    continue;
+                }
+                if (!filter.IsEmpty() && !filter.AcceptsAny(task.node->layers)) {
+                    continue;
+                }
+
+                SideResult result = classify(task.node->bv, task.planeMask);
+                if (result == SideResult::eINSIDE) {
+                    next.push_back({ task.node, task.planeMask, true });
+                } else if (result == SideResult::eINTERSECTING) {
+                    // the serial query visits the second child first
+                    next.push_back({ task.node->children[1], task.planeMask });
+                    next.push_back({ task.node->children[0], task.planeMask });
+                    expanded = true;
+                }
+            }
+            tasks = std::move(next);
+        }
+
+        // Tasks are handed out one at a time, every task has its own output chunk
+        std::vector<std::vector<unsigned>> chunks(tasks.size());
+        std::atomic<size_t>                nextTask{ 0 };
+        auto                               worker = [&]() {
+            for (size_t t = nextTask.fetch_add(1, std::memory_order_relaxed); t < tasks.size(); t = nextTask.fetch_add(1, std::memory_order_relaxed)) {
+                if (tasks[t].inside) {
+                    AppendObjects(tasks[t].node, filter, nullptr, chunks[t]);
+                } else {
+                    QueryPlanes(classify, tasks[t].node, tasks[t].planeMask, filter, nullptr, chunks[t]);
+                }
+            }
+        };
+
+        unsigned                 workerCount = static_cast<unsigned>(std::min<size_t>(threadCount, tasks.size()));
+        std::vector<std::thread> threads;
+        std::vector<size_t>      workerTests(workerCount, 0);
+        for (unsigned w = 1; w < workerCount; w++) {
+            threads.emplace_back([&, w]() {
+                worker();
+                workerTests[w] = Stats::Instance().frustumVsAabb;
+            });
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (size_t tests : workerTests) {
+            Stats::Instance().frustumVsAabb += tests;
+        }
+
+        size_t total = 0;
+        for (auto const& chunk : chunks) {
+            total += chunk.size();
+        }
+        std::vector<unsigned> objectsIds;
+        objectsIds.reserve(total);
+        for (auto const& chunk : chunks) {
+            objectsIds.insert(objectsIds.end(), chunk.begin(), chunk.end());
+        }
+        return objectsIds;
+    }
+
+    template <typename T, BoundingVolume BV>
+    VisibilityMatrix Bvh<T, BV>::QueryLineOfSight(std::span<vec3 const> positions, float maxDistance, unsigned threadCount, QueryFilter const& filter) const {
+
+        if (threadCount == 0) {
+            threadCount = std::max(1u, std::thread::hardware_concurrency());
+        }
+        size_t           count = positions.size();
+        VisibilityMatrix visibility(count);
+        float            maxDistanceSq = maxDistance * maxDistance;
+        bool             filtered      = !filter.IsEmpty();
+
+        // Agents sorted along x, pairs further apart than the cutoff on x alone are never looked at
+        std::vector<uint32_t> order(count);
+        for (uint32_t a = 0; a < order.size(); ++a) {
+            order[a] = a;
+        }
+        std::sort(order.begin(), order.end(), [&](uint32_t lhs, uint32_t rhs) { return positions[lhs].x < positions[rhs].x; });
+
+        // Traces the segments of one origin to every agent later in the sorted order, filling the row of the origin
+        auto worker = [&](std::atomic<size_t>& nextOrigin) {
+            std::vector<Ray>                   segments;    // Target minus origin, hits up to time 1 block
+            std::vector<uint32_t>              targets;     // Agent of each segment
+            std::vector<uint8_t>               blocked;     //
+            std::deque<std::vector<uint32_t>>  active;      // Segments crossing the node visited at each level, grows as lazy nodes are expanded
+
+            auto visit = [&](auto self, Node const* node, size_t level, std::vector<uint32_t> const& parentActive) -> void {
+                if (filtered && !filter.AcceptsAny(node->layers)) {
+                    return;
+                }
+                if (level == active.size()) {
+                    active.emplace_back();
+                }
+                auto& crossing = active[level];
+                crossing.clear();
+                for (uint32_t s : parentActive) {
+                    float time = blocked[s] ? -1.f : segments[s].intersect(node->bv);
+                    if (time >= 0.f && time <= 1.f) {
+                        crossing.push_back(s);
+                    }
+                }
+                if (crossing.empty()) {
+                    return;
+                }
+
+                if (Expand(node)->IsLeaf()) {
+                    for (T object = node->firstObject; object != nullptr; object = object->bvhInfo.next) {
+                        if (filtered && !filter.Accepts(ObjectLayers(object))) {
+                            continue;
+                        }
+                        for (uint32_t s : crossing) {
+                            float time = blocked[s] ? -1.f : segments[s].intersect(object->bv);
+                            blocked[s] = blocked[s] || (time >= 0.f && time <= 1.f);
+                        }
+                    }
+                    return;
+                }
+
+                // The closer child first, segments blocked there skip the other one
+                vec3 const& origin = segments[crossing.front()].start;
+                bool        swap   = node->children[1]->bv.bounds().squared_distance(origin) < node->children[0]->bv.bounds().squared_distance(origin);
+                self(self, node->children[swap ? 1 : 0], level + 1, crossing);
+                self(self, node->children[swap ? 0 : 1], level + 1, crossing);
+            };
+
+            for (size_t rank = nextOrigin.fetch_add(1, std::memory_order_relaxed); rank < count; rank = nextOrigin.fetch_add(1, std::memory_order_relaxed)) {
+                size_t i = order[rank];
+                segments.clear();
+                targets.clear();
+                for (size_t next = rank + 1; next < count && positions[order[next]].x - positions[i].x <= maxDistance; ++next) {
+                    vec3 delta = positions[order[next]] - positions[i];
+                    if (glm::dot(delta, delta) <= maxDistanceSq) {
+                        segments.emplace_back(positions[i], delta);
+                        targets.push_back(order[next]);
+                    }
+                }
+                blocked.assign(segments.size(), 0);
+
+                if (mRoot != nullptr && !segments.empty()) {
+                    std::vector<uint32_t> all(segments.size());
+                    for (uint32_t s = 0; s < all.size(); ++s) {
+                        all[s] = s;
+                    }
+                    visit(visit, mRoot, 0, all);
+                }
+                for (size_t s = 0; s < segments.size(); ++s) {
+                    if (!blocked[s]) {
+                        visibility.SetVisible(i, targets[s]);
+                    }
+                }
+            }
+        };
+
+        std::atomic<size_t>      nextOrigin{ 0 };
+        unsigned                 workerCount = static_cast<unsigned>(std::min<size_t>(threadCount, std::max<size_t>(count, 1)));
+        std::vector<std::thread> threads;
+        std::vector<size_t>      workerTests(workerCount, 0);
+        for (unsigned w = 1; w < workerCount; w++) {
+            threads.emplace_back([&, w]() {
+                worker(nextOrigin);
+                workerTests[w] = Stats::Instance().rayVsAabb;
+            });
+        }
+        worker(nextOrigin);
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        for (size_t tests : workerTests) {
+            Stats::Instance().rayVsAabb += tests;
+        }
+
+        // Every pair is in the row of only one of its agents
+        for (size_t i = 0; i < count; ++i) {
+            visibility.ForEachVisible(i, [&](size_t j) { visibility.SetVisible(j, i); });
+        }
+        return visibility;
+    }
+
+    template <typename T, BoundingVolume BV>
+    std::vector<unsigned> Bvh<T, BV>::Query(std::span<Plane const> planes, QueryFilter const& filter) const {
+        if (planes.size() > cMaxConvexPlanes) {
+            throw std::runtime_error(fmt::format("bvh.inl: convex volume with {} planes, at most {} are supported", planes.size(), cMaxConvexPlanes));
+        }
+
+        std::vector<unsigned> objectsIds;
+        QueryPlanes([&](auto const& bv, uint32_t& planeMask) { return ClassifyConvexVolume(planes, bv, planeMask); },
+                    mRoot,
+                    FullPlaneMask(planes.size()),
+                    filter,
+                    nullptr,
+                    objectsIds);
+        return objectsIds;
+    }
+
+    template <typename T, BoundingVolume BV>
+    std::vector<unsigned> Bvh<T, BV>::Query(Cone const& cone, QueryFilter const& filter) const {
+        if (!(cone.angle > 0.0f && cone.angle <= glm::half_pi<float>())) {
+            throw std::runtime_error(fmt::format("bvh.inl: cone half angle {} is not in (0, pi/2]", cone.angle));
+        }
+        if (!(cone.range >= 0.0f)) {
+            throw std::runtime_error(fmt::format("bvh.inl: cone range {} is negative", cone.range));
+        }
 
+        // No planes, the mask is unused
         std::vector<unsigned> objectsIds;
+        QueryPlanes([&](auto const& bv, uint32_t&) { return cone.classify(bv.bounds()); },
+                    mRoot,
+                    0u,
+                    filter,
+                    nullptr,
+                    objectsIds,
+                    [&](Aabb const& bv) { return cone.intersects(bv); });
+        return objectsIds;
+    }
+
+    template <typename T, BoundingVolume BV>
+    template <typename Fn, typename ObjectFn>
+    void Bvh<T, BV>::QueryPlanes(Fn const& classify, Node* start, uint32_t planeMask, QueryFilter const& filter, vec3 const* eye, std::vector<unsigned>& objectsIds, ObjectFn const& overlapsObject) const {
 
-		std::stack<Node*> stack;
-		stack.push(mRoot);
+        bool filtered = !filter.IsEmpty();
+
+        // Objects of the current leaf and their distance to the eye
+        std::vector<std::pair<float, unsigned>> bucket;
+
+        // Every node carries the planes its parent was not completely inside of
+		std::stack<std::pair<Node*, uint32_t>> stack;
+		stack.push({ start, planeMask });
 
         while (!stack.empty()) {
 
-			Node* node = stack.top();
+			auto [node, mask] = stack.top();
 			stack.pop();
 
             if (node == nullptr) {
                 break;
             }
-            SideResult result = frustum.classify(node->bv);
+
+            // no object of the subtree would be returned, not even worth a classification
+            if (filtered && !filter.AcceptsAny(node->layers)) {
+                continue;
+            }
+            SideResult result = classify(node->bv, mask);
 
             // if node is outside, skip
             if (result == SideResult::eOUTSIDE) {
@@ -545,43 +1432,97 @@ namespace CS350 {
 
             // if node is inside, skip query
             if (result == SideResult::eINSIDE) {
-                auto retrieveIds = [&](T obj) {
-                    objectsIds.push_back(obj->id);
-                    };
-
-                node->TraverseLevelOrderObjects(retrieveIds);
-
+                AppendObjects(node, filter, eye, objectsIds);
                 continue;
             }
 
             //if node is intersecting, check children node
             if (result == SideResult::eINTERSECTING) {
                 // if node is leaf
-                if (node->IsLeaf()) {
+                if (Expand(node)->IsLeaf()) {
                     T object = node->firstObject;
                     while (object != nullptr) {
 
                         //render objects intersecting/inside
-                        if (frustum.classify(object->bv) != SideResult::eOUTSIDE) {
-                            objectsIds.push_back(object->id);
+                        bool overlaps = false;
+                        if (!filtered || filter.Accepts(ObjectLayers(object))) {
+                            if constexpr (std::is_null_pointer_v<ObjectFn>) {
+                                uint32_t objectMask = mask;
+                                overlaps            = classify(object->bv, objectMask) != SideResult::eOUTSIDE;
+                            } else {
+                                overlaps = overlapsObject(object->bv);
+                            }
+                        }
+                        if (overlaps) {
+                            if (eye != nullptr) {
+                                bucket.emplace_back(object->bv.squared_distance(*eye), object->id);
+                            } else {
+                                objectsIds.push_back(object->id);
+                            }
                         }
 
                         object = object->bvhInfo.next;
                     }
+                    AppendNearToFar(bucket, objectsIds);
 
                     continue;
                 }
 
-                stack.push(node->children[0]);
-                stack.push(node->children[1]);
+                // the last pushed is visited first
+                unsigned nearChild = 1;
+                if (eye != nullptr) {
+                    nearChild = node->children[1]->bv.bounds().squared_distance(*eye) < node->children[0]->bv.bounds().squared_distance(*eye) ? 1u : 0u;
+                }
+                stack.push({ node->children[nearChild ^ 1u], mask });
+                stack.push({ node->children[nearChild], mask });
             }
         }
+    }
 
-        return objectsIds;
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::AppendObjects(Node const* node, QueryFilter const& filter, vec3 const* eye, std::vector<unsigned>& objectsIds) const {
+        bool filtered = !filter.IsEmpty();
+        if (!filtered && eye == nullptr && !mLazy) {
+            node->TraverseLevelOrderObjects([&](T obj) { objectsIds.push_back(obj->id); });
+            return;
+        }
+
+        std::vector<std::pair<float, unsigned>> bucket;
+        std::stack<Node const*>                 stack;
+        stack.push(node);
+        while (!stack.empty()) {
+            node = stack.top();
+            stack.pop();
+            if (filtered && !filter.AcceptsAny(node->layers)) {
+                continue;
+            }
+
+            if (Expand(node)->IsLeaf()) {
+                for (T object = node->firstObject; object != nullptr; object = object->bvhInfo.next) {
+                    if (filtered && !filter.Accepts(ObjectLayers(object))) {
+                        continue;
+                    }
+                    if (eye != nullptr) {
+                        bucket.emplace_back(object->bv.squared_distance(*eye), object->id);
+                    } else {
+                        objectsIds.push_back(object->id);
+                    }
+                }
+                AppendNearToFar(bucket, objectsIds);
+                continue;
+            }
+
+            unsigned nearChild = 0;
+            if (eye != nullptr) {
+                nearChild = node->children[1]->bv.bounds().squared_distance(*eye) < node->children[0]->bv.bounds().squared_distance(*eye) ? 1u : 0u;
+            }
+            stack.push(node->children[nearChild ^ 1u]);
+            stack.push(node->children[nearChild]);
+        }
     }
 
-    template <typename T>
-    std::optional<unsigned> Bvh<T>::QueryDebug(Ray const& ray, bool closest_only, std::vector<unsigned>& allIntersectedObjects, std::vector<Node const*>& debug_tested_nodes) const {
+    template <typename T, BoundingVolume BV>
+    std::optional<unsigned> Bvh<T, BV>::QueryDebug(Ray const& ray, bool closest_only, std::vector<unsigned>& allIntersectedObjects, std::vector<Node const*>& debug_tested_nodes, QueryFilter const& filter) const {
 
         //empty containers
         allIntersectedObjects.clear();
@@ -593,17 +1534,22 @@ namespace CS350 {
 
         int closestIntersect = -1;
         float bvhShortestTime = std::numeric_limits<float>::max();
+        bool filtered = !filter.IsEmpty();
 
 		//Recurse lamda to find the closest object intersected by the ray
         auto QueryNodesRay = [&](auto queryNodeRayFunc, const Node* node) {
 
             //if leaf check children, check all objects and return min time
-            if (node->IsLeaf()) {
+            if (Expand(node)->IsLeaf()) {
 
                 float nodeShortestTime = std::numeric_limits<float>::max();
                 T object = node->firstObject;
 
                 while (object != nullptr) {
+                    if (filtered && !filter.Accepts(ObjectLayers(object))) {
+                        object = object->bvhInfo.next;
+                        continue;
+                    }
                     float time = ray.intersect(object->bv);
 
                     //object intersects
@@ -637,11 +1583,11 @@ namespace CS350 {
             float childFirstT = -1.f;
             float childSecondT = -1.f;
 
-            if (node->children[0]) {
+            if (node->children[0] && (!filtered || filter.AcceptsAny(node->children[0]->layers))) {
                 debug_tested_nodes.push_back(node->children[0]);
                 childFirstT = ray.intersect(node->children[0]->bv);
             }
-            if (node->children[1]) {
+            if (node->children[1] && (!filtered || filter.AcceptsAny(node->children[1]->layers))) {
                 debug_tested_nodes.push_back(node->children[1]);
                 childSecondT = ray.intersect(node->children[1]->bv);
             }
@@ -691,6 +1637,10 @@ namespace CS350 {
         };
 
 
+        if (filtered && !filter.AcceptsAny(mRoot->layers)) {
+            return std::nullopt;
+        }
+
         debug_tested_nodes.push_back(mRoot);
 
         if (ray.intersect(mRoot->bv) >= 0) {
@@ -715,9 +1665,498 @@ namespace CS350 {
         return closestIntersect;
     }
 
-    template <typename T>
+    template <typename T, BoundingVolume BV>
+    std::optional<unsigned> Bvh<T, BV>::Query(Ray const& ray, QueryFilter const& filter) const {
+
+        bool filtered = !filter.IsEmpty();
+        if (mRoot == nullptr || (filtered && !filter.AcceptsAny(mRoot->layers))) {
+            return std::nullopt;
+        }
+
+        float rootT = ray.intersect(mRoot->bv);
+        if (rootT < 0.f) {
+            return std::nullopt;
+        }
+
+        std::optional<unsigned> closestObject;
+        float closestTime = std::numeric_limits<float>::max();
+
+        // nodes are stored with the time the ray enters them
+        std::vector<std::pair<Node const*, float>> stack;
+        stack.emplace_back(mRoot, rootT);
+
+        while (!stack.empty()) {
+
+            auto [node, entryTime] = stack.back();
+            stack.pop_back();
+
+            // a closer object has been found since this node was pushed
+            if (entryTime > closestTime) {
+                continue;
+            }
+
+            if (Expand(node)->IsLeaf()) {
+                T object = node->firstObject;
+                while (object != nullptr) {
+                    if (!filtered || filter.Accepts(ObjectLayers(object))) {
+                        float time = ray.intersect(object->bv);
+                        if (time >= 0.f && time < closestTime) {
+                            closestTime = time;
+                            closestObject = object->id;
+                        }
+                    }
+                    object = object->bvhInfo.next;
+                }
+                continue;
+            }
+
+            // children without accepted objects count as missed
+            float childFirstT = !filtered || filter.AcceptsAny(node->children[0]->layers) ? ray.intersect(node->children[0]->bv) : -1.f;
+            float childSecondT = !filtered || filter.AcceptsAny(node->children[1]->layers) ? ray.intersect(node->children[1]->bv) : -1.f;
+
+            // push the furthest child first so the closest one is visited first
+            bool firstIsCloser = childSecondT < 0.f || (childFirstT >= 0.f && childFirstT <= childSecondT);
+            unsigned closer = firstIsCloser ? 0u : 1u;
+            float closerT = firstIsCloser ? childFirstT : childSecondT;
+            float furtherT = firstIsCloser ? childSecondT : childFirstT;
+
+            if (furtherT >= 0.f && furtherT <= closestTime) {
+                stack.emplace_back(node->children[closer ^ 1u], furtherT);
+            }
+            if (closerT >= 0.f && closerT <= closestTime) {
+                stack.emplace_back(node->children[closer], closerT);
+            }
+        }
+
+        return closestObject;
+    }
+
+    template <typename T, BoundingVolume BV>
+    template <typename Fn>
+    std::optional<unsigned> Bvh<T, BV>::QueryExact(Ray const& ray, float& tMax, Fn&& intersect, QueryFilter const& filter) const {
+
+        bool filtered = !filter.IsEmpty();
+        if (mRoot == nullptr || (filtered && !filter.AcceptsAny(mRoot->layers))) {
+            return std::nullopt;
+        }
+
+        float rootT = ray.intersect(mRoot->bv);
+        if (rootT < 0.f || rootT > tMax) {
+            return std::nullopt;
+        }
+
+        std::optional<unsigned> closestObject;
+
+        // nodes are stored with the time the ray enters them
+        std::vector<std::pair<Node const*, float>> stack;
+        stack.emplace_back(mRoot, rootT);
+
+        while (!stack.empty()) {
+
+            auto [node, entryTime] = stack.back();
+            stack.pop_back();
+
+            // an exact hit closer than this node has been accepted since it was pushed
+            if (entryTime > tMax) {
+                continue;
+            }
+
+            if (Expand(node)->IsLeaf()) {
+                T object = node->firstObject;
+                while (object != nullptr) {
+                    // the geometry is inside the bv, a later entry can not be closer
+                    if (!filtered || filter.Accepts(ObjectLayers(object))) {
+                        float time = ray.intersect(object->bv);
+                        if (time >= 0.f && time <= tMax && intersect(object, tMax)) {
+                            closestObject = object->id;
+                        }
+                    }
+                    object = object->bvhInfo.next;
+                }
+                continue;
+            }
+
+            float childFirstT = !filtered || filter.AcceptsAny(node->children[0]->layers) ? ray.intersect(node->children[0]->bv) : -1.f;
+            float childSecondT = !filtered || filter.AcceptsAny(node->children[1]->layers) ? ray.intersect(node->children[1]->bv) : -1.f;
+
+            // push the furthest child first so the closest one is visited first
+            bool firstIsCloser = childSecondT < 0.f || (childFirstT >= 0.f && childFirstT <= childSecondT);
+            unsigned closer = firstIsCloser ? 0u : 1u;
+            float closerT = firstIsCloser ? childFirstT : childSecondT;
+            float furtherT = firstIsCloser ? childSecondT : childFirstT;
+
+            if (furtherT >= 0.f && furtherT <= tMax) {
+                stack.emplace_back(node->children[closer ^ 1u], furtherT);
+            }
+            if (closerT >= 0.f && closerT <= tMax) {
+                stack.emplace_back(node->children[closer], closerT);
+            }
+        }
+
+        return closestObject;
+    }
+
+    template <typename T, BoundingVolume BV>
+    std::vector<unsigned> Bvh<T, BV>::Query(Aabb const& aabb, QueryFilter const& filter) const {
+
+        std::vector<unsigned> objectsIds;
+        bool                  filtered = !filter.IsEmpty();
+
+        if (mRoot == nullptr) {
+            return objectsIds;
+        }
+
+        std::stack<Node const*> stack;
+        stack.push(mRoot);
+
+        while (!stack.empty()) {
+
+            Node const* node = stack.top();
+            stack.pop();
+
+            Aabb bounds = node->bv.bounds();
+            if ((filtered && !filter.AcceptsAny(node->layers)) || !bounds.intersects(aabb)) {
+                continue;
+            }
+
+            // node completely inside the query volume, every object overlaps
+            if (aabb.intersects(bounds.min) && aabb.intersects(bounds.max)) {
+                AppendObjects(node, filter, nullptr, objectsIds);
+                continue;
+            }
+
+            if (Expand(node)->IsLeaf()) {
+                T object = node->firstObject;
+                while (object != nullptr) {
+                    if ((!filtered || filter.Accepts(ObjectLayers(object))) && object->bv.intersects(aabb)) {
+                        objectsIds.push_back(object->id);
+                    }
+                    object = object->bvhInfo.next;
+                }
+                continue;
+            }
+
+            stack.push(node->children[0]);
+            stack.push(node->children[1]);
+        }
+
+        return objectsIds;
+    }
+
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::QueryBatch(Ray const* rays, size_t count, std::optional<unsigned>* closestObjects, QueryFilter const& filter) const {
+
+        bool filtered = !filter.IsEmpty();
+        auto accepts  = [&](Node const* node) { return !filtered || filter.AcceptsAny(node->layers); };
+
+        // Traversal state of one ray, nodes are stored with the time the ray enters them
+        struct Lane {
+            size_t                                     query       = 0;
+            float                                      closestTime = 0.f;
+            std::vector<std::pair<Node const*, float>> stack;
+        };
+
+        // The bv of a pushed node is already tested, what it needs next is its children or objects
+        auto push = [this](Lane& lane, Node const* node, float entryTime) {
+            lane.stack.emplace_back(node, entryTime);
+            if (Expand(node)->IsLeaf()) {
+                Prefetch(node->firstObject);
+            } else {
+                Prefetch(node->children[0]);
+                Prefetch(node->children[1]);
+            }
+        };
+
+        size_t nextQuery = 0;
+        auto   start     = [&](Lane& lane) {
+            while (nextQuery < count) {
+                size_t query          = nextQuery++;
+                closestObjects[query] = std::nullopt;
+
+                float rootT = mRoot != nullptr && accepts(mRoot) ? rays[query].intersect(mRoot->bv) : -1.f;
+                if (rootT >= 0.f) {
+                    lane.query       = query;
+                    lane.closestTime = std::numeric_limits<float>::max();
+                    push(lane, mRoot, rootT);
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        std::array<Lane, cBatchLanes> lanes;
+        bool                          running = true;
+        while (running) {
+            running = false;
+
+            // Every lane moves by a single node, giving the prefetches of the others time to land
+            for (Lane& lane : lanes) {
+                if (lane.stack.empty() && !start(lane)) {
+                    continue;
+                }
+                running = true;
+
+                auto [node, entryTime] = lane.stack.back();
+                lane.stack.pop_back();
+
+                // a closer object has been found since this node was pushed
+                if (entryTime > lane.closestTime) {
+                    continue;
+                }
+
+                Ray const& ray = rays[lane.query];
+                if (node->IsLeaf()) {
+                    T object = node->firstObject;
+                    while (object != nullptr) {
+                        if (!filtered || filter.Accepts(ObjectLayers(object))) {
+                            float time = ray.intersect(object->bv);
+                            if (time >= 0.f && time < lane.closestTime) {
+                                lane.closestTime            = time;
+                                closestObjects[lane.query] = object->id;
+                            }
+                        }
+                        object = object->bvhInfo.next;
+                    }
+                    continue;
+                }
+
+                float childFirstT  = accepts(node->children[0]) ? ray.intersect(node->children[0]->bv) : -1.f;
+                float childSecondT = accepts(node->children[1]) ? ray.intersect(node->children[1]->bv) : -1.f;
+
+                // push the furthest child first so the closest one is visited first
+                bool     firstIsCloser = childSecondT < 0.f || (childFirstT >= 0.f && childFirstT <= childSecondT);
+                unsigned closer        = firstIsCloser ? 0u : 1u;
+                float    closerT       = firstIsCloser ? childFirstT : childSecondT;
+                float    furtherT      = firstIsCloser ? childSecondT : childFirstT;
+
+                if (furtherT >= 0.f && furtherT <= lane.closestTime) {
+                    push(lane, node->children[closer ^ 1u], furtherT);
+                }
+                if (closerT >= 0.f && closerT <= lane.closestTime) {
+                    push(lane, node->children[closer], closerT);
+                }
+            }
+        }
+    }
+
+    template <typename T, BoundingVolume BV>
+    void Bvh<T, BV>::QueryBatch(vec3 const* points, size_t count, std::vector<std::vector<unsigned>>& objectsIds, QueryFilter const& filter) const {
+
+        objectsIds.resize(count);
+        bool filtered = !filter.IsEmpty();
+        auto accepts  = [&](Node const* node) { return !filtered || filter.AcceptsAny(node->layers); };
+
+        // Traversal state of one point
+        struct Lane {
+            size_t                   query = 0;
+            std::vector<Node const*> stack;
+        };
+
+        // The bv of a pushed node already contains the point, what it needs next is its children or objects
+        auto push = [this](Lane& lane, Node const* node) {
+            lane.stack.push_back(node);
+            if (Expand(node)->IsLeaf()) {
+                Prefetch(node->firstObject);
+            } else {
+                Prefetch(node->children[0]);
+                Prefetch(node->children[1]);
+            }
+        };
+
+        size_t nextQuery = 0;
+        auto   start     = [&](Lane& lane) {
+            while (nextQuery < count) {
+                size_t query = nextQuery++;
+                objectsIds[query].clear();
+
+                if (mRoot != nullptr && accepts(mRoot) && mRoot->bv.bounds().intersects(points[query])) {
+                    lane.query = query;
+                    push(lane, mRoot);
+                    return true;
+                }
+            }
+            return false;
+        };
+
+        std::array<Lane, cBatchLanes> lanes;
+        bool                          running = true;
+        while (running) {
+            running = false;
+
+            for (Lane& lane : lanes) {
+                if (lane.stack.empty() && !start(lane)) {
+                    continue;
+                }
+                running = true;
+
+                Node const* node = lane.stack.back();
+                lane.stack.pop_back();
+
+                vec3 const& point = points[lane.query];
+                if (node->IsLeaf()) {
+                    T object = node->firstObject;
+                    while (object != nullptr) {
+                        if ((!filtered || filter.Accepts(ObjectLayers(object))) && object->bv.intersects(point)) {
+                            objectsIds[lane.query].push_back(object->id);
+                        }
+                        object = object->bvhInfo.next;
+                    }
+                    continue;
+                }
+
+                for (Node const* child : node->children) {
+                    if (accepts(child) && child->bv.bounds().intersects(point)) {
+                        push(lane, child);
+                    }
+                }
+            }
+        }
+    }
+
+    template <typename T, BoundingVolume BV>
+    template <typename IT>
+    size_t Bvh<T, BV>::SplitObjects(IT first, IT last, Aabb const& box, BvhBuildConfig const& config) {
+        constexpr size_t bins  = 16;
+        size_t           count = static_cast<size_t>(last - first);
+        int              axis  = box.longest_axis();
+
+        // Center bins of each axis, the best plane between two bins has the least area weighted
+        // object count of both sides. Flat axes have a single bin and no plane.
+        int    sahAxis = -1;
+        size_t sahBin  = 0;
+        vec3   centerMin{}, centerScale{};
+        if (config.splitPolicy == SplitPolicy::eSah) {
+            vec3 centerMax = (*first)->bv.get_center();
+            centerMin      = centerMax;
+            for (auto it = first + 1; it != last; it++) {
+                centerMin = glm::min(centerMin, (*it)->bv.get_center());
+                centerMax = glm::max(centerMax, (*it)->bv.get_center());
+            }
+
+            float bestCost = std::numeric_limits<float>::max();
+            for (int a = 0; a < 3; ++a) {
+                float extent = centerMax[a] - centerMin[a];
+                if (extent <= 0.0f) {
+                    continue;
+                }
+                centerScale[a] = static_cast<float>(bins) / extent;
+
+                std::array<Aabb, bins>   binBvs{};
+                std::array<size_t, bins> binCounts{};
+                for (auto it = first; it != last; it++) {
+                    float  offset = ((*it)->bv.get_center()[a] - centerMin[a]) * centerScale[a];
+                    size_t bin    = std::min(bins - 1, static_cast<size_t>(offset));
+                    binBvs[bin]   = binCounts[bin] == 0 ? (*it)->bv : Aabb(binBvs[bin], (*it)->bv);
+                    ++binCounts[bin];
+                }
+
+                // Right sides from the end, then left sides from the start
+                std::array<float, bins> rightCost{};
+                Aabb                    side{};
+                size_t                  sideCount = 0;
+                for (size_t bin = bins - 1; bin > 0; --bin) {
+                    if (binCounts[bin] != 0) {
+                        side = sideCount == 0 ? binBvs[bin] : Aabb(side, binBvs[bin]);
+                        sideCount += binCounts[bin];
+                    }
+                    rightCost[bin] = sideCount == 0 ? -1.0f : side.surface_area() * static_cast<float>(sideCount);
+                }
+                sideCount = 0;
+                for (size_t bin = 0; bin + 1 < bins; ++bin) {
+                    if (binCounts[bin] != 0) {
+                        side = sideCount == 0 ? binBvs[bin] : Aabb(side, binBvs[bin]);
+                        sideCount += binCounts[bin];
+                    }
+                    float cost = side.surface_area() * static_cast<float>(sideCount) + rightCost[bin + 1];
+                    if (sideCount != 0 && rightCost[bin + 1] >= 0.0f && cost < bestCost) {
+                        bestCost = cost;
+                        sahAxis  = a;
+                        sahBin   = bin + 1;
+                    }
+                }
+            }
+            axis = sahAxis >= 0 ? sahAxis : axis;
+        }
+
+        std::sort(first, last, [&](T const& lhs, T const& rhs) {
+            return lhs->bv.get_center()[axis] < rhs->bv.get_center()[axis];
+        });
+        if (sahAxis < 0) {
+            return count / 2;
+        }
+
+        // Bins grow with the center, the objects of the left bins are a prefix
+        auto split = std::partition_point(first, last, [&](T const& object) {
+            float offset = (object->bv.get_center()[sahAxis] - centerMin[sahAxis]) * centerScale[sahAxis];
+            return std::min(bins - 1, static_cast<size_t>(offset)) < sahBin;
+        });
+        return static_cast<size_t>(split - first);
+    }
+
+    template <typename T, BoundingVolume BV>
+    Bvh<T, BV>::Node const* Bvh<T, BV>::Expand(Node const* node) const {
+        if (!node->pending.load(std::memory_order_acquire)) {
+            return node;
+        }
+
+        // Nodes are never created const, queries only expand what BuildLazy left pending
+        Node* pendingNode = const_cast<Node*>(node);
+        SpinLock(pendingNode->locked);
+        if (pendingNode->pending.load(std::memory_order_relaxed)) {
+            std::vector<T> objects;
+            for (T object = pendingNode->firstObject; object != nullptr; object = object->bvhInfo.next) {
+                objects.push_back(object);
+            }
+
+            // Split of the object bounds, like BuildTopDown
+            Aabb box = objects.front()->bv;
+            for (T object : objects) {
+                box = Aabb(box, object->bv);
+            }
+            auto splitIt = objects.begin() + static_cast<std::ptrdiff_t>(SplitObjects(objects.begin(), objects.end(), box, mLazyConfig));
+
+            Node* children[2];
+            for (unsigned side = 0; side < 2; ++side) {
+                auto first = side == 0 ? objects.begin() : splitIt;
+                auto last  = side == 0 ? splitIt : objects.end();
+
+                BV boundingVolume((*first)->bv);
+                for (auto it = first + 1; it != last; it++) {
+                    boundingVolume = BV(boundingVolume, BV((*it)->bv));
+                }
+                Node* child  = new Node(boundingVolume);
+                child->level = static_cast<uint16_t>(pendingNode->level + 1);
+                for (auto it = first; it != last; it++) {
+                    (*it)->bvhInfo = {};
+                    child->AddObject(*it);
+                }
+                child->pending.store(IsLazySplit(child, static_cast<size_t>(last - first)), std::memory_order_relaxed);
+                children[side] = child;
+            }
+
+            // Published by the release below, readers only look at them after seeing the node is not pending
+            pendingNode->firstObject = nullptr;
+            pendingNode->lastObject  = nullptr;
+            pendingNode->children[0] = children[0];
+            pendingNode->children[1] = children[1];
+            pendingNode->pending.store(false, std::memory_order_release);
+        }
+        SpinUnlock(pendingNode->locked);
+        return node;
+    }
+
+    template <typename T, BoundingVolume BV>
+    bool Bvh<T, BV>::IsLazySplit(Node const* node, size_t count) const {
+        return count >= 2 &&
+               count > mLazyConfig.minObjects &&
+               node->bv.volume() > mLazyConfig.minVolume &&
+               node->level < mLazyConfig.maxDepth &&
+               node->level < std::numeric_limits<uint16_t>::max();
+    }
+
+    template <typename T, BoundingVolume BV>
     template <typename Fn> 
-    void Bvh<T>::TraverseLevelOrder(Fn func) const {
+    void Bvh<T, BV>::TraverseLevelOrder(Fn func) const {
         if (mRoot == nullptr) {
             return;
         }
@@ -725,9 +2164,9 @@ namespace CS350 {
         mRoot->TraverseLevelOrder(func);
     }
 
-    template <typename T>
+    template <typename T, BoundingVolume BV>
     template <typename Fn> 
-    void Bvh<T>::TraverseLevelOrderObjects(Fn func) const {
+    void Bvh<T, BV>::TraverseLevelOrderObjects(Fn func) const {
         if (mRoot == nullptr) {
             return;
         }
@@ -735,14 +2174,19 @@ namespace CS350 {
         mRoot->TraverseLevelOrderObjects(func);
     }
 
-    template <typename T>
-    Bvh<T>::NodeCosts::NodeCosts(Node* _node, T object, float costToNode, unsigned int _level) :
+    template <typename T, BoundingVolume BV>
+    Bvh<T, BV>::NodeCosts::NodeCosts(Node* _node, T object, float costToNode, unsigned int _level) :
+        NodeCosts(_node, _node->bv, object, costToNode, _level)
+    {}
+
+    template <typename T, BoundingVolume BV>
+    Bvh<T, BV>::NodeCosts::NodeCosts(Node* _node, BV const& nodeBv, T object, float costToNode, unsigned int _level) :
         node{ _node },
         level{ _level }
     {
-        newAabb = Aabb(node->bv, object->bv);
-        newGeometrics = newAabb.volume();
-        newGeometricsChange = newGeometrics - node->bv.volume();
+        newBv = BV(nodeBv, BV(object->bv));
+        newGeometrics = newBv.volume();
+        newGeometricsChange = newGeometrics - nodeBv.volume();
 
         rootToNewParentCost = newGeometrics + costToNode;
 
@@ -14,7 +14,12 @@
 #include "cs350_loader.hpp"
 #include "utils.hpp"
 
+#include <algorithm>
+#include <bit>
+#include <chrono>
 #include <sstream>
+#include <thread>
+#include <unordered_map>
 
 namespace CS350 {
 
@@ -86,7 +91,7 @@ namespace CS350 {
 		std::string line;
 		while (std::getline(fs, line)) {
 			
-			CS350::CS350SceneObject object{0, mat4()};
+			CS350::CS350SceneObject object{};
 			object.primitiveIndex = std::stoi(line);
 			
 			if (!std::getline(fs, line)) {
@@ -95,7 +100,9 @@ namespace CS350 {
 
 			std::istringstream is(line);
 			//read textfile and assign to variable
-			GenericVecRead(is, object.m2w);
+			mat4 m2w;
+			GenericVecRead(is, m2w);
+			object.m2w = Affine(m2w);
 
 			sceneObjects.emplace_back(object);
 		}
@@ -104,6 +111,300 @@ namespace CS350 {
 
 		return sceneObjects;
 	}
+
+	namespace {
+		// FNV-1a over 8 byte words, the tail is padded with zeros
+		void HashBytes(uint64_t& hash, void const* data, size_t size)
+		{
+			constexpr uint64_t prime = 0x100000001b3ull;
+			auto const*        bytes = static_cast<unsigned char const*>(data);
+			hash = (hash ^ size) * prime;
+			for (size_t offset = 0; offset < size; offset += sizeof(uint64_t)) {
+				uint64_t word = 0;
+				std::memcpy(&word, bytes + offset, std::min(sizeof(uint64_t), size - offset));
+				hash = (hash ^ word) * prime;
+			}
+		}
+
+		template <typename T>
+		size_t ByteSize(std::vector<T> const& values)
+		{
+			return values.size() * sizeof(T);
+		}
+
+		size_t PrimitiveBytes(CS350PrimitiveData const& data)
+		{
+			return ByteSize(data.positions) + ByteSize(data.uvs) + ByteSize(data.normals) + ByteSize(data.polygons) + ByteSize(data.quantizedPositions);
+		}
+
+		template <typename T>
+		bool SameBytes(std::vector<T> const& lhs, std::vector<T> const& rhs)
+		{
+			return lhs.size() == rhs.size() && (lhs.empty() || std::memcmp(lhs.data(), rhs.data(), ByteSize(lhs)) == 0);
+		}
+	}
+
+	uint64_t HashCS350Primitive(CS350PrimitiveData const& data)
+	{
+		uint64_t hash = 0xcbf29ce484222325ull;
+		HashBytes(hash, data.positions.data(), ByteSize(data.positions));
+		HashBytes(hash, data.uvs.data(), ByteSize(data.uvs));
+		HashBytes(hash, data.normals.data(), ByteSize(data.normals));
+		HashBytes(hash, data.polygons.data(), ByteSize(data.polygons));
+		HashBytes(hash, data.quantizedPositions.data(), ByteSize(data.quantizedPositions));
+		HashBytes(hash, &data.bvMin, sizeof(data.bvMin));
+		HashBytes(hash, &data.bvMax, sizeof(data.bvMax));
+		return hash;
+	}
+
+	bool SameCS350Primitive(CS350PrimitiveData const& lhs, CS350PrimitiveData const& rhs)
+	{
+		return SameBytes(lhs.positions, rhs.positions) && SameBytes(lhs.uvs, rhs.uvs) && SameBytes(lhs.normals, rhs.normals) &&
+			   SameBytes(lhs.polygons, rhs.polygons) && SameBytes(lhs.quantizedPositions, rhs.quantizedPositions) &&
+			   std::memcmp(&lhs.bvMin, &rhs.bvMin, sizeof(lhs.bvMin)) == 0 && std::memcmp(&lhs.bvMax, &rhs.bvMax, sizeof(lhs.bvMax)) == 0;
+	}
+
+	std::vector<CS350PrimitiveData> LoadCS350Primitives(std::string const& pattern, std::vector<int>& fileToPrimitive, CS350LoadStats* stats)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		std::vector<CS350PrimitiveData>        primitives;
+		std::unordered_multimap<uint64_t, int> byHash;
+		CS350LoadStats                         loadStats;
+		fileToPrimitive.clear();
+
+		auto path = fmt::format(fmt::runtime(pattern), fileToPrimitive.size());
+		while (std::filesystem::exists(path)) {
+			CS350PrimitiveData data  = LoadCS350Binary(path);
+			uint64_t           hash  = HashCS350Primitive(data);
+			size_t             bytes = PrimitiveBytes(data);
+			loadStats.bytesLoaded += bytes;
+
+			// same hash is not enough, the content must match
+			int  shared = -1;
+			auto range  = byHash.equal_range(hash);
+			for (auto it = range.first; it != range.second && shared < 0; ++it) {
+				if (SameCS350Primitive(data, primitives[static_cast<size_t>(it->second)])) {
+					shared = it->second;
+				}
+			}
+
+			if (shared >= 0) {
+				loadStats.bytesSaved += bytes;
+				fileToPrimitive.push_back(shared);
+			} else {
+				int index = static_cast<int>(primitives.size());
+				byHash.emplace(hash, index);
+				fileToPrimitive.push_back(index);
+				primitives.push_back(std::move(data));
+			}
+			path = fmt::format(fmt::runtime(pattern), fileToPrimitive.size());
+		}
+
+		if (stats != nullptr) {
+			loadStats.files      = fileToPrimitive.size();
+			loadStats.primitives = primitives.size();
+			loadStats.loadMs     = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+			*stats               = loadStats;
+		}
+		return primitives;
+	}
+
+	void RemapCS350Scene(std::vector<CS350SceneObject>& objects, std::vector<int> const& fileToPrimitive)
+	{
+		for (auto& object : objects) {
+			if (object.primitiveIndex < 0 || static_cast<size_t>(object.primitiveIndex) >= fileToPrimitive.size()) {
+				throw std::runtime_error(fmt::format("RemapCS350Scene: primitive {} was not loaded", object.primitiveIndex));
+			}
+			object.primitiveIndex = fileToPrimitive[static_cast<size_t>(object.primitiveIndex)];
+		}
+	}
+
+	namespace {
+		constexpr uint32_t cEmptySlot = std::numeric_limits<uint32_t>::max();
+
+		// Attributes of a corner as bits, -0 stored as 0 so both weld
+		using CornerKey = std::array<uint32_t, 8>;
+
+		CornerKey MakeCornerKey(CS350PrimitiveData const& data, size_t corner)
+		{
+			CornerKey key{};
+			auto      store = [&](size_t slot, float value) {
+				key[slot] = value == 0.0f ? 0u : std::bit_cast<uint32_t>(value);
+			};
+			for (int i = 0; i < 3; i++) {
+				store(static_cast<size_t>(i), data.positions[corner][i]);
+			}
+			if (!data.normals.empty()) {
+				for (int i = 0; i < 3; i++) {
+					store(static_cast<size_t>(3 + i), data.normals[corner][i]);
+				}
+			}
+			if (!data.uvs.empty()) {
+				for (int i = 0; i < 2; i++) {
+					store(static_cast<size_t>(6 + i), data.uvs[corner][i]);
+				}
+			}
+			return key;
+		}
+
+		uint64_t HashCornerKey(CornerKey const& key)
+		{
+			uint64_t hash = 0xcbf29ce484222325ull;
+			HashBytes(hash, key.data(), sizeof(key));
+
+			// FNV low bits only depend on the low bits of the input, the table index needs all of them
+			hash ^= hash >> 33;
+			hash *= 0xff51afd7ed558ccdull;
+			hash ^= hash >> 33;
+			hash *= 0xc4ceb9fe1a85ec53ull;
+			hash ^= hash >> 33;
+			return hash;
+		}
+
+		// Calls fn(worker) on `workerCount` threads, the calling one included
+		template <typename Fn>
+		void RunWorkers(unsigned workerCount, Fn const& fn)
+		{
+			std::vector<std::thread> threads;
+			for (unsigned worker = 1; worker < workerCount; worker++) {
+				threads.emplace_back(fn, worker);
+			}
+			fn(0u);
+			for (auto& thread : threads) {
+				thread.join();
+			}
+		}
+	}
+
+	CS350WeldStats WeldCS350Primitive(CS350PrimitiveData& data, unsigned threadCount)
+	{
+		auto start = std::chrono::steady_clock::now();
+
+		CS350WeldStats stats;
+		size_t         corners = data.positions.size();
+		stats.corners          = corners;
+		stats.vertices         = corners;
+		stats.bytesBefore      = PrimitiveBytes(data);
+		stats.bytesAfter       = stats.bytesBefore;
+		if (!data.polygons.empty() || corners == 0) {
+			return stats;
+		}
+		if (corners % 3 != 0 || corners >= cEmptySlot ||
+			(!data.normals.empty() && data.normals.size() != corners) || (!data.uvs.empty() && data.uvs.size() != corners)) {
+			throw std::runtime_error(fmt::format("WeldCS350Primitive: {} corners do not form triangles", corners));
+		}
+
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		unsigned workerCount = corners < cParallelWeldCorners ? 1u : threadCount;
+
+		// Hash of every corner, each chunk lists its corners by the worker that owns their hash
+		std::vector<uint64_t>              hashes(corners);
+		std::vector<std::vector<uint32_t>> byOwner(static_cast<size_t>(workerCount) * workerCount);
+		size_t                             chunk = (corners + workerCount - 1) / workerCount;
+		RunWorkers(workerCount, [&](unsigned worker) {
+			size_t first = std::min(corners, worker * chunk);
+			size_t last  = std::min(corners, (worker + 1) * chunk);
+			auto   lists = byOwner.begin() + static_cast<std::ptrdiff_t>(worker * workerCount);
+			for (unsigned owner = 0; owner < workerCount; owner++) {
+				lists[static_cast<std::ptrdiff_t>(owner)].reserve((last - first) / workerCount * 9 / 8 + 16);
+			}
+			for (size_t corner = first; corner < last; corner++) {
+				hashes[corner] = HashCornerKey(MakeCornerKey(data, corner));
+				lists[static_cast<std::ptrdiff_t>((hashes[corner] >> 40) % workerCount)].push_back(static_cast<uint32_t>(corner));
+			}
+		});
+
+		// Every worker owns the corners of a range of hashes, with its own open addressing table.
+		// Its lists are walked in chunk order, so corners come in increasing order and the first
+		// corner of each key is its representative.
+		std::vector<uint32_t> representative(corners);
+		RunWorkers(workerCount, [&](unsigned worker) {
+			size_t owned = 0;
+			for (unsigned chunkWorker = 0; chunkWorker < workerCount; chunkWorker++) {
+				owned += byOwner[chunkWorker * workerCount + worker].size();
+			}
+			std::vector<uint32_t> table(std::bit_ceil(owned * 2 + 1), cEmptySlot);
+			size_t                mask = table.size() - 1;
+
+			for (unsigned chunkWorker = 0; chunkWorker < workerCount; chunkWorker++) {
+				for (uint32_t corner : byOwner[chunkWorker * workerCount + worker]) {
+					CornerKey key = MakeCornerKey(data, corner);
+					for (size_t slot = hashes[corner] & mask;; slot = (slot + 1) & mask) {
+						uint32_t other = table[slot];
+						if (other == cEmptySlot) {
+							table[slot]            = corner;
+							representative[corner] = corner;
+							break;
+						}
+						if (hashes[other] == hashes[corner] && MakeCornerKey(data, other) == key) {
+							representative[corner] = other;
+							break;
+						}
+					}
+				}
+			}
+		});
+
+		// Vertices in the order of their first use, a representative always comes before its copies
+		CS350PrimitiveData welded;
+		welded.bvMin = data.bvMin;
+		welded.bvMax = data.bvMax;
+		welded.polygons.resize(corners / 3);
+		std::vector<uint32_t> vertexOf(corners);
+		for (size_t corner = 0; corner < corners; corner++) {
+			if (representative[corner] == corner) {
+				vertexOf[corner] = static_cast<uint32_t>(welded.positions.size());
+				welded.positions.push_back(data.positions[corner]);
+				if (!data.normals.empty()) {
+					welded.normals.push_back(data.normals[corner]);
+				}
+				if (!data.uvs.empty()) {
+					welded.uvs.push_back(data.uvs[corner]);
+				}
+			} else {
+				vertexOf[corner] = vertexOf[representative[corner]];
+			}
+			welded.polygons[corner / 3][corner % 3] = static_cast<int>(vertexOf[corner]);
+		}
+		welded.positions.shrink_to_fit();
+		welded.normals.shrink_to_fit();
+		welded.uvs.shrink_to_fit();
+		data = std::move(welded);
+
+		stats.vertices   = data.positions.size();
+		stats.bytesAfter = PrimitiveBytes(data);
+		stats.weldMs     = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		return stats;
+	}
+
+	void QuantizeCS350Positions(CS350PrimitiveData& data)
+	{
+		if (data.positions.empty()) {
+			return;
+		}
+		PositionQuantization quantization(data.bvMin, data.bvMax);
+		data.quantizedPositions.resize(data.positions.size());
+		for (size_t i = 0; i < data.positions.size(); i++) {
+			data.quantizedPositions[i] = quantization.quantize(data.positions[i]);
+		}
+		data.positions = {};
+	}
+
+	std::vector<vec3> CS350Positions(CS350PrimitiveData const& data)
+	{
+		if (data.quantizedPositions.empty()) {
+			return data.positions;
+		}
+		PositionQuantization quantization(data.bvMin, data.bvMax);
+		std::vector<vec3>    positions(data.quantizedPositions.size());
+		for (size_t i = 0; i < positions.size(); i++) {
+			positions[i] = quantization.dequantize(data.quantizedPositions[i]);
+		}
+		return positions;
+	}
 }
 
 #endif // CS350LOADER_CPP
@@ -12,7 +12,10 @@
 #define CS350LOADER_HPP
 
 #include "math.hpp"
+#include "quantization.hpp"
+#include "transform.hpp"
 
+#include <cstdint>
 #include <cstring>
 #include <tuple>
 #include <vector>
@@ -55,6 +58,7 @@ namespace CS350 {
      * 	- If polygons:
      * 		- Is empty: Mesh is NOT indexed, every three {pos/[norm]/[uv]} will describe a triangle
      * 		- Is non-empty: Mesh is indexed, each face is described by a three index tuple
+     * 	- If quantizedPositions is non-empty, it replaces positions, see QuantizeCS350Positions
      */
     struct CS350PrimitiveData
     {
@@ -65,6 +69,8 @@ namespace CS350 {
         std::vector<Face> polygons;
         vec3              bvMin;
         vec3              bvMax;
+
+        std::vector<QuantizedPosition> quantizedPositions; // Relative to bvMin/bvMax
     };
 
     /**
@@ -72,12 +78,13 @@ namespace CS350 {
      *
      * Each object has:
      * 	- A primitive index (referring to a vector of primitives that has been previously loaded)
-     * 	- A m2w, describing how that primitive should be represented
+     * 	- A m2w, describing how that primitive should be represented. Stored as an Affine, the scene
+     * 	  file has full matrices whose last row is always (0, 0, 0, 1)
      */
     struct CS350SceneObject
     {
-        int  primitiveIndex;
-        mat4 m2w;
+        int    primitiveIndex;
+        Affine m2w;
     };
 
     /**
@@ -96,6 +103,96 @@ namespace CS350 {
      */
     std::vector<CS350SceneObject> LoadCS350Scene(std::string const& file);
 
+    /**
+     * @brief
+     *  64 bit hash of the content of every attribute and of the bounds, equal for identical meshes loaded from
+     *  different files
+     */
+    uint64_t HashCS350Primitive(CS350PrimitiveData const& data);
+
+    /**
+     * @brief
+     *  Byte equality of everything HashCS350Primitive hashes, the quantized positions only mean the same
+     *  mesh with the same bounds
+     */
+    bool SameCS350Primitive(CS350PrimitiveData const& lhs, CS350PrimitiveData const& rhs);
+
+    /**
+     * Report of LoadCS350Primitives
+     */
+    struct CS350LoadStats
+    {
+        size_t files       = 0;   // Files found with the pattern
+        size_t primitives  = 0;   // Unique primitives among them
+        size_t bytesLoaded = 0;   // Attribute memory of every file
+        size_t bytesSaved  = 0;   // Of it, not kept because an identical primitive was already loaded
+        double loadMs      = 0.0; // Reading, hashing and comparing
+    };
+
+    /**
+     * @brief
+     *  Loads the files of a fmt pattern with an increasing index from 0 until one is missing. Files
+     *  with the same content share one primitive: hashes are compared first, then the full data.
+     * @param pattern
+     *  File path with a {} for the index, e.g. "mirlo_{}.cs350_binary"
+     * @param fileToPrimitive
+     *  Output, index of the primitive of every file, see RemapCS350Scene
+     * @param stats
+     *  Output if not null
+     * @return
+     *  Unique primitives in the order they were first found
+     */
+    std::vector<CS350PrimitiveData> LoadCS350Primitives(std::string const& pattern, std::vector<int>& fileToPrimitive, CS350LoadStats* stats = nullptr);
+
+    /**
+     * @brief
+     *  Replaces the file index of every object with the index of its shared primitive
+     */
+    void RemapCS350Scene(std::vector<CS350SceneObject>& objects, std::vector<int> const& fileToPrimitive);
+
+    // Meshes with fewer triangle corners are welded by a single thread
+    constexpr size_t cParallelWeldCorners = size_t{ 1 } << 16;
+
+    /**
+     * Report of WeldCS350Primitive
+     */
+    struct CS350WeldStats
+    {
+        size_t corners     = 0;   // Vertices before, one per triangle corner
+        size_t vertices    = 0;   // Unique vertices after
+        size_t bytesBefore = 0;   // Attribute memory before
+        size_t bytesAfter  = 0;   // Attribute and index memory after
+        double weldMs      = 0.0;
+    };
+
+    /**
+     * @brief
+     *  Optional load time pass for non indexed primitives: corners with the same attributes, bit by bit
+     *  with -0 and 0 equal, become one vertex and `polygons` is filled. Vertices are stored in the
+     *  order the triangles first use them, so consecutive triangles fetch nearby vertices. Triangles
+     *  keep their order and corners, the result does not depend on the amount of threads. Indexed
+     *  primitives are left as they are.
+     * @param data
+     *  Primitive to weld, the corner count must be a multiple of 3
+     * @param threadCount
+     *  For meshes of at least cParallelWeldCorners corners, 0 for every cpu
+     */
+    CS350WeldStats WeldCS350Primitive(CS350PrimitiveData& data, unsigned threadCount = 0);
+
+    /**
+     * @brief
+     *  Optional pass after loading (and welding): replaces the positions with 16 bits per component
+     *  relative to bvMin/bvMax, every position moves by at most PositionQuantization::error().
+     *  Does nothing if already quantized.
+     */
+    void QuantizeCS350Positions(CS350PrimitiveData& data);
+
+    /**
+     * @brief
+     *  Positions of a primitive, dequantized if needed
+     */
+    std::vector<vec3> CS350Positions(CS350PrimitiveData const& data);
+
     /**
      * @brief
      *  Final overload to stop recurse from unpacking binary
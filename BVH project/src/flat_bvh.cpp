@@ -0,0 +1,226 @@
+/**
+ * @file
+ *  flat_bvh.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/16
+ * @brief
+ *  Queries on a flattened Bvh
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "flat_bvh.hpp"
+
+#include <algorithm>
+#include <limits>
+
+namespace CS350 {
+
+    bool FlatBvhView::IsValid(void const* data, size_t size) {
+        if (data == nullptr || size < sizeof(FlatBvhHeader)) {
+            return false;
+        }
+
+        FlatBvhHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.magic != cFlatBvhMagic || header.version != cFlatBvhVersion) {
+            return false;
+        }
+
+        // Everything must fit in the block, computed in 64 bits so counts can not overflow
+        uint64_t nodesEnd   = header.nodesOffset + uint64_t{ header.nodeCount } * sizeof(FlatBvhNode);
+        uint64_t objectsEnd = header.objectsOffset + uint64_t{ header.objectCount } * sizeof(FlatBvhObject);
+        return header.nodesOffset >= sizeof(FlatBvhHeader) && header.objectsOffset >= nodesEnd &&
+               objectsEnd <= header.totalSize && header.totalSize <= size &&
+               header.nodesOffset % alignof(FlatBvhNode) == 0 && header.objectsOffset % alignof(FlatBvhObject) == 0;
+    }
+
+    FlatBvhView::FlatBvhView(void const* data, size_t size) {
+        if (!IsValid(data, size)) {
+            throw std::runtime_error("flat_bvh: invalid or incompatible flattened Bvh");
+        }
+
+        FlatBvhHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        auto const* bytes = static_cast<std::byte const*>(data);
+        mNodes            = reinterpret_cast<FlatBvhNode const*>(bytes + header.nodesOffset);
+        mObjects          = reinterpret_cast<FlatBvhObject const*>(bytes + header.objectsOffset);
+        mNodeCount        = header.nodeCount;
+        mObjectCount      = header.objectCount;
+    }
+
+    std::pair<uint32_t, uint32_t> FlatBvhView::ObjectRange(FlatBvhNode const& node) const {
+        uint32_t first = std::min(node.firstObject, mObjectCount);
+        return { first, first + std::min(node.objectCount, mObjectCount - first) };
+    }
+
+    void FlatBvhView::AppendObjects(FlatBvhNode const& node, std::vector<unsigned>& ids) const {
+        auto [first, last] = ObjectRange(node);
+        for (uint32_t i = first; i < last; i++) {
+            ids.push_back(mObjects[i].id);
+        }
+    }
+
+    std::vector<unsigned> FlatBvhView::Query(Frustum const& frustum) const {
+
+        std::vector<unsigned> objectsIds;
+        if (Empty()) {
+            return objectsIds;
+        }
+
+        std::vector<uint32_t> stack;
+        stack.push_back(0);
+
+        while (!stack.empty()) {
+
+            uint32_t           index = stack.back();
+            FlatBvhNode const& node  = mNodes[index];
+            stack.pop_back();
+
+            SideResult result = frustum.classify(node.bv);
+
+            // if node is outside, skip
+            if (result == SideResult::eOUTSIDE) {
+                continue;
+            }
+
+            // if node is inside, every object of the subtree is visible
+            if (result == SideResult::eINSIDE) {
+                AppendObjects(node, objectsIds);
+                continue;
+            }
+
+            // if node is intersecting leaf, check objects
+            if (node.rightChild == 0) {
+                auto [first, last] = ObjectRange(node);
+                for (uint32_t i = first; i < last; i++) {
+                    if (frustum.classify(mObjects[i].bv) != SideResult::eOUTSIDE) {
+                        objectsIds.push_back(mObjects[i].id);
+                    }
+                }
+                continue;
+            }
+
+            // children always come after their parent, a corrupted block can not loop
+            if (node.rightChild > index + 1 && node.rightChild < mNodeCount) {
+                stack.push_back(node.rightChild);
+                stack.push_back(index + 1);
+            }
+        }
+
+        return objectsIds;
+    }
+
+    std::optional<unsigned> FlatBvhView::Query(Ray const& ray) const {
+
+        if (Empty()) {
+            return std::nullopt;
+        }
+
+        float rootT = ray.intersect(mNodes[0].bv);
+        if (rootT < 0.f) {
+            return std::nullopt;
+        }
+
+        std::optional<unsigned> closestObject;
+        float                   closestTime = std::numeric_limits<float>::max();
+
+        // nodes are stored with the time the ray enters them
+        std::vector<std::pair<uint32_t, float>> stack;
+        stack.emplace_back(0u, rootT);
+
+        while (!stack.empty()) {
+
+            auto [index, entryTime] = stack.back();
+            stack.pop_back();
+
+            // a closer object has been found since this node was pushed
+            if (entryTime > closestTime) {
+                continue;
+            }
+
+            FlatBvhNode const& node = mNodes[index];
+            if (node.rightChild == 0) {
+                auto [first, last] = ObjectRange(node);
+                for (uint32_t i = first; i < last; i++) {
+                    float time = ray.intersect(mObjects[i].bv);
+                    if (time >= 0.f && time < closestTime) {
+                        closestTime   = time;
+                        closestObject = mObjects[i].id;
+                    }
+                }
+                continue;
+            }
+
+            if (node.rightChild <= index + 1 || node.rightChild >= mNodeCount) {
+                continue;
+            }
+
+            uint32_t children[2]  = { index + 1, node.rightChild };
+            float    childFirstT  = ray.intersect(mNodes[children[0]].bv);
+            float    childSecondT = ray.intersect(mNodes[children[1]].bv);
+
+            // push the furthest child first so the closest one is visited first
+            bool     firstIsCloser = childSecondT < 0.f || (childFirstT >= 0.f && childFirstT <= childSecondT);
+            unsigned closer        = firstIsCloser ? 0u : 1u;
+            float    closerT       = firstIsCloser ? childFirstT : childSecondT;
+            float    furtherT      = firstIsCloser ? childSecondT : childFirstT;
+
+            if (furtherT >= 0.f && furtherT <= closestTime) {
+                stack.emplace_back(children[closer ^ 1u], furtherT);
+            }
+            if (closerT >= 0.f && closerT <= closestTime) {
+                stack.emplace_back(children[closer], closerT);
+            }
+        }
+
+        return closestObject;
+    }
+
+    std::vector<unsigned> FlatBvhView::Query(Aabb const& aabb) const {
+
+        std::vector<unsigned> objectsIds;
+        if (Empty()) {
+            return objectsIds;
+        }
+
+        std::vector<uint32_t> stack;
+        stack.push_back(0);
+
+        while (!stack.empty()) {
+
+            uint32_t           index = stack.back();
+            FlatBvhNode const& node  = mNodes[index];
+            stack.pop_back();
+
+            if (!node.bv.intersects(aabb)) {
+                continue;
+            }
+
+            // node completely inside the query volume, every object overlaps
+            if (aabb.intersects(node.bv.min) && aabb.intersects(node.bv.max)) {
+                AppendObjects(node, objectsIds);
+                continue;
+            }
+
+            if (node.rightChild == 0) {
+                auto [first, last] = ObjectRange(node);
+                for (uint32_t i = first; i < last; i++) {
+                    if (mObjects[i].bv.intersects(aabb)) {
+                        objectsIds.push_back(mObjects[i].id);
+                    }
+                }
+                continue;
+            }
+
+            if (node.rightChild > index + 1 && node.rightChild < mNodeCount) {
+                stack.push_back(node.rightChild);
+                stack.push_back(index + 1);
+            }
+        }
+
+        return objectsIds;
+    }
+}
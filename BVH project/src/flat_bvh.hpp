@@ -0,0 +1,228 @@
+/**
+ * @file
+ *  flat_bvh.hpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/16
+ * @brief
+ *  Position independent, flattened copy of a Bvh. Nodes and objects are stored in a single
+ *  block of memory and reference each other by index, so the block can be copied, written to a
+ *  file or mapped by another process at any address and queried in place.
+ *
+ *  Layout: FlatBvhHeader, nodes in depth first order, objects in the order of their leaves.
+ *  The left child of node i is i + 1, the right child is stored in the node. Every node keeps the
+ *  range of objects of its whole subtree, which is contiguous because of the depth first order.
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef FLAT_BVH_HPP
+#define FLAT_BVH_HPP
+
+#include "bvh.hpp"
+#include "shapes.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace CS350 {
+
+    constexpr uint32_t cFlatBvhMagic   = 0x31425343; // "CSB1"
+    constexpr uint16_t cFlatBvhVersion = 1;          // Bumped on any change of the layout below
+
+    /**
+     * @brief
+     *  Start of every flattened Bvh. Offsets are relative to the start of the header.
+     */
+    struct FlatBvhHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        uint32_t nodeCount;
+        uint32_t objectCount;
+        uint64_t nodesOffset;
+        uint64_t objectsOffset;
+        uint64_t totalSize; // Header, nodes and objects
+    };
+    static_assert(sizeof(FlatBvhHeader) == 40);
+
+    struct FlatBvhNode {
+        Aabb     bv;
+        uint32_t rightChild;  // 0 for leaves, the root can never be a right child
+        uint32_t firstObject; // Objects of the whole subtree
+        uint32_t objectCount; //
+    };
+    static_assert(sizeof(FlatBvhNode) == 36);
+    static_assert(std::is_trivially_copyable<FlatBvhNode>());
+
+    struct FlatBvhObject {
+        Aabb     bv;
+        uint32_t id;
+    };
+    static_assert(sizeof(FlatBvhObject) == 28);
+    static_assert(std::is_trivially_copyable<FlatBvhObject>());
+
+    /**
+     * @brief
+     *  Bytes needed to flatten the Bvh
+     */
+    template <typename T>
+    size_t FlatBvhSize(Bvh<T> const& bvh);
+
+    /**
+     * @brief
+     *  Writes a flattened copy of the Bvh into the buffer
+     * @param bvh
+     *  Bvh to flatten
+     * @param buffer
+     *  Destination, aligned to at least 8 bytes
+     * @param capacity
+     *  Size of the buffer, throws if smaller than FlatBvhSize(bvh)
+     * @return
+     *  Bytes written
+     */
+    template <typename T>
+    size_t FlattenBvh(Bvh<T> const& bvh, void* buffer, size_t capacity);
+
+    /**
+     * @brief
+     *  Read only view of a flattened Bvh. Does not own the memory.
+     *
+     *  Traversal never leaves the block even if its content is garbage (e.g. it is being rewritten
+     *  by another process): child indices must grow and object ranges are clamped, so a corrupted
+     *  block gives wrong results instead of crashing or looping.
+     */
+    class FlatBvhView {
+      public:
+        FlatBvhView() = default;
+
+        /**
+         * @brief
+         *  Wraps a flattened Bvh, throws if the header does not describe a valid block
+         * @param data
+         *  Start of the block
+         * @param size
+         *  Bytes available at data
+         */
+        FlatBvhView(void const* data, size_t size);
+
+        /**
+         * @brief
+         *  Checks the header of a block without throwing
+         * @return
+         *  True if the block can be wrapped by a FlatBvhView
+         */
+        static bool IsValid(void const* data, size_t size);
+
+		/**
+		 * @brief
+		 *  Peforms frustum vs Bvh query
+		 * @return
+		 *  Ids of the objects that are visible in the frustum
+		 */
+        std::vector<unsigned>   Query(Frustum const& frustum) const;
+
+		/**
+		 * @brief
+		 *  Peforms ray vs Bvh query for the closest object only
+		 * @return
+		 *  Id of the closest intersected object
+		 */
+        std::optional<unsigned> Query(Ray const& ray) const;
+
+		/**
+		 * @brief
+		 *  Peforms aabb vs Bvh overlap query
+		 * @return
+		 *  Ids of the objects whose bounding volume overlaps the aabb
+		 */
+        std::vector<unsigned>   Query(Aabb const& aabb) const;
+
+        bool                 Empty() const { return mNodeCount == 0; }
+        unsigned             nodeCount() const { return mNodeCount; }
+        unsigned             objectCount() const { return mObjectCount; }
+        FlatBvhNode const*   nodes() const { return mNodes; }
+        FlatBvhObject const* objects() const { return mObjects; }
+
+      private:
+        /**
+         * @brief
+         *  Objects of the node subtree as [first, last), clamped to the object array
+         */
+        std::pair<uint32_t, uint32_t> ObjectRange(FlatBvhNode const& node) const;
+
+        /**
+         * @brief
+         *  Appends the ids of every object of the node subtree
+         */
+        void AppendObjects(FlatBvhNode const& node, std::vector<unsigned>& ids) const;
+
+        FlatBvhNode const*   mNodes       = nullptr;
+        FlatBvhObject const* mObjects     = nullptr;
+        unsigned             mNodeCount   = 0;
+        unsigned             mObjectCount = 0;
+    };
+
+    template <typename T>
+    size_t FlatBvhSize(Bvh<T> const& bvh) {
+        size_t nodeCount = bvh.Empty() ? 0u : static_cast<size_t>(bvh.Size());
+        return sizeof(FlatBvhHeader) + nodeCount * sizeof(FlatBvhNode) + bvh.objectCount() * sizeof(FlatBvhObject);
+    }
+
+    template <typename T>
+    size_t FlattenBvh(Bvh<T> const& bvh, void* buffer, size_t capacity) {
+        size_t totalSize = FlatBvhSize(bvh);
+        if (capacity < totalSize) {
+            throw std::runtime_error(fmt::format("flat_bvh: buffer of {} bytes is too small, {} needed", capacity, totalSize));
+        }
+
+        auto*          bytes  = static_cast<std::byte*>(buffer);
+        FlatBvhHeader  header{};
+        header.magic          = cFlatBvhMagic;
+        header.version        = cFlatBvhVersion;
+        header.nodeCount      = bvh.Empty() ? 0u : static_cast<uint32_t>(bvh.Size());
+        header.objectCount    = bvh.objectCount();
+        header.nodesOffset    = sizeof(FlatBvhHeader);
+        header.objectsOffset  = header.nodesOffset + header.nodeCount * sizeof(FlatBvhNode);
+        header.totalSize      = totalSize;
+
+        // Nodes are written in depth first order, the right child index is only known once the left subtree is done
+        uint32_t nodeIndex   = 0;
+        uint32_t objectIndex = 0;
+        auto     flattenNode = [&](auto self, typename Bvh<T>::Node const* node) -> uint32_t {
+            uint32_t    index = nodeIndex++;
+            FlatBvhNode flat{ node->bv, 0u, objectIndex, 0u };
+
+            if (node->IsLeaf()) {
+                for (T object = node->firstObject; object != nullptr; object = object->bvhInfo.next) {
+                    FlatBvhObject flatObject{ object->bv, object->id };
+                    std::memcpy(bytes + header.objectsOffset + objectIndex * sizeof(FlatBvhObject), &flatObject, sizeof(flatObject));
+                    objectIndex++;
+                }
+            } else {
+                self(self, node->children[0]);
+                flat.rightChild = self(self, node->children[1]);
+            }
+
+            flat.objectCount = objectIndex - flat.firstObject;
+            std::memcpy(bytes + header.nodesOffset + index * sizeof(FlatBvhNode), &flat, sizeof(flat));
+            return index;
+        };
+
+        if (!bvh.Empty()) {
+            flattenNode(flattenNode, bvh.root());
+        }
+
+        std::memcpy(bytes, &header, sizeof(header));
+        return totalSize;
+    }
+}
+
+#endif // FLAT_BVH_HPP
@@ -0,0 +1,216 @@
+/**
+ * @file
+ *  pvs.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/23
+ * @brief
+ *  Potentially visible sets lookup and compressed file format
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "pvs.hpp"
+
+#include <bit>
+#include <cstring>
+#include <istream>
+#include <limits>
+#include <ostream>
+#include <stdexcept>
+
+namespace CS350 {
+
+    namespace {
+        void WriteVarint(std::vector<uint8_t>& bytes, uint32_t value) {
+            while (value >= 0x80) {
+                bytes.push_back(static_cast<uint8_t>(value | 0x80));
+                value >>= 7;
+            }
+            bytes.push_back(static_cast<uint8_t>(value));
+        }
+
+        /**
+         * @brief
+         *  Reads one LEB128 value, false if the bytes end first or it does not fit in 32 bits
+         */
+        bool ReadVarint(std::vector<uint8_t> const& bytes, size_t& offset, uint32_t& value) {
+            value = 0;
+            for (unsigned shift = 0; shift < 35; shift += 7) {
+                if (offset == bytes.size()) {
+                    return false;
+                }
+                uint8_t byte = bytes[offset++];
+                if (shift == 28 && (byte & 0xF0) != 0) {
+                    return false;
+                }
+                value |= uint32_t{ byte & 0x7Fu } << shift;
+                if ((byte & 0x80) == 0) {
+                    return true;
+                }
+            }
+            return false;
+        }
+
+        template <typename U>
+        void Read(std::istream& is, U* data, size_t size) {
+            if (!is.read(reinterpret_cast<char*>(data), static_cast<std::streamsize>(size))) {
+                throw std::runtime_error("pvs: truncated file");
+            }
+        }
+    }
+
+    Pvs::Pvs(Aabb const& bounds, ivec3 const& cells, unsigned objectCount) :
+        mBounds(bounds),
+        mCells(cells),
+        mObjectCount(objectCount),
+        mWordsPerCell((size_t{ objectCount } + 63) / 64) {
+        if (cells.x <= 0 || cells.y <= 0 || cells.z <= 0) {
+            throw std::runtime_error("pvs: every axis needs at least one view cell");
+        }
+        mBits.assign(cellCount() * mWordsPerCell, 0);
+    }
+
+    std::optional<size_t> Pvs::CellIndex(vec3 const& point) const {
+        if (cellCount() == 0 || !mBounds.intersects(point)) {
+            return std::nullopt;
+        }
+
+        // Points on the max face belong to the last cell
+        vec3  size = glm::max(mBounds.max - mBounds.min, vec3(std::numeric_limits<float>::min()));
+        ivec3 cell = glm::clamp(ivec3((point - mBounds.min) / size * vec3(mCells)), ivec3(0), mCells - 1);
+        return (static_cast<size_t>(cell.z) * static_cast<size_t>(mCells.y) + static_cast<size_t>(cell.y)) * static_cast<size_t>(mCells.x) + static_cast<size_t>(cell.x);
+    }
+
+    Aabb Pvs::CellBounds(size_t cell) const {
+        ivec3 coords(static_cast<int>(cell % static_cast<size_t>(mCells.x)),
+                     static_cast<int>(cell / static_cast<size_t>(mCells.x) % static_cast<size_t>(mCells.y)),
+                     static_cast<int>(cell / (static_cast<size_t>(mCells.x) * static_cast<size_t>(mCells.y))));
+        vec3 cellSize = (mBounds.max - mBounds.min) / vec3(mCells);
+        vec3 min      = mBounds.min + cellSize * vec3(coords);
+        return Aabb(min, min + cellSize);
+    }
+
+    void Pvs::SetVisible(size_t cell, unsigned id) {
+        if (cell >= cellCount() || id >= mObjectCount) {
+            throw std::runtime_error("pvs: cell or object out of range");
+        }
+        CellBits(cell)[id / 64] |= uint64_t{ 1 } << (id % 64);
+    }
+
+    bool Pvs::IsVisible(size_t cell, unsigned id) const {
+        return cell < cellCount() && id < mObjectCount && (CellBits(cell)[id / 64] >> (id % 64) & 1u) != 0;
+    }
+
+    size_t Pvs::VisibleCount(size_t cell) const {
+        size_t          count = 0;
+        uint64_t const* bits  = CellBits(cell);
+        for (size_t w = 0; w < mWordsPerCell; ++w) {
+            count += static_cast<size_t>(std::popcount(bits[w]));
+        }
+        return count;
+    }
+
+    std::vector<unsigned> Pvs::Cull(vec3 const& eye, std::vector<unsigned> const& objectsIds) const {
+        auto cell = CellIndex(eye);
+        if (!cell) {
+            return objectsIds;
+        }
+
+        std::vector<unsigned> visible;
+        visible.reserve(objectsIds.size());
+        for (unsigned id : objectsIds) {
+            if (id >= mObjectCount || IsVisible(*cell, id)) {
+                visible.push_back(id);
+            }
+        }
+        return visible;
+    }
+
+    void Pvs::Save(std::ostream& os) const {
+        PvsHeader header{};
+        header.magic       = cPvsMagic;
+        header.version     = cPvsVersion;
+        header.objectCount = mObjectCount;
+        for (int i = 0; i < 3; ++i) {
+            header.cells[i]     = mCells[i];
+            header.boundsMin[i] = mBounds.min[i];
+            header.boundsMax[i] = mBounds.max[i];
+        }
+        os.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+        std::vector<uint8_t> bytes;
+        for (size_t cell = 0; cell < cellCount(); ++cell) {
+            // Alternating runs, starting with hidden objects
+            bytes.clear();
+            bool     visible = false;
+            uint32_t run     = 0;
+            for (unsigned id = 0; id < mObjectCount; ++id) {
+                if (IsVisible(cell, id) != visible) {
+                    WriteVarint(bytes, run);
+                    visible = !visible;
+                    run     = 0;
+                }
+                ++run;
+            }
+            WriteVarint(bytes, run);
+
+            auto byteCount = static_cast<uint32_t>(bytes.size());
+            os.write(reinterpret_cast<char const*>(&byteCount), sizeof(byteCount));
+            os.write(reinterpret_cast<char const*>(bytes.data()), static_cast<std::streamsize>(bytes.size()));
+        }
+        if (!os) {
+            throw std::runtime_error("pvs: failed to write");
+        }
+    }
+
+    Pvs Pvs::Load(std::istream& is) {
+        PvsHeader header;
+        Read(is, &header, sizeof(header));
+        if (header.magic != cPvsMagic || header.version != cPvsVersion) {
+            throw std::runtime_error("pvs: invalid or incompatible file");
+        }
+
+        Pvs pvs(Aabb(vec3(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]),
+                     vec3(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2])),
+                ivec3(header.cells[0], header.cells[1], header.cells[2]),
+                header.objectCount);
+
+        std::vector<uint8_t> bytes;
+        for (size_t cell = 0; cell < pvs.cellCount(); ++cell) {
+            uint32_t byteCount;
+            Read(is, &byteCount, sizeof(byteCount));
+            // Each run takes at least a byte and there is at most one per object, plus the last
+            if (byteCount > (uint64_t{ header.objectCount } + 1) * 5) {
+                throw std::runtime_error("pvs: corrupted cell");
+            }
+            bytes.resize(byteCount);
+            Read(is, bytes.data(), bytes.size());
+
+            size_t   offset  = 0;
+            uint64_t id      = 0;
+            bool     visible = false;
+            while (offset < bytes.size()) {
+                uint32_t run;
+                if (!ReadVarint(bytes, offset, run) || id + run > header.objectCount) {
+                    throw std::runtime_error("pvs: corrupted cell");
+                }
+                for (uint32_t i = 0; visible && i < run; ++i) {
+                    pvs.SetVisible(cell, static_cast<unsigned>(id + i));
+                }
+                id += run;
+                visible = !visible;
+            }
+            if (id != header.objectCount) {
+                throw std::runtime_error("pvs: corrupted cell");
+            }
+        }
+        return pvs;
+    }
+
+    bool Pvs::operator==(Pvs const& rhs) const {
+        return mBounds.min == rhs.mBounds.min && mBounds.max == rhs.mBounds.max && mCells == rhs.mCells &&
+               mObjectCount == rhs.mObjectCount && mBits == rhs.mBits;
+    }
+}
@@ -0,0 +1,161 @@
+/**
+ * @file
+ *  pvs.hpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/23
+ * @brief
+ *  Potentially visible sets of a static scene, baked offline with batched Bvh rays.
+ *
+ *  The scene bounds are divided in a grid of view cells. Rays are shot in every direction from
+ *  random points inside each cell, any object hit first by a ray is visible from that cell. Bvs
+ *  around the origin of a ray never stop it, a camera inside a floor or room box sees past it. At
+ *  runtime the cell of the camera removes the objects never seen from it off a frustum query.
+ *  Sampling can miss small or distant objects, more samples and rays make it more conservative.
+ *
+ *  File layout: PvsHeader, then per cell a uint32_t byte count followed by the visibility bits
+ *  run-length encoded, alternating runs of hidden and visible objects (hidden first) as LEB128.
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef PVS_HPP
+#define PVS_HPP
+
+#include "bvh.hpp"
+#include "shapes.hpp"
+
+#include <cstdint>
+#include <iosfwd>
+#include <optional>
+#include <vector>
+
+namespace CS350 {
+
+    constexpr uint32_t cPvsMagic   = 0x53565043; // "CPVS"
+    constexpr uint16_t cPvsVersion = 1;          // Bumped on any change of the file layout
+
+    /**
+     * @brief
+     *  Start of every PVS file
+     */
+    struct PvsHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t reserved;
+        int32_t  cells[3];    // View cells along each axis
+        uint32_t objectCount; // Bits per cell, objects ids are below it
+        float    boundsMin[3];
+        float    boundsMax[3];
+    };
+    static_assert(sizeof(PvsHeader) == 48);
+
+    /**
+     * @brief
+     *  Parameters of BakePvs
+     */
+    struct PvsBakeConfig {
+        std::optional<Aabb> bounds;              // Region covered by the view cells, the whole Bvh if empty
+        ivec3               cells          = ivec3(8);
+        unsigned            samplesPerCell = 8;   // Random ray origins inside each cell
+        unsigned            raysPerSample  = 256; // Directions shot from every origin
+        uint32_t            seed           = 1;
+    };
+
+    /**
+     * @brief
+     *  One visibility bitset per view cell
+     */
+    class Pvs {
+      public:
+        Pvs() = default;
+
+        /**
+         * @brief
+         *  Grid of view cells where nothing is visible yet
+         * @param bounds
+         *  Region divided in cells
+         * @param cells
+         *  Amount of cells along each axis, all positive
+         * @param objectCount
+         *  Objects ids must be below it
+         */
+        Pvs(Aabb const& bounds, ivec3 const& cells, unsigned objectCount);
+
+        /**
+         * @brief
+         *  Cell containing the point, empty when it is outside of the bounds
+         */
+        std::optional<size_t> CellIndex(vec3 const& point) const;
+
+        /**
+         * @brief
+         *  Region covered by a cell
+         */
+        Aabb                  CellBounds(size_t cell) const;
+
+        void                  SetVisible(size_t cell, unsigned id);
+        bool                  IsVisible(size_t cell, unsigned id) const;
+        size_t                VisibleCount(size_t cell) const;
+
+        /**
+         * @brief
+         *  Runtime lookup, removes the objects not visible from the cell of the eye off the result of a Bvh query.
+         *  Everything is kept if the eye is outside the baked bounds, as are objects newer than the bake.
+         * @param eye
+         *  Camera position
+         * @param objectsIds
+         *  Result of a query, usually Bvh::Query(Frustum)
+         * @return
+         *  Potentially visible objects in the same order
+         */
+        std::vector<unsigned> Cull(vec3 const& eye, std::vector<unsigned> const& objectsIds) const;
+
+        /**
+         * @brief
+         *  Writes the compressed file
+         */
+        void                  Save(std::ostream& os) const;
+
+        /**
+         * @brief
+         *  Reads a file written by Save, throws on invalid or incompatible files
+         */
+        static Pvs            Load(std::istream& is);
+
+        bool                  operator==(Pvs const& rhs) const;
+
+        Aabb const&           bounds() const { return mBounds; }
+        ivec3 const&          cells() const { return mCells; }
+        size_t                cellCount() const { return static_cast<size_t>(mCells.x) * static_cast<size_t>(mCells.y) * static_cast<size_t>(mCells.z); }
+        unsigned              objectCount() const { return mObjectCount; }
+
+      private:
+        uint64_t const*       CellBits(size_t cell) const { return mBits.data() + cell * mWordsPerCell; }
+        uint64_t*             CellBits(size_t cell) { return mBits.data() + cell * mWordsPerCell; }
+
+        Aabb                  mBounds{};
+        ivec3                 mCells{ 0 };
+        unsigned              mObjectCount  = 0;
+        size_t                mWordsPerCell = 0;
+        std::vector<uint64_t> mBits; // Uncompressed, cells one after the other
+    };
+
+    /**
+     * @brief
+     *  Bakes the potentially visible sets of the objects of a Bvh
+     * @param bvh
+     *  Scene, objects ids are expected to be small and dense
+     * @param config
+     *  Grid and sampling rates
+     * @return
+     *  Visibility of every cell
+     */
+    template <typename T>
+    Pvs BakePvs(Bvh<T> const& bvh, PvsBakeConfig const& config = {});
+}
+
+#include "pvs.inl"
+
+#endif // PVS_HPP
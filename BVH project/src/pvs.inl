@@ -0,0 +1,97 @@
+/**
+ * @file
+ *  pvs.inl
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/23
+ * @brief
+ *  Baking of potentially visible sets
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef PVS_INL
+#define PVS_INL
+
+#include "pvs.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <random>
+#include <stdexcept>
+
+namespace CS350 {
+
+    template <typename T>
+    Pvs BakePvs(Bvh<T> const& bvh, PvsBakeConfig const& config) {
+        if (!config.bounds && bvh.Empty()) {
+            throw std::runtime_error("pvs.inl: bounds are required to bake an empty Bvh");
+        }
+
+        unsigned       objectCount = 0;
+        std::vector<T> objectsById;
+        bvh.TraverseLevelOrderObjects([&](auto const& object) {
+            objectCount = std::max(objectCount, static_cast<unsigned>(object->id) + 1u);
+            objectsById.resize(objectCount);
+            objectsById[object->id] = object;
+        });
+        Pvs pvs(config.bounds ? *config.bounds : bvh.root()->bv, config.cells, objectCount);
+
+        // Every ray of a cell goes in a single batch. The CS170 generator is global, use our own.
+        std::mt19937                          random(config.seed);
+        std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+        size_t                                rayCount = size_t{ config.samplesPerCell } * config.raysPerSample;
+        std::vector<Ray>                      rays(rayCount);
+        std::vector<std::optional<unsigned>>  closestObjects(rayCount);
+        for (size_t cell = 0; cell < pvs.cellCount(); ++cell) {
+            Aabb cellBounds = pvs.CellBounds(cell);
+
+            // A camera inside the cell sees whatever overlaps it, even if no ray starts inside
+            for (unsigned id : bvh.Query(cellBounds)) {
+                pvs.SetVisible(cell, id);
+            }
+
+            for (size_t s = 0; s < config.samplesPerCell; ++s) {
+                float x      = unit(random);
+                float y      = unit(random);
+                float z      = unit(random);
+                vec3  origin = cellBounds.min + (cellBounds.max - cellBounds.min) * vec3(x, y, z);
+                for (size_t r = 0; r < config.raysPerSample; ++r) {
+                    // Uniform on the sphere
+                    float cosTheta = 2.0f * unit(random) - 1.0f;
+                    float phi      = 2.0f * glm::pi<float>() * unit(random);
+                    float sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+                    rays[s * config.raysPerSample + r] = Ray(origin, vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta));
+                }
+            }
+
+            bvh.QueryBatch(rays.data(), rays.size(), closestObjects.data());
+            for (size_t r = 0; r < rayCount; ++r) {
+                std::optional<unsigned> closest = closestObjects[r];
+                Ray const&              ray     = rays[r];
+
+                // A bv around the origin (floor, room, terrain) is hit at 0 and would hide everything
+                // behind it. It is already visible from the overlap query, trace again through it.
+                if (closest && ray.intersect(objectsById[*closest]->bv) <= 0.0f) {
+                    float tMax = std::numeric_limits<float>::max();
+                    closest    = bvh.QueryExact(ray, tMax, [&](T const& object, float& closestTime) {
+                        float time = ray.intersect(object->bv);
+                        if (time <= 0.0f || time >= closestTime) {
+                            return false;
+                        }
+                        closestTime = time;
+                        return true;
+                    });
+                }
+                if (closest) {
+                    pvs.SetVisible(cell, *closest);
+                }
+            }
+        }
+        return pvs;
+    }
+}
+
+#endif // PVS_INL
@@ -0,0 +1,49 @@
+/**
+ * @file
+ *  quantization.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Quantization of mesh positions
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "quantization.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace CS350 {
+
+    PositionQuantization::PositionQuantization(vec3 const& bvMin, vec3 const& bvMax) :
+        mOffset{ bvMin },
+        mStepSize{ (bvMax - bvMin) / cQuantizationSteps },
+        mInvStep{}
+    {
+        for (int axis = 0; axis < 3; axis++) {
+            mInvStep[axis] = mStepSize[axis] > 0.0f ? 1.0f / mStepSize[axis] : 0.0f;
+        }
+#ifdef CS350_QUANTIZATION_SSE2
+        mOffsetLanes = _mm_setr_ps(mOffset.x, mOffset.y, mOffset.z, 0.0f);
+        mStepLanes   = _mm_setr_ps(mStepSize.x, mStepSize.y, mStepSize.z, 0.0f);
+#endif
+    }
+
+    QuantizedPosition PositionQuantization::quantize(vec3 const& position) const {
+        QuantizedPosition steps{};
+        for (int axis = 0; axis < 3; axis++) {
+            float step = std::round((position[axis] - mOffset[axis]) * mInvStep[axis]);
+            steps[static_cast<size_t>(axis)] = static_cast<uint16_t>(std::clamp(step, 0.0f, cQuantizationSteps));
+        }
+        return steps;
+    }
+
+    vec3 PositionQuantization::error() const {
+        vec3 bvMax = mOffset + mStepSize * cQuantizationSteps;
+        return mStepSize * 0.5f + glm::max(glm::abs(mOffset), glm::abs(bvMax)) * (8.0f * FLT_EPSILON);
+    }
+}
@@ -0,0 +1,105 @@
+/**
+ * @file
+ *  quantization.hpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  16 bit mesh positions relative to the bounds of their mesh. Each axis of the bounds is split
+ *  in 65535 steps, a position is the closest step on each axis: 6 bytes instead of 12, with an
+ *  error of at most half a step plus the float rounding of the dequantization, see error().
+ *
+ *  Dequantization uses SSE2 where available, so query kernels can keep only the 16 bit values.
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef QUANTIZATION_HPP
+#define QUANTIZATION_HPP
+
+#include "math.hpp"
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define CS350_QUANTIZATION_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace CS350 {
+
+    using QuantizedPosition = std::array<uint16_t, 3>;
+    static_assert(sizeof(QuantizedPosition) == 6);
+
+    constexpr float cQuantizationSteps = 65535.0f;
+
+    /**
+     * @brief
+     *  Mapping between positions inside bounds and their steps
+     */
+    class PositionQuantization {
+      public:
+        PositionQuantization(vec3 const& bvMin, vec3 const& bvMax);
+
+        /**
+         * @brief
+         *  Closest step of each axis, positions outside of the bounds are clamped to them
+         */
+        QuantizedPosition quantize(vec3 const& position) const;
+
+        /**
+         * @brief
+         *  bvMin + step * stepSize with one rounding per operation, the same on every path
+         * @param steps
+         *  Reads exactly 3 values
+         */
+        vec3 dequantize(uint16_t const* steps) const;
+        vec3 dequantize(QuantizedPosition const& steps) const { return dequantize(steps.data()); }
+
+        /**
+         * @brief
+         *  Largest difference on each axis between a position inside the bounds and its round trip:
+         *  half a step, plus 8 float epsilons of the largest bound coordinate for the rounding of the
+         *  step size, the quantization and the dequantization
+         */
+        vec3 error() const;
+
+        vec3 const& stepSize() const { return mStepSize; }
+
+      private:
+        vec3 mOffset;   // bvMin
+        vec3 mStepSize; // Of each axis, 0 for flat axes
+        vec3 mInvStep;  // Steps per unit, 0 for flat axes
+#ifdef CS350_QUANTIZATION_SSE2
+        __m128 mOffsetLanes;
+        __m128 mStepLanes;
+#endif
+    };
+
+    inline vec3 PositionQuantization::dequantize(uint16_t const* steps) const {
+#ifdef CS350_QUANTIZATION_SSE2
+        // x and y in one 32 bit load, z inserted, widened to 32 bit integers then converted
+        int32_t xy;
+        std::memcpy(&xy, steps, sizeof(xy));
+        __m128i packed = _mm_insert_epi16(_mm_cvtsi32_si128(xy), steps[2], 2);
+        __m128  lanes  = _mm_cvtepi32_ps(_mm_unpacklo_epi16(packed, _mm_setzero_si128()));
+        lanes          = _mm_add_ps(_mm_mul_ps(lanes, mStepLanes), mOffsetLanes);
+
+        alignas(16) float result[4];
+        _mm_store_ps(result, lanes);
+        return vec3(result[0], result[1], result[2]);
+#else
+        vec3 result;
+        for (int axis = 0; axis < 3; axis++) {
+            float scaled = static_cast<float>(steps[axis]) * mStepSize[axis];
+            result[axis] = mOffset[axis] + scaled;
+        }
+        return result;
+#endif
+    }
+}
+
+#endif // QUANTIZATION_HPP
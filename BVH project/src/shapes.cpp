@@ -16,10 +16,235 @@
 #include <iostream>
 #include <random>
 #include <algorithm>
+#include <array>
+#include <bit>
+#include <cmath>
+#include <limits>
 
 
 namespace {
     constexpr float cEpsilon = 1e-5f;
+    constexpr int   cGjkIterations = 64; // Undecided after that many is reported as overlapping
+
+    // Axes, corner diagonals and edge diagonals
+    constexpr float cKdopDirections[13][3] = {
+        { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 },
+        { 1, 1, 1 }, { 1, 1, -1 }, { 1, -1, 1 }, { -1, 1, 1 },
+        { 1, 1, 0 }, { 1, -1, 0 }, { 1, 0, 1 }, { 1, 0, -1 }, { 0, 1, 1 }, { 0, 1, -1 },
+    };
+
+    struct PolytopeMeasures {
+        float surfaceArea = 0.f;
+        float volume      = 0.f;
+    };
+
+    /**
+     * @brief
+     *  Measures the box clipped by the half spaces dot(normal, pt) <= offset. Faces are clipped one
+     *  plane at a time, the points left on the plane form the new face.
+     */
+    PolytopeMeasures MeasureClippedBox(vec3 const& min, vec3 const& max, std::vector<std::pair<vec3, float>> const& halfSpaces) {
+        // Counter clockwise seen from outside
+        std::vector<std::vector<vec3>> faces = {
+            { vec3(min.x, min.y, min.z), vec3(min.x, min.y, max.z), vec3(min.x, max.y, max.z), vec3(min.x, max.y, min.z) },
+            { vec3(max.x, min.y, min.z), vec3(max.x, max.y, min.z), vec3(max.x, max.y, max.z), vec3(max.x, min.y, max.z) },
+            { vec3(min.x, min.y, min.z), vec3(max.x, min.y, min.z), vec3(max.x, min.y, max.z), vec3(min.x, min.y, max.z) },
+            { vec3(min.x, max.y, min.z), vec3(min.x, max.y, max.z), vec3(max.x, max.y, max.z), vec3(max.x, max.y, min.z) },
+            { vec3(min.x, min.y, min.z), vec3(min.x, max.y, min.z), vec3(max.x, max.y, min.z), vec3(max.x, min.y, min.z) },
+            { vec3(min.x, min.y, max.z), vec3(max.x, min.y, max.z), vec3(max.x, max.y, max.z), vec3(min.x, max.y, max.z) },
+        };
+
+        for (auto const& [normal, offset] : halfSpaces) {
+            std::vector<std::vector<vec3>> clipped;
+            std::vector<vec3>              cap;
+            for (auto const& face : faces) {
+                std::vector<vec3> kept;
+                for (size_t i = 0; i < face.size(); ++i) {
+                    vec3 const& current  = face[i];
+                    vec3 const& next     = face[(i + 1) % face.size()];
+                    float       dCurrent = glm::dot(normal, current) - offset;
+                    float       dNext    = glm::dot(normal, next) - offset;
+                    if (dCurrent <= 0.f) {
+                        kept.push_back(current);
+                    }
+                    if ((dCurrent < 0.f && dNext > 0.f) || (dCurrent > 0.f && dNext < 0.f)) {
+                        vec3 crossing = current + (next - current) * (dCurrent / (dCurrent - dNext));
+                        kept.push_back(crossing);
+                        cap.push_back(crossing);
+                    } else if (dCurrent == 0.f) {
+                        cap.push_back(current);
+                    }
+                }
+                if (kept.size() >= 3) {
+                    clipped.push_back(std::move(kept));
+                }
+            }
+
+            // Cap around its center, counter clockwise seen along the normal
+            if (cap.size() >= 3) {
+                vec3 center(0.f);
+                for (vec3 const& point : cap) {
+                    center += point;
+                }
+                center /= static_cast<float>(cap.size());
+                vec3 tangent   = glm::normalize(glm::cross(glm::abs(normal.x) > 0.5f ? vec3(0, 1, 0) : vec3(1, 0, 0), normal));
+                vec3 bitangent = glm::cross(normal, tangent);
+                auto angle     = [&](vec3 const& point) {
+                    vec3 offsetToPoint = point - center;
+                    return std::atan2(glm::dot(offsetToPoint, bitangent), glm::dot(offsetToPoint, tangent));
+                };
+                std::sort(cap.begin(), cap.end(), [&](vec3 const& lhs, vec3 const& rhs) { return angle(lhs) < angle(rhs); });
+                clipped.push_back(std::move(cap));
+            }
+            faces = std::move(clipped);
+        }
+
+        // Divergence theorem, every face is a cone to the origin
+        PolytopeMeasures measures;
+        for (auto const& face : faces) {
+            vec3 areaVector(0.f);
+            for (size_t i = 0; i < face.size(); ++i) {
+                areaVector += glm::cross(face[i], face[(i + 1) % face.size()]);
+            }
+            areaVector *= 0.5f;
+            measures.surfaceArea += glm::length(areaVector);
+            measures.volume += glm::dot(face[0], areaVector) / 3.f;
+        }
+        measures.volume = glm::max(measures.volume, 0.f);
+        return measures;
+    }
+
+    template <unsigned K>
+    PolytopeMeasures MeasureKdop(CS350::Kdop<K> const& kdop) {
+        vec3 min(kdop.min[0], kdop.min[1], kdop.min[2]);
+        vec3 max(kdop.max[0], kdop.max[1], kdop.max[2]);
+
+        // Only the diagonal slabs cutting into the box
+        std::vector<std::pair<vec3, float>> halfSpaces;
+        CS350::Kdop<K>                      box(CS350::Aabb(min, max));
+        for (unsigned slab = 3; slab < CS350::Kdop<K>::cSlabs; ++slab) {
+            vec3 dir = CS350::Kdop<K>::direction(slab);
+            if (kdop.max[slab] < box.max[slab]) {
+                halfSpaces.emplace_back(dir, kdop.max[slab]);
+            }
+            if (kdop.min[slab] > box.min[slab]) {
+                halfSpaces.emplace_back(-dir, -kdop.min[slab]);
+            }
+        }
+        return MeasureClippedBox(min, max, halfSpaces);
+    }
+
+    bool SameDirection(vec3 const& lhs, vec3 const& rhs) {
+        return glm::dot(lhs, rhs) > 0.f;
+    }
+
+    /**
+     * @brief
+     *  Keeps the feature of the simplex closest to the origin and the direction to search next.
+     *  The newest point is simplex[0].
+     * @return
+     *  True once the simplex encloses the origin
+     */
+    bool NextSimplex(std::array<vec3, 4>& simplex, int& size, vec3& dir) {
+        vec3 a  = simplex[0];
+        vec3 ao = -a;
+
+        auto line = [&](vec3 const& b) {
+            vec3 ab = b - a;
+            if (SameDirection(ab, ao)) {
+                simplex = { a, b };
+                size    = 2;
+                dir     = glm::cross(glm::cross(ab, ao), ab);
+            } else {
+                simplex = { a };
+                size    = 1;
+                dir     = ao;
+            }
+            return false;
+        };
+        auto triangle = [&](vec3 const& b, vec3 const& c) {
+            vec3 ab  = b - a;
+            vec3 ac  = c - a;
+            vec3 abc = glm::cross(ab, ac);
+            if (SameDirection(glm::cross(abc, ac), ao)) {
+                if (SameDirection(ac, ao)) {
+                    simplex = { a, c };
+                    size    = 2;
+                    dir     = glm::cross(glm::cross(ac, ao), ac);
+                    return false;
+                }
+                return line(b);
+            }
+            if (SameDirection(glm::cross(ab, abc), ao)) {
+                return line(b);
+            }
+            if (SameDirection(abc, ao)) {
+                simplex = { a, b, c };
+                dir     = abc;
+            } else {
+                simplex = { a, c, b };
+                dir     = -abc;
+            }
+            size = 3;
+            return false;
+        };
+
+        switch (size) {
+            case 2: return line(simplex[1]);
+            case 3: return triangle(simplex[1], simplex[2]);
+            default: {
+                // Faces through the newest point, normals facing away from the opposite point
+                vec3 b = simplex[1], c = simplex[2], d = simplex[3];
+                auto outside = [&](vec3 const& p, vec3 const& q, vec3 const& opposite) {
+                    vec3 normal = glm::cross(p - a, q - a);
+                    return glm::dot(normal, ao) * glm::dot(normal, opposite - a) < 0.f;
+                };
+                if (outside(b, c, d)) {
+                    return triangle(b, c);
+                }
+                if (outside(c, d, b)) {
+                    return triangle(c, d);
+                }
+                if (outside(d, b, c)) {
+                    return triangle(d, b);
+                }
+                return true;
+            }
+        }
+    }
+
+    /**
+     * @brief
+     *  Boolean GJK, true if two convex shapes given by their support functions overlap
+     */
+    template <typename SupportA, typename SupportB>
+    bool Overlaps(SupportA const& supportA, SupportB const& supportB, vec3 dir) {
+        auto support = [&](vec3 const& d) { return supportA(d) - supportB(-d); };
+        if (glm::dot(dir, dir) == 0.f) {
+            dir = vec3(1, 0, 0);
+        }
+
+        std::array<vec3, 4> simplex{};
+        int                 size = 1;
+        simplex[0]               = support(dir);
+        dir                      = -simplex[0];
+        for (int i = 0; i < cGjkIterations; ++i) {
+            // the origin is on the simplex
+            if (glm::dot(dir, dir) == 0.f) {
+                return true;
+            }
+            vec3 a = support(dir);
+            if (glm::dot(a, dir) < 0.f) {
+                return false;
+            }
+            simplex = { a, simplex[0], simplex[1], simplex[2] };
+            ++size;
+            if (NextSimplex(simplex, size, dir)) {
+                return true;
+            }
+        }
+        return true;
+    }
 }
 
 namespace CS350 {
@@ -84,35 +309,27 @@ namespace CS350 {
         max.z = glm::max(lhs.max.z, rhs.max.z);
     }
 
-    Aabb Aabb::transform( mat4 const& m2w) const {
-
-        std::array<vec3, 8> corners{
-            min,
-            vec3{min.x, max.y, max.z},
-            vec3{min.x, min.y, max.z},
-            vec3{min.x, max.y, min.z},
-            max,
-            vec3{max.x, max.y, min.z},
-            vec3{max.x, min.y, min.z},
-            vec3{max.x, min.y, max.z}
-        };
-
-        
-        vec3 point = vec3{ m2w * vec4{corners[0], 1.f} };
-        Aabb aabb(point,point);
-
-        // transform all corners and get the min and max
-        for (size_t n{1}; n < corners.size(); n++) {
-
-            vec3 transformedPoint = vec3{ m2w * vec4{corners[n], 1.f}};
-            
-            aabb.min = glm::min(aabb.min, transformedPoint);
-            aabb.max = glm::max(aabb.max, transformedPoint);
+    Aabb Aabb::transform(mat4 const& m2w) const {
+        return transform(Affine(m2w));
+    }
 
+    Aabb Aabb::transform(Affine const& m2w) const {
+        // Each term of a row takes its smallest and largest value over the box independently. Rounding
+        // is monotonic, so with the sums in the order of Affine::transform_point this is exactly the
+        // bounds of the 8 transformed corners, with 18 products instead of 72
+        Aabb aabb;
+        for (int row = 0; row < 3; row++) {
+            vec4 const& r = m2w.rows[static_cast<size_t>(row)];
+            float lo[3], hi[3];
+            for (int axis = 0; axis < 3; axis++) {
+                float a = r[axis] * min[axis];
+                float b = r[axis] * max[axis];
+                lo[axis] = glm::min(a, b);
+                hi[axis] = glm::max(a, b);
+            }
+            aabb.min[row] = ((lo[0] + lo[1]) + lo[2]) + r.w;
+            aabb.max[row] = ((hi[0] + hi[1]) + hi[2]) + r.w;
         }
-           
-
-
         return aabb;
     }
 
@@ -152,6 +369,11 @@ namespace CS350 {
         return (min + max) * 0.5f;
     }
 
+    float Aabb::squared_distance(vec3 const& pt) const {
+        vec3 outside = glm::max(glm::max(min - pt, pt - max), vec3(0.0f));
+        return glm::dot(outside, outside);
+    }
+
     int Aabb::longest_axis() const {
         vec3 extend = get_extents();
 
@@ -244,6 +466,45 @@ namespace CS350 {
         return sqrDistance <= (radius * radius);
     }
 
+    Sphere::Sphere(Aabb const& aabb) :
+        center{ aabb.get_center() },
+        radius{ glm::length(aabb.get_extents()) * 0.5f }
+    {}
+
+    Sphere::Sphere(Sphere const& lhs, Sphere const& rhs) :
+        center{ lhs.center },
+        radius{ lhs.radius }
+    {
+        vec3  offset   = rhs.center - lhs.center;
+        float distance = glm::length(offset);
+
+        // one already contains the other
+        if (distance + rhs.radius <= lhs.radius) {
+            return;
+        }
+        if (distance + lhs.radius <= rhs.radius) {
+            center = rhs.center;
+            radius = rhs.radius;
+            return;
+        }
+
+        // from the far side of one to the far side of the other
+        radius = (distance + lhs.radius + rhs.radius) * 0.5f;
+        center = lhs.center + offset * ((radius - lhs.radius) / distance);
+    }
+
+    float Sphere::surface_area() const {
+        return 4.f * glm::pi<float>() * radius * radius;
+    }
+
+    float Sphere::volume() const {
+        return 4.f / 3.f * glm::pi<float>() * radius * radius * radius;
+    }
+
+    Aabb Sphere::bounds() const {
+        return Aabb(center - vec3(radius), center + vec3(radius));
+    }
+
     Sphere Sphere::centroid( vec3 const* points, size_t count){
         vec3 sumOfPostions{};
 
@@ -633,6 +894,36 @@ namespace CS350 {
         return normal * dot_result;
     }
 
+    namespace {
+        /**
+         * @brief
+         *  Aabb against the planes of the mask, same math as Plane::classify but the center and half
+         *  extents are computed once. Planes the aabb is inside of are cleared from the mask.
+         */
+        SideResult ClassifyPlanes(Plane const* planes, Aabb const& aabb, uint32_t& planeMask) {
+            vec3 half   = (aabb.max - aabb.min) * 0.5f;
+            vec3 center = (aabb.max + aabb.min) * 0.5f;
+
+            uint32_t remaining = planeMask;
+            while (remaining != 0) {
+                int          index = std::countr_zero(remaining);
+                Plane const& plane = planes[index];
+                remaining &= remaining - 1u;
+
+                float radius   = half.x * glm::abs(plane.normal.x) + half.y * glm::abs(plane.normal.y) + half.z * glm::abs(plane.normal.z);
+                float distance = plane.distance(center);
+                if (distance > radius) {
+                    return eOUTSIDE;
+                }
+                if (distance < -radius) {
+                    planeMask &= ~(1u << index);
+                }
+            }
+
+            return planeMask == 0 ? eINSIDE : eINTERSECTING;
+        }
+    }
+
     Frustum::Frustum(std::array<vec3, 6> const& normals, std::array<float, 6> const& dists):
         planes{ Plane(normals[0], dists[0]), Plane(normals[1], dists[1]),
                  Plane(normals[2], dists[2]), Plane(normals[3], dists[3]),
@@ -683,28 +974,25 @@ namespace CS350 {
 
 
     SideResult Frustum::classify(Aabb const& aabb) const {
+        uint32_t planeMask = FullPlaneMask(planes.size());
+        return classify(aabb, planeMask);
+    }
+
+    SideResult Frustum::classify(Aabb const& aabb, uint32_t& planeMask) const {
 
         //update stats
 		CS350::Stats::Instance().frustumVsAabb++;
 
-        bool isInside = true;
-        SideResult result{};
-
-        // test AABB to every plane on the frustrum
-        for (const Plane& plane : this->planes) {
+        return ClassifyPlanes(planes.data(), aabb, planeMask);
+    }
 
-            result = plane.classify(aabb);
+    SideResult ClassifyConvex(std::span<Plane const> planes, Aabb const& aabb, uint32_t& planeMask) {
 
-            if (result == eOUTSIDE) {
-                return eOUTSIDE;
-            }
-            
-            if (result == eINTERSECTING) {
-                isInside = false;
-            }
-        }
+        //update stats
+        CS350::Stats::Instance().convexVsAabb++;
 
-        return isInside ? eINSIDE : eINTERSECTING;
+        planeMask &= FullPlaneMask(planes.size());
+        return ClassifyPlanes(planes.data(), aabb, planeMask);
     }
 
     Ray::Ray(vec3 const& _start, vec3 const& _dir) :
@@ -866,4 +1154,252 @@ namespace CS350 {
 
     }
 
-}
\ No newline at end of file
+
+    Cone::Cone(vec3 const& _apex, vec3 const& _axis, float _angle, float _range) :
+        apex{ _apex },
+        axis{ glm::normalize(_axis) },
+        angle{ _angle },
+        range{ _range }
+    {}
+
+    bool Cone::contains(vec3 const& pt) const {
+        vec3  d        = pt - apex;
+        float distance = glm::length(d);
+        return distance <= range && glm::dot(d, axis) >= distance * std::cos(angle);
+    }
+
+    SideResult Cone::classify(Aabb const& aabb) const {
+
+        //update stats
+        CS350::Stats::Instance().coneVsAabb++;
+
+        vec3  center   = aabb.get_center();
+        float radius   = glm::length(aabb.get_extents()) * 0.5f;
+        vec3  d        = center - apex;
+        float distance = glm::length(d);
+        if (distance - radius > range) {
+            return eOUTSIDE;
+        }
+
+        // Signed distance from the center to the infinite cone, in the plane of the axis and the center.
+        // Points projecting behind the apex onto the side of the cone are closest to the apex itself.
+        float cosAngle     = std::cos(angle);
+        float sinAngle     = std::sin(angle);
+        float along        = glm::dot(d, axis);
+        float across       = std::sqrt(glm::max(0.f, distance * distance - along * along));
+        float coneDistance = along * cosAngle + across * sinAngle < 0.f ? distance : across * cosAngle - along * sinAngle;
+        if (coneDistance >= radius) {
+            return eOUTSIDE;
+        }
+        if (coneDistance <= -radius && distance + radius <= range) {
+            return eINSIDE;
+        }
+        return eINTERSECTING;
+    }
+
+    bool Cone::intersects(Aabb const& aabb) const {
+        auto boxSupport = [&](vec3 const& dir) {
+            return vec3(dir.x >= 0.f ? aabb.max.x : aabb.min.x, dir.y >= 0.f ? aabb.max.y : aabb.min.y, dir.z >= 0.f ? aabb.max.z : aabb.min.z);
+        };
+        auto coneSupport = [&](vec3 const& dir) { return support(dir); };
+        return Overlaps(boxSupport, coneSupport, aabb.get_center() - apex);
+    }
+
+    vec3 Cone::support(vec3 const& dir) const {
+        float length = glm::length(dir);
+        if (length == 0.f) {
+            return apex;
+        }
+
+        // Inside the cone of directions the furthest point is on the cap
+        vec3  unit  = dir / length;
+        float along = glm::dot(unit, axis);
+        if (along >= std::cos(angle)) {
+            return apex + unit * range;
+        }
+
+        // Otherwise it is on the rim of the cap, on the side of the direction, or the apex.
+        // Decided from the angles, the side is only noise for directions close to the axis.
+        vec3  across       = unit - axis * along;
+        float acrossLength = glm::length(across);
+        if (acrossLength < cEpsilon || along * std::cos(angle) + acrossLength * std::sin(angle) <= 0.f) {
+            return apex;
+        }
+        return apex + (axis * std::cos(angle) + across / acrossLength * std::sin(angle)) * range;
+    }
+
+    template <unsigned K>
+    Kdop<K>::Kdop(Aabb const& aabb) {
+        for (unsigned slab = 0; slab < cSlabs; ++slab) {
+            vec3 dir = direction(slab);
+            min[slab] = 0.f;
+            max[slab] = 0.f;
+            for (int axis = 0; axis < 3; ++axis) {
+                float low  = dir[axis] * aabb.min[axis];
+                float high = dir[axis] * aabb.max[axis];
+                min[slab] += glm::min(low, high);
+                max[slab] += glm::max(low, high);
+            }
+        }
+    }
+
+    template <unsigned K>
+    Kdop<K>::Kdop(Kdop const& lhs, Kdop const& rhs) {
+        for (unsigned slab = 0; slab < cSlabs; ++slab) {
+            min[slab] = glm::min(lhs.min[slab], rhs.min[slab]);
+            max[slab] = glm::max(lhs.max[slab], rhs.max[slab]);
+        }
+    }
+
+    template <unsigned K>
+    vec3 Kdop<K>::direction(unsigned slab) {
+        // 18-DOPs skip the corner diagonals
+        unsigned index = K == 18 && slab >= 3 ? slab + 4 : slab;
+        return vec3(cKdopDirections[index][0], cKdopDirections[index][1], cKdopDirections[index][2]);
+    }
+
+    template <unsigned K>
+    float Kdop<K>::extent(vec3 const& dir) const {
+        // dir = lambda * direction(slab) + residual along the axes bounds dot(dir, pt) by the slab and
+        // the axes. Convex in lambda, the best one zeroes a residual component.
+        auto slabBound = [&](unsigned slab, float lambda) { return lambda >= 0.f ? lambda * max[slab] : lambda * min[slab]; };
+        auto axesBound = [&](vec3 const& residual) { return slabBound(0, residual.x) + slabBound(1, residual.y) + slabBound(2, residual.z); };
+
+        float bound = axesBound(dir);
+        for (unsigned slab = 3; slab < cSlabs; ++slab) {
+            vec3 slabDir = direction(slab);
+            for (int axis = 0; axis < 3; ++axis) {
+                if (slabDir[axis] == 0.f) {
+                    continue;
+                }
+                float lambda = dir[axis] / slabDir[axis];
+                bound        = glm::min(bound, slabBound(slab, lambda) + axesBound(dir - slabDir * lambda));
+            }
+        }
+        return bound;
+    }
+
+    template <unsigned K>
+    bool Kdop<K>::intersects(vec3 const& pt) const {
+        for (unsigned slab = 0; slab < cSlabs; ++slab) {
+            float projection = glm::dot(direction(slab), pt);
+            if (projection < min[slab] || projection > max[slab]) {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    template <unsigned K>
+    float Kdop<K>::surface_area() const {
+        return MeasureKdop(*this).surfaceArea;
+    }
+
+    template <unsigned K>
+    float Kdop<K>::volume() const {
+        return MeasureKdop(*this).volume;
+    }
+
+    template <unsigned K>
+    Aabb Kdop<K>::bounds() const {
+        return Aabb(vec3(min[0], min[1], min[2]), vec3(max[0], max[1], max[2]));
+    }
+
+    template <unsigned K>
+    SideResult Plane::classify(Kdop<K> const& kdop) const {
+        if (-kdop.extent(-normal) - dot_result > 0.f) {
+            return eOUTSIDE;
+        }
+        if (kdop.extent(normal) - dot_result < 0.f) {
+            return eINSIDE;
+        }
+        return eINTERSECTING;
+    }
+
+    template <unsigned K>
+    float Ray::intersect(Kdop<K> const& kdop) const {
+
+        // Slab test like the aabb, with every slab of the polytope
+        bool  inside   = true;
+        float minRange = -std::numeric_limits<float>::max();
+        float maxRange = std::numeric_limits<float>::max();
+        for (unsigned slab = 0; slab < Kdop<K>::cSlabs; ++slab) {
+            vec3  slabDir    = Kdop<K>::direction(slab);
+            float projection = glm::dot(slabDir, start);
+            float speed      = glm::dot(slabDir, dir);
+            bool  outside    = projection < kdop.min[slab] || projection > kdop.max[slab];
+            inside           = inside && !outside;
+            if (speed == 0.f) {
+                if (outside) {
+                    return -1.f;
+                }
+                continue;
+            }
+            float t1 = (kdop.min[slab] - projection) / speed;
+            float t2 = (kdop.max[slab] - projection) / speed;
+            minRange = glm::max(minRange, glm::min(t1, t2));
+            maxRange = glm::min(maxRange, glm::max(t1, t2));
+        }
+
+        if (inside) {
+            return 0.f;
+        }
+        if (maxRange < cEpsilon || minRange > maxRange) {
+            return -1.f;
+        }
+        return minRange;
+    }
+
+    template struct Kdop<14>;
+    template struct Kdop<18>;
+    template struct Kdop<26>;
+    template SideResult Plane::classify(Kdop<14> const&) const;
+    template SideResult Plane::classify(Kdop<18> const&) const;
+    template SideResult Plane::classify(Kdop<26> const&) const;
+    template float      Ray::intersect(Kdop<14> const&) const;
+    template float      Ray::intersect(Kdop<18> const&) const;
+    template float      Ray::intersect(Kdop<26> const&) const;
+
+    uint32_t MortonCode(vec3 const& point, Aabb const& bounds) {
+        // spreads the 10 bits of a coordinate two bits apart
+        auto expand = [](uint32_t bits) {
+            bits = (bits | (bits << 16)) & 0x030000FFu;
+            bits = (bits | (bits << 8)) & 0x0300F00Fu;
+            bits = (bits | (bits << 4)) & 0x030C30C3u;
+            bits = (bits | (bits << 2)) & 0x09249249u;
+            return bits;
+        };
+
+        uint32_t code = 0;
+        for (int axis = 0; axis < 3; axis++) {
+            float size  = bounds.max[axis] - bounds.min[axis];
+            float unit  = size > 0.f ? glm::clamp((point[axis] - bounds.min[axis]) / size, 0.f, 1.f) : 0.f;
+            auto  value = static_cast<uint32_t>(unit * 1023.f);
+            code |= expand(value) << (2 - axis);
+        }
+        return code;
+    }
+
+    std::vector<unsigned> MortonOrder(std::span<Aabb const> bvs) {
+        std::vector<unsigned> order(bvs.size());
+        if (bvs.empty()) {
+            return order;
+        }
+
+        Aabb centers(bvs[0].get_center(), bvs[0].get_center());
+        for (auto const& bv : bvs) {
+            centers = Aabb(centers, Aabb(bv.get_center(), bv.get_center()));
+        }
+
+        // code in the high bits, index in the low ones, so ties keep their order
+        std::vector<uint64_t> keys(bvs.size());
+        for (size_t i = 0; i < bvs.size(); i++) {
+            keys[i] = (static_cast<uint64_t>(MortonCode(bvs[i].get_center(), centers)) << 32) | i;
+        }
+        std::sort(keys.begin(), keys.end());
+        for (size_t i = 0; i < keys.size(); i++) {
+            order[i] = static_cast<unsigned>(keys[i]);
+        }
+        return order;
+    }
+}
@@ -2,8 +2,11 @@
 #define __SHAPES_HPP__
 
 #include "math.hpp"
+#include "transform.hpp"
 #include <vector>
 #include <array>
+#include <cstdint>
+#include <span>
 
 // Forward declarations
 namespace CS350 {
@@ -15,6 +18,8 @@ namespace CS350 {
     struct Plane;
     struct Segment;
     struct Ray;
+    struct Cone;
+    template <unsigned K> struct Kdop;
 
     enum SideResult {
         eINSIDE       = -1,
@@ -55,6 +60,8 @@ namespace CS350 {
         float intersect(Aabb const& aabb) const;
         float intersect(Sphere const& sphere) const;
         float intersect(Triangle const& triangle) const;
+        template <unsigned K>
+        float intersect(Kdop<K> const& kdop) const;
     };
 
     static_assert(std::is_trivial<Ray>());
@@ -103,6 +110,8 @@ namespace CS350 {
         SideResult classify(Triangle const& triangle) const;
         SideResult classify(Aabb const& aabb) const;
         SideResult classify(Sphere const& sphere) const;
+        template <unsigned K>
+        SideResult classify(Kdop<K> const& kdop) const;
     };
     static_assert(sizeof(Plane) == sizeof(float) * 4);
     static_assert(std::is_trivial<Plane>());
@@ -138,8 +147,13 @@ namespace CS350 {
 
         Sphere() = default;
         Sphere(vec3 const& center, float radius);
-        bool contains(const vec3&  pt) const;
-        bool intersects(Sphere const& rhs) const;
+        explicit Sphere(Aabb const& aabb);                // Around the aabb
+        Sphere(Sphere const& lhs, Sphere const& rhs);     // Smallest sphere around both
+        bool  contains(const vec3&  pt) const;
+        bool  intersects(Sphere const& rhs) const;
+        float surface_area() const;
+        float volume() const;
+        Aabb  bounds() const;
 
         static Sphere centroid(vec3 const* points, size_t count);
         static Sphere centroid(vec3 const* points, size_t count, mat4 const& transformMatrix);
@@ -167,7 +181,8 @@ namespace CS350 {
         Aabb(Aabb const& bv, mat4 const& _transform);
         Aabb(Aabb const& lhs, Aabb const& rhs);
 
-        Aabb  transform(mat4 const& m2w) const;
+        Aabb  transform(mat4 const& m2w) const;   // Affine, the last row is ignored
+        Aabb  transform(Affine const& m2w) const; // Same bounds as transforming the 8 corners
         bool  intersects(vec3 const& pt) const;
         bool  intersects(Aabb const& rhs) const;
         float surface_area() const;
@@ -175,6 +190,8 @@ namespace CS350 {
         vec3  get_center() const;
         vec3  get_extents() const;
         int   longest_axis() const;
+        float squared_distance(vec3 const& pt) const; // 0 if the point is inside
+        Aabb  bounds() const { return *this; }        // Same as the other bounding volumes
     };
     static_assert(std::is_trivial<Aabb>());
     static_assert(std::is_standard_layout<Aabb>());
@@ -191,6 +208,7 @@ namespace CS350 {
 
         SideResult classify(Sphere const& sphere) const;
         SideResult classify(Aabb const& aabb) const;
+        SideResult classify(Aabb const& aabb, uint32_t& planeMask) const;
 
         /**
          * @brief
@@ -222,6 +240,129 @@ namespace CS350 {
     };
     static_assert(std::is_trivial<Frustum>());
     static_assert(std::is_standard_layout<Frustum>());
+
+    /**
+     * @brief
+     *  Maximum amount of planes of a convex volume, one bit each in a plane mask
+     */
+    constexpr size_t cMaxConvexPlanes = 32;
+
+    /**
+     * @brief
+     *  Plane mask with the first count planes still to be tested
+     */
+    constexpr uint32_t FullPlaneMask(size_t count) {
+        return count >= cMaxConvexPlanes ? ~0u : (1u << count) - 1u;
+    }
+
+    /**
+     * @brief
+     *  Classifies an aabb against a convex volume bounded by planes with the normals pointing outwards,
+     *  the same convention as the frustum.
+     * @param planes
+     *  Planes of the volume, at most cMaxConvexPlanes
+     * @param aabb
+     *  Bounding volume to classify
+     * @param planeMask
+     *  Bit i is set while plane i has to be tested. Planes the aabb is completely inside of are cleared,
+     *  anything contained by the aabb can then skip them.
+     * @return
+     *  eOUTSIDE if outside of any plane, eINSIDE once the mask is empty
+     */
+    SideResult ClassifyConvex(std::span<Plane const> planes, Aabb const& aabb, uint32_t& planeMask);
+
+    /**
+     * @brief
+     *  Cone capped by a sphere around its apex, such as a vision cone or a spotlight.
+     *  The half angle is at most 90 degrees, so the shape is convex.
+     */
+    struct Cone {
+        vec3  apex;
+        vec3  axis;  // Normalized
+        float angle; // Half angle in radians, (0, pi/2]
+        float range; // Distance from the apex
+
+        Cone() = default;
+        Cone(vec3 const& _apex, vec3 const& _axis, float _angle, float _range);
+
+        bool       contains(vec3 const& pt) const;
+
+        /**
+         * @brief
+         *  Conservative and cheap, tests the bounding sphere of the aabb
+         * @return
+         *  eINSIDE or eOUTSIDE only when the whole aabb is, eINTERSECTING otherwise
+         */
+        SideResult classify(Aabb const& aabb) const;
+
+        /**
+         * @brief
+         *  Exact overlap with the aabb (GJK on both convex shapes)
+         */
+        bool       intersects(Aabb const& aabb) const;
+
+        /**
+         * @brief
+         *  Furthest point of the cone along the direction
+         */
+        vec3       support(vec3 const& dir) const;
+    };
+    static_assert(std::is_trivial<Cone>());
+    static_assert(std::is_standard_layout<Cone>());
+
+    /**
+     * @brief
+     *  Discrete oriented polytope, the intersection of K/2 slabs. The first three slabs are the axes,
+     *  14-DOPs add the 4 corner diagonals, 18-DOPs the 6 edge diagonals and 26-DOPs both.
+     *  Directions are not normalized, the slab bounds are dot products with them.
+     */
+    template <unsigned K>
+    struct Kdop {
+        static_assert(K == 14 || K == 18 || K == 26, "Only 14, 18 and 26-DOPs are supported");
+        static constexpr unsigned cSlabs = K / 2;
+
+        std::array<float, cSlabs> min;
+        std::array<float, cSlabs> max;
+
+        Kdop() = default;
+        explicit Kdop(Aabb const& aabb);        // Around the aabb
+        Kdop(Kdop const& lhs, Kdop const& rhs); // Around both
+
+        static vec3 direction(unsigned slab);
+
+        /**
+         * @brief
+         *  Upper bound of dot(dir, pt) for the points of the polytope, exact along the slab directions.
+         *  Tighter than the aabb of the polytope for any direction.
+         */
+        float extent(vec3 const& dir) const;
+
+        bool  intersects(vec3 const& pt) const;
+        float surface_area() const; // Of the polytope, the box clipped by the diagonal slabs
+        float volume() const;       //
+        Aabb  bounds() const;
+    };
+    static_assert(std::is_trivial<Kdop<14>>());
+    static_assert(std::is_standard_layout<Kdop<14>>());
+
+    extern template struct Kdop<14>;
+    extern template struct Kdop<18>;
+    extern template struct Kdop<26>;
+
+    /**
+     * @brief
+     *  30 bit Morton code of a point, interleaving 10 bits per axis of its position inside the bounds
+     */
+    uint32_t MortonCode(vec3 const& point, Aabb const& bounds);
+
+    /**
+     * @brief
+     *  Order of the bounding volumes along the Morton curve of their centers. Storing objects in it
+     *  keeps the objects of a Bvh leaf, and of a query result, close in memory.
+     * @return
+     *  order[i] is the index in `bvs` of the i-th volume, ties keep their original order
+     */
+    std::vector<unsigned> MortonOrder(std::span<Aabb const> bvs);
 }
 
 #endif // __SHAPES_HPP__
@@ -0,0 +1,179 @@
+/**
+ * @file
+ *  split_bvh.hpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/22
+ * @brief
+ *  Facade over two Bvh, one for static scenery and one for moving objects.
+ *
+ *  The static tree is built top-down with the surface area heuristic and only rebuilt when
+ *  objects join or leave it, so it affords the slower build of a better tree. The dynamic
+ *  tree is filled by insertion and refitted every update, so moving objects never touch the
+ *  static one. Objects are assigned by observed motion: a static object that moves is demoted,
+ *  a dynamic object that stays still for a while is promoted. Queries cover both trees.
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef SPLIT_BVH_HPP
+#define SPLIT_BVH_HPP
+
+#include "bvh.hpp"
+
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <vector>
+
+namespace CS350 {
+
+    /**
+     * @brief
+     *  Rules of a SplitBvh
+     */
+    struct SplitBvhConfig {
+        BvhBuildConfig staticConfig   = { .splitPolicy = SplitPolicy::eSah }; // BuildTopDown of the static tree
+        BvhBuildConfig dynamicConfig  = {};                                    // Insert of the dynamic tree
+        unsigned       promoteUpdates = 60; // Updates without moving before a dynamic object can become static
+        unsigned       promoteBatch   = 16; // Objects promoted together, each promotion rebuilds the static tree
+        float          motionEpsilon  = 0;  // Largest change of a bv corner still considered not moving
+    };
+
+    /**
+     * @brief
+     *  Static and dynamic Bvh behind a single interface. Same requirements on T as Bvh.
+     *  Every object is in exactly one of the trees.
+     */
+    template <typename T>
+    class SplitBvh {
+      public:
+        /**
+         * @brief
+         *  Creates an empty split Bvh
+         */
+        explicit SplitBvh(SplitBvhConfig const& config = {});
+        SplitBvh(SplitBvh const&)            = delete;
+        SplitBvh& operator=(SplitBvh const&) = delete;
+
+        /**
+         * @brief
+         *  Registers an object, it is part of the queries after the next Update
+         * @param object
+         *  Object to add, its id must be unique
+         * @param isStatic
+         *  Known to be scenery, skips the dynamic tree. Wrong guesses are fixed by the motion tracking.
+         */
+        void                        Add(T object, bool isStatic = false);
+
+        /**
+         * @brief
+         *  Unregisters an object. It is taken out of the trees on the next Update and must stay alive until then.
+         */
+        void                        Remove(T object);
+
+        /**
+         * @brief
+         *  Call once per frame after moving objects. Applies additions and removals, moves objects
+         *  between the trees, rebuilds the static tree if its objects changed and refits the dynamic one.
+         */
+        void                        Update();
+
+        /**
+         * @brief
+         *  Removes every object from both trees
+         */
+        void                        Clear();
+
+        /**
+         * @brief
+         *  Frustum vs both trees
+         */
+        std::vector<unsigned>       Query(Frustum const& frustum, QueryFilter const& filter = {}) const;
+
+        /**
+         * @brief
+         *  Frustum query of both trees sorted by the squared distance of the object bvs to the eye,
+         *  exactly near to far unlike Bvh::QueryOrdered. Sorting costs O(n log n) on the visible objects.
+         */
+        std::vector<unsigned>       QueryOrdered(Frustum const& frustum, vec3 const& eye, QueryFilter const& filter = {}) const;
+
+        /**
+         * @brief
+         *  Convex volume vs both trees
+         */
+        std::vector<unsigned>       Query(std::span<Plane const> planes, QueryFilter const& filter = {}) const;
+
+        /**
+         * @brief
+         *  Cone vs both trees
+         */
+        std::vector<unsigned>       Query(Cone const& cone, QueryFilter const& filter = {}) const;
+
+        /**
+         * @brief
+         *  Closest object hit by the ray in any of the trees
+         */
+        std::optional<unsigned>     Query(Ray const& ray, QueryFilter const& filter = {}) const;
+
+        /**
+         * @brief
+         *  Aabb overlap vs both trees
+         */
+        std::vector<unsigned>       Query(Aabb const& aabb, QueryFilter const& filter = {}) const;
+
+        /**
+         * @brief
+         *  Batched closest hits, merged per ray by hit time
+         */
+        void                        QueryBatch(Ray const* rays, size_t count, std::optional<unsigned>* closestObjects, QueryFilter const& filter = {}) const;
+
+        /**
+         * @brief
+         *  Batched point queries, static results first
+         */
+        void                        QueryBatch(vec3 const* points, size_t count, std::vector<std::vector<unsigned>>& objectsIds, QueryFilter const& filter = {}) const;
+
+        Bvh<T> const&               staticTree() const { return mStatic; }
+        Bvh<T> const&               dynamicTree() const { return mDynamic; }
+        unsigned                    staticRebuilds() const { return mStaticRebuilds; } // Times the static tree was rebuilt
+
+      private:
+        /**
+         * @brief
+         *  Tracking of one registered object
+         */
+        struct Entry {
+            T        object;
+            Aabb     lastBv;               // Bv seen on the previous update
+            unsigned stillUpdates = 0;     // Updates without moving
+            bool     isStatic     = false; //
+            bool     inTree       = false; // Added by an update already
+            bool     removed      = false; //
+        };
+
+        /**
+         * @brief
+         *  Closest of two hits of the same ray, by the time it hits their bounding volumes
+         */
+        std::optional<unsigned>     Closer(Ray const& ray, std::optional<unsigned> first, std::optional<unsigned> second) const;
+
+        /**
+         * @brief
+         *  True if the bv of the object changed more than the motion epsilon since the last update
+         */
+        bool                        Moved(Entry const& entry) const;
+
+        SplitBvhConfig                       mConfig;
+        Bvh<T>                               mStatic;
+        Bvh<T>                               mDynamic;
+        std::vector<Entry>                   mEntries;
+        std::unordered_map<unsigned, size_t> mEntryById;
+        unsigned                             mStaticRebuilds = 0;
+    };
+}
+
+#include "split_bvh.inl"
+
+#endif // SPLIT_BVH_HPP
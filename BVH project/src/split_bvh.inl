@@ -0,0 +1,246 @@
+/**
+ * @file
+ *  split_bvh.inl
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/22
+ * @brief
+ *  Definition of the static/dynamic split Bvh
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef SPLIT_BVH_INL
+#define SPLIT_BVH_INL
+
+#include "split_bvh.hpp"
+
+#include <algorithm>
+#include <iterator>
+#include <stdexcept>
+#include <utility>
+
+namespace CS350 {
+
+    template <typename T>
+    SplitBvh<T>::SplitBvh(SplitBvhConfig const& config) :
+        mConfig(config) {
+    }
+
+    template <typename T>
+    void SplitBvh<T>::Add(T object, bool isStatic) {
+        if (mEntryById.contains(object->id)) {
+            throw std::runtime_error(fmt::format("split_bvh.inl: object {} added twice", object->id));
+        }
+
+        Entry entry;
+        entry.object   = object;
+        entry.lastBv   = object->bv;
+        entry.isStatic = isStatic;
+        mEntryById[object->id] = mEntries.size();
+        mEntries.push_back(entry);
+    }
+
+    template <typename T>
+    void SplitBvh<T>::Remove(T object) {
+        auto it = mEntryById.find(object->id);
+        if (it == mEntryById.end()) {
+            throw std::runtime_error(fmt::format("split_bvh.inl: object {} was not added", object->id));
+        }
+        mEntries[it->second].removed = true;
+    }
+
+    template <typename T>
+    void SplitBvh<T>::Update() {
+
+        bool rebuildStatic  = false;
+        bool rebuildDynamic = false;
+
+        // Removed objects leave a hole in their tree, filled by the rebuild
+        for (size_t i = 0; i < mEntries.size();) {
+            if (!mEntries[i].removed) {
+                ++i;
+                continue;
+            }
+            if (mEntries[i].inTree) {
+                (mEntries[i].isStatic ? rebuildStatic : rebuildDynamic) = true;
+            }
+            mEntryById.erase(mEntries[i].object->id);
+            if (i + 1 != mEntries.size()) {
+                mEntries[i]                          = mEntries.back();
+                mEntryById[mEntries[i].object->id] = i;
+            }
+            mEntries.pop_back();
+        }
+
+        // Motion since the last update
+        std::vector<T>      toInsert; // Joining the dynamic tree
+        std::vector<size_t> settled;  // Dynamic objects still long enough to be static
+        bool                dynamicMoved = false;
+        for (size_t i = 0; i < mEntries.size(); ++i) {
+            Entry& entry = mEntries[i];
+            if (!entry.inTree) {
+                entry.inTree = true;
+                if (entry.isStatic) {
+                    rebuildStatic = true;
+                } else {
+                    toInsert.push_back(entry.object);
+                }
+            } else if (Moved(entry)) {
+                entry.stillUpdates = 0;
+                if (entry.isStatic) {
+                    // Demoted, the static rebuild takes it out of the static tree first
+                    entry.isStatic = false;
+                    rebuildStatic  = true;
+                    toInsert.push_back(entry.object);
+                } else {
+                    dynamicMoved = true;
+                }
+            } else if (!entry.isStatic && ++entry.stillUpdates >= mConfig.promoteUpdates) {
+                settled.push_back(i);
+            }
+            entry.lastBv = entry.object->bv;
+        }
+
+        // Promotions cost a rebuild of both trees, wait until enough objects settle or the static tree is rebuilt anyway
+        if (!settled.empty() && (rebuildStatic || settled.size() >= mConfig.promoteBatch)) {
+            for (size_t i : settled) {
+                mEntries[i].isStatic = true;
+            }
+            rebuildStatic  = true;
+            rebuildDynamic = true;
+        }
+
+        // Clearing resets the Bvh information of the objects, so it goes before any of them changes tree
+        if (rebuildDynamic) {
+            mDynamic.Clear();
+        }
+        if (rebuildStatic) {
+            mStatic.Clear();
+            std::vector<T> staticObjects;
+            for (Entry const& entry : mEntries) {
+                if (entry.isStatic) {
+                    staticObjects.push_back(entry.object);
+                }
+            }
+            mStatic.BuildTopDown(staticObjects.begin(), staticObjects.end(), mConfig.staticConfig);
+            ++mStaticRebuilds;
+        }
+
+        if (rebuildDynamic) {
+            toInsert.clear();
+            for (Entry const& entry : mEntries) {
+                if (!entry.isStatic) {
+                    toInsert.push_back(entry.object);
+                }
+            }
+        } else if (dynamicMoved) {
+            mDynamic.Refit();
+        }
+        mDynamic.Insert(toInsert.begin(), toInsert.end(), mConfig.dynamicConfig);
+    }
+
+    template <typename T>
+    void SplitBvh<T>::Clear() {
+        mStatic.Clear();
+        mDynamic.Clear();
+        mEntries.clear();
+        mEntryById.clear();
+    }
+
+    template <typename T>
+    std::vector<unsigned> SplitBvh<T>::Query(Frustum const& frustum, QueryFilter const& filter) const {
+        std::vector<unsigned> objectsIds        = mStatic.Query(frustum, filter);
+        std::vector<unsigned> dynamicObjectsIds = mDynamic.Query(frustum, filter);
+        objectsIds.insert(objectsIds.end(), dynamicObjectsIds.begin(), dynamicObjectsIds.end());
+        return objectsIds;
+    }
+
+    template <typename T>
+    std::vector<unsigned> SplitBvh<T>::QueryOrdered(Frustum const& frustum, vec3 const& eye, QueryFilter const& filter) const {
+        std::vector<unsigned> objectsIds        = mStatic.QueryOrdered(frustum, eye, filter);
+        std::vector<unsigned> dynamicObjectsIds = mDynamic.QueryOrdered(frustum, eye, filter);
+        objectsIds.insert(objectsIds.end(), dynamicObjectsIds.begin(), dynamicObjectsIds.end());
+
+        // Each tree is only near to far between its leaves, so both lists are sorted again together.
+        // Distances are looked up once, O(n log n) on the visible objects.
+        std::vector<std::pair<float, unsigned>> byDistance;
+        byDistance.reserve(objectsIds.size());
+        for (unsigned id : objectsIds) {
+            byDistance.emplace_back(mEntries[mEntryById.at(id)].object->bv.squared_distance(eye), id);
+        }
+        std::stable_sort(byDistance.begin(), byDistance.end(), [](auto const& lhs, auto const& rhs) { return lhs.first < rhs.first; });
+        for (size_t i = 0; i < byDistance.size(); i++) {
+            objectsIds[i] = byDistance[i].second;
+        }
+        return objectsIds;
+    }
+
+    template <typename T>
+    std::vector<unsigned> SplitBvh<T>::Query(std::span<Plane const> planes, QueryFilter const& filter) const {
+        std::vector<unsigned> objectsIds        = mStatic.Query(planes, filter);
+        std::vector<unsigned> dynamicObjectsIds = mDynamic.Query(planes, filter);
+        objectsIds.insert(objectsIds.end(), dynamicObjectsIds.begin(), dynamicObjectsIds.end());
+        return objectsIds;
+    }
+
+    template <typename T>
+    std::vector<unsigned> SplitBvh<T>::Query(Cone const& cone, QueryFilter const& filter) const {
+        std::vector<unsigned> objectsIds        = mStatic.Query(cone, filter);
+        std::vector<unsigned> dynamicObjectsIds = mDynamic.Query(cone, filter);
+        objectsIds.insert(objectsIds.end(), dynamicObjectsIds.begin(), dynamicObjectsIds.end());
+        return objectsIds;
+    }
+
+    template <typename T>
+    std::optional<unsigned> SplitBvh<T>::Query(Ray const& ray, QueryFilter const& filter) const {
+        return Closer(ray, mStatic.Query(ray, filter), mDynamic.Query(ray, filter));
+    }
+
+    template <typename T>
+    std::vector<unsigned> SplitBvh<T>::Query(Aabb const& aabb, QueryFilter const& filter) const {
+        std::vector<unsigned> objectsIds        = mStatic.Query(aabb, filter);
+        std::vector<unsigned> dynamicObjectsIds = mDynamic.Query(aabb, filter);
+        objectsIds.insert(objectsIds.end(), dynamicObjectsIds.begin(), dynamicObjectsIds.end());
+        return objectsIds;
+    }
+
+    template <typename T>
+    void SplitBvh<T>::QueryBatch(Ray const* rays, size_t count, std::optional<unsigned>* closestObjects, QueryFilter const& filter) const {
+        std::vector<std::optional<unsigned>> dynamicClosest(count);
+        mStatic.QueryBatch(rays, count, closestObjects, filter);
+        mDynamic.QueryBatch(rays, count, dynamicClosest.data(), filter);
+        for (size_t i = 0; i < count; ++i) {
+            closestObjects[i] = Closer(rays[i], closestObjects[i], dynamicClosest[i]);
+        }
+    }
+
+    template <typename T>
+    void SplitBvh<T>::QueryBatch(vec3 const* points, size_t count, std::vector<std::vector<unsigned>>& objectsIds, QueryFilter const& filter) const {
+        std::vector<std::vector<unsigned>> dynamicObjectsIds;
+        mStatic.QueryBatch(points, count, objectsIds, filter);
+        mDynamic.QueryBatch(points, count, dynamicObjectsIds, filter);
+        for (size_t i = 0; i < count; ++i) {
+            objectsIds[i].insert(objectsIds[i].end(), dynamicObjectsIds[i].begin(), dynamicObjectsIds[i].end());
+        }
+    }
+
+    template <typename T>
+    std::optional<unsigned> SplitBvh<T>::Closer(Ray const& ray, std::optional<unsigned> first, std::optional<unsigned> second) const {
+        if (!first || !second) {
+            return first ? first : second;
+        }
+        float firstTime  = ray.intersect(mEntries[mEntryById.at(*first)].object->bv);
+        float secondTime = ray.intersect(mEntries[mEntryById.at(*second)].object->bv);
+        return secondTime < firstTime ? second : first;
+    }
+
+    template <typename T>
+    bool SplitBvh<T>::Moved(Entry const& entry) const {
+        vec3 change = glm::max(glm::abs(entry.object->bv.min - entry.lastBv.min), glm::abs(entry.object->bv.max - entry.lastBv.max));
+        return std::max(change.x, std::max(change.y, change.z)) > mConfig.motionEpsilon;
+    }
+}
+
+#endif // SPLIT_BVH_INL
@@ -16,20 +16,25 @@ namespace CS350 {
         Stats& operator=(Stats const&) = delete;
 
       public:
+        // One instance per thread, so queries can run concurrently
         static Stats& Instance()
         {
-            static Stats st;
+            static thread_local Stats st;
             return st;
         }
 
         void Reset()
         {
             frustumVsAabb = 0;
+            convexVsAabb  = 0;
             rayVsAabb     = 0;
+            coneVsAabb    = 0;
         }
 
         size_t frustumVsAabb;
+        size_t convexVsAabb;
         size_t rayVsAabb;
+        size_t coneVsAabb;
     };
 }
 #endif // STATS_HPP
@@ -0,0 +1,161 @@
+/**
+ * @file
+ *  transform.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Conversions of the compact transforms
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "transform.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+namespace CS350 {
+
+    namespace {
+        constexpr float cScaleSteps    = 2048.0f; // Per power of two
+        constexpr float cRotationRange = 0.70710678f; // The smallest three components are within +-1/sqrt(2)
+        constexpr float cMaxU16        = 65535.0f;
+
+        uint16_t QuantizeUnit(float value) {
+            return static_cast<uint16_t>(std::lround(std::clamp(value, 0.0f, 1.0f) * cMaxU16));
+        }
+
+        // Rotation of unit columns where the flat axes, the zero ones, are any completion of the others
+        void CompleteRotation(mat3& rotation, std::array<bool, 3> const& flat) {
+            int flatCount = static_cast<int>(flat[0]) + static_cast<int>(flat[1]) + static_cast<int>(flat[2]);
+            if (flatCount == 3) {
+                rotation = mat3(1.0f);
+                return;
+            }
+            if (flatCount == 2) {
+                int  kept  = !flat[0] ? 0 : (!flat[1] ? 1 : 2);
+                vec3 axis  = rotation[kept];
+                vec3 other = std::abs(axis.x) < 0.5f ? vec3(1.0f, 0.0f, 0.0f) : vec3(0.0f, 1.0f, 0.0f);
+                rotation[(kept + 1) % 3] = glm::normalize(glm::cross(axis, other));
+            }
+            for (int axis = 0; axis < 3; axis++) {
+                if (flat[static_cast<size_t>(axis)] && glm::dot(rotation[axis], rotation[axis]) == 0.0f) {
+                    rotation[axis] = glm::cross(rotation[(axis + 1) % 3], rotation[(axis + 2) % 3]);
+                }
+            }
+        }
+    }
+
+    Affine::Affine(mat4 const& m2w) {
+        for (int row = 0; row < 3; row++) {
+            rows[static_cast<size_t>(row)] = vec4(m2w[0][row], m2w[1][row], m2w[2][row], m2w[3][row]);
+        }
+    }
+
+    mat4 Affine::matrix() const {
+        mat4 m2w(1.0f);
+        for (int row = 0; row < 3; row++) {
+            for (int column = 0; column < 4; column++) {
+                m2w[column][row] = rows[static_cast<size_t>(row)][column];
+            }
+        }
+        return m2w;
+    }
+
+    vec3 Affine::translation() const {
+        return vec3(rows[0].w, rows[1].w, rows[2].w);
+    }
+
+    void Affine::translate(vec3 const& offset) {
+        rows[0].w += offset.x;
+        rows[1].w += offset.y;
+        rows[2].w += offset.z;
+    }
+
+    vec3 Affine::transform_point(vec3 const& point) const {
+        vec3 result;
+        for (int row = 0; row < 3; row++) {
+            vec4 const& r = rows[static_cast<size_t>(row)];
+            result[row]   = ((r.x * point.x + r.y * point.y) + r.z * point.z) + r.w;
+        }
+        return result;
+    }
+
+    QuantizedTrs::QuantizedTrs(Affine const& m2w) :
+        translation{ m2w.translation() },
+        rotation{},
+        scale{},
+        flags{}
+    {
+        // Scale of each axis, x is negated when the transform mirrors. Zero and denormal scales are
+        // step 0, their axis takes any direction that keeps a rotation and the transform never mirrors
+        mat3 linear;
+        for (int column = 0; column < 3; column++) {
+            linear[column] = vec3(m2w.rows[0][column], m2w.rows[1][column], m2w.rows[2][column]);
+        }
+        vec3                axisScale(glm::length(linear[0]), glm::length(linear[1]), glm::length(linear[2]));
+        std::array<bool, 3> flat = { axisScale.x < FLT_MIN, axisScale.y < FLT_MIN, axisScale.z < FLT_MIN };
+        if (!flat[0] && !flat[1] && !flat[2] && glm::dot(glm::cross(linear[0], linear[1]), linear[2]) < 0.0f) {
+            flags |= 4u;
+            axisScale.x = -axisScale.x;
+        }
+        for (int axis = 0; axis < 3; axis++) {
+            if (flat[static_cast<size_t>(axis)]) {
+                linear[axis] = vec3(0.0f);
+                continue;
+            }
+            float steps = std::log2(std::abs(axisScale[axis])) * cScaleSteps + 32768.0f;
+            scale[static_cast<size_t>(axis)] = static_cast<uint16_t>(std::clamp(std::round(steps), 1.0f, cMaxU16));
+            linear[axis] /= axisScale[axis];
+        }
+        CompleteRotation(linear, flat);
+
+        // Smallest three, the largest component is positive so it can be rebuilt from the others
+        quat                 q          = glm::normalize(glm::quat_cast(linear));
+        std::array<float, 4> components = { q.x, q.y, q.z, q.w };
+        size_t               largest    = 0;
+        for (size_t i = 1; i < 4; i++) {
+            if (std::abs(components[i]) > std::abs(components[largest])) {
+                largest = i;
+            }
+        }
+        float sign = components[largest] < 0.0f ? -1.0f : 1.0f;
+        flags      = static_cast<uint16_t>(flags | largest);
+        for (size_t i = 0, stored = 0; i < 4; i++) {
+            if (i != largest) {
+                rotation[stored++] = QuantizeUnit((components[i] * sign / cRotationRange) * 0.5f + 0.5f);
+            }
+        }
+    }
+
+    Affine QuantizedTrs::affine() const {
+        std::array<float, 4> components{};
+        size_t               largest = flags & 3u;
+        float                sum     = 0.0f;
+        for (size_t i = 0, stored = 0; i < 4; i++) {
+            if (i != largest) {
+                components[i] = (static_cast<float>(rotation[stored++]) / cMaxU16 * 2.0f - 1.0f) * cRotationRange;
+                sum += components[i] * components[i];
+            }
+        }
+        components[largest] = std::sqrt(std::max(0.0f, 1.0f - sum));
+        mat3 linear         = glm::mat3_cast(glm::normalize(quat(components[3], components[0], components[1], components[2])));
+
+        Affine m2w;
+        for (int axis = 0; axis < 3; axis++) {
+            uint16_t step      = scale[static_cast<size_t>(axis)];
+            float    axisScale = step == 0 ? 0.0f : std::exp2((static_cast<float>(step) - 32768.0f) / cScaleSteps);
+            if (axis == 0 && (flags & 4u) != 0) {
+                axisScale = -axisScale;
+            }
+            linear[axis] *= axisScale;
+        }
+        for (int row = 0; row < 3; row++) {
+            m2w.rows[static_cast<size_t>(row)] = vec4(linear[0][row], linear[1][row], linear[2][row], translation[row]);
+        }
+        return m2w;
+    }
+}
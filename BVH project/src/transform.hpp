@@ -0,0 +1,80 @@
+/**
+ * @file
+ *  transform.hpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Compact model to world transforms of scene objects. Every scene object is an affine TRS, so
+ *  the last row of its mat4 is always (0, 0, 0, 1) and only wastes bandwidth when bounds are
+ *  recomputed for many instances.
+ *
+ *  Affine: the first three rows, 48 bytes, converts to and from mat4 exactly.
+ *  QuantizedTrs: 28 bytes, exact translation, rotation and scale within cQuantizedTrsError.
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef TRANSFORM_HPP
+#define TRANSFORM_HPP
+
+#include "math.hpp"
+
+#include <array>
+#include <cstdint>
+#include <type_traits>
+
+namespace CS350 {
+
+    /**
+     * @brief
+     *  Affine transform stored as the first three rows of its matrix
+     */
+    struct Affine {
+        std::array<vec4, 3> rows; // Linear part in xyz, translation in w
+
+        Affine() = default;
+        explicit Affine(mat4 const& m2w); // Drops the last row, the same one Aabb::transform always ignored
+
+        mat4 matrix() const; // Last row (0, 0, 0, 1)
+        vec3 translation() const;
+        void translate(vec3 const& offset);
+
+        /**
+         * @brief
+         *  Sums in the order ((x + y) + z) + translation, Aabb::transform relies on it to give the
+         *  same bounds as transforming the 8 corners
+         */
+        vec3 transform_point(vec3 const& point) const;
+    };
+    static_assert(std::is_trivial<Affine>());
+    static_assert(sizeof(Affine) == 48);
+
+    // Bound of the difference of every linear element of a QuantizedTrs round trip, relative to the largest scale
+    constexpr float cQuantizedTrsError = 5e-4f;
+
+    /**
+     * @brief
+     *  Translation, rotation and scale of an affine transform without shear. The translation is
+     *  kept as is, the rotation as the smallest three components of its unit quaternion in 16 bits
+     *  each and the scale as the log2 of each axis in 1/2048 steps, from 2^-16 to 2^16. Step 0 is
+     *  reserved for zero and denormal scales, which decode to an exact 0. A negative determinant
+     *  mirrors the x axis.
+     */
+    struct QuantizedTrs {
+        vec3                    translation;
+        std::array<uint16_t, 3> rotation;
+        std::array<uint16_t, 3> scale;
+        uint16_t                flags; // Bits 0-1: dropped quaternion component, bit 2: mirrored
+
+        QuantizedTrs() = default;
+        explicit QuantizedTrs(Affine const& m2w);
+
+        Affine affine() const;
+    };
+    static_assert(std::is_trivial<QuantizedTrs>());
+    static_assert(sizeof(QuantizedTrs) == 28);
+}
+
+#endif // TRANSFORM_HPP
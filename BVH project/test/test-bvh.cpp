@@ -1,5 +1,8 @@
 #include "common.hpp"       // Test utilities
 #include "bvh.hpp"          // Bvh
+#include "flat_bvh.hpp"     // Flattened Bvh
+#include "split_bvh.hpp"    // Static and dynamic Bvh
+#include "pvs.hpp"          // Potentially visible sets
 #include "shapes.hpp"       // Dealing with shapes
 #include "cs350_loader.hpp" // Loading scenes
 #include "logging.hpp"      // Pretty printing
@@ -11,10 +14,15 @@
 #include <limits>
 #include <memory>
 #include <optional>
+#include <random>
 #include <unordered_set>
 #include <fstream>
 #include <filesystem>
 #include <algorithm>
+#include <atomic>
+#include <thread>
+#include <sstream>
+#include <typeinfo>
 
 namespace {
     struct Object;
@@ -23,8 +31,9 @@ namespace {
 
     // Scene objects
     struct Object {
-        unsigned    id{}; // Object identification
-        CS350::Aabb bv{}; // Bounding volume of the object
+        unsigned         id{};                      // Object identification
+        CS350::Aabb      bv{};                      // Bounding volume of the object
+        CS350::LayerMask layers = CS350::cAllLayers; // Categories used by query filters
 
         // Bvh information
         struct {
@@ -34,6 +43,19 @@ namespace {
         } bvhInfo;
     };
 
+    // Scene objects of a Bvh with other node bounding volumes
+    template <typename BV>
+    struct VolumeObject {
+        unsigned    id{};
+        CS350::Aabb bv{};
+
+        struct {
+            VolumeObject*                                 next = nullptr;
+            VolumeObject*                                 prev = nullptr;
+            typename CS350::Bvh<VolumeObject*, BV>::Node* node = nullptr;
+        } bvhInfo;
+    };
+
     /**
      * @brief
      *  Retrieve all the indices of a node (recursively)
@@ -170,6 +192,54 @@ namespace {
 #endif
     }
 
+    /**
+     * @brief
+     *  Fragments passing the depth test when rendering the objects in the given order, with a small
+     *  software depth buffer. Each object covers the screen rectangle of its bv at the depth of its
+     *  nearest corner. Objects crossing the near plane are skipped.
+     */
+    size_t ShadedFragments(std::vector<Object*> const& allObjects, std::vector<unsigned> const& order, mat4 const& viewProj) {
+        constexpr int      cWidth  = 160;
+        constexpr int      cHeight = 90;
+        std::vector<float> depthBuffer(cWidth * cHeight, std::numeric_limits<float>::max());
+        size_t             shaded = 0;
+        for (unsigned id : order) {
+            auto const& bv      = allObjects[id]->bv;
+            vec3        lo      = vec3(std::numeric_limits<float>::max());
+            vec3        hi      = vec3(-std::numeric_limits<float>::max());
+            bool        clipped = false;
+            for (int corner = 0; corner < 8; ++corner) {
+                vec3 point = vec3(corner & 1 ? bv.max.x : bv.min.x, corner & 2 ? bv.max.y : bv.min.y, corner & 4 ? bv.max.z : bv.min.z);
+                glm::vec4 clip = viewProj * glm::vec4(point, 1.0f);
+                if (clip.w <= 1e-3f) {
+                    clipped = true;
+                    break;
+                }
+                vec3 ndc = vec3(clip) / clip.w;
+                lo       = glm::min(lo, ndc);
+                hi       = glm::max(hi, ndc);
+            }
+            if (clipped) {
+                continue;
+            }
+
+            int x0 = std::max(0, static_cast<int>((lo.x * 0.5f + 0.5f) * cWidth));
+            int x1 = std::min(cWidth - 1, static_cast<int>((hi.x * 0.5f + 0.5f) * cWidth));
+            int y0 = std::max(0, static_cast<int>((lo.y * 0.5f + 0.5f) * cHeight));
+            int y1 = std::min(cHeight - 1, static_cast<int>((hi.y * 0.5f + 0.5f) * cHeight));
+            for (int y = y0; y <= y1; ++y) {
+                for (int x = x0; x <= x1; ++x) {
+                    float& depth = depthBuffer[static_cast<size_t>(y * cWidth + x)];
+                    if (lo.z < depth) {
+                        depth = lo.z;
+                        shaded++;
+                    }
+                }
+            }
+        }
+        return shaded;
+    }
+
     /**
      * @brief
      *  Loads both the primitives and the scene
@@ -178,19 +248,14 @@ namespace {
                                 std::vector<CS350::CS350SceneObject>&   objects,
                                 std::vector<CS350::Aabb>&               worldBvs,
                                 char const*                             sceneFile) {
-        // Load all models
-        allPrimitives.clear();
-        size_t lastIndex = 0;
-        auto   assetPath = fmt::format(cAssetPath, lastIndex);
-        while (std::filesystem::exists(assetPath)) {
-            allPrimitives.push_back(CS350::LoadCS350Binary(assetPath));
-            lastIndex++;
-            assetPath = fmt::format(cAssetPath, lastIndex);
-        }
+        // Load all models, identical ones are shared
+        std::vector<int> fileToPrimitive;
+        allPrimitives = CS350::LoadCS350Primitives(cAssetPath, fileToPrimitive);
         ASSERT_FALSE(allPrimitives.empty()) << "No assets were loaded";
 
         // Load the scene
         objects = CS350::LoadCS350Scene(sceneFile);
+        CS350::RemapCS350Scene(objects, fileToPrimitive);
 
         // Process bvs
         worldBvs.clear();
@@ -352,6 +417,15 @@ namespace {
                            "\tsmallestTBvh: {:.02f}\n", smallestTBvh)
                            .c_str();
             }
+            {
+                // BVH approach (closest only, no debug information)
+                auto  hitClosest   = bvh.Query(ray);
+                float smallestTClosest = hitClosest.has_value() ? ray.intersect(objectWithId(hitClosest.value())->bv) : -1;
+                ASSERT_FLOAT_EQ(smallestTClosest, smallestTBvh)
+                    << "Different result between Query and QueryDebug"
+                    << fmt::format("\trayStart: {}\n", rayStart).c_str()
+                    << fmt::format("\trayTarget: {}\n", rayTarget).c_str();
+            }
         }
 
         if (checkPerformance) {
@@ -568,7 +642,7 @@ TEST_F(BoundingVolumeHierarchy, TopDown_MirloRandomRays) {
     TestSceneRandomRays(bvhObjects, bvh, 100, true);
 }
 
-TEST_F(BoundingVolumeHierarchy, Insert_MirloRandom) {
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloOverlap) {
     CS170::Utils::srand(5, 5);
     std::vector<CS350::CS350PrimitiveData> allPrimitives;
     std::vector<CS350::CS350SceneObject>   objects;
@@ -577,169 +651,1795 @@ TEST_F(BoundingVolumeHierarchy, Insert_MirloRandom) {
     auto bvhObjects = CreateObjects(worldBvs);
 
     Bvh bvh;
-    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), cInsertConfig);
-    PrintDebugInformation(bvh);
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
     AssertProperNodes(bvh);
     AssertAllAccountedFor(bvh, bvhObjects);
-    TestSceneAtRandomPositions(bvhObjects, bvh);
+
+    for (int i = 0; i < 100; ++i) {
+        vec3        center = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        vec3        half   = vec3(CS170::Utils::Random(1.0f, 50.0f));
+        CS350::Aabb query(center - half, center + half);
+
+        std::unordered_set<unsigned> overlapBf;
+        for (auto* object : bvhObjects) {
+            if (object->bv.intersects(query)) {
+                overlapBf.insert(object->id);
+            }
+        }
+
+        auto overlapBvh = bvh.Query(query);
+        std::unordered_set<unsigned> overlapBvhSet(overlapBvh.begin(), overlapBvh.end());
+        ASSERT_EQ(overlapBvh.size(), overlapBvhSet.size()) << "Objects reported twice";
+        ASSERT_EQ(overlapBvhSet, overlapBf) << fmt::format("center: {}, half: {}", center, half).c_str();
+    }
 }
 
-TEST_F(BoundingVolumeHierarchy, Insert_MirloCompletelyInside) {
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloConvex) {
     CS170::Utils::srand(5, 5);
     std::vector<CS350::CS350PrimitiveData> allPrimitives;
     std::vector<CS350::CS350SceneObject>   objects;
     std::vector<CS350::Aabb>               worldBvs;
     LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
     auto bvhObjects = CreateObjects(worldBvs);
-    shuffle(bvhObjects);
 
     Bvh bvh;
-    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), cInsertConfig);
-    PrintDebugInformation(bvh);
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
     AssertProperNodes(bvh);
     AssertAllAccountedFor(bvh, bvhObjects);
 
-    vec3 max = bvh.root()->bv.max;
-    vec3 min = bvh.root()->bv.min;
+    // Polyhedra from 4 to 32 planes tangent to a sphere
+    for (int i = 0; i < 100; ++i) {
+        vec3  center     = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        float radius     = CS170::Utils::Random(5.0f, 80.0f);
+        int   planeCount = CS170::Utils::Random(4, 32);
 
-    // Place a camera outside the root, looking in an opposite direction
-    vec3 cameraPosition = vec3(max.x + (max.x - min.x) * 2, 0, 0);
-    vec3 cameraTarget   = vec3(0, 0, 0);
-    vec3 cameraUp       = vec3(0, 1, 0);
-    mat4 view           = glm::lookAt(cameraPosition, cameraTarget, cameraUp);
-    mat4 proj           = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, (max.x - min.x) * 5);
-    mat4 viewProj       = proj * view;
-    auto visible        = bvh.Query(CS350::Frustum(viewProj));
-    ASSERT_EQ(visible.size(), objects.size()) << "All objects should be visible from this point";
-    ASSERT_EQ(CS350::Stats::Instance().frustumVsAabb, 1u) << "Only root should have been tested";
+        std::vector<CS350::Plane> planes;
+        for (int p = 0; p < planeCount; ++p) {
+            vec3 normal = glm::normalize(vec3(CS170::Utils::Random(-1.0f, 1.0f), CS170::Utils::Random(-1.0f, 1.0f), CS170::Utils::Random(-1.0f, 1.0f)) + vec3(1e-3f));
+            planes.emplace_back(center + normal * radius, normal);
+        }
+
+        std::unordered_set<unsigned> visibleBf;
+        for (auto* object : bvhObjects) {
+            uint32_t planeMask = CS350::FullPlaneMask(planes.size());
+            if (CS350::ClassifyConvex(planes, object->bv, planeMask) != CS350::SideResult::eOUTSIDE) {
+                visibleBf.insert(object->id);
+            }
+        }
+
+        CS350::Stats::Instance().Reset();
+        auto                         visibleBvh = bvh.Query(std::span<CS350::Plane const>(planes));
+        std::unordered_set<unsigned> visibleBvhSet(visibleBvh.begin(), visibleBvh.end());
+        ASSERT_EQ(visibleBvh.size(), visibleBvhSet.size()) << "Objects reported twice";
+        ASSERT_EQ(visibleBvhSet, visibleBf) << fmt::format("center: {}, radius: {}, planes: {}", center, radius, planeCount).c_str();
+        ASSERT_GT(CS350::Stats::Instance().convexVsAabb, 0u);
+        ASSERT_EQ(CS350::Stats::Instance().frustumVsAabb, 0u);
+    }
+
+    // The frustum planes as a convex volume give the same result as the frustum query
+    for (int i = 0; i < 20; ++i) {
+        vec3           cameraPosition = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        vec3           cameraTarget   = vec3(CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f));
+        mat4           view           = glm::lookAt(cameraPosition, cameraTarget, vec3(0, 1, 0));
+        mat4           proj           = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+        CS350::Frustum frustum(proj * view);
+
+        CS350::Stats::Instance().Reset();
+        auto fromFrustum = bvh.Query(frustum);
+        auto fromPlanes  = bvh.Query(std::span<CS350::Plane const>(frustum.planes));
+        ASSERT_EQ(fromFrustum, fromPlanes);
+        ASSERT_EQ(CS350::Stats::Instance().frustumVsAabb, CS350::Stats::Instance().convexVsAabb);
+    }
+
+    std::vector<CS350::Plane> tooMany(CS350::cMaxConvexPlanes + 1, CS350::Plane(vec3(1, 0, 0), 0.0f));
+    ASSERT_THROW(bvh.Query(std::span<CS350::Plane const>(tooMany)), std::runtime_error);
 }
 
-TEST_F(BoundingVolumeHierarchy, Insert_SingleAabb) {
-    // Scene BVs
-    std::vector<CS350::Aabb> bvs        = { CS350::Aabb{ { 0, 0, 0 }, { 1, 1, 1 } } };
-    auto                     bvhObjects = CreateObjects(bvs);
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloCone) {
+    CS170::Utils::srand(6, 6);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
 
-    // BVH
     Bvh bvh;
-    for (unsigned i = 0; i < bvs.size(); ++i) {
-        bvh.Insert(bvhObjects[i], cInsertConfig);
-        AssertProperNodes(bvh);
-        AssertAllAccountedFor(bvh, bvhObjects);
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+    AssertProperNodes(bvh);
+    AssertAllAccountedFor(bvh, bvhObjects);
+
+    // Known cases against a unit box
+    CS350::Aabb unit(vec3(-1), vec3(1));
+    ASSERT_TRUE(CS350::Cone(vec3(0), vec3(1, 0, 0), 0.1f, 0.5f).intersects(unit)) << "Apex inside";
+    ASSERT_TRUE(CS350::Cone(vec3(-5, 0, 0), vec3(1, 0, 0), 0.1f, 4.5f).intersects(unit)) << "Reaching the face";
+    ASSERT_FALSE(CS350::Cone(vec3(-5, 0, 0), vec3(1, 0, 0), 0.1f, 3.5f).intersects(unit)) << "Short of the face";
+    ASSERT_FALSE(CS350::Cone(vec3(-5, 0, 0), vec3(-1, 0, 0), 1.0f, 100.0f).intersects(unit)) << "Facing away";
+    ASSERT_FALSE(CS350::Cone(vec3(-5, 3, 0), vec3(1, 0, 0), 0.2f, 100.0f).intersects(unit)) << "Passing above";
+    ASSERT_TRUE(CS350::Cone(vec3(-5, 3, 0), vec3(1, 0, 0), 0.5f, 100.0f).intersects(unit)) << "Wide enough";
+    ASSERT_TRUE(CS350::Cone(vec3(0, 5, 0), vec3(0, -1, 0), glm::half_pi<float>(), 4.1f).intersects(unit)) << "Half space cap";
+    ASSERT_FALSE(CS350::Cone(vec3(0, 5, 0), vec3(0, -1, 0), glm::half_pi<float>(), 3.9f).intersects(unit)) << "Half space cap too short";
+
+    int insideCount = 0;
+    for (int i = 0; i < 100; ++i) {
+        vec3  apex  = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        vec3  axis  = vec3(CS170::Utils::Random(-1.0f, 1.0f), CS170::Utils::Random(-1.0f, 1.0f), CS170::Utils::Random(-1.0f, 1.0f)) + vec3(1e-3f);
+        float angle = CS170::Utils::Random(0.05f, glm::half_pi<float>());
+        float range = CS170::Utils::Random(5.0f, 200.0f);
+        CS350::Cone cone(apex, axis, angle, range);
+
+        std::unordered_set<unsigned> visibleBf;
+        for (auto* object : bvhObjects) {
+            bool overlaps = cone.intersects(object->bv);
+            if (overlaps) {
+                visibleBf.insert(object->id);
+            }
+
+            // The cheap node test is conservative
+            CS350::SideResult side = cone.classify(object->bv);
+            ASSERT_FALSE(side == CS350::SideResult::eOUTSIDE && overlaps) << fmt::format("apex: {}, axis: {}, angle: {}, range: {} bv {} {}", cone.apex, cone.axis, angle, range, object->bv.min, object->bv.max).c_str();
+            ASSERT_FALSE(side == CS350::SideResult::eINSIDE && !overlaps);
+            if (side == CS350::SideResult::eINSIDE) {
+                ++insideCount;
+                for (int c = 0; c < 8; ++c) {
+                    vec3 corner((c & 1) ? object->bv.max.x : object->bv.min.x, (c & 2) ? object->bv.max.y : object->bv.min.y, (c & 4) ? object->bv.max.z : object->bv.min.z);
+                    ASSERT_TRUE(cone.contains(corner));
+                }
+            }
+
+            // A point of the bv inside the cone means they overlap
+            for (int p = 0; p < 4 && !overlaps; ++p) {
+                vec3 point = object->bv.min + (object->bv.max - object->bv.min) * vec3(CS170::Utils::Random(0.0f, 1.0f), CS170::Utils::Random(0.0f, 1.0f), CS170::Utils::Random(0.0f, 1.0f));
+                ASSERT_FALSE(cone.contains(point));
+            }
+        }
+
+        CS350::Stats::Instance().Reset();
+        auto                         visibleBvh = bvh.Query(cone);
+        std::unordered_set<unsigned> visibleBvhSet(visibleBvh.begin(), visibleBvh.end());
+        ASSERT_EQ(visibleBvh.size(), visibleBvhSet.size()) << "Objects reported twice";
+        ASSERT_EQ(visibleBvhSet, visibleBf) << fmt::format("apex: {}, axis: {}, angle: {}, range: {}", apex, axis, angle, range).c_str();
+        ASSERT_GT(CS350::Stats::Instance().coneVsAabb, 0u);
+        ASSERT_EQ(CS350::Stats::Instance().frustumVsAabb, 0u);
+        ASSERT_EQ(CS350::Stats::Instance().convexVsAabb, 0u);
     }
-    PrintDebugInformation(bvh);
+    ASSERT_GT(insideCount, 0) << "Bulk emission never exercised";
 
-    //
-    ASSERT_NEAR(bvh.root()->bv, bvs[0], cTestEpsilon);
+    ASSERT_THROW(bvh.Query(CS350::Cone(vec3(0), vec3(1, 0, 0), 0.0f, 10.0f)), std::runtime_error);
+    ASSERT_THROW(bvh.Query(CS350::Cone(vec3(0), vec3(1, 0, 0), 2.0f, 10.0f)), std::runtime_error);
+    ASSERT_THROW(bvh.Query(CS350::Cone(vec3(0), vec3(1, 0, 0), 0.5f, -1.0f)), std::runtime_error);
 }
 
-TEST_F(BoundingVolumeHierarchy, Insert_PairAabb) {
-    // Scene BVs
-    std::vector<CS350::Aabb> bvs = {
-        CS350::Aabb{ { 0, 0, 0 }, { 1, 1, 1 } },
-        CS350::Aabb{ { 1, 0, 0 }, { 2, 1, 1 } },
-    };
-    auto bvhObjects = CreateObjects(bvs);
+namespace {
+    /**
+     * @brief
+     *  True if the outer volume contains the inner one
+     */
+    template <typename BV>
+    bool Encloses(BV const& outer, BV const& inner) {
+        BV merged(outer, inner);
+        if constexpr (std::is_same_v<BV, CS350::Sphere>) {
+            return merged.radius <= outer.radius + cTestEpsilon;
+        } else {
+            return merged.min == outer.min && merged.max == outer.max;
+        }
+    }
+
+    /**
+     * @brief
+     *  Builds a Bvh with BV nodes over the aabbs, checks its nodes and that every query returns the
+     *  same objects as the Aabb tree, the objects are tested the same way at the leaves
+     */
+    template <typename BV, typename Reference>
+    void AssertSameQueries(std::vector<CS350::Aabb> const& worldBvs, Reference const& reference, bool insert) {
+        using VolumeBvh = CS350::Bvh<VolumeObject<BV>*, BV>;
+        SCOPED_TRACE(fmt::format("{} {}", typeid(BV).name(), insert ? "inserted" : "top down"));
+        std::vector<VolumeObject<BV>>  storage(worldBvs.size());
+        std::vector<VolumeObject<BV>*> objects;
+        for (unsigned i = 0; i < worldBvs.size(); ++i) {
+            storage[i].id = i;
+            storage[i].bv = worldBvs[i];
+            objects.push_back(&storage[i]);
+        }
+
+        VolumeBvh bvh;
+        if (insert) {
+            bvh.Insert(objects.begin(), objects.end(), cInsertConfig);
+        } else {
+            bvh.BuildTopDown(objects.begin(), objects.end(), cTopDownConfig);
+        }
+        ASSERT_EQ(bvh.objectCount(), objects.size());
+
+        // Every node encloses the objects below it. Merged spheres depend on the order, a child is not
+        // always inside its parent.
+        bvh.TraverseLevelOrder([&](typename VolumeBvh::Node const* node) {
+            node->TraverseLevelOrderObjects([&](VolumeObject<BV> const* object) { ASSERT_TRUE(Encloses(node->bv, BV(object->bv))); });
+            if (!node->IsLeaf() && !std::is_same_v<BV, CS350::Sphere>) {
+                ASSERT_TRUE(Encloses(node->bv, node->children[0]->bv));
+                ASSERT_TRUE(Encloses(node->bv, node->children[1]->bv));
+            }
+        });
+
+        auto sorted = [](std::vector<unsigned> ids) {
+            std::sort(ids.begin(), ids.end());
+            return ids;
+        };
+        for (int i = 0; i < 20; ++i) {
+            vec3 cameraPosition = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+            vec3 cameraTarget   = vec3(CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f));
+            mat4 view           = glm::lookAt(cameraPosition, cameraTarget, vec3(0, 1, 0));
+            mat4 proj           = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+            CS350::Frustum frustum(proj * view);
+            ASSERT_EQ(sorted(bvh.Query(frustum)), sorted(reference.Query(frustum)));
+            ASSERT_EQ(bvh.QueryOrdered(frustum, cameraPosition).size(), reference.Query(frustum).size());
+            ASSERT_EQ(sorted(bvh.Query(std::span<CS350::Plane const>(frustum.planes))), sorted(reference.Query(frustum)));
+
+            CS350::Ray ray(cameraPosition, cameraTarget - cameraPosition);
+            // Objects hit at the same time may come in any order, compare the time of the hit
+            auto hit = bvh.Query(ray), referenceHit = reference.Query(ray);
+            ASSERT_EQ(hit.has_value(), referenceHit.has_value());
+            if (hit) {
+                ASSERT_EQ(ray.intersect(worldBvs[*hit]), ray.intersect(worldBvs[*referenceHit]));
+            }
+
+            CS350::Aabb box(cameraTarget - vec3(20.0f), cameraTarget + vec3(20.0f));
+            ASSERT_EQ(sorted(bvh.Query(box)), sorted(reference.Query(box)));
+
+            CS350::Cone cone(cameraPosition, cameraTarget - cameraPosition, 0.3f, 150.0f);
+            ASSERT_EQ(sorted(bvh.Query(cone)), sorted(reference.Query(cone)));
+        }
+    }
+}
+
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloBoundingVolumes) {
+    CS170::Utils::srand(7, 7);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
 
-    // BVH
     Bvh bvh;
-    for (unsigned i = 0; i < bvhObjects.size(); ++i) {
-        bvh.Insert(bvhObjects[i], cInsertConfig);
-        AssertProperNodes(bvh);
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+
+    // Volumes around a single box
+    CS350::Aabb box(vec3(-1, -2, -3), vec3(2, 1, 4));
+    ASSERT_NEAR(CS350::Kdop<14>(box).volume(), box.volume(), cTestEpsilon);
+    ASSERT_NEAR(CS350::Kdop<18>(box).surface_area(), box.surface_area(), cTestEpsilon);
+    ASSERT_NEAR(CS350::Kdop<26>(box).volume(), box.volume(), cTestEpsilon);
+    for (int c = 0; c < 8; ++c) {
+        vec3 corner((c & 1) ? box.max.x : box.min.x, (c & 2) ? box.max.y : box.min.y, (c & 4) ? box.max.z : box.min.z);
+        ASSERT_LE(glm::distance(corner, CS350::Sphere(box).center), CS350::Sphere(box).radius + cTestEpsilon);
+        ASSERT_TRUE(CS350::Kdop<14>(box).intersects(corner));
     }
-    AssertAllAccountedFor(bvh, bvhObjects);
-    PrintDebugInformation(bvh);
-    auto bvh_objects = BvhFlatMap(bvh.root());
 
-    //
-    CS350::Aabb full = { { 0, 0, 0 }, { 2, 1, 1 } }; // Full scene Aabb
-    ASSERT_NEAR(bvh.root()->bv, full, cTestEpsilon); // Should match
+    // Corner of a unit cube cut by a corner diagonal, and a diagonal row of boxes
+    CS350::Kdop<14> corner(CS350::Aabb(vec3(0), vec3(1)));
+    corner.max[3] = 1.0f;
+    ASSERT_NEAR(corner.volume(), 1.0f / 6.0f, cTestEpsilon);
+    ASSERT_NEAR(corner.surface_area(), 1.5f + std::sqrt(3.0f) * 0.5f, cTestEpsilon);
+    CS350::Kdop<18> row(CS350::Aabb(vec3(0), vec3(1)));
+    for (int i = 1; i < 10; ++i) {
+        row = CS350::Kdop<18>(row, CS350::Kdop<18>(CS350::Aabb(vec3(float(i)), vec3(float(i + 1)))));
+    }
+    ASSERT_LT(row.volume(), row.bounds().volume() * 0.1f);
+    ASSERT_LT(CS350::Ray(vec3(-5, 9, 0), vec3(1, 0, 0)).intersect(row), 0.0f) << "Misses the row, hits its box";
+    ASSERT_GE(CS350::Ray(vec3(-5, 9, 0), vec3(1, 0, 0)).intersect(row.bounds()), 0.0f);
+
+    AssertSameQueries<CS350::Sphere>(worldBvs, bvh, false);
+    AssertSameQueries<CS350::Kdop<14>>(worldBvs, bvh, false);
+    AssertSameQueries<CS350::Kdop<18>>(worldBvs, bvh, false);
+    AssertSameQueries<CS350::Sphere>(worldBvs, bvh, true);
+    AssertSameQueries<CS350::Kdop<14>>(worldBvs, bvh, true);
 }
 
-TEST_F(BoundingVolumeHierarchy, Insert_ClearCheck) {
-    // Scene BVs
-    std::vector<CS350::Aabb> bvs        = { CS350::Aabb{ { 0, 0, 0 }, { 1, 1, 1 } } };
-    auto                     bvhObjects = CreateObjects(bvs);
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloNearToFar) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
 
-    // BVH
     Bvh bvh;
-    for (unsigned i = 0; i < bvhObjects.size(); ++i) {
-        bvh.Insert(bvhObjects[i], cInsertConfig);
-        AssertProperNodes(bvh);
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+
+    auto sorted = [](std::vector<unsigned> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    // Cameras inside the scene, where the order matters the most
+    size_t stackOrderShaded = 0, nearToFarShaded = 0, exactShaded = 0;
+    for (int i = 0; i < 50; ++i) {
+        vec3 cameraPosition = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        vec3 cameraTarget   = vec3(CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f));
+        mat4 view           = glm::lookAt(cameraPosition, cameraTarget, vec3(0, 1, 0));
+        mat4 proj           = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+        mat4 viewProj       = proj * view;
+        CS350::Frustum frustum(viewProj);
+
+        auto stackOrder = bvh.Query(frustum);
+        auto nearToFar  = bvh.QueryOrdered(frustum, cameraPosition);
+        ASSERT_EQ(sorted(nearToFar), sorted(stackOrder)) << "Both queries must return the same objects";
+
+        // Objects of the same leaf are sorted
+        for (size_t o = 1; o < nearToFar.size(); ++o) {
+            auto const* previous = bvhObjects[nearToFar[o - 1]];
+            auto const* current  = bvhObjects[nearToFar[o]];
+            if (previous->bvhInfo.node == current->bvhInfo.node) {
+                ASSERT_LE(previous->bv.squared_distance(cameraPosition), current->bv.squared_distance(cameraPosition));
+            }
+        }
+
+        auto exact = nearToFar;
+        std::stable_sort(exact.begin(), exact.end(), [&](unsigned lhs, unsigned rhs) {
+            return bvhObjects[lhs]->bv.squared_distance(cameraPosition) < bvhObjects[rhs]->bv.squared_distance(cameraPosition);
+        });
+
+        stackOrderShaded += ShadedFragments(bvhObjects, stackOrder, viewProj);
+        nearToFarShaded += ShadedFragments(bvhObjects, nearToFar, viewProj);
+        exactShaded += ShadedFragments(bvhObjects, exact, viewProj);
     }
-    AssertAllAccountedFor(bvh, bvhObjects);
-    PrintDebugInformation(bvh);
-    bvh.Clear();
 
-    //
-    ASSERT_EQ(bvh.Depth(), -1);
-    ASSERT_EQ(bvh.Size(), 0);
-    ASSERT_EQ(bvh.root(), nullptr);
+    RecordProperty("ShadedStackOrder", std::to_string(stackOrderShaded));
+    RecordProperty("ShadedNearToFar", std::to_string(nearToFarShaded));
+    RecordProperty("ShadedFullySorted", std::to_string(exactShaded));
+    ASSERT_LT(nearToFarShaded, stackOrderShaded) << "Near to far order should reduce overdraw";
 }
 
-TEST_F(BoundingVolumeHierarchy, Insert_CornerCase) {
-    // Scene BVs
-    std::vector<CS350::Aabb> bvs(500, CS350::Aabb{ { 0, 0, 0 }, { 1, 1, 1 } });
-    auto                     bvhObjects = CreateObjects(bvs);
-    shuffle(bvhObjects);
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloParallel) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+    for (auto* object : bvhObjects) {
+        object->layers = 1u << (object->id % 3);
+    }
 
-    // BVH
     Bvh bvh;
-    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), cInsertConfig);
-    PrintDebugInformation(bvh);
-    AssertProperNodes(bvh);
-    AssertAllAccountedFor(bvh, bvhObjects);
-    ASSERT_EQ(bvh.Depth(), 0u);
-    ASSERT_EQ(bvh.Size(), 1u);
-    bvh.Clear();
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
 
-    //
-    ASSERT_EQ(bvh.Depth(), -1);
-    ASSERT_EQ(bvh.Size(), 0);
-    ASSERT_EQ(bvh.root(), nullptr);
+    for (int i = 0; i < 30; ++i) {
+        vec3           cameraPosition = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        vec3           cameraTarget   = vec3(CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f));
+        mat4           view           = glm::lookAt(cameraPosition, cameraTarget, vec3(0, 1, 0));
+        mat4           proj           = glm::perspective(glm::radians(i % 2 == 0 ? 50.0f : 120.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+        CS350::Frustum frustum(proj * view);
+
+        for (CS350::QueryFilter filter : { CS350::QueryFilter{}, CS350::QueryFilter{ 1u | 4u, 0u } }) {
+            CS350::Stats::Instance().Reset();
+            auto   serial      = bvh.Query(frustum, filter);
+            size_t serialTests = CS350::Stats::Instance().frustumVsAabb;
+
+            // Same ids in the same order and the same amount of work for any amount of threads
+            for (unsigned threads : { 1u, 2u, 3u, 8u, 32u }) {
+                CS350::Stats::Instance().Reset();
+                ASSERT_EQ(bvh.QueryParallel(frustum, threads, filter), serial) << fmt::format("{} threads", threads).c_str();
+                ASSERT_EQ(CS350::Stats::Instance().frustumVsAabb, serialTests) << fmt::format("{} threads", threads).c_str();
+            }
+        }
+    }
+
+    Bvh empty;
+    ASSERT_TRUE(empty.QueryParallel(CS350::Frustum(glm::perspective(glm::radians(50.0f), 1.0f, 0.01f, 1000.0f)), 4).empty());
 }
 
-TEST_F(BoundingVolumeHierarchy, Insert_Manual01) {
-    // Scene BVs
-    std::vector<CS350::Aabb> bvs = {
-        CS350::Aabb{ { 1, 3, 0 }, { 3, 5, 1 } },  // 0
-        CS350::Aabb{ { 4, 1, 0 }, { 6, 7, 1 } },  // 1
-        CS350::Aabb{ { 6, 6, 0 }, { 7, 7, 1 } },  // 2
-        CS350::Aabb{ { 6, 5, 0 }, { 7, 6, 1 } },  // 3
-        CS350::Aabb{ { 6, 4, 0 }, { 7, 5, 1 } },  // 4
-        CS350::Aabb{ { 6, 3, 0 }, { 7, 4, 1 } },  // 5
-        CS350::Aabb{ { 6, 2, 0 }, { 7, 3, 1 } },  // 6
-        CS350::Aabb{ { 6, 1, 0 }, { 7, 2, 1 } },  // 7
-        CS350::Aabb{ { 8, 3, 0 }, { 9, 5, 1 } },  // 8
-        CS350::Aabb{ { 9, 3, 0 }, { 10, 5, 1 } }, // 9
-    };
-    auto bvhObjects = CreateObjects(bvs);
-    shuffle(bvhObjects);
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloLazy) {
+    CS170::Utils::srand(6, 6);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
 
-    // Override config
-    const CS350::BvhBuildConfig cInsertConfig = {
-        100,       // max_depth
-        1,         // min_objects
-        1 * 1 * 1, // min_volume
-    };
+    // Reference tree over its own objects
+    using ReferenceBvh = CS350::Bvh<VolumeObject<CS350::Aabb>*>;
+    std::vector<VolumeObject<CS350::Aabb>>  referenceStorage(worldBvs.size());
+    std::vector<VolumeObject<CS350::Aabb>*> referenceObjects;
+    for (unsigned i = 0; i < worldBvs.size(); ++i) {
+        referenceStorage[i].id = i;
+        referenceStorage[i].bv = worldBvs[i];
+        referenceObjects.push_back(&referenceStorage[i]);
+    }
+    ReferenceBvh reference;
+    reference.BuildTopDown(referenceObjects.begin(), referenceObjects.end(), cTopDownConfig);
+
+    std::vector<CS350::Frustum> frustums;
+    std::vector<CS350::Ray>     rays;
+    for (int i = 0; i < 30; ++i) {
+        vec3 cameraPosition = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        vec3 cameraTarget   = vec3(CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f));
+        mat4 view           = glm::lookAt(cameraPosition, cameraTarget, vec3(0, 1, 0));
+        mat4 proj           = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+        frustums.emplace_back(proj * view);
+        rays.emplace_back(cameraPosition, cameraTarget - cameraPosition);
+    }
 
-    // BVH
+    // Only the root exists until a query goes down, a small query only splits its way to the box
     Bvh bvh;
-    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), cInsertConfig);
-    PrintDebugInformation(bvh);
+    bvh.BuildLazy(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+    ASSERT_EQ(bvh.Size(), 1);
+    ASSERT_EQ(bvh.objectCount(), bvhObjects.size());
+    CS350::Aabb box(worldBvs[0].get_center() - vec3(1.0f), worldBvs[0].get_center() + vec3(1.0f));
+    ASSERT_EQ(bvh.Query(box), reference.Query(box));
+    ASSERT_GT(bvh.Size(), 1);
+    ASSERT_LT(bvh.Size(), reference.Size() / 4);
+
+    // Splits are the ones of BuildTopDown, so are the results
+    for (size_t i = 0; i < frustums.size(); ++i) {
+        ASSERT_EQ(bvh.Query(frustums[i]), reference.Query(frustums[i]));
+        ASSERT_EQ(bvh.QueryOrdered(frustums[i], rays[i].start), reference.QueryOrdered(frustums[i], rays[i].start));
+        ASSERT_EQ(bvh.Query(rays[i]), reference.Query(rays[i]));
+        CS350::Cone cone(rays[i].start, rays[i].dir, 0.3f, 150.0f);
+        ASSERT_EQ(bvh.Query(cone), reference.Query(cone));
+    }
+
+    // A box around everything expands every node, ending with the same tree as maxDepth never stops a split
+    CS350::Aabb everything(vec3(-1e6f), vec3(1e6f));
+    ASSERT_EQ(bvh.Query(everything), reference.Query(everything));
+    ASSERT_EQ(bvh.Size(), reference.Size());
+    ASSERT_EQ(bvh.Depth(), reference.Depth());
     AssertProperNodes(bvh);
-    AssertAllAccountedFor(bvh, bvhObjects);
 
-    // Testing
-    auto createRay = [](vec2 from, vec2 to) {
-        vec3 st  = vec3(from.x, from.y, 0.5f); // 0.5f so that we are in the same plane as AABBs volumes
-        vec3 end = vec3(to.x, to.y, 0.5f);
-        vec3 dir = end - st;
-        return CS350::Ray(st, dir);
-    };
+    // Threads querying a fresh lazy tree at once expand every node a single time
+    bvh.BuildLazy(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+    std::vector<std::vector<unsigned>> expected;
+    std::vector<std::optional<unsigned>> expectedHits;
+    for (size_t i = 0; i < frustums.size(); ++i) {
+        expected.push_back(reference.Query(frustums[i]));
+        expectedHits.push_back(reference.Query(rays[i]));
+    }
+    std::atomic<unsigned>    mismatches{ 0 };
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+            for (size_t i = 0; i < frustums.size(); ++i) {
+                size_t query = (i + t * 7) % frustums.size();
+                if (bvh.Query(frustums[query]) != expected[query] || bvh.Query(rays[query]) != expectedHits[query]) {
+                    ++mismatches;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    ASSERT_EQ(mismatches.load(), 0u);
+    ASSERT_EQ(bvh.Query(everything), reference.Query(everything));
+    ASSERT_EQ(bvh.Size(), reference.Size());
+    AssertProperNodes(bvh);
+}
 
-    // Some rays manually
-    std::vector<unsigned>       allIntersectedObjects;
-    std::vector<BvhNode const*> allIntersectedNodes;
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloSliced) {
+    CS170::Utils::srand(8, 8);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+    for (auto* object : bvhObjects) {
+        object->layers = 1u << (object->id % 3);
+    }
+
+    // What the current tree and the new one return, over their own objects
+    const CS350::BvhBuildConfig cNewConfig = { std::numeric_limits<unsigned>::max(), 5, 10.0f };
+    using ReferenceBvh                     = CS350::Bvh<VolumeObject<CS350::Aabb>*>;
+    std::vector<VolumeObject<CS350::Aabb>>  referenceStorage(worldBvs.size());
+    std::vector<VolumeObject<CS350::Aabb>*> referenceObjects;
+    for (unsigned i = 0; i < worldBvs.size(); ++i) {
+        referenceStorage[i].id = i;
+        referenceStorage[i].bv = worldBvs[i];
+        referenceObjects.push_back(&referenceStorage[i]);
+    }
+    ReferenceBvh oldReference;
+    oldReference.BuildTopDown(referenceObjects.begin(), referenceObjects.end(), cTopDownConfig);
+    std::vector<VolumeObject<CS350::Aabb>>  newStorage(referenceStorage);
+    std::vector<VolumeObject<CS350::Aabb>*> newObjects;
+    for (auto& object : newStorage) {
+        object.bvhInfo = {};
+        newObjects.push_back(&object);
+    }
+    ReferenceBvh newReference;
+    newReference.BuildTopDown(newObjects.begin(), newObjects.end(), cNewConfig);
+
+    vec3           cameraPosition(60.0f, 30.0f, -80.0f);
+    mat4           view = glm::lookAt(cameraPosition, vec3(0.0f), vec3(0, 1, 0));
+    mat4           proj = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+    CS350::Frustum frustum(proj * view);
+    CS350::Ray     ray(cameraPosition, -cameraPosition);
+
+    // Nothing changes for queries until the last step
+    Bvh bvh;
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+    bvh.BeginBuild(bvhObjects.begin(), bvhObjects.end(), cNewConfig);
+    ASSERT_TRUE(bvh.Building());
+    unsigned steps    = 0;
+    float    progress = 0.0f;
+    for (bool done = false; !done; ++steps) {
+        ASSERT_EQ(bvh.Query(frustum), oldReference.Query(frustum));
+        ASSERT_EQ(bvh.Query(ray), oldReference.Query(ray));
+        ASSERT_EQ(bvh.Size(), oldReference.Size());
+        done = bvh.Step(0); // A single node per step
+        ASSERT_GE(bvh.buildProgress(), done ? 0.0f : progress);
+        progress = bvh.buildProgress();
+    }
+    ASSERT_FALSE(bvh.Building());
+    ASSERT_EQ(steps, static_cast<unsigned>(newReference.Size()));
+
+    // Same tree as BuildTopDown, objects linked to it
+    ASSERT_EQ(bvh.objectCount(), bvhObjects.size());
+    ASSERT_EQ(bvh.Size(), newReference.Size());
+    ASSERT_EQ(bvh.Depth(), newReference.Depth());
+    AssertProperNodes(bvh);
+    ASSERT_EQ(bvh.Query(frustum), newReference.Query(frustum));
+    ASSERT_EQ(bvh.Query(ray), newReference.Query(ray));
+
+    // Layers of the internal nodes are set once the objects are linked
+    std::vector<unsigned> layerTwo;
+    for (unsigned id : bvh.Query(frustum)) {
+        if (id % 3 == 1) {
+            layerTwo.push_back(id);
+        }
+    }
+    ASSERT_EQ(bvh.Query(frustum, CS350::QueryFilter{ 2u, 0u }), layerTwo);
+
+    // A large budget finishes in a single call, cancelling or clearing keeps the current tree
+    bvh.BeginBuild(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+    bvh.Step(0);
+    bvh.CancelBuild();
+    ASSERT_FALSE(bvh.Building());
+    ASSERT_EQ(bvh.Size(), newReference.Size());
+    ASSERT_EQ(bvh.Query(frustum), newReference.Query(frustum));
+    bvh.BeginBuild(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+    ASSERT_TRUE(bvh.Step(10000000));
+    ASSERT_EQ(bvh.Size(), oldReference.Size());
+    ASSERT_EQ(bvh.Query(frustum), oldReference.Query(frustum));
+    bvh.BeginBuild(bvhObjects.begin(), bvhObjects.end(), cNewConfig);
+    bvh.Step(0);
+    bvh.Clear();
+    ASSERT_FALSE(bvh.Building());
+    ASSERT_TRUE(bvh.Empty());
+    ASSERT_FALSE(bvh.Step(1000));
+
+    // Objects inserted one per frame during the build end in the new tree too
+    auto half = bvhObjects.begin() + static_cast<std::ptrdiff_t>(bvhObjects.size() / 2);
+    bvh.BuildTopDown(bvhObjects.begin(), half, cTopDownConfig);
+    bvh.BeginBuild(bvhObjects.begin(), half, cNewConfig);
+    auto next = half;
+    while (!bvh.Step(0)) {
+        if (next != bvhObjects.end()) {
+            bvh.Insert(*next++, cInsertConfig);
+        }
+        if (next != bvhObjects.end()) {
+            bvh.InsertConcurrent(*next++, cInsertConfig);
+        }
+    }
+    bvh.Insert(next, bvhObjects.end(), cInsertConfig);
+    ASSERT_EQ(bvh.objectCount(), bvhObjects.size());
+    AssertProperNodes(bvh);
+    AssertAllAccountedFor(bvh, bvhObjects);
+    auto visible   = bvh.Query(frustum);
+    auto reference = newReference.Query(frustum);
+    std::sort(visible.begin(), visible.end());
+    std::sort(reference.begin(), reference.end());
+    ASSERT_EQ(visible, reference);
+
+    // A whole BuildTopDown meanwhile drops the sliced build
+    bvh.Clear();
+    bvh.BeginBuild(bvhObjects.begin(), half, cNewConfig);
+    bvh.Step(0);
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+    ASSERT_FALSE(bvh.Building());
+    ASSERT_EQ(bvh.objectCount(), bvhObjects.size());
+    AssertAllAccountedFor(bvh, bvhObjects);
+}
+
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloLineOfSight) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+    for (auto* object : bvhObjects) {
+        object->layers = 1u << (object->id % 3);
+    }
+
+    Bvh bvh;
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+
+    std::vector<vec3> agents;
+    for (int i = 0; i < 150; ++i) {
+        agents.push_back(vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f)));
+    }
+
+    // Every object against every segment
+    auto bruteForce = [&](size_t i, size_t j, float maxDistance, CS350::QueryFilter const& filter) {
+        if (glm::distance(agents[i], agents[j]) > maxDistance) {
+            return false;
+        }
+        CS350::Ray segment(agents[i], agents[j] - agents[i]);
+        for (auto const* object : bvhObjects) {
+            float time = segment.intersect(object->bv);
+            if (filter.Accepts(object->layers) && time >= 0.0f && time <= 1.0f) {
+                return false;
+            }
+        }
+        return true;
+    };
+
+    for (float maxDistance : { std::numeric_limits<float>::max(), 80.0f }) {
+        for (CS350::QueryFilter filter : { CS350::QueryFilter{}, CS350::QueryFilter{ 1u, 0u } }) {
+            auto   visibility = bvh.QueryLineOfSight(agents, maxDistance, 1, filter);
+            size_t visible    = 0;
+            ASSERT_EQ(visibility.count(), agents.size());
+            for (size_t i = 0; i < agents.size(); ++i) {
+                ASSERT_FALSE(visibility.Visible(i, i));
+                for (size_t j = i + 1; j < agents.size(); ++j) {
+                    ASSERT_EQ(visibility.Visible(i, j), bruteForce(i, j, maxDistance, filter)) << fmt::format("agents {} and {}", i, j).c_str();
+                    ASSERT_EQ(visibility.Visible(i, j), visibility.Visible(j, i));
+                    visible += visibility.Visible(i, j) ? 1u : 0u;
+                }
+            }
+            ASSERT_GT(visible, 0u);
+
+            // Same matrix for any amount of threads
+            for (unsigned threads : { 2u, 3u, 8u }) {
+                auto parallel = bvh.QueryLineOfSight(agents, maxDistance, threads, filter);
+                for (size_t i = 0; i < agents.size(); ++i) {
+                    for (size_t j = 0; j < agents.size(); ++j) {
+                        ASSERT_EQ(parallel.Visible(i, j), visibility.Visible(i, j));
+                    }
+                }
+            }
+        }
+    }
+
+    Bvh empty;
+    auto open = empty.QueryLineOfSight(agents, 1000.0f);
+    ASSERT_TRUE(open.Visible(0, 1));
+    ASSERT_EQ(bvh.QueryLineOfSight(std::span<vec3 const>{}).count(), 0u);
+}
+
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloFlattened) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+
+    Bvh bvh;
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+
+    // Flatten, then move the block to make sure nothing depends on its address
+    std::vector<uint64_t> buffer((CS350::FlatBvhSize(bvh) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+    size_t                size = CS350::FlattenBvh(bvh, buffer.data(), buffer.size() * sizeof(uint64_t));
+    std::vector<uint64_t> moved = buffer;
+    buffer.assign(buffer.size(), 0);
+
+    CS350::FlatBvhView flat(moved.data(), size);
+    ASSERT_EQ(flat.nodeCount(), static_cast<unsigned>(bvh.Size()));
+    ASSERT_EQ(flat.objectCount(), bvh.objectCount());
+
+    auto sorted = [](std::vector<unsigned> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+    for (int i = 0; i < 100; ++i) {
+        vec3 a = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        vec3 b = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+
+        mat4 view = glm::lookAt(a, b * 0.1f, vec3(0, 1, 0));
+        mat4 proj = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+        CS350::Frustum frustum(proj * view);
+        ASSERT_EQ(sorted(flat.Query(frustum)), sorted(bvh.Query(frustum)));
+
+        CS350::Ray ray(a * 2.0f, b - a * 2.0f);
+        ASSERT_EQ(flat.Query(ray), bvh.Query(ray));
+
+        CS350::Aabb aabb(glm::min(a, b), glm::min(a, b) + vec3(20.0f));
+        ASSERT_EQ(sorted(flat.Query(aabb)), sorted(bvh.Query(aabb)));
+    }
+
+    // Blocks written with another layout are rejected
+    CS350::FlatBvhHeader header;
+    std::memcpy(&header, moved.data(), sizeof(header));
+    header.version = CS350::cFlatBvhVersion + 1;
+    std::memcpy(moved.data(), &header, sizeof(header));
+    ASSERT_FALSE(CS350::FlatBvhView::IsValid(moved.data(), size));
+    ASSERT_THROW(CS350::FlatBvhView(moved.data(), size), std::runtime_error);
+}
+
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloBatch) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+
+    Bvh bvh;
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+
+    // More queries than lanes, so lanes are reused
+    std::vector<CS350::Ray> rays;
+    std::vector<vec3>       points;
+    for (int i = 0; i < 1000; ++i) {
+        vec3 rayStart  = vec3(CS170::Utils::Random(-200.0f, 200.0f), CS170::Utils::Random(-200.0f, 200.0f), CS170::Utils::Random(-200.0f, 200.0f));
+        vec3 rayTarget = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        rays.emplace_back(rayStart, rayTarget - rayStart);
+        points.push_back(rayTarget);
+    }
+    // Points inside objects, to make sure some are found
+    for (auto* object : bvhObjects) {
+        points.push_back(object->bv.get_center());
+    }
+
+    std::vector<std::optional<unsigned>> closest(rays.size());
+    bvh.QueryBatch(rays.data(), rays.size(), closest.data());
+    for (size_t i = 0; i < rays.size(); ++i) {
+        ASSERT_EQ(closest[i], bvh.Query(rays[i])) << fmt::format("ray {}", i).c_str();
+    }
+
+    std::vector<std::vector<unsigned>> containing;
+    bvh.QueryBatch(points.data(), points.size(), containing);
+    ASSERT_EQ(containing.size(), points.size());
+    for (size_t i = 0; i < points.size(); ++i) {
+        std::vector<unsigned> containingBf;
+        for (auto* object : bvhObjects) {
+            if (object->bv.intersects(points[i])) {
+                containingBf.push_back(object->id);
+            }
+        }
+        std::sort(containing[i].begin(), containing[i].end());
+        ASSERT_EQ(containing[i], containingBf) << fmt::format("point {}", points[i]).c_str();
+    }
+}
+
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloExact) {
+    CS170::Utils::srand(6, 6);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+
+    Bvh bvh;
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+
+    // Exact geometry: the sphere inscribed in each bv, the payload is the normal at the hit
+    std::vector<CS350::Sphere> spheres;
+    for (auto* object : bvhObjects) {
+        vec3 extents = object->bv.get_extents();
+        spheres.emplace_back(object->bv.get_center(), std::min({ extents.x, extents.y, extents.z }) * 0.5f);
+    }
+
+    size_t hits = 0;
+    for (int i = 0; i < 1000; ++i) {
+        vec3        rayStart  = vec3(CS170::Utils::Random(-200.0f, 200.0f), CS170::Utils::Random(-200.0f, 200.0f), CS170::Utils::Random(-200.0f, 200.0f));
+        vec3        rayTarget = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        CS350::Ray  ray(rayStart, rayTarget - rayStart);
+        std::string trace = fmt::format("ray {}", i);
+
+        // Brute force
+        std::optional<unsigned> closestBf;
+        float                   closestTimeBf = std::numeric_limits<float>::max();
+        for (auto* object : bvhObjects) {
+            float t = ray.intersect(spheres[object->id]);
+            if (t >= 0.0f && t < closestTimeBf) {
+                closestTimeBf = t;
+                closestBf     = object->id;
+            }
+        }
+
+        size_t tested = 0;
+        vec3   normal(0.0f);
+        auto   intersect = [&](Object* object, float& tMax) {
+            ++tested;
+            float t = ray.intersect(spheres[object->id]);
+            if (t < 0.0f || t >= tMax) {
+                return false;
+            }
+            tMax   = t;
+            normal = glm::normalize(ray.start + ray.dir * t - spheres[object->id].center);
+            return true;
+        };
+        float tMax    = std::numeric_limits<float>::max();
+        auto  closest = bvh.QueryExact(ray, tMax, intersect);
+        if (!closestBf) {
+            ASSERT_FALSE(closest.has_value()) << trace.c_str();
+            continue;
+        }
+        ASSERT_TRUE(closest.has_value()) << trace.c_str();
+        ASSERT_EQ(tMax, closestTimeBf) << trace.c_str();
+        ASSERT_EQ(ray.intersect(spheres[*closest]), closestTimeBf) << trace.c_str();
+        if (tMax > 0.0f) { // Not starting inside the sphere
+            ASSERT_NEAR(glm::length(ray.start + ray.dir * tMax - spheres[*closest].center), spheres[*closest].radius, 1e-2f) << trace.c_str();
+            ASSERT_NEAR(glm::length(normal), 1.0f, 1e-4f) << trace.c_str();
+        }
+        ASSERT_LT(tested, bvhObjects.size() / 10) << trace.c_str();
+        ++hits;
+
+        // Limited before the hit, nothing is hit and tMax is kept
+        float limit = closestTimeBf * 0.5f;
+        tMax        = limit;
+        ASSERT_FALSE(bvh.QueryExact(ray, tMax, intersect).has_value()) << trace.c_str();
+        ASSERT_EQ(tMax, limit) << trace.c_str();
+
+        // Rejected objects do not block the ray
+        tMax = std::numeric_limits<float>::max();
+        ASSERT_FALSE(bvh.QueryExact(ray, tMax, [](Object*, float&) { return false; }).has_value()) << trace.c_str();
+        ASSERT_EQ(tMax, std::numeric_limits<float>::max()) << trace.c_str();
+    }
+    ASSERT_GT(hits, 100u);
+}
+
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloMorton) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+
+    // Codes of the corners of the bounds
+    CS350::Aabb bounds(vec3(-1.0f), vec3(1.0f));
+    ASSERT_EQ(CS350::MortonCode(bounds.min, bounds), 0u);
+    ASSERT_EQ(CS350::MortonCode(bounds.max, bounds), 0x3FFFFFFFu);
+    ASSERT_EQ(CS350::MortonCode(vec3(1.0f, -1.0f, -1.0f), bounds), 0x24924924u); // x is the highest bit of each triple
+    ASSERT_EQ(CS350::MortonCode(vec3(5.0f, -5.0f, -5.0f), bounds), 0x24924924u); // Clamped
+
+    // A permutation, with consecutive objects much closer than in the scene file
+    std::vector<unsigned> order = CS350::MortonOrder(worldBvs);
+    ASSERT_EQ(order.size(), worldBvs.size());
+    std::vector<unsigned> sortedOrder = order;
+    std::sort(sortedOrder.begin(), sortedOrder.end());
+    for (unsigned i = 0; i < sortedOrder.size(); ++i) {
+        ASSERT_EQ(sortedOrder[i], i);
+    }
+    float fileDistance = 0.0f, mortonDistance = 0.0f;
+    for (size_t i = 1; i < worldBvs.size(); ++i) {
+        fileDistance += glm::distance(worldBvs[i - 1].get_center(), worldBvs[i].get_center());
+        mortonDistance += glm::distance(worldBvs[order[i - 1]].get_center(), worldBvs[order[i]].get_center());
+    }
+    ASSERT_LT(mortonDistance, fileDistance * 0.25f);
+
+    // Same queries on the reordered objects once mapped back to the scene file
+    auto bvhObjects = CreateObjects(worldBvs);
+    Bvh  bvh;
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+
+    using MortonBvh = CS350::Bvh<VolumeObject<CS350::Aabb>*>;
+    std::vector<VolumeObject<CS350::Aabb>>  mortonStorage(order.size());
+    std::vector<VolumeObject<CS350::Aabb>*> mortonObjects;
+    for (unsigned i = 0; i < order.size(); ++i) {
+        mortonStorage[i].id = i;
+        mortonStorage[i].bv = worldBvs[order[i]];
+        mortonObjects.push_back(&mortonStorage[i]);
+    }
+    MortonBvh mortonBvh;
+    mortonBvh.BuildTopDown(mortonObjects.begin(), mortonObjects.end(), cTopDownConfig);
+
+    for (int i = 0; i < 100; ++i) {
+        vec3 a = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        vec3 b = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+
+        mat4                  view = glm::lookAt(a, b * 0.1f, vec3(0, 1, 0));
+        mat4                  proj = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+        CS350::Frustum        frustum(proj * view);
+        std::vector<unsigned> visible = bvh.Query(frustum);
+        std::vector<unsigned> mortonVisible;
+        for (unsigned id : mortonBvh.Query(frustum)) {
+            mortonVisible.push_back(order[id]);
+        }
+        std::sort(visible.begin(), visible.end());
+        std::sort(mortonVisible.begin(), mortonVisible.end());
+        ASSERT_EQ(mortonVisible, visible);
+    }
+}
+
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloRefit) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+
+    Bvh bvh;
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+    int size = bvh.Size();
+
+    // Move every object, the structure must stay but volumes must follow
+    for (auto* object : bvhObjects) {
+        vec3 offset = vec3(CS170::Utils::Random(-5.0f, 5.0f), CS170::Utils::Random(-5.0f, 5.0f), CS170::Utils::Random(-5.0f, 5.0f));
+        object->bv  = CS350::Aabb(object->bv.min + offset, object->bv.max + offset);
+    }
+    bvh.Refit();
+    ASSERT_EQ(bvh.Size(), size);
+    AssertProperNodes(bvh);
+    AssertAllAccountedFor(bvh, bvhObjects);
+
+    bvh.TraverseLevelOrder([](BvhNode const* n) {
+        n->TraverseLevelOrderObjects([&](Object const* object) {
+            ASSERT_TRUE(n->bv.intersects(object->bv.min) && n->bv.intersects(object->bv.max)) << "Object outside of its node";
+        });
+    });
+
+    for (int i = 0; i < 100; ++i) {
+        vec3        center = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        CS350::Aabb query(center - vec3(20.0f), center + vec3(20.0f));
+
+        std::vector<unsigned> overlapBf;
+        for (auto* object : bvhObjects) {
+            if (object->bv.intersects(query)) {
+                overlapBf.push_back(object->id);
+            }
+        }
+        auto overlapBvh = bvh.Query(query);
+        std::sort(overlapBvh.begin(), overlapBvh.end());
+        ASSERT_EQ(overlapBvh, overlapBf);
+    }
+}
+
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloLayers) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+
+    // Layers follow the position so whole subtrees share them, every 7th object is also in layer 4
+    auto assignLayers = [&](unsigned shift) {
+        for (auto* object : bvhObjects) {
+            unsigned slab  = static_cast<unsigned>(object->bv.get_center().x + 1000.0f) / 50u;
+            object->layers = 1u << ((slab + shift) % 4u);
+            if (object->id % 7 == 0) {
+                object->layers |= 1u << 4;
+            }
+        }
+    };
+    auto assertLayers = [](Bvh const& tree) {
+        tree.TraverseLevelOrder([](BvhNode const* n) {
+            CS350::LayerMask layers = 0;
+            if (n->IsLeaf()) {
+                for (auto* object = n->firstObject; object != nullptr; object = object->bvhInfo.next) {
+                    layers |= object->layers;
+                }
+            } else {
+                layers = n->children[0]->layers | n->children[1]->layers;
+            }
+            ASSERT_EQ(n->layers, layers) << "Node layers are not the union of the layers below";
+        });
+    };
+
+    std::vector<CS350::QueryFilter> filters = {
+        {},                            // Everything
+        { 1u, 0u },                    // Single layer
+        { 1u | 2u, 0u },               // Any of two layers
+        { CS350::cAllLayers, 1u << 4 }, // All but a layer
+        { 1u << 4, 1u },               // Layer, except the ones also in another
+    };
+    auto accepted = [](CS350::QueryFilter const& filter, Object const* object) {
+        return filter.IsEmpty() || filter.Accepts(object->layers);
+    };
+    auto sorted = [](std::vector<unsigned> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+
+    auto assertQueries = [&](Bvh const& tree) {
+        for (int i = 0; i < 30; ++i) {
+            vec3 a = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+            vec3 b = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+
+            mat4           view = glm::lookAt(a, b * 0.1f, vec3(0, 1, 0));
+            mat4           proj = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+            CS350::Frustum frustum(proj * view);
+            CS350::Aabb    aabb(glm::min(a, b), glm::min(a, b) + vec3(40.0f));
+            CS350::Ray     ray(a * 2.0f, b - a * 2.0f);
+
+            for (auto const& filter : filters) {
+                std::vector<unsigned> visibleBf, overlapBf;
+                float                 closestBf = std::numeric_limits<float>::max();
+                for (auto* object : bvhObjects) {
+                    if (!accepted(filter, object)) {
+                        continue;
+                    }
+                    if (frustum.classify(object->bv) != CS350::SideResult::eOUTSIDE) {
+                        visibleBf.push_back(object->id);
+                    }
+                    if (object->bv.intersects(aabb)) {
+                        overlapBf.push_back(object->id);
+                    }
+                    float time = ray.intersect(object->bv);
+                    if (time >= 0.f) {
+                        closestBf = std::min(closestBf, time);
+                    }
+                }
+
+                ASSERT_EQ(sorted(tree.Query(frustum, filter)), sorted(visibleBf));
+                ASSERT_EQ(sorted(tree.Query(std::span<CS350::Plane const>(frustum.planes), filter)), sorted(visibleBf));
+                ASSERT_EQ(sorted(tree.Query(aabb, filter)), sorted(overlapBf));
+
+                auto closest = tree.Query(ray, filter);
+                ASSERT_EQ(closest.has_value(), closestBf != std::numeric_limits<float>::max());
+                if (closest) {
+                    ASSERT_TRUE(accepted(filter, bvhObjects[*closest]));
+                    ASSERT_EQ(ray.intersect(bvhObjects[*closest]->bv), closestBf);
+                }
+
+                std::optional<unsigned> closestBatch;
+                tree.QueryBatch(&ray, 1, &closestBatch, filter);
+                ASSERT_EQ(closestBatch, closest);
+
+                vec3                               point = bvhObjects[static_cast<size_t>(i)]->bv.get_center();
+                std::vector<std::vector<unsigned>> containing;
+                tree.QueryBatch(&point, 1, containing, filter);
+                ASSERT_EQ(sorted(containing[0]), sorted(tree.Query(CS350::Aabb(point, point), filter)));
+            }
+        }
+
+        // No object in the layer, not even the root is tested
+        CS350::Stats::Instance().Reset();
+        ASSERT_TRUE(tree.Query(CS350::Frustum(glm::perspective(glm::radians(50.0f), 1.0f, 0.01f, 1000.0f)), { 1u << 8, 0u }).empty());
+        ASSERT_EQ(CS350::Stats::Instance().frustumVsAabb, 0u);
+    };
+
+    // Build
+    assignLayers(0);
+    Bvh bvh;
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+    assertLayers(bvh);
+    assertQueries(bvh);
+
+    // Objects change layers
+    assignLayers(1);
+    bvh.Refit();
+    assertLayers(bvh);
+    assertQueries(bvh);
+
+    // Insertion
+    bvh.Clear();
+    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), cInsertConfig);
+    assertLayers(bvh);
+    assertQueries(bvh);
+
+    bvh.Clear();
+    bvh.InsertConcurrent(bvhObjects.begin(), bvhObjects.end(), cInsertConfig);
+    assertLayers(bvh);
+}
+
+TEST_F(BoundingVolumeHierarchy, TopDown_MirloPvs) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+
+    Bvh bvh;
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+
+    CS350::PvsBakeConfig config;
+    config.cells          = ivec3(4, 3, 4);
+    config.samplesPerCell = 4;
+    config.raysPerSample  = 128;
+    CS350::Pvs pvs        = CS350::BakePvs(bvh, config);
+    ASSERT_EQ(pvs.cellCount(), 48u);
+    ASSERT_EQ(pvs.objectCount(), bvhObjects.size());
+
+    // Compressed round trip
+    std::stringstream file;
+    pvs.Save(file);
+    size_t compressedSize = file.str().size();
+    ASSERT_EQ(CS350::Pvs::Load(file), pvs);
+    RecordProperty("PvsBytes", std::to_string(compressedSize));
+    RecordProperty("PvsUncompressedBytes", std::to_string(pvs.cellCount() * ((bvhObjects.size() + 7) / 8)));
+
+    size_t frustumCount = 0, pvsCount = 0;
+    for (int i = 0; i < 50; ++i) {
+        CS350::Aabb const& bounds         = pvs.bounds();
+        vec3               cameraPosition = vec3(CS170::Utils::Random(bounds.min.x, bounds.max.x), CS170::Utils::Random(bounds.min.y, bounds.max.y), CS170::Utils::Random(bounds.min.z, bounds.max.z));
+        vec3               cameraTarget   = vec3(CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f));
+        mat4               view           = glm::lookAt(cameraPosition, cameraTarget, vec3(0, 1, 0));
+        mat4               proj           = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+        CS350::Frustum     frustum(proj * view);
+
+        auto inFrustum = bvh.Query(frustum);
+        auto visible   = pvs.Cull(cameraPosition, inFrustum);
+        frustumCount += inFrustum.size();
+        pvsCount += visible.size();
+
+        // Subset in the same order
+        ASSERT_TRUE(std::includes(inFrustum.begin(), inFrustum.end(), visible.begin(), visible.end(), [&](unsigned lhs, unsigned rhs) {
+            return std::find(inFrustum.begin(), inFrustum.end(), lhs) < std::find(inFrustum.begin(), inFrustum.end(), rhs);
+        }));
+
+        // Objects around the camera are always kept
+        auto cell = pvs.CellIndex(cameraPosition);
+        ASSERT_TRUE(cell.has_value());
+        for (unsigned id : bvh.Query(CS350::Aabb(cameraPosition, cameraPosition))) {
+            ASSERT_TRUE(pvs.IsVisible(*cell, id));
+        }
+    }
+    RecordProperty("DrawnFrustum", std::to_string(frustumCount));
+    RecordProperty("DrawnFrustumAndPvs", std::to_string(pvsCount));
+    ASSERT_LT(pvsCount, frustumCount) << "The PVS should hide occluded objects";
+
+    // No information outside of the baked region
+    std::vector<unsigned> all{ 0, 1, 2 };
+    ASSERT_EQ(pvs.Cull(pvs.bounds().max + vec3(1.0f), all), all);
+
+    // Invalid files
+    std::string bytes = file.str();
+    std::stringstream truncated(bytes.substr(0, bytes.size() - 1));
+    ASSERT_THROW(CS350::Pvs::Load(truncated), std::runtime_error);
+    bytes[0] = 'X';
+    std::stringstream wrongMagic(bytes);
+    ASSERT_THROW(CS350::Pvs::Load(wrongMagic), std::runtime_error);
+}
+
+TEST_F(BoundingVolumeHierarchy, TopDown_RoomPvs) {
+    // Cameras inside a room box, a wall splitting half of it and pillars on the floor
+    std::vector<CS350::Aabb> bvs = {
+        CS350::Aabb(vec3(-40.0f, -1.0f, -40.0f), vec3(40.0f, 20.0f, 40.0f)), // Room
+        CS350::Aabb(vec3(-40.0f, -1.0f, -40.0f), vec3(40.0f, 0.0f, 40.0f)),  // Floor
+        CS350::Aabb(vec3(-1.0f, 0.0f, -40.0f), vec3(1.0f, 20.0f, 0.0f)),     // Wall
+    };
+    for (float x : { -30.0f, -10.0f, 10.0f, 30.0f }) {
+        for (float z : { -30.0f, -10.0f, 10.0f, 30.0f }) {
+            bvs.emplace_back(vec3(x - 2.0f, 0.0f, z - 2.0f), vec3(x + 2.0f, 4.0f, z + 2.0f));
+        }
+    }
+    auto bvhObjects = CreateObjects(bvs);
+    Bvh  bvh;
+    bvh.BuildTopDown(bvhObjects.begin(), bvhObjects.end(), cTopDownConfig);
+
+    CS350::PvsBakeConfig config;
+    config.bounds         = CS350::Aabb(vec3(-40.0f, 0.0f, -40.0f), vec3(40.0f, 20.0f, 40.0f));
+    config.cells          = ivec3(4, 1, 4);
+    config.samplesPerCell = 32;
+    config.raysPerSample  = 1024;
+    CS350::Pvs pvs        = CS350::BakePvs(bvh, config);
+
+    // Brute force rays from other points of every cell never reach a hidden object, the boxes
+    // around the origin (room and sometimes floor) do not block them. Cameras are never inside
+    // the wall or a pillar.
+    std::mt19937                          random(7);
+    std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+    size_t                                hidden = 0;
+    for (size_t cell = 0; cell < pvs.cellCount(); ++cell) {
+        CS350::Aabb cellBounds = pvs.CellBounds(cell);
+        hidden += bvhObjects.size() - pvs.VisibleCount(cell);
+        for (int sample = 0; sample < 8; ++sample) {
+            vec3 origin = cellBounds.min + (cellBounds.max - cellBounds.min) * vec3(unit(random), unit(random), unit(random));
+            if (std::any_of(bvhObjects.begin() + 2, bvhObjects.end(), [&](Object const* object) { return object->bv.intersects(origin); })) {
+                continue;
+            }
+            for (int r = 0; r < 256; ++r) {
+                float      cosTheta = 2.0f * unit(random) - 1.0f;
+                float      phi      = 2.0f * glm::pi<float>() * unit(random);
+                float      sinTheta = std::sqrt(std::max(0.0f, 1.0f - cosTheta * cosTheta));
+                CS350::Ray ray(origin, vec3(sinTheta * std::cos(phi), sinTheta * std::sin(phi), cosTheta));
+
+                std::optional<unsigned> closest;
+                float                   closestTime = std::numeric_limits<float>::max();
+                for (auto* object : bvhObjects) {
+                    float time = ray.intersect(object->bv);
+                    if (time > 0.0f && time < closestTime) {
+                        closestTime = time;
+                        closest     = object->id;
+                    }
+                }
+                if (closest) {
+                    ASSERT_TRUE(pvs.IsVisible(cell, *closest)) << "Cell " << cell << " hides object " << *closest << " seen from " << origin;
+                }
+            }
+        }
+    }
+    ASSERT_GT(hidden, 0u) << "The wall and pillars should hide something";
+}
+
+TEST_F(BoundingVolumeHierarchy, Split_MirloMotion) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+
+    CS350::SplitBvhConfig config;
+    ASSERT_EQ(config.staticConfig.splitPolicy, CS350::SplitPolicy::eSah);
+    config.staticConfig             = cTopDownConfig;
+    config.staticConfig.splitPolicy = CS350::SplitPolicy::eSah;
+    config.dynamicConfig            = cInsertConfig;
+    config.promoteUpdates           = 3;
+    config.promoteBatch             = 1;
+    CS350::SplitBvh<Object*> split(config);
+
+    // Half is known scenery, the rest starts dynamic and every 10th object keeps moving
+    for (auto* object : bvhObjects) {
+        split.Add(object, object->id % 2 == 0);
+    }
+    auto isMoving = [](Object const* object) { return object->id % 10 == 1; };
+
+    std::unordered_set<unsigned> removed;
+    auto                         sorted = [](std::vector<unsigned> ids) {
+        std::sort(ids.begin(), ids.end());
+        return ids;
+    };
+    auto assertQueries = [&]() {
+        for (int i = 0; i < 10; ++i) {
+            vec3 a = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+            vec3 b = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+
+            mat4           view = glm::lookAt(a, b * 0.1f, vec3(0, 1, 0));
+            mat4           proj = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+            CS350::Frustum frustum(proj * view);
+            CS350::Aabb    aabb(glm::min(a, b), glm::min(a, b) + vec3(40.0f));
+            CS350::Ray     ray(a * 2.0f, b - a * 2.0f);
+
+            std::vector<unsigned> visibleBf, overlapBf;
+            float                 closestBf = std::numeric_limits<float>::max();
+            for (auto* object : bvhObjects) {
+                if (removed.contains(object->id)) {
+                    continue;
+                }
+                if (frustum.classify(object->bv) != CS350::SideResult::eOUTSIDE) {
+                    visibleBf.push_back(object->id);
+                }
+                if (object->bv.intersects(aabb)) {
+                    overlapBf.push_back(object->id);
+                }
+                float time = ray.intersect(object->bv);
+                if (time >= 0.f) {
+                    closestBf = std::min(closestBf, time);
+                }
+            }
+
+            ASSERT_EQ(sorted(split.Query(frustum)), visibleBf);
+            auto nearToFar = split.QueryOrdered(frustum, a);
+            ASSERT_EQ(sorted(nearToFar), visibleBf);
+            ASSERT_TRUE(std::is_sorted(nearToFar.begin(), nearToFar.end(), [&](unsigned lhs, unsigned rhs) {
+                return bvhObjects[lhs]->bv.squared_distance(a) < bvhObjects[rhs]->bv.squared_distance(a);
+            }));
+            ASSERT_EQ(sorted(split.Query(std::span<CS350::Plane const>(frustum.planes))), visibleBf);
+            ASSERT_EQ(sorted(split.Query(aabb)), overlapBf);
+
+            auto closest = split.Query(ray);
+            ASSERT_EQ(closest.has_value(), closestBf != std::numeric_limits<float>::max());
+            if (closest) {
+                ASSERT_EQ(ray.intersect(bvhObjects[*closest]->bv), closestBf);
+            }
+            std::optional<unsigned> closestBatch;
+            split.QueryBatch(&ray, 1, &closestBatch);
+            ASSERT_EQ(closestBatch, closest);
+        }
+    };
+
+    for (int update = 0; update < 6; ++update) {
+        split.Update();
+        assertQueries();
+        for (auto* object : bvhObjects) {
+            if (isMoving(object)) {
+                object->bv = CS350::Aabb(object->bv.min + vec3(2.0f, 0.0f, 0.0f), object->bv.max + vec3(2.0f, 0.0f, 0.0f));
+            }
+        }
+    }
+
+    // Objects that never moved ended in the static tree, the moving ones in the dynamic tree
+    split.Update();
+    assertQueries();
+    auto staticIds  = BvhFlatMap(split.staticTree().root());
+    auto dynamicIds = BvhFlatMap(split.dynamicTree().root());
+    ASSERT_EQ(staticIds.size() + dynamicIds.size(), bvhObjects.size());
+    for (unsigned id : dynamicIds) {
+        ASSERT_TRUE(isMoving(bvhObjects[id])) << "Object " << id << " does not move but is still dynamic";
+    }
+    for (unsigned id : staticIds) {
+        ASSERT_FALSE(isMoving(bvhObjects[id])) << "Object " << id << " moves but is static";
+    }
+
+    // The static tree is cheaper than a median split of the same objects, copies so they keep their tree
+    std::vector<Object>  medianObjects(staticIds.size());
+    std::vector<Object*> medianPointers;
+    for (size_t i = 0; i < staticIds.size(); ++i) {
+        medianObjects[i].id = staticIds[i];
+        medianObjects[i].bv = bvhObjects[staticIds[i]]->bv;
+        medianPointers.push_back(&medianObjects[i]);
+    }
+    Bvh median;
+    median.BuildTopDown(medianPointers.begin(), medianPointers.end(), cTopDownConfig);
+    float sahCost    = split.staticTree().SurfaceAreaCost();
+    float medianCost = median.SurfaceAreaCost();
+    AssertProperNodes(split.staticTree());
+    RecordProperty("StaticSahCost", std::to_string(sahCost));
+    RecordProperty("StaticMedianCost", std::to_string(medianCost));
+    ASSERT_LT(sahCost, medianCost);
+
+    // Dynamic motion alone never touches the static tree
+    unsigned staticRebuilds = split.staticRebuilds();
+    for (auto* object : bvhObjects) {
+        if (isMoving(object)) {
+            object->bv = CS350::Aabb(object->bv.min + vec3(2.0f, 0.0f, 0.0f), object->bv.max + vec3(2.0f, 0.0f, 0.0f));
+        }
+    }
+    split.Update();
+    assertQueries();
+    ASSERT_EQ(split.staticRebuilds(), staticRebuilds);
+
+    // A static object that moves is demoted, removed objects are not found anymore
+    Object* demoted = bvhObjects[static_cast<size_t>(staticIds.front())];
+    demoted->bv     = CS350::Aabb(demoted->bv.min + vec3(0.0f, 5.0f, 0.0f), demoted->bv.max + vec3(0.0f, 5.0f, 0.0f));
+    split.Remove(bvhObjects[static_cast<size_t>(staticIds.back())]);
+    split.Remove(bvhObjects[static_cast<size_t>(dynamicIds.front())]);
+    removed.insert(staticIds.back());
+    removed.insert(dynamicIds.front());
+    split.Update();
+    assertQueries();
+    auto newDynamicIds = BvhFlatMap(split.dynamicTree().root());
+    ASSERT_TRUE(std::find(newDynamicIds.begin(), newDynamicIds.end(), demoted->id) != newDynamicIds.end());
+    ASSERT_EQ(split.staticTree().objectCount() + split.dynamicTree().objectCount(), bvhObjects.size() - removed.size());
+}
+
+TEST_F(BoundingVolumeHierarchy, Loader_MirloDeduplicated) {
+    // Every file on its own
+    std::vector<CS350::CS350PrimitiveData> files;
+    for (auto path = fmt::format(cAssetPath, 0); std::filesystem::exists(path); path = fmt::format(cAssetPath, files.size())) {
+        files.push_back(CS350::LoadCS350Binary(path));
+    }
+
+    std::vector<int>      fileToPrimitive;
+    CS350::CS350LoadStats stats;
+    auto                  primitives = CS350::LoadCS350Primitives(cAssetPath, fileToPrimitive, &stats);
+    ASSERT_EQ(fileToPrimitive.size(), files.size());
+    ASSERT_EQ(stats.files, files.size());
+    ASSERT_EQ(stats.primitives, primitives.size());
+    ASSERT_LT(primitives.size(), files.size()) << "The mirlo set repeats meshes under different names";
+    ASSERT_GT(stats.loadMs, 0.0);
+
+    // Each file maps to a primitive with its exact content, only duplicated files are shared
+    size_t bytesLoaded = 0, bytesSaved = 0;
+    for (size_t f = 0; f < files.size(); ++f) {
+        auto const& primitive = primitives.at(static_cast<size_t>(fileToPrimitive[f]));
+        ASSERT_EQ(primitive.positions, files[f].positions) << f;
+        ASSERT_EQ(primitive.bvMin, files[f].bvMin) << f;
+        ASSERT_EQ(primitive.bvMax, files[f].bvMax) << f;
+        ASSERT_EQ(CS350::HashCS350Primitive(primitive), CS350::HashCS350Primitive(files[f])) << f;
+
+        size_t bytes = files[f].positions.size() * sizeof(vec3);
+        bytesLoaded += bytes;
+        bool duplicate = false;
+        for (size_t other = 0; other < f; ++other) {
+            duplicate = duplicate || files[other].positions == files[f].positions;
+        }
+        auto previous = fileToPrimitive.begin() + static_cast<std::ptrdiff_t>(f);
+        ASSERT_EQ(duplicate, std::find(fileToPrimitive.begin(), previous, fileToPrimitive[f]) != previous) << f;
+        bytesSaved += duplicate ? bytes : 0;
+    }
+    ASSERT_EQ(stats.bytesLoaded, bytesLoaded);
+    ASSERT_EQ(stats.bytesSaved, bytesSaved);
+
+    // Any change of the content changes the hash
+    CS350::CS350PrimitiveData changed = files[0];
+    changed.positions.back().x += 1.0f;
+    ASSERT_NE(CS350::HashCS350Primitive(changed), CS350::HashCS350Primitive(files[0]));
+    ASSERT_FALSE(CS350::SameCS350Primitive(changed, files[0]));
+    ASSERT_TRUE(CS350::SameCS350Primitive(files[0], files[0]));
+
+    // Same vertices quantized against other bounds are another mesh, so are the same steps
+    CS350::CS350PrimitiveData quantized = files[0];
+    CS350::QuantizeCS350Positions(quantized);
+    CS350::CS350PrimitiveData widened = files[0];
+    widened.bvMax += vec3(1.0f);
+    ASSERT_FALSE(CS350::SameCS350Primitive(widened, files[0]));
+    ASSERT_NE(CS350::HashCS350Primitive(widened), CS350::HashCS350Primitive(files[0]));
+    CS350::QuantizeCS350Positions(widened);
+    ASSERT_NE(widened.quantizedPositions, quantized.quantizedPositions);
+    ASSERT_FALSE(CS350::SameCS350Primitive(widened, quantized));
+    widened.quantizedPositions = quantized.quantizedPositions;
+    ASSERT_FALSE(CS350::SameCS350Primitive(widened, quantized));
+    ASSERT_NE(CS350::HashCS350Primitive(widened), CS350::HashCS350Primitive(quantized));
+
+    // Remapped scenes keep the same world bounds
+    std::vector<CS350::CS350SceneObject> objects = CS350::LoadCS350Scene(cSceneNormal);
+    std::vector<CS350::CS350SceneObject> remapped = objects;
+    CS350::RemapCS350Scene(remapped, fileToPrimitive);
+    for (size_t i = 0; i < objects.size(); ++i) {
+        auto const& file      = files.at(static_cast<size_t>(objects[i].primitiveIndex));
+        auto const& primitive = primitives.at(static_cast<size_t>(remapped[i].primitiveIndex));
+        ASSERT_EQ(CS350::Aabb(file.bvMin, file.bvMax).transform(objects[i].m2w).min, CS350::Aabb(primitive.bvMin, primitive.bvMax).transform(remapped[i].m2w).min) << i;
+    }
+    remapped[0].primitiveIndex = static_cast<int>(files.size());
+    ASSERT_THROW(CS350::RemapCS350Scene(remapped, fileToPrimitive), std::runtime_error);
+}
+
+TEST_F(BoundingVolumeHierarchy, Loader_MirloWelded) {
+    // Mirlo meshes and the dragon, the only one large enough for the parallel path
+    std::vector<std::string> paths = { "assets/cs350/dragon.cs350_binary" };
+    for (auto path = fmt::format(cAssetPath, 0); std::filesystem::exists(path); path = fmt::format(cAssetPath, paths.size() - 1)) {
+        paths.push_back(path);
+    }
+
+    for (auto const& path : paths) {
+        CS350::CS350PrimitiveData original = CS350::LoadCS350Binary(path);
+        ASSERT_TRUE(original.polygons.empty()) << path;
+
+        CS350::CS350PrimitiveData serial   = original;
+        CS350::CS350PrimitiveData parallel = original;
+        CS350::CS350WeldStats     stats    = CS350::WeldCS350Primitive(serial, 1);
+        CS350::WeldCS350Primitive(parallel, 4);
+        ASSERT_EQ(serial.positions, parallel.positions) << path;
+        ASSERT_EQ(serial.polygons, parallel.polygons) << path;
+
+        ASSERT_EQ(stats.corners, original.positions.size()) << path;
+        ASSERT_EQ(stats.vertices, serial.positions.size()) << path;
+        ASSERT_LT(stats.vertices, stats.corners) << path;
+        ASSERT_LT(stats.bytesAfter, stats.bytesBefore) << path;
+        ASSERT_EQ(serial.bvMin, original.bvMin) << path;
+        ASSERT_EQ(serial.bvMax, original.bvMax) << path;
+
+        // Same triangles corner by corner, every vertex used and first used in storage order
+        ASSERT_EQ(serial.polygons.size() * 3, original.positions.size()) << path;
+        int nextVertex = 0;
+        for (size_t face = 0; face < serial.polygons.size(); ++face) {
+            for (size_t corner = 0; corner < 3; ++corner) {
+                int vertex = serial.polygons[face][corner];
+                ASSERT_LE(vertex, nextVertex) << path << " " << face;
+                nextVertex = std::max(nextVertex, vertex + 1);
+                ASSERT_EQ(serial.positions.at(static_cast<size_t>(vertex)), original.positions[face * 3 + corner]) << path << " " << face;
+            }
+        }
+        ASSERT_EQ(static_cast<size_t>(nextVertex), serial.positions.size()) << path;
+
+        // No two vertices left with the same position
+        std::vector<vec3> sorted = serial.positions;
+        auto              less   = [](vec3 const& a, vec3 const& b) {
+            return a.x != b.x ? a.x < b.x : (a.y != b.y ? a.y < b.y : a.z < b.z);
+        };
+        std::sort(sorted.begin(), sorted.end(), less);
+        ASSERT_EQ(std::adjacent_find(sorted.begin(), sorted.end()), sorted.end()) << path;
+
+        // Welding again does nothing
+        CS350::CS350WeldStats again = CS350::WeldCS350Primitive(serial);
+        ASSERT_EQ(again.vertices, serial.positions.size()) << path;
+        ASSERT_EQ(again.bytesAfter, again.bytesBefore) << path;
+    }
+
+    // Loose corners are not triangles
+    CS350::CS350PrimitiveData loose;
+    loose.positions = { vec3(0), vec3(1), vec3(2), vec3(3) };
+    ASSERT_THROW(CS350::WeldCS350Primitive(loose), std::runtime_error);
+}
+
+TEST_F(BoundingVolumeHierarchy, Loader_MirloQuantized) {
+    std::vector<std::string> paths = { "assets/cs350/dragon.cs350_binary", "assets/cs350/bunny-dense.cs350_binary" };
+    for (auto path = fmt::format(cAssetPath, 0); std::filesystem::exists(path); path = fmt::format(cAssetPath, paths.size() - 2)) {
+        paths.push_back(path);
+    }
+
+    for (auto const& path : paths) {
+        CS350::CS350PrimitiveData original = CS350::LoadCS350Binary(path);
+        CS350::CS350PrimitiveData mesh     = original;
+        CS350::WeldCS350Primitive(mesh);
+        std::vector<vec3> welded = mesh.positions;
+        CS350::QuantizeCS350Positions(mesh);
+        ASSERT_TRUE(mesh.positions.empty()) << path;
+        ASSERT_EQ(mesh.quantizedPositions.size(), welded.size()) << path;
+        ASSERT_EQ(mesh.polygons.size() * 3, original.positions.size()) << path;
+        ASSERT_NE(CS350::HashCS350Primitive(mesh), CS350::HashCS350Primitive(original)) << path;
+
+        // Every position within the guaranteed error, SIMD dequantization as the scalar formula
+        CS350::PositionQuantization quantization(mesh.bvMin, mesh.bvMax);
+        vec3                        bound     = quantization.error();
+        vec3                        step      = (mesh.bvMax - mesh.bvMin) / CS350::cQuantizationSteps;
+        std::vector<vec3>           positions = CS350::CS350Positions(mesh);
+        ASSERT_EQ(positions.size(), welded.size()) << path;
+        ASSERT_EQ(quantization.stepSize(), step) << path;
+        for (int axis = 0; axis < 3; ++axis) {
+            ASSERT_LT(bound[axis], step[axis] * 0.6f) << path << " axis " << axis;
+        }
+        float largestError = 0.0f;
+        for (size_t i = 0; i < welded.size(); ++i) {
+            auto const& steps = mesh.quantizedPositions[i];
+            for (int axis = 0; axis < 3; ++axis) {
+                float scaled   = static_cast<float>(steps[static_cast<size_t>(axis)]) * step[axis];
+                float expected = mesh.bvMin[axis] + scaled;
+                ASSERT_EQ(positions[i][axis], expected) << path << " " << i;
+
+                float error = std::abs(positions[i][axis] - welded[i][axis]);
+                ASSERT_LE(error, bound[axis]) << path << " " << i << " axis " << axis;
+                largestError = std::max(largestError, error / bound[axis]);
+            }
+            ASSERT_EQ(quantization.quantize(positions[i]), steps) << path << " " << i;
+        }
+        ASSERT_GT(largestError, 0.5f) << path << ": the bound should not be far from the real error";
+
+        // Triangles keep their corners within the bound
+        for (size_t face = 0; face < mesh.polygons.size(); ++face) {
+            for (size_t corner = 0; corner < 3; ++corner) {
+                vec3 const& from = original.positions[face * 3 + corner];
+                vec3 const& to   = positions.at(static_cast<size_t>(mesh.polygons[face][corner]));
+                for (int axis = 0; axis < 3; ++axis) {
+                    ASSERT_LE(std::abs(to[axis] - from[axis]), bound[axis]) << path << " " << face;
+                }
+            }
+        }
+
+        // Quantizing again does nothing
+        auto steps = mesh.quantizedPositions;
+        CS350::QuantizeCS350Positions(mesh);
+        ASSERT_EQ(mesh.quantizedPositions, steps) << path;
+    }
+
+    // Flat axes have no steps and no error
+    CS350::PositionQuantization flat(vec3(-1.0f, 2.0f, 0.0f), vec3(1.0f, 2.0f, 0.0f));
+    ASSERT_EQ(flat.dequantize(flat.quantize(vec3(0.5f, 2.0f, 0.0f))).y, 2.0f);
+    ASSERT_EQ(flat.quantize(vec3(-1.0f, 2.0f, 0.0f)), (CS350::QuantizedPosition{ 0, 0, 0 }));
+    ASSERT_EQ(flat.quantize(vec3(1.0f, 2.0f, 0.0f)), (CS350::QuantizedPosition{ 65535, 0, 0 }));
+}
+
+TEST_F(BoundingVolumeHierarchy, Transform_MirloCompact) {
+    CS170::Utils::srand(7, 7);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+
+    // Scene transforms, plus random ones with rotations about any axis and mirrored ones
+    std::vector<mat4> transforms;
+    for (auto const& object : objects) {
+        transforms.push_back(object.m2w.matrix());
+    }
+    for (int i = 0; i < 1000; ++i) {
+        vec3 translation(CS170::Utils::Random(-500.0f, 500.0f), CS170::Utils::Random(-500.0f, 500.0f), CS170::Utils::Random(-500.0f, 500.0f));
+        vec3 axis(CS170::Utils::Random(-1.0f, 1.0f), CS170::Utils::Random(-1.0f, 1.0f), CS170::Utils::Random(0.1f, 1.0f));
+        vec3 scale(CS170::Utils::Random(0.01f, 100.0f), CS170::Utils::Random(0.01f, 100.0f), CS170::Utils::Random(0.01f, 100.0f));
+        if (i % 2 == 1) {
+            scale.y = -scale.y;
+        }
+        transforms.push_back(glm::translate(translation) * glm::rotate(CS170::Utils::Random(-3.0f, 3.0f), axis) * glm::scale(scale));
+    }
+    // Flattened ones, zero and denormal scales decode to an exact zero
+    size_t firstFlat = transforms.size();
+    for (int i = 0; i < 200; ++i) {
+        vec3 axis(CS170::Utils::Random(-1.0f, 1.0f), CS170::Utils::Random(-1.0f, 1.0f), CS170::Utils::Random(0.1f, 1.0f));
+        vec3 scale(CS170::Utils::Random(0.01f, 100.0f), CS170::Utils::Random(0.01f, 100.0f), CS170::Utils::Random(0.01f, 100.0f));
+        int  flat = i % 3;
+        switch (i % 4) {
+            case 0: scale[flat] = 0.0f; break;
+            case 1: scale[flat] = 1e-40f; break;
+            case 2:
+                scale[(flat + 1) % 3] = 0.0f;
+                scale[(flat + 2) % 3] = 0.0f;
+                break;
+            default: scale = vec3(0.0f); break;
+        }
+        transforms.push_back(glm::translate(vec3(static_cast<float>(i))) * glm::rotate(CS170::Utils::Random(-3.0f, 3.0f), axis) * glm::scale(scale));
+    }
+
+    for (size_t i = 0; i < transforms.size(); ++i) {
+        mat4 const&   m2w = transforms[i];
+        CS350::Affine affine(m2w);
+        std::string   trace = fmt::format("transform {}", i);
+
+        // Exact round trip
+        ASSERT_EQ(affine.matrix(), m2w) << trace.c_str();
+        ASSERT_EQ(affine.translation(), vec3(m2w[3])) << trace.c_str();
+
+        // Same bounds through both paths, exactly those of the transformed corners
+        auto const& primitive = allPrimitives.at(i % allPrimitives.size());
+        CS350::Aabb local(primitive.bvMin, primitive.bvMax);
+        CS350::Aabb world = local.transform(affine);
+        ASSERT_EQ(world.min, local.transform(m2w).min) << trace.c_str();
+        ASSERT_EQ(world.max, local.transform(m2w).max) << trace.c_str();
+        vec3 cornerMin(std::numeric_limits<float>::max()), cornerMax(-std::numeric_limits<float>::max());
+        for (int corner = 0; corner < 8; ++corner) {
+            vec3 point((corner & 1) ? local.max.x : local.min.x, (corner & 2) ? local.max.y : local.min.y, (corner & 4) ? local.max.z : local.min.z);
+            vec3 transformed = affine.transform_point(point);
+            cornerMin        = glm::min(cornerMin, transformed);
+            cornerMax        = glm::max(cornerMax, transformed);
+            ASSERT_LT(glm::distance(transformed, vec3(m2w * vec4(point, 1.0f))), 1e-3f * (1.0f + glm::length(transformed))) << trace.c_str();
+        }
+        ASSERT_EQ(world.min, cornerMin) << trace.c_str();
+        ASSERT_EQ(world.max, cornerMax) << trace.c_str();
+
+        // Quantized: exact translation, linear part within the bound, mirroring kept
+        CS350::QuantizedTrs quantized(affine);
+        CS350::Affine       decoded  = quantized.affine();
+        float               maxScale = std::max({ glm::length(vec3(m2w[0])), glm::length(vec3(m2w[1])), glm::length(vec3(m2w[2])) });
+        ASSERT_EQ(decoded.translation(), affine.translation()) << trace.c_str();
+        for (int row = 0; row < 3; ++row) {
+            for (int column = 0; column < 3; ++column) {
+                ASSERT_NEAR(decoded.rows[row][column], affine.rows[row][column], CS350::cQuantizedTrsError * maxScale) << trace.c_str();
+            }
+        }
+        mat3 linear(m2w), decodedLinear(decoded.matrix());
+        ASSERT_EQ(glm::dot(glm::cross(linear[0], linear[1]), linear[2]) < 0.0f, glm::dot(glm::cross(decodedLinear[0], decodedLinear[1]), decodedLinear[2]) < 0.0f) << trace.c_str();
+        for (int column = 0; i >= firstFlat && column < 3; ++column) {
+            if (glm::length(linear[column]) < std::numeric_limits<float>::min()) {
+                ASSERT_EQ(decodedLinear[column], vec3(0.0f)) << trace.c_str();
+            }
+        }
+    }
+}
+
+TEST_F(BoundingVolumeHierarchy, Insert_MirloRandom) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+
+    Bvh bvh;
+    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), cInsertConfig);
+    PrintDebugInformation(bvh);
+    AssertProperNodes(bvh);
+    AssertAllAccountedFor(bvh, bvhObjects);
+    TestSceneAtRandomPositions(bvhObjects, bvh);
+}
+
+TEST_F(BoundingVolumeHierarchy, Insert_MirloCompletelyInside) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+    shuffle(bvhObjects);
+
+    Bvh bvh;
+    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), cInsertConfig);
+    PrintDebugInformation(bvh);
+    AssertProperNodes(bvh);
+    AssertAllAccountedFor(bvh, bvhObjects);
+
+    vec3 max = bvh.root()->bv.max;
+    vec3 min = bvh.root()->bv.min;
+
+    // Place a camera outside the root, looking in an opposite direction
+    vec3 cameraPosition = vec3(max.x + (max.x - min.x) * 2, 0, 0);
+    vec3 cameraTarget   = vec3(0, 0, 0);
+    vec3 cameraUp       = vec3(0, 1, 0);
+    mat4 view           = glm::lookAt(cameraPosition, cameraTarget, cameraUp);
+    mat4 proj           = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, (max.x - min.x) * 5);
+    mat4 viewProj       = proj * view;
+    auto visible        = bvh.Query(CS350::Frustum(viewProj));
+    ASSERT_EQ(visible.size(), objects.size()) << "All objects should be visible from this point";
+    ASSERT_EQ(CS350::Stats::Instance().frustumVsAabb, 1u) << "Only root should have been tested";
+}
+
+TEST_F(BoundingVolumeHierarchy, Insert_SingleAabb) {
+    // Scene BVs
+    std::vector<CS350::Aabb> bvs        = { CS350::Aabb{ { 0, 0, 0 }, { 1, 1, 1 } } };
+    auto                     bvhObjects = CreateObjects(bvs);
+
+    // BVH
+    Bvh bvh;
+    for (unsigned i = 0; i < bvs.size(); ++i) {
+        bvh.Insert(bvhObjects[i], cInsertConfig);
+        AssertProperNodes(bvh);
+        AssertAllAccountedFor(bvh, bvhObjects);
+    }
+    PrintDebugInformation(bvh);
+
+    //
+    ASSERT_NEAR(bvh.root()->bv, bvs[0], cTestEpsilon);
+}
+
+TEST_F(BoundingVolumeHierarchy, Insert_PairAabb) {
+    // Scene BVs
+    std::vector<CS350::Aabb> bvs = {
+        CS350::Aabb{ { 0, 0, 0 }, { 1, 1, 1 } },
+        CS350::Aabb{ { 1, 0, 0 }, { 2, 1, 1 } },
+    };
+    auto bvhObjects = CreateObjects(bvs);
+
+    // BVH
+    Bvh bvh;
+    for (unsigned i = 0; i < bvhObjects.size(); ++i) {
+        bvh.Insert(bvhObjects[i], cInsertConfig);
+        AssertProperNodes(bvh);
+    }
+    AssertAllAccountedFor(bvh, bvhObjects);
+    PrintDebugInformation(bvh);
+    auto bvh_objects = BvhFlatMap(bvh.root());
+
+    //
+    CS350::Aabb full = { { 0, 0, 0 }, { 2, 1, 1 } }; // Full scene Aabb
+    ASSERT_NEAR(bvh.root()->bv, full, cTestEpsilon); // Should match
+}
+
+TEST_F(BoundingVolumeHierarchy, Insert_ClearCheck) {
+    // Scene BVs
+    std::vector<CS350::Aabb> bvs        = { CS350::Aabb{ { 0, 0, 0 }, { 1, 1, 1 } } };
+    auto                     bvhObjects = CreateObjects(bvs);
+
+    // BVH
+    Bvh bvh;
+    for (unsigned i = 0; i < bvhObjects.size(); ++i) {
+        bvh.Insert(bvhObjects[i], cInsertConfig);
+        AssertProperNodes(bvh);
+    }
+    AssertAllAccountedFor(bvh, bvhObjects);
+    PrintDebugInformation(bvh);
+    bvh.Clear();
+
+    //
+    ASSERT_EQ(bvh.Depth(), -1);
+    ASSERT_EQ(bvh.Size(), 0);
+    ASSERT_EQ(bvh.root(), nullptr);
+}
+
+TEST_F(BoundingVolumeHierarchy, Insert_CornerCase) {
+    // Scene BVs
+    std::vector<CS350::Aabb> bvs(500, CS350::Aabb{ { 0, 0, 0 }, { 1, 1, 1 } });
+    auto                     bvhObjects = CreateObjects(bvs);
+    shuffle(bvhObjects);
+
+    // BVH
+    Bvh bvh;
+    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), cInsertConfig);
+    PrintDebugInformation(bvh);
+    AssertProperNodes(bvh);
+    AssertAllAccountedFor(bvh, bvhObjects);
+    ASSERT_EQ(bvh.Depth(), 0u);
+    ASSERT_EQ(bvh.Size(), 1u);
+    bvh.Clear();
+
+    //
+    ASSERT_EQ(bvh.Depth(), -1);
+    ASSERT_EQ(bvh.Size(), 0);
+    ASSERT_EQ(bvh.root(), nullptr);
+}
+
+TEST_F(BoundingVolumeHierarchy, Insert_Manual01) {
+    // Scene BVs
+    std::vector<CS350::Aabb> bvs = {
+        CS350::Aabb{ { 1, 3, 0 }, { 3, 5, 1 } },  // 0
+        CS350::Aabb{ { 4, 1, 0 }, { 6, 7, 1 } },  // 1
+        CS350::Aabb{ { 6, 6, 0 }, { 7, 7, 1 } },  // 2
+        CS350::Aabb{ { 6, 5, 0 }, { 7, 6, 1 } },  // 3
+        CS350::Aabb{ { 6, 4, 0 }, { 7, 5, 1 } },  // 4
+        CS350::Aabb{ { 6, 3, 0 }, { 7, 4, 1 } },  // 5
+        CS350::Aabb{ { 6, 2, 0 }, { 7, 3, 1 } },  // 6
+        CS350::Aabb{ { 6, 1, 0 }, { 7, 2, 1 } },  // 7
+        CS350::Aabb{ { 8, 3, 0 }, { 9, 5, 1 } },  // 8
+        CS350::Aabb{ { 9, 3, 0 }, { 10, 5, 1 } }, // 9
+    };
+    auto bvhObjects = CreateObjects(bvs);
+    shuffle(bvhObjects);
+
+    // Override config
+    const CS350::BvhBuildConfig cInsertConfig = {
+        100,       // max_depth
+        1,         // min_objects
+        1 * 1 * 1, // min_volume
+    };
+
+    // BVH
+    Bvh bvh;
+    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), cInsertConfig);
+    PrintDebugInformation(bvh);
+    AssertProperNodes(bvh);
+    AssertAllAccountedFor(bvh, bvhObjects);
+
+    // Testing
+    auto createRay = [](vec2 from, vec2 to) {
+        vec3 st  = vec3(from.x, from.y, 0.5f); // 0.5f so that we are in the same plane as AABBs volumes
+        vec3 end = vec3(to.x, to.y, 0.5f);
+        vec3 dir = end - st;
+        return CS350::Ray(st, dir);
+    };
+
+    // Some rays manually
+    std::vector<unsigned>       allIntersectedObjects;
+    std::vector<BvhNode const*> allIntersectedNodes;
     ASSERT_EQ(bvh.QueryDebug(createRay({ 0, 0 }, { 2, 4 }), true, allIntersectedObjects, allIntersectedNodes), 0u);
     ASSERT_EQ(bvh.QueryDebug(createRay({ 1, 1 }, { 2, 4 }), true, allIntersectedObjects, allIntersectedNodes), 0u);
     ASSERT_EQ(bvh.QueryDebug(createRay({ 5, 0 }, { 5, 1 }), true, allIntersectedObjects, allIntersectedNodes), 1u);
@@ -989,3 +2689,110 @@ TEST_F(BoundingVolumeHierarchy, Insert_MirloRandomRays) {
     AssertAllAccountedFor(bvh, bvhObjects);
     TestSceneRandomRays(bvhObjects, bvh, 100, true);
 }
+
+TEST_F(BoundingVolumeHierarchy, Insert_MirloSurfaceArea) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+
+    // A floor of flat tiles on top of the scene, they have no volume at all
+    for (int x = 0; x < 30; ++x) {
+        for (int z = 0; z < 30; ++z) {
+            vec3 corner(-150.0f + static_cast<float>(x) * 10.0f, -60.0f, -150.0f + static_cast<float>(z) * 10.0f);
+            worldBvs.emplace_back(corner, corner + vec3(10.0f, 0.0f, 10.0f));
+        }
+    }
+    auto bvhObjects = CreateObjects(worldBvs);
+    shuffle(bvhObjects);
+
+    CS350::BvhBuildConfig config = cInsertConfig;
+    Bvh                   bvh;
+    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), config);
+    float volumeCost  = bvh.SurfaceAreaCost();
+    int   volumeDepth = bvh.Depth();
+    bvh.Clear();
+
+    config.insertPolicy = CS350::InsertPolicy::eSurfaceArea;
+    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), config);
+    PrintDebugInformation(bvh);
+    AssertProperNodes(bvh);
+    AssertAllAccountedFor(bvh, bvhObjects);
+    TestSceneRandomRays(bvhObjects, bvh, 100, true);
+
+    // The floor no longer grows a long chain of nodes, the tree is better overall
+    float surfaceAreaCost = bvh.SurfaceAreaCost();
+    ASSERT_LT(surfaceAreaCost, volumeCost * 0.8f) << fmt::format("{} vs {}", surfaceAreaCost, volumeCost).c_str();
+    ASSERT_LT(bvh.Depth() * 4, volumeDepth);
+    bvh.TraverseLevelOrder([](BvhNode const* node) {
+        if (node->IsLeaf()) {
+            ASSERT_EQ(node->ObjectCount(), 1u);
+        }
+    });
+
+    // Leaves with room are filled first
+    bvh.Clear();
+    config.minObjects = 4;
+    bvh.Insert(bvhObjects.begin(), bvhObjects.end(), config);
+    AssertProperNodes(bvh);
+    AssertAllAccountedFor(bvh, bvhObjects);
+    unsigned leaves = 0;
+    bvh.TraverseLevelOrder([&](BvhNode const* node) { leaves += node->IsLeaf() ? 1u : 0u; });
+    ASSERT_LT(leaves, bvhObjects.size());
+}
+
+TEST_F(BoundingVolumeHierarchy, Insert_MirloConcurrent) {
+    CS170::Utils::srand(5, 5);
+    std::vector<CS350::CS350PrimitiveData> allPrimitives;
+    std::vector<CS350::CS350SceneObject>   objects;
+    std::vector<CS350::Aabb>               worldBvs;
+    LoadPrimitivesAndScene(allPrimitives, objects, worldBvs, cSceneNormal);
+    auto bvhObjects = CreateObjects(worldBvs);
+
+    // Several rounds, the interleaving differs every time
+    for (unsigned threadCount : { 2u, 4u, 8u, 16u }) {
+        shuffle(bvhObjects);
+        for (auto* object : bvhObjects) {
+            object->bvhInfo = {};
+        }
+
+        Bvh                      bvh;
+        std::vector<std::thread> threads;
+        for (unsigned t = 0; t < threadCount; ++t) {
+            threads.emplace_back([&, t]() {
+                for (size_t i = t; i < bvhObjects.size(); i += threadCount) {
+                    bvh.InsertConcurrent(bvhObjects[i], cInsertConfig);
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+
+        ASSERT_EQ(bvh.objectCount(), bvhObjects.size());
+        AssertProperNodes(bvh);
+        AssertAllAccountedFor(bvh, bvhObjects);
+        bvh.TraverseLevelOrder([](BvhNode const* n) {
+            n->TraverseLevelOrderObjects([&](Object const* object) {
+                ASSERT_TRUE(n->bv.intersects(object->bv.min) && n->bv.intersects(object->bv.max)) << "Object outside of its node";
+            });
+        });
+
+        for (int i = 0; i < 20; ++i) {
+            vec3        center = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+            CS350::Aabb query(center - vec3(30.0f), center + vec3(30.0f));
+
+            std::vector<unsigned> overlapBf;
+            for (auto* object : bvhObjects) {
+                if (object->bv.intersects(query)) {
+                    overlapBf.push_back(object->id);
+                }
+            }
+            std::sort(overlapBf.begin(), overlapBf.end());
+            auto overlapBvh = bvh.Query(query);
+            std::sort(overlapBvh.begin(), overlapBvh.end());
+            ASSERT_EQ(overlapBvh, overlapBf) << fmt::format("{} threads", threadCount).c_str();
+        }
+    }
+}
@@ -0,0 +1,72 @@
+#include "common.hpp"        // Test utilities
+#include "query_service.hpp" // Query service protocol
+
+#include <gtest/gtest.h>
+#include <limits>
+#include <vector>
+
+namespace {
+    using namespace CS350::QueryService;
+
+    // One query of each kind
+    BatchWriter ExampleBatch(CS350::Frustum& frustum, CS350::Ray& ray, CS350::Aabb& aabb) {
+        std::array<vec3, 6>  normals = { vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1) };
+        std::array<float, 6> dists   = { -10.0f, -20.0f, -30.0f, -40.0f, -50.0f, -60.0f };
+        frustum                      = CS350::Frustum(normals, dists);
+        ray                          = CS350::Ray(vec3(1, 2, 3), vec3(0, 0, 1));
+        aabb                         = CS350::Aabb(vec3(-1, -2, -3), vec3(4, 5, 6));
+
+        BatchWriter batch;
+        batch.AddFrustum(frustum);
+        batch.AddRay(ray, true);
+        batch.AddOverlap(aabb);
+        return batch;
+    }
+}
+
+TEST(QueryService, ReadBatch) {
+    CS350::Frustum frustum;
+    CS350::Ray     ray;
+    CS350::Aabb    aabb;
+    BatchWriter    batch   = ExampleBatch(frustum, ray, aabb);
+    auto const&    payload = batch.payload();
+
+    // Well formed, every value as written
+    std::vector<Query> queries;
+    ASSERT_TRUE(ReadBatch(payload.data(), payload.size(), batch.count(), queries));
+    ASSERT_EQ(queries.size(), 3u);
+    ASSERT_EQ(queries[0].kind, QueryKind::eFRUSTUM);
+    for (size_t plane = 0; plane < 6; ++plane) {
+        ASSERT_EQ(queries[0].frustum.planes[plane].normal, frustum.planes[plane].normal) << plane;
+        ASSERT_EQ(queries[0].frustum.planes[plane].dot_result, frustum.planes[plane].dot_result) << plane;
+    }
+    ASSERT_EQ(queries[1].kind, QueryKind::eRAY);
+    ASSERT_TRUE(queries[1].closestOnly);
+    ASSERT_EQ(queries[1].ray.start, ray.start);
+    ASSERT_EQ(queries[1].ray.dir, ray.dir);
+    ASSERT_EQ(queries[2].kind, QueryKind::eOVERLAP);
+    ASSERT_FALSE(queries[2].closestOnly);
+    ASSERT_EQ(queries[2].aabb.min, aabb.min);
+    ASSERT_EQ(queries[2].aabb.max, aabb.max);
+    ASSERT_TRUE(ReadBatch(payload.data(), 0, 0, queries));
+    ASSERT_TRUE(queries.empty());
+
+    // Truncated anywhere, or with bytes left over
+    for (size_t size = 0; size < payload.size(); ++size) {
+        ASSERT_FALSE(ReadBatch(payload.data(), size, batch.count(), queries)) << size;
+    }
+    ASSERT_FALSE(ReadBatch(payload.data(), payload.size(), batch.count() - 1, queries));
+
+    // Unknown kind
+    std::vector<std::byte> unknown = payload;
+    unknown[0]                     = std::byte{ 7 };
+    ASSERT_FALSE(ReadBatch(unknown.data(), unknown.size(), batch.count(), queries));
+
+    // Over counted, more queries than the payload can hold are rejected before reserving them
+    ASSERT_FALSE(ReadBatch(payload.data(), payload.size(), batch.count() + 1, queries));
+    for (unsigned count : { 1u << 20, std::numeric_limits<unsigned>::max() }) {
+        std::vector<Query> fresh;
+        ASSERT_FALSE(ReadBatch(payload.data(), payload.size(), count, fresh)) << count;
+        ASSERT_EQ(fresh.capacity(), 0u) << count;
+    }
+}
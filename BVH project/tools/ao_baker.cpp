@@ -0,0 +1,178 @@
+/**
+ * @file
+ *  ao_baker.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Per vertex ambient occlusion baker. Every vertex shoots cosine weighted occlusion rays over the
+ *  hemisphere of its normal against the triangle Bvh of the mesh, the AO value is the fraction
+ *  of rays that escape within the occlusion radius. Timed with an increasing amount of threads.
+ *
+ *  Output file: uint32_t vertex count followed by one float per vertex, in the order of the mesh positions
+ *  (of the welded mesh when welding).
+ *
+ *  Usage: cs350-ao-baker [mesh file] [rays per vertex] [max threads, 0 for every cpu] [output file] [radius, fraction of the mesh size] [weld, 0 or 1]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "mesh_bvh.hpp"
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+
+namespace {
+    using namespace CS350;
+
+    constexpr size_t cVerticesPerTask = 256;
+    constexpr float  cRayOffset       = 1e-4f; // Of the mesh size, keeps rays from hitting their own triangle
+
+    /**
+     * @brief
+     *  Area weighted normal of every vertex, from the faces using it
+     */
+    std::vector<vec3> VertexNormals(CS350PrimitiveData const& mesh) {
+        std::vector<vec3> normals(mesh.positions.size(), vec3(0.0f));
+        auto              addFace = [&](size_t a, size_t b, size_t c) {
+            vec3 normal = glm::cross(mesh.positions[b] - mesh.positions[a], mesh.positions[c] - mesh.positions[a]);
+            normals[a] += normal;
+            normals[b] += normal;
+            normals[c] += normal;
+        };
+        if (mesh.polygons.empty()) {
+            for (size_t i = 0; i + 2 < mesh.positions.size(); i += 3) {
+                addFace(i, i + 1, i + 2);
+            }
+        } else {
+            for (auto const& face : mesh.polygons) {
+                addFace(static_cast<size_t>(face[0]), static_cast<size_t>(face[1]), static_cast<size_t>(face[2]));
+            }
+        }
+        for (auto& normal : normals) {
+            float length = glm::length(normal);
+            normal       = length > 0.0f ? normal / length : vec3(0, 1, 0);
+        }
+        return normals;
+    }
+
+    /**
+     * @brief
+     *  Bakes every vertex with the given amount of threads. Each task has its own generator seeded by
+     *  its index, so the result does not depend on the amount of threads.
+     * @return
+     *  Milliseconds taken
+     */
+    double Bake(Tools::MeshBvh const& bvh, CS350PrimitiveData const& mesh, std::vector<vec3> const& normals, unsigned raysPerVertex, float radius, unsigned threadCount, std::vector<float>& ao) {
+        ao.assign(mesh.positions.size(), 0.0f);
+        float               offset = glm::length(bvh.bounds().get_extents()) * cRayOffset;
+        std::atomic<size_t> nextTask{ 0 };
+        size_t              taskCount = (mesh.positions.size() + cVerticesPerTask - 1) / cVerticesPerTask;
+        auto                worker    = [&]() {
+            std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+            for (size_t task = nextTask.fetch_add(1); task < taskCount; task = nextTask.fetch_add(1)) {
+                std::mt19937 random(static_cast<uint32_t>(task + 1));
+                size_t       last = std::min(mesh.positions.size(), (task + 1) * cVerticesPerTask);
+                for (size_t v = task * cVerticesPerTask; v < last; ++v) {
+                    // Tangent frame of the normal
+                    vec3 normal    = normals[v];
+                    vec3 tangent   = glm::normalize(glm::cross(glm::abs(normal.x) > 0.9f ? vec3(0, 1, 0) : vec3(1, 0, 0), normal));
+                    vec3 bitangent = glm::cross(normal, tangent);
+                    vec3 origin    = mesh.positions[v] + normal * offset;
+
+                    unsigned escaped = 0;
+                    for (unsigned r = 0; r < raysPerVertex; ++r) {
+                        // Cosine weighted, the AO value is then the plain fraction of escaping rays
+                        float u1       = unit(random);
+                        float u2       = unit(random);
+                        float sinTheta = std::sqrt(u1);
+                        float phi      = 2.0f * glm::pi<float>() * u2;
+                        vec3  dir      = tangent * (sinTheta * std::cos(phi)) + bitangent * (sinTheta * std::sin(phi)) + normal * std::sqrt(1.0f - u1);
+                        if (!bvh.Occluded(Ray(origin, dir), radius)) {
+                            ++escaped;
+                        }
+                    }
+                    ao[v] = static_cast<float>(escaped) / static_cast<float>(raysPerVertex);
+                }
+            }
+        };
+
+        Tools::Stopwatch         watch;
+        std::vector<std::thread> threads;
+        for (unsigned t = 1; t < threadCount; ++t) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return watch.ElapsedMs();
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string meshFile      = argc > 1 ? argv[1] : "assets/cs350/dragon.cs350_binary";
+    unsigned    raysPerVertex = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 32u;
+    unsigned    maxThreads    = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 0u;
+    std::string outputFile    = argc > 4 ? argv[4] : "ao.bin";
+    float       radiusScale   = argc > 5 ? std::stof(argv[5]) : 0.1f;
+    bool        weld          = argc > 6 ? std::stoul(argv[6]) != 0 : false;
+    if (maxThreads == 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    try {
+        // Resolve the output before moving to the asset directory
+        outputFile = std::filesystem::absolute(outputFile).string();
+        CS350::ChangeWorkdir();
+
+        Tools::Stopwatch   watch;
+        CS350PrimitiveData mesh = LoadCS350Binary(meshFile);
+        if (weld) {
+            // Shared corners get one smooth normal and are baked once
+            CS350WeldStats stats = WeldCS350Primitive(mesh, maxThreads);
+            fmt::print("{}: welded {} corners to {} vertices in {:.02f}ms\n", meshFile, stats.corners, stats.vertices, stats.weldMs);
+        }
+        Tools::MeshBvh     bvh(Tools::MeshTriangles(mesh));
+        auto               normals = VertexNormals(mesh);
+        float              radius  = glm::length(bvh.bounds().get_extents()) * radiusScale;
+        fmt::print("{}: {} vertices, {} triangles, loaded and built in {:.02f}ms\n", meshFile, mesh.positions.size(), bvh.triangleCount(), watch.ElapsedMs());
+
+        std::vector<float> ao;
+        double             rays = static_cast<double>(mesh.positions.size()) * raysPerVertex;
+        for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+            double elapsedMs    = Bake(bvh, mesh, normals, raysPerVertex, radius, threadCount, ao);
+            double raysPerSec   = rays / (elapsedMs * 1e-3);
+            fmt::print("{:>3} threads {:>10.02f}ms {:>12.0f} rays {:>8.02f} Mrays/s {:>8.02f} Mrays/s per thread\n",
+                       threadCount,
+                       elapsedMs,
+                       rays,
+                       raysPerSec * 1e-6,
+                       raysPerSec * 1e-6 / threadCount);
+        }
+
+        std::ofstream file(outputFile, std::ios::binary);
+        auto          count = static_cast<uint32_t>(ao.size());
+        file.write(reinterpret_cast<char const*>(&count), sizeof(count));
+        file.write(reinterpret_cast<char const*>(ao.data()), static_cast<std::streamsize>(ao.size() * sizeof(float)));
+        if (!file) {
+            throw std::runtime_error(fmt::format("ao_baker: failed to write {}", outputFile));
+        }
+
+        double average = 0.0;
+        for (float value : ao) {
+            average += value;
+        }
+        fmt::print("{}: average AO {:.03f}\n", outputFile, ao.empty() ? 0.0 : average / static_cast<double>(ao.size()));
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
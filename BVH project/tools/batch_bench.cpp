@@ -0,0 +1,113 @@
+/**
+ * @file
+ *  batch_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/18
+ * @brief
+ *  Compares one-by-one ray and point queries against the interleaved QueryBatch.
+ *  The scene is replicated to get a tree larger than the cache, where the prefetches pay off.
+ *
+ *  Usage: cs350-batch-bench [scene copies] [query count] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "tool_scene.hpp"
+#include "utils.hpp"
+#include "PRNG.h"
+
+#include <algorithm>
+
+namespace {
+    using namespace CS350;
+
+    void Print(char const* label, double elapsedUs, size_t queries, size_t hits) {
+        fmt::print("{:<16} {:>12.0f} queries/s   {:>9.02f}ms   {} hits\n",
+                   label,
+                   static_cast<double>(queries) / (elapsedUs * 1e-6),
+                   elapsedUs * 1e-3,
+                   hits);
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned    copies       = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 256u;
+    unsigned    queryCount   = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 100000u;
+    std::string sceneFile    = argc > 3 ? argv[3] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 4 ? argv[4] : Tools::cAssetPath;
+
+    try {
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::ReplicateScene(scene, copies);
+        Tools::SceneBvh bvh;
+        bvh.BuildTopDown(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+        fmt::print("{} objects, {} nodes, depth {}\n", scene.objects.size(), bvh.Size(), bvh.Depth());
+
+        // Rays and points spread over the whole tree, so consecutive queries share few nodes
+        Aabb const& bounds = bvh.root()->bv;
+        auto        random = [&]() {
+            return vec3(CS170::Utils::Random(bounds.min.x, bounds.max.x),
+                        CS170::Utils::Random(bounds.min.y, bounds.max.y),
+                        CS170::Utils::Random(bounds.min.z, bounds.max.z));
+        };
+        CS170::Utils::srand(5, 5);
+        std::vector<Ray>  rays;
+        std::vector<vec3> points;
+        for (unsigned i{}; i < queryCount; i++) {
+            vec3 start = random();
+            rays.emplace_back(start, random() - start);
+            points.push_back(scene.objects[i % scene.objects.size()]->bv.get_center());
+        }
+
+        // Rays
+        std::vector<std::optional<unsigned>> closest(rays.size());
+        size_t                               hits = 0;
+        Tools::Stopwatch                     watch;
+        for (size_t i{}; i < rays.size(); i++) {
+            closest[i] = bvh.Query(rays[i]);
+            hits += closest[i] ? 1u : 0u;
+        }
+        Print("rays", watch.ElapsedUs(), rays.size(), hits);
+
+        std::vector<std::optional<unsigned>> closestBatch(rays.size());
+        watch.Restart();
+        bvh.QueryBatch(rays.data(), rays.size(), closestBatch.data());
+        double elapsedUs = watch.ElapsedUs();
+        size_t batchHits = static_cast<size_t>(std::count_if(closestBatch.begin(), closestBatch.end(), [](auto const& id) { return id.has_value(); }));
+        Print("rays batch", elapsedUs, rays.size(), batchHits);
+
+        // Points
+        std::vector<std::vector<unsigned>> containing(points.size());
+        size_t                             found = 0;
+        watch.Restart();
+        for (size_t i{}; i < points.size(); i++) {
+            containing[i] = bvh.Query(Aabb(points[i], points[i]));
+            found += containing[i].size();
+        }
+        Print("points", watch.ElapsedUs(), points.size(), found);
+
+        std::vector<std::vector<unsigned>> containingBatch;
+        watch.Restart();
+        bvh.QueryBatch(points.data(), points.size(), containingBatch);
+        elapsedUs         = watch.ElapsedUs();
+        size_t batchFound = 0;
+        for (auto const& ids : containingBatch) {
+            batchFound += ids.size();
+        }
+        Print("points batch", elapsedUs, points.size(), batchFound);
+
+        if (closest != closestBatch || found != batchFound) {
+            fmt::print(stderr, "Batched results differ from single queries\n");
+            return 1;
+        }
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
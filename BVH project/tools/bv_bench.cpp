@@ -0,0 +1,177 @@
+/**
+ * @file
+ *  bv_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Node bounding volumes compared on the same scene: Aabb, Sphere, 14-DOP and 18-DOP trees built
+ *  top down and by insertion, with the total volume of their nodes and the time of frustum and
+ *  ray queries from random cameras. Every tree must return as many objects as the Aabb one.
+ *
+ *  Usage: cs350-bv-bench [cameras] [scene copies] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <random>
+
+namespace {
+    using namespace CS350;
+
+    const BvhBuildConfig cToolInsertConfig = {
+        100,          // max_depth
+        1,            // min_objects
+        10 * 10 * 10, // min_volume
+    };
+
+    // Same layout as Tools::SceneObject, with the node type of the bounding volume
+    template <typename BV>
+    struct VolumeObject {
+        unsigned id{};
+        Aabb     bv{};
+
+        struct {
+            VolumeObject*                          next = nullptr;
+            VolumeObject*                          prev = nullptr;
+            typename Bvh<VolumeObject*, BV>::Node* node = nullptr;
+        } bvhInfo;
+    };
+
+    struct Camera {
+        Frustum frustum;
+        Ray     ray;
+    };
+
+    struct Result {
+        size_t visible = 0; // Objects returned by every frustum query
+        size_t hits    = 0; // Rays that hit an object
+    };
+
+    template <typename BV>
+    Result Measure(char const* label, char const* build, Bvh<VolumeObject<BV>*, BV> const& bvh, double buildMs, std::vector<Camera> const& cameras) {
+        using Node = typename Bvh<VolumeObject<BV>*, BV>::Node;
+
+        double volume = 0.0;
+        bvh.TraverseLevelOrder([&](Node const* node) { volume += static_cast<double>(node->bv.volume()); });
+
+        Result           result;
+        Tools::Stopwatch watch;
+        for (auto const& camera : cameras) {
+            result.visible += bvh.Query(camera.frustum).size();
+        }
+        double frustumMs = watch.ElapsedMs();
+
+        watch.Restart();
+        for (auto const& camera : cameras) {
+            result.hits += bvh.Query(camera.ray) ? 1u : 0u;
+        }
+        double rayMs = watch.ElapsedMs();
+
+        fmt::print("{:<8} {:<8} {:>9.02f}ms build {:>7} nodes {:>8.01f}KB {:>14.0f} volume {:>9.03f}ms frustum {:>9.03f}ms ray   {} visible, {} hits\n",
+                   label,
+                   build,
+                   buildMs,
+                   bvh.Size(),
+                   static_cast<double>(static_cast<size_t>(bvh.Size()) * sizeof(Node)) / 1024.0,
+                   volume,
+                   frustumMs / static_cast<double>(cameras.size()),
+                   rayMs / static_cast<double>(cameras.size()),
+                   result.visible,
+                   result.hits);
+        return result;
+    }
+
+    /**
+     * @brief
+     *  Builds both trees of a bounding volume, checking their results against the Aabb ones
+     * @return
+     *  False if any count differs from the reference
+     */
+    template <typename BV>
+    bool Compare(char const* label, Tools::Scene const& scene, std::vector<Camera> const& cameras, std::optional<Result>& reference) {
+        std::vector<VolumeObject<BV>>  storage(scene.objects.size());
+        std::vector<VolumeObject<BV>*> objects;
+        for (size_t i = 0; i < storage.size(); ++i) {
+            storage[i].id = scene.objects[i]->id;
+            storage[i].bv = scene.objects[i]->bv;
+            objects.push_back(&storage[i]);
+        }
+
+        bool matches = true;
+        auto check   = [&](Result const& result) {
+            if (!reference) {
+                reference = result;
+            }
+            matches = matches && result.visible == reference->visible && result.hits == reference->hits;
+        };
+
+        {
+            Bvh<VolumeObject<BV>*, BV> bvh;
+            Tools::Stopwatch           watch;
+            bvh.BuildTopDown(objects.begin(), objects.end(), Tools::cToolTopDownConfig);
+            check(Measure(label, "top down", bvh, watch.ElapsedMs(), cameras));
+        }
+
+        for (auto& object : storage) {
+            object.bvhInfo = {};
+        }
+        {
+            Bvh<VolumeObject<BV>*, BV> bvh;
+            Tools::Stopwatch           watch;
+            bvh.Insert(objects.begin(), objects.end(), cToolInsertConfig);
+            check(Measure(label, "insert", bvh, watch.ElapsedMs(), cameras));
+        }
+        return matches;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned    cameraCount  = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 200u;
+    unsigned    copies       = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 1u;
+    std::string sceneFile    = argc > 3 ? argv[3] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 4 ? argv[4] : Tools::cAssetPath;
+
+    try {
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::ReplicateScene(scene, copies);
+
+        // Cameras inside the scene looking at random points of it
+        Aabb bounds = scene.objects.front()->bv;
+        for (auto const* object : scene.objects) {
+            bounds = Aabb(bounds, object->bv);
+        }
+        std::mt19937                          random(1);
+        std::uniform_real_distribution<float> x(bounds.min.x, bounds.max.x), y(bounds.min.y, bounds.max.y), z(bounds.min.z, bounds.max.z);
+        mat4                                  proj = glm::perspective(glm::radians(50.0f), 16.0f / 9.0f, 0.1f, glm::length(bounds.get_extents()));
+        std::vector<Camera>                   cameras;
+        for (unsigned c{}; c < cameraCount; c++) {
+            float ex = x(random), ey = y(random), ez = z(random);
+            float tx = x(random), ty = y(random), tz = z(random);
+            vec3  eye(ex, ey, ez), target(tx, ty, tz);
+            cameras.push_back({ Frustum(proj * glm::lookAt(eye, target, vec3(0, 1, 0))), Ray(eye, target - eye) });
+        }
+        fmt::print("{} objects, {} cameras\n", scene.objects.size(), cameras.size());
+
+        std::optional<Result> reference;
+        bool                  matches = Compare<Aabb>("Aabb", scene, cameras, reference);
+        matches                       = Compare<Sphere>("Sphere", scene, cameras, reference) && matches;
+        matches                       = Compare<Kdop<14>>("14-DOP", scene, cameras, reference) && matches;
+        matches                       = Compare<Kdop<18>>("18-DOP", scene, cameras, reference) && matches;
+        if (!matches) {
+            fmt::print(stderr, "Query results differ from the Aabb tree\n");
+            return 1;
+        }
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
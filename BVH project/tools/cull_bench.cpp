@@ -0,0 +1,83 @@
+/**
+ * @file
+ *  cull_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/23
+ * @brief
+ *  Serial frustum culling against QueryParallel with an increasing amount of threads, with a wide
+ *  frustum that sees most of a replicated scene.
+ *
+ *  Usage: cs350-cull-bench [max threads, 0 for every cpu] [scene copies] [repetitions] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <thread>
+
+namespace {
+    using namespace CS350;
+
+    void Print(char const* label, unsigned threads, double elapsedMs, size_t visible) {
+        fmt::print("{:<10} {:>3} threads {:>9.02f}ms per query   {} visible\n", label, threads, elapsedMs, visible);
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned    maxThreads   = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 0u;
+    unsigned    copies       = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 250u;
+    unsigned    repetitions  = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 10u;
+    std::string sceneFile    = argc > 4 ? argv[4] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 5 ? argv[5] : Tools::cAssetPath;
+    if (maxThreads == 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    try {
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::ReplicateScene(scene, copies);
+        Tools::SceneBvh bvh;
+        bvh.BuildTopDown(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+        fmt::print("{} objects, {} nodes, depth {}\n", scene.objects.size(), bvh.Size(), bvh.Depth());
+
+        // Camera in front of the scene looking at its center, wide enough to see most of it
+        Aabb const& bounds   = bvh.root()->bv;
+        vec3        center   = bounds.get_center();
+        vec3        extents  = bounds.get_extents();
+        vec3        eye      = center - vec3(0.0f, 0.0f, extents.z * 1.5f);
+        mat4        view     = glm::lookAt(eye, center, vec3(0, 1, 0));
+        mat4        proj     = glm::perspective(glm::radians(90.0f), 16.0f / 9.0f, 0.1f, glm::length(extents) * 4.0f);
+        Frustum     frustum(proj * view);
+
+        std::vector<unsigned> serial;
+        Tools::Stopwatch      watch;
+        for (unsigned r{}; r < repetitions; r++) {
+            serial = bvh.Query(frustum);
+        }
+        Print("serial", 1, watch.ElapsedMs() / repetitions, serial.size());
+
+        for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+            std::vector<unsigned> parallel;
+            watch.Restart();
+            for (unsigned r{}; r < repetitions; r++) {
+                parallel = bvh.QueryParallel(frustum, threadCount);
+            }
+            Print("parallel", threadCount, watch.ElapsedMs() / repetitions, parallel.size());
+            if (parallel != serial) {
+                fmt::print(stderr, "Parallel result differs from the serial one\n");
+                return 1;
+            }
+        }
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
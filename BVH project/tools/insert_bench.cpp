@@ -0,0 +1,97 @@
+/**
+ * @file
+ *  insert_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/21
+ * @brief
+ *  Insertion throughput of Insert against InsertConcurrent with an increasing amount of threads.
+ *
+ *  Usage: cs350-insert-bench [max threads, 0 for every cpu] [scene copies] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <thread>
+
+namespace {
+    using namespace CS350;
+
+    const BvhBuildConfig cToolInsertConfig = {
+        100,          // max_depth
+        1,            // min_objects
+        10 * 10 * 10, // min_volume
+    };
+
+    void ResetObjects(Tools::Scene& scene) {
+        for (auto* object : scene.objects) {
+            object->bvhInfo = {};
+        }
+    }
+
+    void Print(char const* label, unsigned threads, double elapsedMs, size_t objects, Tools::SceneBvh const& bvh) {
+        fmt::print("{:<12} {:>3} threads {:>12.0f} inserts/s   {:>9.02f}ms   {} nodes, depth {}\n",
+                   label,
+                   threads,
+                   static_cast<double>(objects) / (elapsedMs * 1e-3),
+                   elapsedMs,
+                   bvh.Size(),
+                   bvh.Depth());
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned    maxThreads   = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 0u;
+    unsigned    copies       = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 8u;
+    std::string sceneFile    = argc > 3 ? argv[3] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 4 ? argv[4] : Tools::cAssetPath;
+    if (maxThreads == 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    try {
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::ReplicateScene(scene, copies);
+        size_t objectCount = scene.objects.size();
+
+        {
+            Tools::SceneBvh  bvh;
+            Tools::Stopwatch watch;
+            bvh.Insert(scene.objects.begin(), scene.objects.end(), cToolInsertConfig);
+            Print("Insert", 1, watch.ElapsedMs(), objectCount, bvh);
+        }
+
+        for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+            ResetObjects(scene);
+            Tools::SceneBvh          bvh;
+            std::vector<std::thread> threads;
+            Tools::Stopwatch         watch;
+            for (unsigned t{}; t < threadCount; t++) {
+                threads.emplace_back([&, t]() {
+                    for (size_t i = t; i < objectCount; i += threadCount) {
+                        bvh.InsertConcurrent(scene.objects[i], cToolInsertConfig);
+                    }
+                });
+            }
+            for (auto& thread : threads) {
+                thread.join();
+            }
+            Print("Concurrent", threadCount, watch.ElapsedMs(), objectCount, bvh);
+            if (bvh.objectCount() != objectCount) {
+                fmt::print(stderr, "{} objects inserted, expected {}\n", bvh.objectCount(), objectCount);
+                return 1;
+            }
+        }
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+/**
+ * @file
+ *  insert_cost_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Insertion policies compared on the same shuffled scene, optionally with a floor of flat tiles:
+ *  build time, tree quality (surface area cost, depth) and frustum and ray query time and node
+ *  tests from random cameras. Both trees must return the same objects.
+ *
+ *  Usage: cs350-insert-cost-bench [cameras] [floor tiles per side, 0 for none] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "stats.hpp"
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <random>
+
+namespace {
+    using namespace CS350;
+
+    // Same rules as the Insert_* tests
+    const BvhBuildConfig cToolInsertConfig = {
+        100,          // max_depth
+        1,            // min_objects
+        10 * 10 * 10, // min_volume
+    };
+
+    struct Camera {
+        Frustum frustum;
+        Ray     ray;
+    };
+
+    struct Result {
+        size_t visible = 0; // Objects returned by every frustum query
+        size_t hits    = 0; // Rays that hit an object
+    };
+
+    Result Measure(char const* label, std::vector<Tools::SceneObject*> const& objects, BvhBuildConfig const& config, std::vector<Camera> const& cameras) {
+        for (auto* object : objects) {
+            object->bvhInfo = {};
+        }
+        Tools::SceneBvh  bvh;
+        Tools::Stopwatch watch;
+        bvh.Insert(objects.begin(), objects.end(), config);
+        double buildMs = watch.ElapsedMs();
+
+        Result result;
+        Stats::Instance().Reset();
+        watch.Restart();
+        for (auto const& camera : cameras) {
+            result.visible += bvh.Query(camera.frustum).size();
+        }
+        double frustumMs = watch.ElapsedMs();
+
+        watch.Restart();
+        for (auto const& camera : cameras) {
+            result.hits += bvh.Query(camera.ray) ? 1u : 0u;
+        }
+        double rayMs = watch.ElapsedMs();
+
+        double count = static_cast<double>(cameras.size());
+        fmt::print("{:<13} {:>9.02f}ms build {:>6} nodes depth {:>4} cost {:>9.02f} {:>8.03f}ms {:>8.0f} tests frustum {:>8.04f}ms {:>6.0f} tests ray   {} visible, {} hits\n",
+                   label,
+                   buildMs,
+                   bvh.Size(),
+                   bvh.Depth(),
+                   bvh.SurfaceAreaCost(),
+                   frustumMs / count,
+                   static_cast<double>(Stats::Instance().frustumVsAabb) / count,
+                   rayMs / count,
+                   static_cast<double>(Stats::Instance().rayVsAabb) / count,
+                   result.visible,
+                   result.hits);
+        return result;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned    cameraCount  = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 200u;
+    unsigned    floorTiles   = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 30u;
+    std::string sceneFile    = argc > 3 ? argv[3] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 4 ? argv[4] : Tools::cAssetPath;
+
+    try {
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Aabb bounds = scene.objects.front()->bv;
+        for (auto const* object : scene.objects) {
+            bounds = Aabb(bounds, object->bv);
+        }
+
+        // Flat tiles under the scene, a floor has no volume at all
+        std::vector<Tools::SceneObject*> objects = scene.objects;
+        std::vector<Tools::SceneObject>  tiles(floorTiles * floorTiles);
+        vec3                             tileSize = (bounds.max - bounds.min) / static_cast<float>(std::max(floorTiles, 1u));
+        for (unsigned x{}; x < floorTiles; x++) {
+            for (unsigned z{}; z < floorTiles; z++) {
+                auto& tile = tiles[x * floorTiles + z];
+                vec3  corner(bounds.min.x + tileSize.x * static_cast<float>(x), bounds.min.y, bounds.min.z + tileSize.z * static_cast<float>(z));
+                tile.id = static_cast<unsigned>(objects.size());
+                tile.bv = Aabb(corner, corner + vec3(tileSize.x, 0.0f, tileSize.z));
+                objects.push_back(&tile);
+            }
+        }
+
+        // Inserted in a random order, cameras inside the scene looking at random points of it
+        std::mt19937 random(1);
+        std::shuffle(objects.begin(), objects.end(), random);
+        std::uniform_real_distribution<float> x(bounds.min.x, bounds.max.x), y(bounds.min.y, bounds.max.y), z(bounds.min.z, bounds.max.z);
+        mat4                                  proj = glm::perspective(glm::radians(50.0f), 16.0f / 9.0f, 0.1f, glm::length(bounds.get_extents()));
+        std::vector<Camera>                   cameras;
+        for (unsigned c{}; c < cameraCount; c++) {
+            float ex = x(random), ey = y(random), ez = z(random);
+            float tx = x(random), ty = y(random), tz = z(random);
+            vec3  eye(ex, ey, ez), target(tx, ty, tz);
+            cameras.push_back({ Frustum(proj * glm::lookAt(eye, target, vec3(0, 1, 0))), Ray(eye, target - eye) });
+        }
+        fmt::print("{} objects ({} floor tiles), {} cameras\n", objects.size(), tiles.size(), cameras.size());
+
+        BvhBuildConfig surfaceAreaConfig = cToolInsertConfig;
+        surfaceAreaConfig.insertPolicy   = InsertPolicy::eSurfaceArea;
+        Result volume                    = Measure("volume", objects, cToolInsertConfig, cameras);
+        Result surfaceArea               = Measure("surface area", objects, surfaceAreaConfig, cameras);
+        if (volume.visible != surfaceArea.visible || volume.hits != surfaceArea.hits) {
+            fmt::print(stderr, "Query results differ between the policies\n");
+            return 1;
+        }
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,117 @@
+/**
+ * @file
+ *  layout_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Object storage in scene file order against Morton order of the bv centers: frustum queries from
+ *  random cameras, then a pass over the visible objects reading their bv and transform like the
+ *  renderer does. Both layouts must see the same objects.
+ *
+ *  Usage: cs350-layout-bench [cameras] [scene copies] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <random>
+
+namespace {
+    using namespace CS350;
+
+    struct Result {
+        size_t visible = 0; // Objects returned by every frustum query
+        float  touched = 0; // Keeps the visit pass from being optimized away
+    };
+
+    Result Measure(char const* label, Tools::Scene const& scene, std::vector<Frustum> const& frustums) {
+        Tools::SceneBvh bvh;
+        bvh.BuildTopDown(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+
+        // Average distance in memory between consecutive objects of a leaf
+        double gaps     = 0.0;
+        size_t gapCount = 0;
+        bvh.TraverseLevelOrder([&](Tools::SceneBvhNode const* node) {
+            for (auto* object = node->firstObject; object != nullptr && object->bvhInfo.next != nullptr; object = object->bvhInfo.next) {
+                auto from = reinterpret_cast<intptr_t>(object);
+                auto to   = reinterpret_cast<intptr_t>(object->bvhInfo.next);
+                gaps += static_cast<double>(std::abs(to - from));
+                gapCount++;
+            }
+        });
+
+        Result                result;
+        double                queryMs = 0.0, visitMs = 0.0;
+        std::vector<unsigned> visible;
+        for (auto const& frustum : frustums) {
+            Tools::Stopwatch watch;
+            visible = bvh.Query(frustum);
+            queryMs += watch.ElapsedMs();
+
+            watch.Restart();
+            for (unsigned id : visible) {
+                result.touched += scene.objects[id]->bv.min.x + scene.sceneObjects[id].m2w.rows[0].w;
+            }
+            visitMs += watch.ElapsedMs();
+            result.visible += visible.size();
+        }
+
+        double count = static_cast<double>(frustums.size());
+        fmt::print("{:<8} {:>10.0f}B leaf gap {:>9.03f}ms query {:>9.03f}ms visit   {} visible\n",
+                   label,
+                   gapCount > 0 ? gaps / static_cast<double>(gapCount) : 0.0,
+                   queryMs / count,
+                   visitMs / count,
+                   result.visible);
+        return result;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned    cameraCount  = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 100u;
+    unsigned    copies       = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 64u;
+    std::string sceneFile    = argc > 3 ? argv[3] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 4 ? argv[4] : Tools::cAssetPath;
+
+    try {
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::ReplicateScene(scene, copies);
+
+        // Cameras inside the scene looking at random points of it
+        Aabb bounds = scene.objects.front()->bv;
+        for (auto const* object : scene.objects) {
+            bounds = Aabb(bounds, object->bv);
+        }
+        std::mt19937                          random(1);
+        std::uniform_real_distribution<float> x(bounds.min.x, bounds.max.x), y(bounds.min.y, bounds.max.y), z(bounds.min.z, bounds.max.z);
+        mat4                                  proj = glm::perspective(glm::radians(50.0f), 16.0f / 9.0f, 0.1f, glm::length(bounds.get_extents()));
+        std::vector<Frustum>                  frustums;
+        for (unsigned c{}; c < cameraCount; c++) {
+            float ex = x(random), ey = y(random), ez = z(random);
+            float tx = x(random), ty = y(random), tz = z(random);
+            frustums.emplace_back(proj * glm::lookAt(vec3(ex, ey, ez), vec3(tx, ty, tz), vec3(0, 1, 0)));
+        }
+        fmt::print("{} objects, {} cameras\n", scene.objects.size(), frustums.size());
+
+        Result fileOrder = Measure("file", scene, frustums);
+        Tools::Stopwatch watch;
+        Tools::MortonOrderScene(scene);
+        fmt::print("Morton order in {:.02f}ms\n", watch.ElapsedMs());
+        Result mortonOrder = Measure("Morton", scene, frustums);
+        if (fileOrder.visible != mortonOrder.visible) {
+            fmt::print(stderr, "Visible objects differ between the layouts\n");
+            return 1;
+        }
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,98 @@
+/**
+ * @file
+ *  los_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  All pairs line of sight between agents spread over the scene: one closest hit ray per pair
+ *  through QueryBatch against QueryLineOfSight with an increasing amount of threads.
+ *
+ *  Usage: cs350-los-bench [agents] [max distance, 0 for none] [max threads, 0 for every cpu] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <random>
+#include <thread>
+
+int main(int argc, char** argv) {
+    using namespace CS350;
+
+    unsigned    agentCount   = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 2000u;
+    float       maxDistance  = argc > 2 ? std::stof(argv[2]) : 0.0f;
+    unsigned    maxThreads   = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 0u;
+    std::string sceneFile    = argc > 4 ? argv[4] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 5 ? argv[5] : Tools::cAssetPath;
+    if (maxDistance <= 0.0f) {
+        maxDistance = std::numeric_limits<float>::max();
+    }
+    if (maxThreads == 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    try {
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::SceneBvh bvh;
+        bvh.BuildTopDown(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+
+        std::mt19937                          random(1);
+        Aabb const&                           bounds = bvh.root()->bv;
+        std::uniform_real_distribution<float> x(bounds.min.x, bounds.max.x), y(bounds.min.y, bounds.max.y), z(bounds.min.z, bounds.max.z);
+        std::vector<vec3>                     agents;
+        for (unsigned a{}; a < agentCount; a++) {
+            float ax = x(random), ay = y(random), az = z(random);
+            agents.emplace_back(ax, ay, az);
+        }
+
+        // Baseline, a pair is visible if nothing is hit before the other agent
+        std::vector<Ray>      rays;
+        std::vector<uint32_t> pairs;
+        for (unsigned i{}; i < agentCount; i++) {
+            for (unsigned j = i + 1; j < agentCount; j++) {
+                if (glm::distance(agents[i], agents[j]) <= maxDistance) {
+                    rays.emplace_back(agents[i], agents[j] - agents[i]);
+                }
+            }
+        }
+        std::vector<std::optional<unsigned>> closestObjects(rays.size());
+        Tools::Stopwatch                     watch;
+        bvh.QueryBatch(rays.data(), rays.size(), closestObjects.data());
+        size_t baselineVisible = 0;
+        for (size_t r{}; r < rays.size(); r++) {
+            baselineVisible += !closestObjects[r] || rays[r].intersect(scene.objects[*closestObjects[r]]->bv) > 1.0f ? 1u : 0u;
+        }
+        double baselineMs = watch.ElapsedMs();
+        fmt::print("{} agents, {} segments, {} objects\n", agentCount, rays.size(), scene.objects.size());
+        fmt::print("{:<18} {:>3} threads {:>10.02f}ms   {} visible pairs\n", "QueryBatch", 1, baselineMs, baselineVisible);
+
+        for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+            watch.Restart();
+            VisibilityMatrix visibility = bvh.QueryLineOfSight(agents, maxDistance, threadCount);
+            double           elapsedMs  = watch.ElapsedMs();
+
+            size_t visible = 0;
+            for (unsigned i{}; i < agentCount; i++) {
+                for (unsigned j = i + 1; j < agentCount; j++) {
+                    visible += visibility.Visible(i, j) ? 1u : 0u;
+                }
+            }
+            fmt::print("{:<18} {:>3} threads {:>10.02f}ms   {} visible pairs\n", "QueryLineOfSight", threadCount, elapsedMs, visible);
+            if (visible != baselineVisible) {
+                fmt::print(stderr, "Line of sight differs from the baseline\n");
+                return 1;
+            }
+        }
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
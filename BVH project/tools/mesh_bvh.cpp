@@ -0,0 +1,183 @@
+/**
+ * @file
+ *  mesh_bvh.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Triangle Bvh construction and exact ray queries
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "mesh_bvh.hpp"
+#include "bvh.hpp"
+#include "logging.hpp"
+
+#include <stdexcept>
+
+namespace CS350::Tools {
+
+    namespace {
+        struct MeshTriangle;
+        using TriangleBvh = Bvh<MeshTriangle*>;
+
+        // One Bvh object per triangle, only alive while building
+        struct MeshTriangle {
+            unsigned id{};
+            Aabb     bv{};
+
+            struct {
+                MeshTriangle*      next = nullptr;
+                MeshTriangle*      prev = nullptr;
+                TriangleBvh::Node* node = nullptr;
+            } bvhInfo;
+        };
+
+        const BvhBuildConfig cMeshConfig = {
+            cMaxTraversalDepth - 2, // max_depth, the traversal stack is fixed
+            4,                      // min_objects
+            -1.0f,                  // min_volume, never stop on it, flat groups of triangles have none
+        };
+    }
+
+    std::vector<Triangle> MeshTriangles(CS350PrimitiveData const& mesh) {
+        std::vector<vec3>        dequantized = mesh.quantizedPositions.empty() ? std::vector<vec3>{} : CS350Positions(mesh);
+        std::vector<vec3> const& positions   = mesh.quantizedPositions.empty() ? mesh.positions : dequantized;
+
+        std::vector<Triangle> triangles;
+        if (mesh.polygons.empty()) {
+            triangles.reserve(positions.size() / 3);
+            for (size_t i = 0; i + 2 < positions.size(); i += 3) {
+                triangles.emplace_back(positions[i], positions[i + 1], positions[i + 2]);
+            }
+            return triangles;
+        }
+
+        triangles.reserve(mesh.polygons.size());
+        for (auto const& face : mesh.polygons) {
+            triangles.emplace_back(positions.at(static_cast<size_t>(face[0])),
+                                   positions.at(static_cast<size_t>(face[1])),
+                                   positions.at(static_cast<size_t>(face[2])));
+        }
+        return triangles;
+    }
+
+    float IntersectTriangle(Ray const& ray, Triangle const& triangle) {
+        // Moller-Trumbore
+        vec3  edge1 = triangle[1] - triangle[0];
+        vec3  edge2 = triangle[2] - triangle[0];
+        vec3  p     = glm::cross(ray.dir, edge2);
+        float det   = glm::dot(edge1, p);
+        if (det == 0.0f) {
+            return -1.0f;
+        }
+
+        float invDet = 1.0f / det;
+        vec3  s      = ray.start - triangle[0];
+        float u      = glm::dot(s, p) * invDet;
+        if (u < 0.0f || u > 1.0f) {
+            return -1.0f;
+        }
+        vec3  q = glm::cross(s, edge1);
+        float v = glm::dot(ray.dir, q) * invDet;
+        if (v < 0.0f || u + v > 1.0f) {
+            return -1.0f;
+        }
+        float t = glm::dot(edge2, q) * invDet;
+        return t >= 0.0f ? t : -1.0f;
+    }
+
+    MeshBvh::MeshBvh(std::vector<Triangle> triangles) {
+        if (triangles.empty()) {
+            throw std::runtime_error("mesh_bvh: mesh without triangles");
+        }
+
+        std::vector<MeshTriangle>  objects(triangles.size());
+        std::vector<MeshTriangle*> objectPtrs(triangles.size());
+        for (size_t i = 0; i < triangles.size(); ++i) {
+            objects[i].id = static_cast<unsigned>(i);
+            objects[i].bv = Aabb(&triangles[i][0], 3);
+            objectPtrs[i] = &objects[i];
+        }
+
+        TriangleBvh bvh;
+        bvh.BuildTopDown(objectPtrs.begin(), objectPtrs.end(), cMeshConfig);
+        if (bvh.Depth() >= static_cast<int>(cMaxTraversalDepth)) {
+            throw std::runtime_error(fmt::format("mesh_bvh: tree of depth {} is too deep", bvh.Depth()));
+        }
+
+        mStorage.resize((FlatBvhSize(bvh) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        size_t size = FlattenBvh(bvh, mStorage.data(), mStorage.size() * sizeof(uint64_t));
+        mView       = FlatBvhView(mStorage.data(), size);
+
+        // Leaf order, the object index of the flattened tree is the triangle index
+        mTriangles.reserve(triangles.size());
+        for (unsigned i = 0; i < mView.objectCount(); ++i) {
+            mTriangles.push_back(triangles[mView.objects()[i].id]);
+        }
+    }
+
+    MeshBvh::MeshBvh(CS350PrimitiveData const& mesh) :
+        MeshBvh(MeshTriangles(mesh))
+    {
+        if (mesh.quantizedPositions.empty()) {
+            return;
+        }
+
+        // The tree was built on the dequantized triangles, the leaves keep the steps of their corners
+        mQuantization = PositionQuantization(mesh.bvMin, mesh.bvMax);
+        mQuantized.reserve(mTriangles.size() * 9);
+        for (unsigned i = 0; i < mView.objectCount(); ++i) {
+            size_t triangle = mView.objects()[i].id;
+            for (size_t corner = 0; corner < 3; ++corner) {
+                size_t vertex = mesh.polygons.empty() ? triangle * 3 + corner : static_cast<size_t>(mesh.polygons[triangle][corner]);
+                auto const& steps = mesh.quantizedPositions.at(vertex);
+                mQuantized.insert(mQuantized.end(), steps.begin(), steps.end());
+            }
+        }
+        mTriangles = {};
+    }
+
+    Triangle MeshBvh::triangle(unsigned index) const {
+        if (mQuantized.empty()) {
+            return mTriangles[index];
+        }
+        uint16_t const* steps = &mQuantized[size_t{ index } * 9];
+        return Triangle(mQuantization->dequantize(steps), mQuantization->dequantize(steps + 3), mQuantization->dequantize(steps + 6));
+    }
+
+    template <bool AnyHit>
+    bool MeshBvh::Trace(Ray const& ray, float& tMax, unsigned& triangle) const {
+        auto accept = [&](float t, uint32_t index, float& closest) {
+            if (t < 0.0f || t >= closest) {
+                return false;
+            }
+            closest  = t;
+            triangle = index;
+            return true;
+        };
+        if (mQuantized.empty()) {
+            return TraverseRay<AnyHit>(mView, ray, tMax, [&](uint32_t index, float& closest) {
+                return accept(IntersectTriangle(ray, mTriangles[index]), index, closest);
+            });
+        }
+        return TraverseRay<AnyHit>(mView, ray, tMax, [&](uint32_t index, float& closest) {
+            return accept(IntersectTriangle(ray, this->triangle(index)), index, closest);
+        });
+    }
+
+    std::optional<MeshHit> MeshBvh::Closest(Ray const& ray, float tMax) const {
+        unsigned triangle = 0;
+        if (!Trace<false>(ray, tMax, triangle)) {
+            return std::nullopt;
+        }
+        return MeshHit{ tMax, triangle };
+    }
+
+    bool MeshBvh::Occluded(Ray const& ray, float tMax) const {
+        unsigned triangle = 0;
+        return Trace<true>(ray, tMax, triangle);
+    }
+}
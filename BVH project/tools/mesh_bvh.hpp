@@ -0,0 +1,176 @@
+/**
+ * @file
+ *  mesh_bvh.hpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Triangle Bvh of a single mesh for exact ray queries.
+ *
+ *  Built with Bvh<T> using one object per triangle, then flattened. Triangles are reordered to
+ *  the order of the leaves, so the objects of a leaf are the triangles [firstObject, firstObject + objectCount).
+ *  The traversal helpers also work on any other flattened Bvh, e.g. a scene of mesh instances.
+ *  Meshes with quantized positions keep them in the leaves, 18 bytes per triangle instead of 36,
+ *  and dequantize the corners of every triangle tested.
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef MESH_BVH_HPP
+#define MESH_BVH_HPP
+
+#include "cs350_loader.hpp"
+#include "flat_bvh.hpp"
+#include "shapes.hpp"
+
+#include <array>
+#include <cstdint>
+#include <limits>
+#include <optional>
+#include <vector>
+
+namespace CS350::Tools {
+
+    constexpr unsigned cMaxTraversalDepth = 64; // Traversal stack size, trees must be shallower
+
+    /**
+     * @brief
+     *  Triangles of a mesh, indexed or not, quantized or not
+     */
+    std::vector<Triangle> MeshTriangles(CS350PrimitiveData const& mesh);
+
+    /**
+     * @brief
+     *  Ray vs triangle without any area epsilon, tiny triangles of dense meshes are still hit
+     * @return
+     *  Time of the hit, negative if missed
+     */
+    float IntersectTriangle(Ray const& ray, Triangle const& triangle);
+
+    /**
+     * @brief
+     *  Front to back traversal of a flattened Bvh
+     * @param view
+     *  Tree, at most cMaxTraversalDepth deep
+     * @param ray
+     *  Ray to trace
+     * @param tMax
+     *  Nodes entered later are skipped. The leaf functor shrinks it on every accepted hit.
+     * @param leaf
+     *  bool(uint32_t object, float& tMax), called for every object of the leaves reached. Returns true on a hit
+     *  and lowers tMax to it.
+     * @return
+     *  True if any object was hit
+     */
+    template <bool AnyHit, typename Fn>
+    bool TraverseRay(FlatBvhView const& view, Ray const& ray, float& tMax, Fn&& leaf);
+
+    struct MeshHit {
+        float    t;
+        unsigned triangle; // Leaf order, see MeshBvh::triangle
+    };
+
+    /**
+     * @brief
+     *  Exact ray queries against the triangles of a mesh
+     */
+    class MeshBvh {
+      public:
+        explicit MeshBvh(std::vector<Triangle> triangles);
+
+        /**
+         * @brief
+         *  Quantized meshes keep their 16 bit positions, hits are the ones of the float tree built
+         *  from the dequantized triangles
+         */
+        explicit MeshBvh(CS350PrimitiveData const& mesh);
+
+        /**
+         * @brief
+         *  Closest triangle hit before tMax
+         */
+        std::optional<MeshHit> Closest(Ray const& ray, float tMax = std::numeric_limits<float>::max()) const;
+
+        /**
+         * @brief
+         *  Any triangle hit before tMax, stops at the first one found
+         */
+        bool                   Occluded(Ray const& ray, float tMax) const;
+
+        Triangle               triangle(unsigned index) const;
+        size_t                 triangleCount() const { return mView.objectCount(); }
+        bool                   quantized() const { return !mQuantized.empty(); }
+        Aabb const&            bounds() const { return mView.nodes()[0].bv; }
+        FlatBvhView const&     view() const { return mView; }
+        size_t                 memorySize() const { return mStorage.size() * sizeof(uint64_t) + mTriangles.size() * sizeof(Triangle) + mQuantized.size() * sizeof(uint16_t); }
+
+      private:
+        template <bool AnyHit>
+        bool                   Trace(Ray const& ray, float& tMax, unsigned& triangle) const;
+
+        std::vector<Triangle>  mTriangles; // Leaf order, empty when quantized
+        std::vector<uint64_t>  mStorage;   // Flattened tree
+        FlatBvhView            mView;
+
+        std::vector<uint16_t>               mQuantized; // Leaf order, 3 corners of 3 steps per triangle
+        std::optional<PositionQuantization> mQuantization;
+    };
+
+    template <bool AnyHit, typename Fn>
+    bool TraverseRay(FlatBvhView const& view, Ray const& ray, float& tMax, Fn&& leaf) {
+        if (view.Empty()) {
+            return false;
+        }
+        float rootT = ray.intersect(view.nodes()[0].bv);
+        if (rootT < 0.f || rootT > tMax) {
+            return false;
+        }
+
+        // Nodes are stored with the time the ray enters them, each pop pushes at most two
+        std::array<std::pair<uint32_t, float>, cMaxTraversalDepth + 1> stack;
+        size_t                                                         size = 0;
+        stack[size++]                                                       = { 0u, rootT };
+
+        bool hit = false;
+        while (size != 0) {
+            auto [index, entryTime] = stack[--size];
+            if (entryTime > tMax) {
+                continue;
+            }
+
+            FlatBvhNode const& node = view.nodes()[index];
+            if (node.rightChild == 0) {
+                for (uint32_t i = node.firstObject; i < node.firstObject + node.objectCount; i++) {
+                    if (leaf(i, tMax)) {
+                        hit = true;
+                        if constexpr (AnyHit) {
+                            return true;
+                        }
+                    }
+                }
+                continue;
+            }
+
+            uint32_t children[2]  = { index + 1, node.rightChild };
+            float    childFirstT  = ray.intersect(view.nodes()[children[0]].bv);
+            float    childSecondT = ray.intersect(view.nodes()[children[1]].bv);
+
+            // Push the furthest child first so the closest one is visited first
+            bool     firstIsCloser = childSecondT < 0.f || (childFirstT >= 0.f && childFirstT <= childSecondT);
+            float    closerT       = firstIsCloser ? childFirstT : childSecondT;
+            float    furtherT      = firstIsCloser ? childSecondT : childFirstT;
+            uint32_t closer        = firstIsCloser ? children[0] : children[1];
+            uint32_t further       = firstIsCloser ? children[1] : children[0];
+            if (furtherT >= 0.f && furtherT <= tMax) {
+                stack[size++] = { further, furtherT };
+            }
+            if (closerT >= 0.f && closerT <= tMax) {
+                stack[size++] = { closer, closerT };
+            }
+        }
+        return hit;
+    }
+}
+
+#endif // MESH_BVH_HPP
@@ -0,0 +1,134 @@
+/**
+ * @file
+ *  numa_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/19
+ * @brief
+ *  Per NUMA node query throughput of a single shared tree against one replica per node.
+ *  Workers are bound to their node. Halfway through each run the scene moves, the Bvh is refitted
+ *  and the replicas are updated while the workers keep querying.
+ *
+ *  Usage: cs350-numa-bench [workers per node, 0 for one per cpu] [seconds per run] [scene copies] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "replicated_bvh.hpp"
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <atomic>
+#include <random>
+#include <thread>
+
+namespace {
+    using namespace CS350;
+
+    constexpr unsigned cQueriesPerAcquire = 256; // Workers pick up a new replica this often
+
+    struct NodeResult {
+        std::atomic<uint64_t> queries{ 0 };
+        std::atomic<uint64_t> lastGeneration{ 0 };
+    };
+
+    void Worker(Numa::ReplicatedBvh const& replicas, unsigned node, unsigned seed, std::atomic<bool> const& running, NodeResult& result) {
+        try {
+            Numa::BindCurrentThread(replicas.topology(), node);
+        } catch (std::exception const& ex) {
+            fmt::print(stderr, "{}\n", ex.what());
+            return;
+        }
+
+        // The CS170 generator is global, every worker gets its own
+        std::mt19937 random(seed);
+        uint64_t     queries = 0;
+        while (running.load(std::memory_order_relaxed)) {
+            auto replica = replicas.Acquire(node);
+            auto bounds  = replica->view.Empty() ? Aabb(vec3(0), vec3(0)) : replica->view.nodes()[0].bv;
+            std::uniform_real_distribution<float> x(bounds.min.x, bounds.max.x), y(bounds.min.y, bounds.max.y), z(bounds.min.z, bounds.max.z);
+            for (unsigned q{}; q < cQueriesPerAcquire; q++) {
+                vec3 a = vec3(x(random), y(random), z(random));
+                vec3 b = vec3(x(random), y(random), z(random));
+                if (q % 2 == 0) {
+                    (void)replica->view.Query(Ray(a, b - a));
+                } else {
+                    (void)replica->view.Query(Aabb(glm::min(a, b), glm::min(a, b) + vec3(10.0f)));
+                }
+            }
+            queries += cQueriesPerAcquire;
+            result.lastGeneration.store(replica->generation, std::memory_order_relaxed);
+        }
+        result.queries.fetch_add(queries);
+    }
+
+    void Run(Tools::Scene& scene, Tools::SceneBvh& bvh, Numa::Topology const& topology, bool replicate, unsigned workersPerNode, double seconds) {
+        Numa::ReplicatedBvh replicas(topology, replicate);
+        replicas.Update(bvh);
+
+        std::atomic<bool>       running{ true };
+        std::vector<NodeResult> results(topology.NodeCount());
+        std::vector<std::thread> workers;
+        for (unsigned node{}; node < topology.NodeCount(); node++) {
+            unsigned count = workersPerNode != 0 ? workersPerNode : static_cast<unsigned>(topology.cpus[node].size());
+            for (unsigned w{}; w < count; w++) {
+                workers.emplace_back(Worker, std::cref(replicas), node, node * 1000 + w + 1, std::cref(running), std::ref(results[node]));
+            }
+        }
+
+        // Move everything a bit and propagate the refit to every replica while workers run
+        auto halfTime = std::chrono::duration<double>(seconds * 0.5);
+        std::this_thread::sleep_for(halfTime);
+        for (auto* object : scene.objects) {
+            object->bv = Aabb(object->bv.min + vec3(1.0f, 0.0f, 0.0f), object->bv.max + vec3(1.0f, 0.0f, 0.0f));
+        }
+        Tools::Stopwatch refitWatch;
+        bvh.Refit();
+        uint64_t generation = replicas.Update(bvh);
+        double   refitMs    = refitWatch.ElapsedMs();
+        std::this_thread::sleep_for(halfTime);
+
+        running = false;
+        for (auto& worker : workers) {
+            worker.join();
+        }
+
+        fmt::print("{} ({} copies), refit and update in {:.02f}ms\n", replicate ? "replicated" : "shared", replicate ? topology.NodeCount() : 1u, refitMs);
+        for (unsigned node{}; node < topology.NodeCount(); node++) {
+            fmt::print("    node {:<3} {:>12.0f} queries/s   generation {}{}\n",
+                       topology.nodeIds[node],
+                       static_cast<double>(results[node].queries.load()) / seconds,
+                       results[node].lastGeneration.load(),
+                       results[node].lastGeneration.load() == generation ? "" : " (stale)");
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned    workersPerNode = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 0u;
+    double      seconds        = argc > 2 ? std::stod(argv[2]) : 2.0;
+    unsigned    copies         = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 64u;
+    std::string sceneFile      = argc > 4 ? argv[4] : Tools::cSceneNormal;
+    std::string assetPattern   = argc > 5 ? argv[5] : Tools::cAssetPath;
+
+    try {
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::ReplicateScene(scene, copies);
+        Tools::SceneBvh bvh;
+        bvh.BuildTopDown(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+
+        Numa::Topology topology = Numa::DetectTopology();
+        fmt::print("{} objects, {} bytes flattened, {} NUMA nodes\n", scene.objects.size(), FlatBvhSize(bvh), topology.NodeCount());
+
+        Run(scene, bvh, topology, false, workersPerNode, seconds);
+        Run(scene, bvh, topology, true, workersPerNode, seconds);
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
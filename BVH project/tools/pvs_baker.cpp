@@ -0,0 +1,109 @@
+/**
+ * @file
+ *  pvs_baker.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/23
+ * @brief
+ *  Bakes the potentially visible sets of a scene to a file, then loads it back and compares the
+ *  objects drawn with frustum culling alone against frustum culling and the PVS.
+ *
+ *  Usage: cs350-pvs-baker [output file] [cells per axis] [samples per cell] [rays per sample] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "pvs.hpp"
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <fstream>
+#include <random>
+
+namespace {
+    using namespace CS350;
+
+    constexpr unsigned cEvaluationCameras = 200;
+}
+
+int main(int argc, char** argv) {
+    std::string outputFile   = argc > 1 ? argv[1] : "scene.pvs";
+    int         cellsPerAxis = argc > 2 ? std::stoi(argv[2]) : 8;
+    unsigned    samples      = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 8u;
+    unsigned    rays         = argc > 4 ? static_cast<unsigned>(std::stoul(argv[4])) : 256u;
+    std::string sceneFile    = argc > 5 ? argv[5] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 6 ? argv[6] : Tools::cAssetPath;
+
+    try {
+        // Resolve the output before moving to the asset directory
+        outputFile = std::filesystem::absolute(outputFile).string();
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::SceneBvh bvh;
+        bvh.BuildTopDown(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+
+        PvsBakeConfig config;
+        config.cells          = ivec3(cellsPerAxis);
+        config.samplesPerCell = samples;
+        config.raysPerSample  = rays;
+
+        Tools::Stopwatch watch;
+        Pvs              pvs = BakePvs(bvh, config);
+        double           bakeMs = watch.ElapsedMs();
+
+        size_t visible = 0;
+        for (size_t cell = 0; cell < pvs.cellCount(); ++cell) {
+            visible += pvs.VisibleCount(cell);
+        }
+        fmt::print("{} objects, {} cells, {} rays baked in {:.02f}ms, {:.1f} visible objects per cell\n",
+                   scene.objects.size(),
+                   pvs.cellCount(),
+                   pvs.cellCount() * samples * rays,
+                   bakeMs,
+                   static_cast<double>(visible) / static_cast<double>(pvs.cellCount()));
+
+        {
+            std::ofstream file(outputFile, std::ios::binary);
+            if (!file) {
+                throw std::runtime_error(fmt::format("pvs_baker: can not open {}", outputFile));
+            }
+            pvs.Save(file);
+        }
+        fmt::print("{}: {} bytes, {} uncompressed\n", outputFile, std::filesystem::file_size(outputFile), pvs.cellCount() * ((pvs.objectCount() + 7) / 8));
+
+        // Runtime side, from the file
+        std::ifstream file(outputFile, std::ios::binary);
+        Pvs           loaded = Pvs::Load(file);
+        if (!(loaded == pvs)) {
+            fmt::print(stderr, "Loaded PVS differs from the baked one\n");
+            return 1;
+        }
+
+        std::mt19937                          random(1);
+        Aabb const&                           bounds = loaded.bounds();
+        std::uniform_real_distribution<float> x(bounds.min.x, bounds.max.x), y(bounds.min.y, bounds.max.y), z(bounds.min.z, bounds.max.z);
+        size_t                                frustumCount = 0, pvsCount = 0;
+        for (unsigned c{}; c < cEvaluationCameras; c++) {
+            vec3    eye    = vec3(x(random), y(random), z(random));
+            vec3    target = vec3(x(random), y(random), z(random));
+            mat4    view   = glm::lookAt(eye, target, vec3(0, 1, 0));
+            mat4    proj   = glm::perspective(glm::radians(60.0f), 16.0f / 9.0f, 0.1f, glm::length(bounds.get_extents()) * 4.0f);
+            Frustum frustum(proj * view);
+
+            auto inFrustum = bvh.Query(frustum);
+            frustumCount += inFrustum.size();
+            pvsCount += loaded.Cull(eye, inFrustum).size();
+        }
+        fmt::print("{} cameras: {:.1f} objects per frame with the frustum, {:.1f} with the frustum and the PVS\n",
+                   cEvaluationCameras,
+                   static_cast<double>(frustumCount) / cEvaluationCameras,
+                   static_cast<double>(pvsCount) / cEvaluationCameras);
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
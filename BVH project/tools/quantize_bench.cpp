@@ -0,0 +1,120 @@
+/**
+ * @file
+ *  quantize_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Triangle Bvh of welded meshes with float positions against 16 bit quantized ones: memory and
+ *  time of closest hit and occlusion rays from random points around the mesh. The quantized tree
+ *  must return exactly the hits of the float tree built from the dequantized positions.
+ *
+ *  Usage: cs350-quantize-bench [rays] [mesh files...]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "logging.hpp"
+#include "mesh_bvh.hpp"
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <random>
+
+namespace {
+    using namespace CS350;
+
+    struct Result {
+        double                                     closestMs  = 0.0;
+        double                                     occludedMs = 0.0;
+        std::vector<std::optional<Tools::MeshHit>> hits;
+        size_t                                     occluded = 0;
+    };
+
+    Result Measure(Tools::MeshBvh const& bvh, std::vector<Ray> const& rays) {
+        Result           result;
+        Tools::Stopwatch watch;
+        result.hits.reserve(rays.size());
+        for (auto const& ray : rays) {
+            result.hits.push_back(bvh.Closest(ray));
+        }
+        result.closestMs = watch.ElapsedMs();
+
+        watch.Restart();
+        for (auto const& ray : rays) {
+            result.occluded += bvh.Occluded(ray, 1.0f) ? 1u : 0u;
+        }
+        result.occludedMs = watch.ElapsedMs();
+        return result;
+    }
+
+    void Print(char const* label, Tools::MeshBvh const& bvh, size_t positionBytes, Result const& result, size_t rayCount) {
+        double count = static_cast<double>(rayCount);
+        fmt::print("  {:<10} {:>8.02f}MB positions {:>8.02f}MB tree {:>8.03f}us closest {:>8.03f}us occluded\n",
+                   label,
+                   static_cast<double>(positionBytes) / (1024.0 * 1024.0),
+                   static_cast<double>(bvh.memorySize()) / (1024.0 * 1024.0),
+                   result.closestMs * 1e3 / count,
+                   result.occludedMs * 1e3 / count);
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned                 rayCount = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 20000u;
+    std::vector<std::string> meshFiles(argv + std::min(argc, 2), argv + argc);
+    if (meshFiles.empty()) {
+        meshFiles = { "assets/cs350/dragon.cs350_binary", "assets/cs350/bunny-dense.cs350_binary", "assets/cs350/suzanne.cs350_binary" };
+    }
+
+    try {
+        CS350::ChangeWorkdir();
+
+        for (auto const& meshFile : meshFiles) {
+            CS350PrimitiveData mesh = LoadCS350Binary(meshFile);
+            WeldCS350Primitive(mesh);
+            size_t floatBytes = mesh.positions.size() * sizeof(vec3);
+            QuantizeCS350Positions(mesh);
+            size_t quantizedBytes = mesh.quantizedPositions.size() * sizeof(QuantizedPosition);
+
+            Tools::Stopwatch watch;
+            Tools::MeshBvh   floatBvh(Tools::MeshTriangles(mesh));
+            Tools::MeshBvh   quantizedBvh(mesh);
+            fmt::print("{}: {} triangles, error bound {}, built in {:.02f}ms\n", meshFile, quantizedBvh.triangleCount(), PositionQuantization(mesh.bvMin, mesh.bvMax).error(), watch.ElapsedMs());
+
+            // From random points of a box twice the size of the mesh to random points of the mesh box
+            Aabb                                  bounds = quantizedBvh.bounds();
+            vec3                                  center = bounds.get_center(), extents = bounds.get_extents();
+            std::mt19937                          random(1);
+            std::uniform_real_distribution<float> unit(-1.0f, 1.0f);
+            std::vector<Ray>                      rays;
+            for (unsigned r{}; r < rayCount; r++) {
+                vec3 from = center + vec3(unit(random), unit(random), unit(random)) * extents;
+                vec3 to   = center + vec3(unit(random), unit(random), unit(random)) * extents * 0.5f;
+                rays.emplace_back(from, to - from);
+            }
+
+            Result floatResult     = Measure(floatBvh, rays);
+            Result quantizedResult = Measure(quantizedBvh, rays);
+            Print("float", floatBvh, floatBytes, floatResult, rays.size());
+            Print("quantized", quantizedBvh, quantizedBytes, quantizedResult, rays.size());
+
+            for (size_t r = 0; r < rays.size(); r++) {
+                auto const& expected = floatResult.hits[r];
+                auto const& actual   = quantizedResult.hits[r];
+                if (expected.has_value() != actual.has_value() || (expected && (expected->t != actual->t || expected->triangle != actual->triangle))) {
+                    fmt::print(stderr, "{}: ray {} hits differ between the float and quantized trees\n", meshFile, r);
+                    return 1;
+                }
+            }
+            if (floatResult.occluded != quantizedResult.occluded) {
+                fmt::print(stderr, "{}: occlusion differs between the float and quantized trees\n", meshFile);
+                return 1;
+            }
+        }
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
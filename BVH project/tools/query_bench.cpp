@@ -0,0 +1,157 @@
+/**
+ * @file
+ *  query_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/14
+ * @brief
+ *  Throughput and latency of the query service compared to in-process Bvh calls.
+ *  Requires a running cs350-query-server loaded with the same scene.
+ *
+ *  Usage: cs350-query-bench [socket path] [batch size] [batch count] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "query_service.hpp"
+#include "tool_scene.hpp"
+#include "utils.hpp"
+#include "PRNG.h"
+
+#include <algorithm>
+
+namespace {
+    using namespace CS350;
+    using namespace CS350::QueryService;
+
+    struct Timings {
+        std::vector<double> batchUs;
+        double              totalUs = 0.0;
+        size_t              ids     = 0;
+    };
+
+    Frustum RandomFrustum() {
+        vec3 cameraPosition = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        vec3 cameraTarget   = vec3(CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f), CS170::Utils::Random(-10.0f, 10.0f));
+        mat4 view           = glm::lookAt(cameraPosition, cameraTarget, vec3(0, 1, 0));
+        mat4 proj           = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+        return Frustum(proj * view);
+    }
+
+    Ray RandomRay() {
+        vec3 rayStart  = vec3(CS170::Utils::Random(-200.0f, 200.0f), CS170::Utils::Random(-200.0f, 200.0f), CS170::Utils::Random(-200.0f, 200.0f));
+        vec3 rayTarget = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        return Ray(rayStart, rayTarget - rayStart);
+    }
+
+    Aabb RandomAabb() {
+        vec3 center = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+        vec3 half   = vec3(CS170::Utils::Random(1.0f, 20.0f));
+        return Aabb(center - half, center + half);
+    }
+
+    void Print(char const* label, Timings& timings, size_t queries) {
+        std::sort(timings.batchUs.begin(), timings.batchUs.end());
+        auto percentile = [&](double p) {
+            return timings.batchUs.at(static_cast<size_t>(p * static_cast<double>(timings.batchUs.size() - 1)));
+        };
+        fmt::print("{:<12} {:>12.0f} queries/s   batch p50 {:>9.02f}us   p99 {:>9.02f}us   {} ids\n",
+                   label,
+                   static_cast<double>(queries) / (timings.totalUs * 1e-6),
+                   percentile(0.5),
+                   percentile(0.99),
+                   timings.ids);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string socketPath   = argc > 1 ? argv[1] : cDefaultSocketPath;
+    unsigned    batchSize    = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 64u;
+    unsigned    batchCount   = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 200u;
+    std::string sceneFile    = argc > 4 ? argv[4] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 5 ? argv[5] : Tools::cAssetPath;
+
+    try {
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::SceneBvh bvh;
+        bvh.BuildTopDown(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+
+        // Same queries for both runs, a third of each kind
+        CS170::Utils::srand(5, 5);
+        std::vector<BatchWriter> batches(batchCount);
+        std::vector<std::vector<Query>> decoded(batchCount);
+        for (unsigned b{}; b < batchCount; b++) {
+            for (unsigned q{}; q < batchSize; q++) {
+                switch (q % 3) {
+                    case 0: batches[b].AddFrustum(RandomFrustum()); break;
+                    case 1: batches[b].AddRay(RandomRay(), q % 2 == 0); break;
+                    default: batches[b].AddOverlap(RandomAabb()); break;
+                }
+            }
+            ReadBatch(batches[b].payload().data(), batches[b].payload().size(), batches[b].count(), decoded[b]);
+        }
+
+        // In process
+        Timings                               local;
+        std::vector<std::vector<unsigned>>    localIds(batchSize);
+        std::vector<unsigned>                 scratchIds;
+        std::vector<Tools::SceneBvhNode const*> scratchNodes;
+        Tools::Stopwatch                      total;
+        for (unsigned b{}; b < batchCount; b++) {
+            Tools::Stopwatch watch;
+            for (size_t q{}; q < decoded[b].size(); q++) {
+                auto const& query = decoded[b][q];
+                switch (query.kind) {
+                    case QueryKind::eFRUSTUM: localIds[q] = bvh.Query(query.frustum); break;
+                    case QueryKind::eOVERLAP: localIds[q] = bvh.Query(query.aabb); break;
+                    case QueryKind::eRAY:
+                        if (query.closestOnly) {
+                            auto closest = bvh.Query(query.ray);
+                            localIds[q].assign(closest ? 1 : 0, closest.value_or(0));
+                        } else {
+                            bvh.QueryDebug(query.ray, false, scratchIds, scratchNodes);
+                            localIds[q] = scratchIds;
+                        }
+                        break;
+                }
+                local.ids += localIds[q].size();
+            }
+            local.batchUs.push_back(watch.ElapsedUs());
+        }
+        local.totalUs = total.ElapsedUs();
+
+        // Through the service
+        Client client;
+        client.Connect(socketPath);
+        Timings             remote;
+        std::vector<Result> results;
+        total.Restart();
+        for (unsigned b{}; b < batchCount; b++) {
+            Tools::Stopwatch watch;
+            client.Submit(batches[b], results);
+            remote.batchUs.push_back(watch.ElapsedUs());
+            for (auto const& result : results) {
+                remote.ids += result.ids.size();
+            }
+        }
+        remote.totalUs = total.ElapsedUs();
+        client.Disconnect();
+
+        size_t queries = static_cast<size_t>(batchSize) * batchCount;
+        fmt::print("{} objects, {} batches of {} queries\n", scene.objects.size(), batchCount, batchSize);
+        Print("in-process", local, queries);
+        Print("service", remote, queries);
+        if (local.ids != remote.ids) {
+            fmt::print(stderr, "Result mismatch: {} ids in process, {} through the service\n", local.ids, remote.ids);
+            return 1;
+        }
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
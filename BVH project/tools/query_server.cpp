@@ -0,0 +1,360 @@
+/**
+ * @file
+ *  query_server.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/14
+ * @brief
+ *  Standalone Bvh query daemon. Loads a cs350 scene, builds the Bvh once and answers batched
+ *  frustum, ray and overlap queries from other processes over a Unix domain socket.
+ *
+ *  Usage: cs350-query-server [socket path] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "query_service.hpp"
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <csignal>
+#include <cerrno>
+#include <map>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace {
+    using namespace CS350;
+    using namespace CS350::QueryService;
+
+    volatile std::sig_atomic_t gRunning = 1;
+
+    void StopServer(int /*signal*/) {
+        gRunning = 0;
+    }
+
+    using Clock = std::chrono::steady_clock;
+
+    // A client that stops in the middle of a message, or of reading a reply, is dropped after this
+    constexpr auto cStallTimeout = std::chrono::seconds(5);
+
+    /**
+     * @brief
+     *  Per connection state. Sockets are non blocking, a message is only handled once all of it arrived.
+     */
+    struct Connection {
+        ResultRing               ring;
+        std::vector<std::byte>   inbox;        // Header then payload of the message being received
+        size_t                   received = 0; // Bytes of it in inbox
+        std::vector<std::byte>   outbox;       // Replies not sent yet, nothing is read until they are
+        size_t                   sent = 0;     // Bytes of outbox already sent
+        Clock::time_point        lastProgress; // Last byte moved of a partial message or reply
+        std::vector<Query>       queries;
+        std::vector<unsigned>    ids; // Every id of the batch, before it is copied to the ring
+        std::vector<ResultEntry> entries;
+    };
+
+    /**
+     * @brief
+     *  Appends a message to the replies of the connection
+     */
+    void QueueMessage(Connection& connection, MessageType type, uint32_t count, void const* payload, size_t payloadSize) {
+        MessageHeader header{ cMagic, cVersion, static_cast<uint16_t>(type), count, static_cast<uint32_t>(payloadSize) };
+        size_t        offset = connection.outbox.size();
+        connection.outbox.resize(offset + sizeof(header) + payloadSize);
+        std::memcpy(connection.outbox.data() + offset, &header, sizeof(header));
+        if (payloadSize != 0) {
+            std::memcpy(connection.outbox.data() + offset + sizeof(header), payload, payloadSize);
+        }
+    }
+
+    /**
+     * @brief
+     *  Sends as much of the pending replies as the socket takes
+     * @return
+     *  False if the connection has to be closed
+     */
+    bool Flush(int fd, Connection& connection) {
+        while (connection.sent < connection.outbox.size()) {
+            ssize_t sent = send(fd, connection.outbox.data() + connection.sent, connection.outbox.size() - connection.sent, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return errno == EAGAIN || errno == EWOULDBLOCK;
+            }
+            connection.sent += static_cast<size_t>(sent);
+            connection.lastProgress = Clock::now();
+        }
+        connection.outbox.clear();
+        connection.sent = 0;
+        return true;
+    }
+
+    /**
+     * @brief
+     *  Runs every query of the batch and stages the results in the connection
+     * @return
+     *  Status to send back
+     */
+    Status ExecuteBatch(Tools::Scene const& scene, Tools::SceneBvh const& bvh, Connection& connection) {
+        std::vector<unsigned>                 scratchIds;
+        std::vector<Tools::SceneBvhNode const*> scratchNodes;
+
+        connection.ids.clear();
+        connection.entries.clear();
+        for (auto const& query : connection.queries) {
+            ResultEntry entry{ connection.ids.size(), 0, -1.f };
+
+            switch (query.kind) {
+                case QueryKind::eFRUSTUM: {
+                    auto visible = bvh.Query(query.frustum);
+                    connection.ids.insert(connection.ids.end(), visible.begin(), visible.end());
+                    break;
+                }
+                case QueryKind::eRAY: {
+                    std::optional<unsigned> closest;
+                    if (query.closestOnly) {
+                        closest = bvh.Query(query.ray);
+                        if (closest) {
+                            connection.ids.push_back(*closest);
+                        }
+                    } else {
+                        closest = bvh.QueryDebug(query.ray, false, scratchIds, scratchNodes);
+                        connection.ids.insert(connection.ids.end(), scratchIds.begin(), scratchIds.end());
+                    }
+                    if (closest) {
+                        entry.time = query.ray.intersect(scene.objects.at(*closest)->bv);
+                    }
+                    break;
+                }
+                case QueryKind::eOVERLAP: {
+                    auto overlapping = bvh.Query(query.aabb);
+                    connection.ids.insert(connection.ids.end(), overlapping.begin(), overlapping.end());
+                    break;
+                }
+            }
+
+            entry.count = static_cast<uint32_t>(connection.ids.size() - entry.ringOffset);
+            connection.entries.push_back(entry);
+        }
+
+        if (connection.ids.size() > connection.ring.capacity()) {
+            return Status::eTOO_LARGE;
+        }
+        if (connection.ids.size() > connection.ring.FreeSpace()) {
+            return Status::eRING_FULL;
+        }
+
+        // Offsets were relative to the batch, make them absolute ring positions
+        uint64_t base = connection.ring.Write(connection.ids.data(), connection.ids.size());
+        for (auto& entry : connection.entries) {
+            entry.ringOffset += base;
+        }
+        connection.ring.Publish();
+        return Status::eOK;
+    }
+
+    /**
+     * @brief
+     *  Answers one complete message, the reply is queued in the connection
+     * @return
+     *  False if the connection has to be closed
+     */
+    bool HandleMessage(MessageHeader const& header, std::byte const* payload, Tools::Scene const& scene, Tools::SceneBvh const& bvh,
+                       Connection& connection, unsigned& ringCounter) {
+        switch (static_cast<MessageType>(header.type)) {
+            case MessageType::eHELLO: {
+                std::string name = fmt::format("/cs350-query-{}-{}", getpid(), ringCounter++);
+                connection.ring  = ResultRing::Create(name, cDefaultRingEntries);
+
+                HelloReply reply{};
+                reply.ringCapacity = connection.ring.capacity();
+                std::memcpy(reply.shmName, name.c_str(), name.size() + 1);
+                QueueMessage(connection, MessageType::eHELLO, 0, &reply, sizeof(reply));
+                return true;
+            }
+
+            case MessageType::eBATCH: {
+                Status status = Status::eBAD_REQUEST;
+                if (connection.ring.capacity() != 0 && ReadBatch(payload, header.payloadSize, header.count, connection.queries)) {
+                    status = ExecuteBatch(scene, bvh, connection);
+                }
+
+                if (status != Status::eOK) {
+                    QueueMessage(connection, MessageType::eERROR, static_cast<uint32_t>(status), nullptr, 0);
+                } else {
+                    QueueMessage(connection, MessageType::eBATCH, static_cast<uint32_t>(connection.entries.size()),
+                                 connection.entries.data(), connection.entries.size() * sizeof(ResultEntry));
+                }
+                return true;
+            }
+
+            case MessageType::eBYE:
+            default:
+                return false;
+        }
+    }
+
+    /**
+     * @brief
+     *  Reads what the socket has of the current message and handles it once complete. Never waits
+     *  for the rest, at most one message is handled per call so other clients are served in between.
+     * @return
+     *  False if the connection has to be closed
+     */
+    bool Receive(int fd, Tools::Scene const& scene, Tools::SceneBvh const& bvh, Connection& connection, unsigned& ringCounter) {
+        MessageHeader header{};
+        while (true) {
+            size_t expected = sizeof(header);
+            if (connection.received >= sizeof(header)) {
+                std::memcpy(&header, connection.inbox.data(), sizeof(header));
+                expected += header.payloadSize;
+            }
+            if (connection.received == expected) {
+                break;
+            }
+
+            connection.inbox.resize(std::max(connection.inbox.size(), expected));
+            ssize_t received = recv(fd, connection.inbox.data() + connection.received, expected - connection.received, 0);
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                return true;
+            }
+            if (received <= 0) {
+                return false;
+            }
+            connection.received += static_cast<size_t>(received);
+            connection.lastProgress = Clock::now();
+
+            // The payload size comes from the client, never allocate more than a message can be
+            if (connection.received == sizeof(header)) {
+                std::memcpy(&header, connection.inbox.data(), sizeof(header));
+                if (!ValidHeader(header) || header.payloadSize > cMaxBatchPayload) {
+                    fmt::print(stderr, "Closing connection {}: invalid header of a {} bytes message\n", fd, header.payloadSize);
+                    return false;
+                }
+            }
+        }
+
+        connection.received = 0;
+        return HandleMessage(header, connection.inbox.data() + sizeof(header), scene, bvh, connection, ringCounter) &&
+               Flush(fd, connection);
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string socketPath   = argc > 1 ? argv[1] : cDefaultSocketPath;
+    std::string sceneFile    = argc > 2 ? argv[2] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 3 ? argv[3] : Tools::cAssetPath;
+
+    try {
+        CS350::ChangeWorkdir();
+
+        // Scene and Bvh, built once for every client
+        Tools::Stopwatch watch;
+        Tools::Scene     scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::SceneBvh bvh;
+        bvh.BuildTopDown(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+        fmt::print("Loaded {} objects, Bvh depth {} size {} in {:.02f}ms\n", scene.objects.size(), bvh.Depth(), bvh.Size(), watch.ElapsedMs());
+
+        // Listening socket
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error(fmt::format("query_server: socket path too long {}", socketPath));
+        }
+        std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+        unlink(socketPath.c_str());
+
+        int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (listener < 0 ||
+            bind(listener, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0 ||
+            listen(listener, SOMAXCONN) != 0) {
+            throw std::runtime_error(fmt::format("query_server: failed to listen on {}: {}", socketPath, std::strerror(errno)));
+        }
+        fmt::print("Listening on {}\n", socketPath);
+
+        std::signal(SIGINT, StopServer);
+        std::signal(SIGTERM, StopServer);
+
+        // Single threaded event loop on non blocking sockets, queries are cheap compared to the round trip
+        std::map<int, Connection> connections;
+        unsigned                  ringCounter = 0;
+        std::vector<pollfd>       fds;
+        while (gRunning) {
+            fds.clear();
+            fds.push_back({ listener, POLLIN, 0 });
+            for (auto const& [fd, connection] : connections) {
+                fds.push_back({ fd, static_cast<short>(connection.outbox.empty() ? POLLIN : POLLOUT), 0 });
+            }
+
+            if (poll(fds.data(), fds.size(), 500) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(fmt::format("query_server: poll failed: {}", std::strerror(errno)));
+            }
+
+            for (auto const& entry : fds) {
+                if (entry.revents == 0) {
+                    continue;
+                }
+
+                if (entry.fd == listener) {
+                    int client = accept(listener, nullptr, nullptr);
+                    if (client >= 0 && fcntl(client, F_SETFL, fcntl(client, F_GETFL) | O_NONBLOCK) == 0) {
+                        connections.emplace(client, Connection{});
+                    } else if (client >= 0) {
+                        close(client);
+                    }
+                    continue;
+                }
+
+                // Pending replies first, the next message is only read once they are sent
+                bool        keep       = false;
+                Connection& connection = connections.at(entry.fd);
+                try {
+                    keep = connection.outbox.empty() ? Receive(entry.fd, scene, bvh, connection, ringCounter) : Flush(entry.fd, connection);
+                } catch (std::exception const& ex) {
+                    fmt::print(stderr, "{}\n", ex.what());
+                }
+                if (!keep) {
+                    close(entry.fd);
+                    connections.erase(entry.fd);
+                }
+            }
+
+            // Drop clients stuck in the middle of a message, they only hold their own connection
+            auto now = Clock::now();
+            for (auto it = connections.begin(); it != connections.end();) {
+                auto const& connection = it->second;
+                if ((connection.received != 0 || !connection.outbox.empty()) && now - connection.lastProgress > cStallTimeout) {
+                    fmt::print(stderr, "Closing connection {}: stalled in the middle of a message\n", it->first);
+                    close(it->first);
+                    it = connections.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+
+        connections.clear();
+        close(listener);
+        unlink(socketPath.c_str());
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,387 @@
+/**
+ * @file
+ *  query_service.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/14
+ * @brief
+ *  Definition of the Bvh query service protocol, result ring and client
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "query_service.hpp"
+#include "logging.hpp"
+
+#include <cerrno>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace CS350::QueryService {
+
+    size_t QueryPayloadSize(QueryKind kind) {
+        switch (kind) {
+            case QueryKind::eFRUSTUM: return sizeof(Plane) * 6;
+            case QueryKind::eRAY: return sizeof(vec3) * 2;
+            case QueryKind::eOVERLAP: return sizeof(vec3) * 2;
+        }
+        return 0;
+    }
+
+    template <typename... Args>
+    void BatchWriter::Append(QueryKind kind, bool closestOnly, Args const&... values) {
+        QueryRecord record{ static_cast<uint8_t>(kind), static_cast<uint8_t>(closestOnly ? 1 : 0), 0 };
+
+        size_t offset = mPayload.size();
+        mPayload.resize(offset + sizeof(record) + (sizeof(values) + ...));
+        std::memcpy(mPayload.data() + offset, &record, sizeof(record));
+        offset += sizeof(record);
+        ((std::memcpy(mPayload.data() + offset, &values, sizeof(values)), offset += sizeof(values)), ...);
+
+        ++mCount;
+    }
+
+    void BatchWriter::AddFrustum(Frustum const& frustum) {
+        Append(QueryKind::eFRUSTUM, false, frustum.planes);
+    }
+
+    void BatchWriter::AddRay(Ray const& ray, bool closestOnly) {
+        Append(QueryKind::eRAY, closestOnly, ray.start, ray.dir);
+    }
+
+    void BatchWriter::AddOverlap(Aabb const& aabb) {
+        Append(QueryKind::eOVERLAP, false, aabb.min, aabb.max);
+    }
+
+    void BatchWriter::Clear() {
+        mPayload.clear();
+        mCount = 0;
+    }
+
+    bool ReadBatch(std::byte const* payload, size_t size, unsigned count, std::vector<Query>& queries) {
+        // The count comes from the client, every query takes at least a record and two vectors
+        queries.clear();
+        if (count > size / (sizeof(QueryRecord) + sizeof(vec3) * 2)) {
+            return false;
+        }
+        queries.reserve(count);
+
+        size_t offset = 0;
+        for (unsigned n{}; n < count; n++) {
+            if (offset + sizeof(QueryRecord) > size) {
+                return false;
+            }
+            QueryRecord record{};
+            std::memcpy(&record, payload + offset, sizeof(record));
+            offset += sizeof(record);
+
+            auto   kind        = static_cast<QueryKind>(record.kind);
+            size_t payloadSize = QueryPayloadSize(kind);
+            if (payloadSize == 0 || offset + payloadSize > size) {
+                return false;
+            }
+
+            Query query{};
+            query.kind        = kind;
+            query.closestOnly = record.closestOnly != 0;
+            switch (kind) {
+                case QueryKind::eFRUSTUM:
+                    std::memcpy(query.frustum.planes.data(), payload + offset, payloadSize);
+                    break;
+                case QueryKind::eRAY:
+                    std::memcpy(&query.ray.start, payload + offset, sizeof(vec3));
+                    std::memcpy(&query.ray.dir, payload + offset + sizeof(vec3), sizeof(vec3));
+                    break;
+                case QueryKind::eOVERLAP:
+                    std::memcpy(&query.aabb.min, payload + offset, sizeof(vec3));
+                    std::memcpy(&query.aabb.max, payload + offset + sizeof(vec3), sizeof(vec3));
+                    break;
+            }
+            offset += payloadSize;
+            queries.push_back(query);
+        }
+
+        return offset == size;
+    }
+
+    ResultRing::~ResultRing() {
+        Reset();
+    }
+
+    ResultRing::ResultRing(ResultRing&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    ResultRing& ResultRing::operator=(ResultRing&& rhs) noexcept {
+        if (this != &rhs) {
+            Reset();
+            mName        = std::move(rhs.mName);
+            mHeader      = rhs.mHeader;
+            mIds         = rhs.mIds;
+            mMappedSize  = rhs.mMappedSize;
+            mPendingHead = rhs.mPendingHead;
+            mOwner       = rhs.mOwner;
+
+            rhs.mHeader     = nullptr;
+            rhs.mIds        = nullptr;
+            rhs.mMappedSize = 0;
+            rhs.mOwner      = false;
+        }
+        return *this;
+    }
+
+    void ResultRing::Reset() {
+        if (mHeader != nullptr) {
+            munmap(mHeader, mMappedSize);
+        }
+        if (mOwner) {
+            shm_unlink(mName.c_str());
+        }
+        mHeader     = nullptr;
+        mIds        = nullptr;
+        mMappedSize = 0;
+        mOwner      = false;
+    }
+
+    ResultRing ResultRing::Create(std::string const& name, uint64_t capacity) {
+        if (name.size() >= cShmNameLength) {
+            throw std::runtime_error(fmt::format("query_service: shared memory name too long {}", name));
+        }
+
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+        if (fd < 0) {
+            throw std::runtime_error(fmt::format("query_service: shm_open {} failed: {}", name, std::strerror(errno)));
+        }
+
+        size_t size = sizeof(RingHeader) + capacity * sizeof(unsigned);
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::runtime_error(fmt::format("query_service: ftruncate {} failed: {}", name, std::strerror(errno)));
+        }
+
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            throw std::runtime_error(fmt::format("query_service: mmap {} failed: {}", name, std::strerror(errno)));
+        }
+
+        ResultRing ring;
+        ring.mName       = name;
+        ring.mHeader     = new (memory) RingHeader{};
+        ring.mIds        = reinterpret_cast<unsigned*>(static_cast<std::byte*>(memory) + sizeof(RingHeader));
+        ring.mMappedSize = size;
+        ring.mOwner      = true;
+        ring.mHeader->head.store(0);
+        ring.mHeader->tail.store(0);
+        ring.mHeader->capacity = capacity;
+        return ring;
+    }
+
+    ResultRing ResultRing::Open(std::string const& name) {
+        int fd = shm_open(name.c_str(), O_RDWR, 0);
+        if (fd < 0) {
+            throw std::runtime_error(fmt::format("query_service: shm_open {} failed: {}", name, std::strerror(errno)));
+        }
+
+        struct stat info {};
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(RingHeader)) {
+            close(fd);
+            throw std::runtime_error(fmt::format("query_service: invalid ring {}", name));
+        }
+
+        auto  size   = static_cast<size_t>(info.st_size);
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) {
+            throw std::runtime_error(fmt::format("query_service: mmap {} failed: {}", name, std::strerror(errno)));
+        }
+
+        ResultRing ring;
+        ring.mName       = name;
+        ring.mHeader     = static_cast<RingHeader*>(memory);
+        ring.mIds        = reinterpret_cast<unsigned*>(static_cast<std::byte*>(memory) + sizeof(RingHeader));
+        ring.mMappedSize = size;
+        if (sizeof(RingHeader) + ring.mHeader->capacity * sizeof(unsigned) > size) {
+            throw std::runtime_error(fmt::format("query_service: ring {} smaller than its capacity", name));
+        }
+        return ring;
+    }
+
+    uint64_t ResultRing::FreeSpace() const {
+        return mHeader->capacity - (mPendingHead - mHeader->tail.load(std::memory_order_acquire));
+    }
+
+    uint64_t ResultRing::Write(unsigned const* ids, size_t count) {
+        uint64_t offset   = mPendingHead;
+        uint64_t capacity = mHeader->capacity;
+
+        // copy in at most two pieces, splitting at the wrap around
+        size_t start = static_cast<size_t>(offset % capacity);
+        size_t first = std::min(count, static_cast<size_t>(capacity) - start);
+        std::memcpy(mIds + start, ids, first * sizeof(unsigned));
+        std::memcpy(mIds, ids + first, (count - first) * sizeof(unsigned));
+
+        mPendingHead += count;
+        return offset;
+    }
+
+    void ResultRing::Publish() {
+        mHeader->head.store(mPendingHead, std::memory_order_release);
+    }
+
+    void ResultRing::Read(uint64_t offset, uint32_t count, std::vector<unsigned>& out) const {
+        // pairs with the release in Publish, ids written before are visible
+        std::ignore = mHeader->head.load(std::memory_order_acquire);
+
+        uint64_t capacity = mHeader->capacity;
+        size_t   start    = static_cast<size_t>(offset % capacity);
+        size_t   first    = std::min(static_cast<size_t>(count), static_cast<size_t>(capacity) - start);
+
+        out.resize(count);
+        std::memcpy(out.data(), mIds + start, first * sizeof(unsigned));
+        std::memcpy(out.data() + first, mIds, (count - first) * sizeof(unsigned));
+    }
+
+    void ResultRing::Release(uint64_t count) {
+        mHeader->tail.fetch_add(count, std::memory_order_release);
+    }
+
+    bool SendAll(int fd, void const* data, size_t size) {
+        auto const* bytes = static_cast<std::byte const*>(data);
+        while (size > 0) {
+            ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+            if (sent < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            bytes += sent;
+            size -= static_cast<size_t>(sent);
+        }
+        return true;
+    }
+
+    bool RecvAll(int fd, void* data, size_t size) {
+        auto* bytes = static_cast<std::byte*>(data);
+        while (size > 0) {
+            ssize_t received = recv(fd, bytes, size, 0);
+            if (received < 0 && errno == EINTR) {
+                continue;
+            }
+            if (received <= 0) {
+                return false;
+            }
+            bytes += received;
+            size -= static_cast<size_t>(received);
+        }
+        return true;
+    }
+
+    bool SendMessage(int fd, MessageType type, uint32_t count, void const* payload, size_t payloadSize) {
+        MessageHeader header{ cMagic, cVersion, static_cast<uint16_t>(type), count, static_cast<uint32_t>(payloadSize) };
+        return SendAll(fd, &header, sizeof(header)) && (payloadSize == 0 || SendAll(fd, payload, payloadSize));
+    }
+
+    bool RecvHeader(int fd, MessageHeader& header) {
+        return RecvAll(fd, &header, sizeof(header)) && ValidHeader(header);
+    }
+
+    bool ValidHeader(MessageHeader const& header) {
+        return header.magic == cMagic && header.version == cVersion;
+    }
+
+    Client::~Client() {
+        Disconnect();
+    }
+
+    void Client::Connect(std::string const& socketPath) {
+        Disconnect();
+
+        sockaddr_un address{};
+        address.sun_family = AF_UNIX;
+        if (socketPath.size() >= sizeof(address.sun_path)) {
+            throw std::runtime_error(fmt::format("query_service: socket path too long {}", socketPath));
+        }
+        std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+        mSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (mSocket < 0) {
+            throw std::runtime_error(fmt::format("query_service: socket failed: {}", std::strerror(errno)));
+        }
+        if (connect(mSocket, reinterpret_cast<sockaddr const*>(&address), sizeof(address)) != 0) {
+            int error = errno;
+            Disconnect();
+            throw std::runtime_error(fmt::format("query_service: connect {} failed: {}", socketPath, std::strerror(error)));
+        }
+
+        // Handshake, retrieve the ring
+        MessageHeader header{};
+        HelloReply    reply{};
+        if (!SendMessage(mSocket, MessageType::eHELLO, 0, nullptr, 0) ||
+            !RecvHeader(mSocket, header) || header.payloadSize != sizeof(reply) ||
+            !RecvAll(mSocket, &reply, sizeof(reply))) {
+            Disconnect();
+            throw std::runtime_error("query_service: handshake failed");
+        }
+        reply.shmName[cShmNameLength - 1] = '\0';
+        mRing                             = ResultRing::Open(reply.shmName);
+    }
+
+    void Client::Submit(BatchWriter const& batch, std::vector<Result>& results) {
+        if (mSocket < 0) {
+            throw std::runtime_error("query_service: client not connected");
+        }
+        if (batch.payload().size() > cMaxBatchPayload) {
+            throw std::runtime_error(fmt::format("query_service: batch of {} bytes is larger than {}", batch.payload().size(), cMaxBatchPayload));
+        }
+
+        if (!SendMessage(mSocket, MessageType::eBATCH, batch.count(), batch.payload().data(), batch.payload().size())) {
+            throw std::runtime_error("query_service: failed to send batch");
+        }
+
+        MessageHeader header{};
+        if (!RecvHeader(mSocket, header)) {
+            throw std::runtime_error("query_service: failed to receive reply");
+        }
+
+        if (header.type == static_cast<uint16_t>(MessageType::eERROR)) {
+            throw std::runtime_error(fmt::format("query_service: batch rejected with status {}", header.count));
+        }
+        if (header.payloadSize != header.count * sizeof(ResultEntry)) {
+            throw std::runtime_error("query_service: malformed reply");
+        }
+
+        std::vector<ResultEntry> entries(header.count);
+        if (!RecvAll(mSocket, entries.data(), header.payloadSize)) {
+            throw std::runtime_error("query_service: failed to receive results");
+        }
+
+        results.resize(entries.size());
+        uint64_t consumed = 0;
+        for (size_t n{}; n < entries.size(); n++) {
+            mRing.Read(entries[n].ringOffset, entries[n].count, results[n].ids);
+            results[n].time = entries[n].time;
+            consumed += entries[n].count;
+        }
+        mRing.Release(consumed);
+    }
+
+    void Client::Disconnect() {
+        if (mSocket >= 0) {
+            SendMessage(mSocket, MessageType::eBYE, 0, nullptr, 0);
+            close(mSocket);
+            mSocket = -1;
+        }
+        mRing = ResultRing();
+    }
+}
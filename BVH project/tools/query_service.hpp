@@ -0,0 +1,299 @@
+/**
+ * @file
+ *  query_service.hpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/14
+ * @brief
+ *  Binary protocol, shared memory result ring and client of the local Bvh query service.
+ *
+ *  A client connects to the server Unix domain socket and sends eHELLO. The server answers with the name
+ *  of a POSIX shared memory segment holding a ring of object ids owned by that client. Every eBATCH
+ *  message carries any number of frustum, ray and overlap queries. The server writes the ids of every
+ *  query into the ring and answers through the socket with one ResultEntry per query, pointing into it.
+ *  The client copies the ids out and moves the ring tail forward.
+ *
+ *  Both processes live on the same host, so every value is sent in native byte order.
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef QUERY_SERVICE_HPP
+#define QUERY_SERVICE_HPP
+
+#include "shapes.hpp"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace CS350::QueryService {
+
+    constexpr uint32_t    cMagic              = 0x31515343; // "CSQ1"
+    constexpr uint16_t    cVersion            = 1;
+    constexpr char const* cDefaultSocketPath  = "/tmp/cs350-query.sock";
+    constexpr uint64_t    cDefaultRingEntries = 1u << 20; // Object ids per client ring
+    constexpr uint32_t    cMaxBatchPayload    = 1u << 24; // Bytes, larger batches close the connection
+    constexpr size_t      cShmNameLength      = 64;
+
+    enum class MessageType : uint16_t {
+        eHELLO = 1,
+        eBATCH = 2,
+        eBYE   = 3,
+        eERROR = 4 // Reply to a rejected batch, count holds the Status
+    };
+
+    enum class QueryKind : uint8_t {
+        eFRUSTUM = 0,
+        eRAY     = 1,
+        eOVERLAP = 2
+    };
+
+    enum class Status : uint32_t {
+        eOK          = 0,
+        eRING_FULL   = 1, // Results do not fit in the free part of the ring, consume and resubmit
+        eBAD_REQUEST = 2,
+        eTOO_LARGE   = 3  // Results exceed the whole ring, resubmitting never works, split the batch
+    };
+
+    /**
+     * @brief
+     *  Header of every message, in both directions
+     */
+    struct MessageHeader {
+        uint32_t magic;
+        uint16_t version;
+        uint16_t type;        // MessageType
+        uint32_t count;       // Queries in a batch, results in a reply
+        uint32_t payloadSize; // Bytes following this header
+    };
+    static_assert(sizeof(MessageHeader) == 16);
+
+    /**
+     * @brief
+     *  Each query of a batch starts with this record, followed by the shape.
+     *  Frustum: 6 planes (24 floats). Ray: start and dir (6 floats). Overlap: min and max (6 floats).
+     */
+    struct QueryRecord {
+        uint8_t  kind;        // QueryKind
+        uint8_t  closestOnly; // Rays only, returns the closest object instead of every hit
+        uint16_t reserved;
+    };
+    static_assert(sizeof(QueryRecord) == 4);
+
+    /**
+     * @brief
+     *  Result of one query. Ids are stored in the ring at [ringOffset, ringOffset + count)
+     */
+    struct ResultEntry {
+        uint64_t ringOffset; // Absolute position, wraps modulo the ring capacity
+        uint32_t count;
+        float    time; // Closest ray hit, -1 when nothing was hit or for other query kinds
+    };
+    static_assert(sizeof(ResultEntry) == 16);
+
+    /**
+     * @brief
+     *  Payload of the reply to eHELLO
+     */
+    struct HelloReply {
+        uint64_t ringCapacity;
+        char     shmName[cShmNameLength];
+    };
+
+    /**
+     * @brief
+     *  Header at the start of the shared memory ring, followed by `capacity` object ids.
+     *  Only the server moves head, only the client moves tail.
+     */
+    struct RingHeader {
+        std::atomic<uint64_t> head;
+        std::atomic<uint64_t> tail;
+        uint64_t              capacity;
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Ring counters must be lock free to be shared between processes");
+
+    /**
+     * @brief
+     *  Size of the shape following a QueryRecord, 0 if the kind is unknown
+     */
+    size_t QueryPayloadSize(QueryKind kind);
+
+    /**
+     * @brief
+     *  Serializes a batch of queries into a message payload
+     */
+    class BatchWriter {
+      public:
+        void AddFrustum(Frustum const& frustum);
+        void AddRay(Ray const& ray, bool closestOnly);
+        void AddOverlap(Aabb const& aabb);
+        void Clear();
+
+        unsigned                  count() const { return mCount; }
+        std::vector<std::byte> const& payload() const { return mPayload; }
+
+      private:
+        template <typename... Args> void Append(QueryKind kind, bool closestOnly, Args const&... values);
+
+        std::vector<std::byte> mPayload;
+        unsigned               mCount = 0;
+    };
+
+    /**
+     * @brief
+     *  A single decoded query
+     */
+    struct Query {
+        QueryKind kind;
+        bool      closestOnly;
+        Frustum   frustum;
+        Ray       ray;
+        Aabb      aabb;
+    };
+
+    /**
+     * @brief
+     *  Decodes a batch payload
+     * @param payload
+     *  Bytes received after the message header
+     * @param size
+     *  Size of the payload in bytes
+     * @param count
+     *  Amount of queries declared by the header
+     * @param queries
+     *  Output queries
+     * @return
+     *  False if the payload is malformed or `count` queries cannot fit in it, nothing is reserved then
+     */
+    bool ReadBatch(std::byte const* payload, size_t size, unsigned count, std::vector<Query>& queries);
+
+    /**
+     * @brief
+     *  Object id ring living in POSIX shared memory
+     */
+    class ResultRing {
+      public:
+        ResultRing() = default;
+        ~ResultRing();
+        ResultRing(ResultRing const&)            = delete;
+        ResultRing& operator=(ResultRing const&) = delete;
+        ResultRing(ResultRing&& rhs) noexcept;
+        ResultRing& operator=(ResultRing&& rhs) noexcept;
+
+        /**
+         * @brief
+         *  Creates and owns a new segment. The segment is unlinked on destruction.
+         */
+        static ResultRing Create(std::string const& name, uint64_t capacity);
+
+        /**
+         * @brief
+         *  Maps a segment created by another process
+         */
+        static ResultRing Open(std::string const& name);
+
+        /**
+         * @brief
+         *  Ids that can still be written before the client releases any
+         */
+        uint64_t FreeSpace() const;
+
+        /**
+         * @brief
+         *  Writes ids at the head of the ring. Caller must check FreeSpace first.
+         * @return
+         *  Absolute offset of the first id written
+         */
+        uint64_t Write(unsigned const* ids, size_t count);
+
+        /**
+         * @brief
+         *  Publishes every id written so far to the reader
+         */
+        void Publish();
+
+        /**
+         * @brief
+         *  Copies `count` ids starting at the absolute `offset` into `out`
+         */
+        void Read(uint64_t offset, uint32_t count, std::vector<unsigned>& out) const;
+
+        /**
+         * @brief
+         *  Frees `count` ids at the tail of the ring
+         */
+        void Release(uint64_t count);
+
+        uint64_t           capacity() const { return mHeader ? mHeader->capacity : 0; }
+        std::string const& name() const { return mName; }
+
+      private:
+        void Reset();
+
+        std::string mName;
+        RingHeader* mHeader      = nullptr;
+        unsigned*   mIds         = nullptr;
+        size_t      mMappedSize  = 0;
+        uint64_t    mPendingHead = 0; // Written but not published yet
+        bool        mOwner       = false;
+    };
+
+    /**
+     * @brief
+     *  Result of a query, as seen by the client
+     */
+    struct Result {
+        std::vector<unsigned> ids;
+        float                 time = -1.f;
+    };
+
+    /**
+     * @brief
+     *  Client side of the query service
+     */
+    class Client {
+      public:
+        Client() = default;
+        ~Client();
+        Client(Client const&)            = delete;
+        Client& operator=(Client const&) = delete;
+
+        /**
+         * @brief
+         *  Connects to a running server and maps the result ring. Throws on failure.
+         */
+        void Connect(std::string const& socketPath = cDefaultSocketPath);
+
+        /**
+         * @brief
+         *  Sends a batch and waits for the results. Throws on failure.
+         * @param batch
+         *  Queries to perform
+         * @param results
+         *  One result per query, in submission order
+         */
+        void Submit(BatchWriter const& batch, std::vector<Result>& results);
+
+        void Disconnect();
+
+      private:
+        int        mSocket = -1;
+        ResultRing mRing;
+    };
+
+    // Socket helpers of the client, they block until the whole message moved. The server never blocks,
+    // it buffers messages per connection and only checks their headers.
+    bool SendAll(int fd, void const* data, size_t size);
+    bool RecvAll(int fd, void* data, size_t size);
+    bool SendMessage(int fd, MessageType type, uint32_t count, void const* payload, size_t payloadSize);
+    bool RecvHeader(int fd, MessageHeader& header);
+    bool ValidHeader(MessageHeader const& header); // Magic and version
+}
+
+#endif // QUERY_SERVICE_HPP
@@ -0,0 +1,262 @@
+/**
+ * @file
+ *  ray_render_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Headless ray cast renderer, one primary ray per pixel, as the end to end ray query workload.
+ *
+ *  Renders the meshes of the assets folder through their triangle Bvh and the mirlo scene twice:
+ *  through the object Bvh alone (hits on the object bounding volumes) and through the object Bvh
+ *  then the triangle Bvh of every instance (exact hits). Every workload is timed at several
+ *  resolutions and thread counts and the largest image is written as a PNG.
+ *
+ *  Usage: cs350-ray-render-bench [output folder] [max threads, 0 for every cpu] [shading: normal or depth] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "mesh_bvh.hpp"
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <lodepng.h>
+
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+namespace {
+    using namespace CS350;
+    using Tools::MeshBvh;
+
+    constexpr char const* cMeshes[] = { "avocado", "suzanne", "bunny", "bunny-dense", "dragon" };
+    constexpr ivec2       cResolutions[] = { ivec2(320, 180), ivec2(640, 360), ivec2(1280, 720) };
+    constexpr unsigned    cRowsPerTask   = 4;
+
+    struct Hit {
+        float t;
+        vec3  normal; // Not normalized
+    };
+
+    /**
+     * @brief
+     *  Pinhole camera looking at the center of the bounds from slightly above
+     */
+    struct Camera {
+        Camera(Aabb const& bounds, float aspect) {
+            vec3  center = bounds.get_center();
+            float radius = glm::length(bounds.get_extents()) * 0.5f;
+            eye          = center + glm::normalize(vec3(0.4f, 0.35f, 1.0f)) * radius * 2.2f;
+            forward      = glm::normalize(center - eye);
+            right        = glm::normalize(glm::cross(forward, vec3(0, 1, 0)));
+            up           = glm::cross(right, forward);
+
+            float tanHalfFov = std::tan(glm::radians(50.0f) * 0.5f);
+            right *= tanHalfFov * aspect;
+            up *= tanHalfFov;
+            near = glm::max(0.0f, glm::distance(eye, center) - radius);
+            far  = glm::distance(eye, center) + radius;
+        }
+
+        Ray PrimaryRay(ivec2 const& pixel, ivec2 const& resolution) const {
+            vec2 ndc = (vec2(pixel) + 0.5f) / vec2(resolution) * 2.0f - 1.0f;
+            return Ray(eye, glm::normalize(forward + right * ndc.x - up * ndc.y));
+        }
+
+        vec3  eye, forward, right, up;
+        float near, far;
+    };
+
+    /**
+     * @brief
+     *  Mirlo scene: object Bvh on top of a triangle Bvh per primitive
+     */
+    struct InstancedScene {
+        struct Instance {
+            mat4           w2m;
+            mat3           normalMatrix;
+            MeshBvh const* mesh;
+        };
+
+        Tools::Scene          scene;
+        std::vector<MeshBvh>  meshes;
+        std::vector<Instance> instances;
+        std::vector<uint64_t> storage;
+        FlatBvhView           objects;
+    };
+
+    void BuildInstancedScene(InstancedScene& world, std::string const& assetPattern, std::string const& sceneFile) {
+        Tools::LoadScene(world.scene, assetPattern, sceneFile);
+        for (auto const& primitive : world.scene.primitives) {
+            world.meshes.emplace_back(Tools::MeshTriangles(primitive));
+        }
+        for (auto const& sceneObject : world.scene.sceneObjects) {
+            mat4 w2m = glm::inverse(sceneObject.m2w.matrix());
+            world.instances.push_back({ w2m, glm::transpose(mat3(w2m)), &world.meshes.at(static_cast<size_t>(sceneObject.primitiveIndex)) });
+        }
+
+        Tools::SceneBvh bvh;
+        bvh.BuildTopDown(world.scene.objects.begin(), world.scene.objects.end(), Tools::cToolTopDownConfig);
+        if (bvh.Empty()) {
+            throw std::runtime_error("ray_render_bench: empty scene");
+        }
+        if (bvh.Depth() >= static_cast<int>(Tools::cMaxTraversalDepth)) {
+            throw std::runtime_error(fmt::format("ray_render_bench: scene tree of depth {} is too deep", bvh.Depth()));
+        }
+        world.storage.resize((FlatBvhSize(bvh) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        size_t size   = FlattenBvh(bvh, world.storage.data(), world.storage.size() * sizeof(uint64_t));
+        world.objects = FlatBvhView(world.storage.data(), size);
+    }
+
+    std::optional<Hit> TraceMesh(MeshBvh const& mesh, Ray const& ray) {
+        auto hit = mesh.Closest(ray);
+        if (!hit) {
+            return std::nullopt;
+        }
+        return Hit{ hit->t, mesh.triangle(hit->triangle).normal() };
+    }
+
+    std::optional<Hit> TraceBoundingVolumes(InstancedScene const& world, Ray const& ray) {
+        std::optional<Hit> closest;
+        float              tMax = std::numeric_limits<float>::max();
+        Tools::TraverseRay<false>(world.objects, ray, tMax, [&](uint32_t index, float& closestT) {
+            Aabb const& bv = world.objects.objects()[index].bv;
+            float       t  = ray.intersect(bv);
+            if (t < 0.0f || t >= closestT) {
+                return false;
+            }
+
+            // Face of the box that was hit, the axis where the point is the furthest from the center
+            vec3 local  = (ray.at(t) - bv.get_center()) / glm::max(bv.get_extents(), vec3(1e-6f));
+            vec3 normal = vec3(0.0f);
+            int  axis   = glm::abs(local.x) > glm::abs(local.y) ? (glm::abs(local.x) > glm::abs(local.z) ? 0 : 2) : (glm::abs(local.y) > glm::abs(local.z) ? 1 : 2);
+            normal[axis] = local[axis] < 0.0f ? -1.0f : 1.0f;
+            closestT     = t;
+            closest      = Hit{ t, normal };
+            return true;
+        });
+        return closest;
+    }
+
+    std::optional<Hit> TraceInstances(InstancedScene const& world, Ray const& ray) {
+        std::optional<Hit> closest;
+        float              tMax = std::numeric_limits<float>::max();
+        Tools::TraverseRay<false>(world.objects, ray, tMax, [&](uint32_t index, float& closestT) {
+            // Same ray parameter in model space, the direction is transformed without normalizing
+            auto const& instance = world.instances[world.objects.objects()[index].id];
+            Ray         local(vec3(instance.w2m * vec4(ray.start, 1.0f)), mat3(instance.w2m) * ray.dir);
+            auto        hit = instance.mesh->Closest(local, closestT);
+            if (!hit) {
+                return false;
+            }
+            closestT = hit->t;
+            closest  = Hit{ hit->t, instance.normalMatrix * instance.mesh->triangle(hit->triangle).normal() };
+            return true;
+        });
+        return closest;
+    }
+
+    /**
+     * @brief
+     *  Renders the image with the given amount of threads, rows are handed out in small tasks
+     * @return
+     *  Milliseconds taken
+     */
+    template <typename TraceFn>
+    double Render(Camera const& camera, ivec2 const& resolution, unsigned threadCount, bool depthShading, std::vector<unsigned char>& rgba, TraceFn const& trace) {
+        rgba.assign(static_cast<size_t>(resolution.x * resolution.y) * 4, 0);
+        std::atomic<int> nextRow{ 0 };
+        auto             worker = [&]() {
+            for (int row = nextRow.fetch_add(cRowsPerTask); row < resolution.y; row = nextRow.fetch_add(cRowsPerTask)) {
+                for (int y = row; y < std::min(row + static_cast<int>(cRowsPerTask), resolution.y); ++y) {
+                    for (int x = 0; x < resolution.x; ++x) {
+                        Ray   ray   = camera.PrimaryRay(ivec2(x, y), resolution);
+                        auto  hit   = trace(ray);
+                        vec3  color = vec3(0.1f);
+                        if (hit && depthShading) {
+                            color = vec3(1.0f - glm::clamp((hit->t - camera.near) / (camera.far - camera.near), 0.0f, 1.0f));
+                        } else if (hit) {
+                            vec3 normal = glm::normalize(hit->normal);
+                            color       = (glm::dot(normal, ray.dir) > 0.0f ? -normal : normal) * 0.5f + 0.5f;
+                        }
+                        size_t pixel = (static_cast<size_t>(y) * static_cast<size_t>(resolution.x) + static_cast<size_t>(x)) * 4;
+                        for (int c = 0; c < 3; ++c) {
+                            rgba[pixel + static_cast<size_t>(c)] = static_cast<unsigned char>(color[c] * 255.0f);
+                        }
+                        rgba[pixel + 3] = 255;
+                    }
+                }
+            }
+        };
+
+        Tools::Stopwatch         watch;
+        std::vector<std::thread> threads;
+        for (unsigned t = 1; t < threadCount; ++t) {
+            threads.emplace_back(worker);
+        }
+        worker();
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        return watch.ElapsedMs();
+    }
+
+    template <typename TraceFn>
+    void Benchmark(std::string const& name, Aabb const& bounds, std::filesystem::path const& outputFolder, unsigned maxThreads, bool depthShading, TraceFn const& trace) {
+        std::vector<unsigned char> rgba;
+        for (ivec2 resolution : cResolutions) {
+            Camera camera(bounds, static_cast<float>(resolution.x) / static_cast<float>(resolution.y));
+            double rays = static_cast<double>(resolution.x * resolution.y);
+            for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+                double elapsedMs = Render(camera, resolution, threadCount, depthShading, rgba, trace);
+                fmt::print("{:<14} {:>4}x{:<4} {:>3} threads {:>9.02f}ms {:>8.02f} Mrays/s\n", name, resolution.x, resolution.y, threadCount, elapsedMs, rays / (elapsedMs * 1e3));
+            }
+        }
+
+        ivec2       resolution = cResolutions[std::size(cResolutions) - 1];
+        std::string file       = (outputFolder / (name + ".png")).string();
+        if (unsigned error = lodepng::encode(file, rgba, static_cast<unsigned>(resolution.x), static_cast<unsigned>(resolution.y)); error != 0) {
+            throw std::runtime_error(fmt::format("ray_render_bench: failed to write {}: {}", file, lodepng_error_text(error)));
+        }
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string outputFolder = argc > 1 ? argv[1] : "renders";
+    unsigned    maxThreads   = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 0u;
+    bool        depthShading = argc > 3 && std::string(argv[3]) == "depth";
+    std::string sceneFile    = argc > 4 ? argv[4] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 5 ? argv[5] : Tools::cAssetPath;
+    if (maxThreads == 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    try {
+        // Resolve the output before moving to the asset directory
+        std::filesystem::path output = std::filesystem::absolute(outputFolder);
+        std::filesystem::create_directories(output);
+        CS350::ChangeWorkdir();
+
+        for (char const* name : cMeshes) {
+            Tools::Stopwatch watch;
+            MeshBvh          mesh(Tools::MeshTriangles(LoadCS350Binary(fmt::format("assets/cs350/{}.cs350_binary", name))));
+            fmt::print("{}: {} triangles, Bvh of {} nodes built in {:.02f}ms\n", name, mesh.triangleCount(), mesh.view().nodeCount(), watch.ElapsedMs());
+            Benchmark(name, mesh.bounds(), output, maxThreads, depthShading, [&](Ray const& ray) { return TraceMesh(mesh, ray); });
+        }
+
+        InstancedScene   world;
+        Tools::Stopwatch watch;
+        BuildInstancedScene(world, assetPattern, sceneFile);
+        fmt::print("mirlo: {} objects, {} meshes, built in {:.02f}ms\n", world.instances.size(), world.meshes.size(), watch.ElapsedMs());
+        Aabb const& bounds = world.objects.nodes()[0].bv;
+        Benchmark("mirlo-bv", bounds, output, maxThreads, depthShading, [&](Ray const& ray) { return TraceBoundingVolumes(world, ray); });
+        Benchmark("mirlo-exact", bounds, output, maxThreads, depthShading, [&](Ray const& ray) { return TraceInstances(world, ray); });
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
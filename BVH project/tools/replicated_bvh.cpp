@@ -0,0 +1,168 @@
+/**
+ * @file
+ *  replicated_bvh.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/19
+ * @brief
+ *  NUMA topology detection, thread binding and replica updates
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "replicated_bvh.hpp"
+#include "logging.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstring>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <thread>
+
+#include <sched.h>
+
+namespace CS350::Numa {
+
+    namespace {
+        /**
+         * @brief
+         *  Parses a kernel cpu list such as "0-3,8,10-11"
+         */
+        std::vector<unsigned> ParseCpuList(std::string const& list) {
+            std::vector<unsigned> cpus;
+            std::stringstream     ss(list);
+            std::string           range;
+            while (std::getline(ss, range, ',')) {
+                if (range.empty() || range == "\n") {
+                    continue;
+                }
+                size_t   dash  = range.find('-');
+                unsigned first = static_cast<unsigned>(std::stoul(range.substr(0, dash)));
+                unsigned last  = dash == std::string::npos ? first : static_cast<unsigned>(std::stoul(range.substr(dash + 1)));
+                for (unsigned cpu = first; cpu <= last; cpu++) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+    }
+
+    Topology DetectTopology() {
+        Topology topology;
+
+        std::filesystem::path nodesPath = "/sys/devices/system/node";
+        std::error_code       error;
+        for (auto const& entry : std::filesystem::directory_iterator(nodesPath, error)) {
+            std::string name = entry.path().filename().string();
+            if (name.rfind("node", 0) != 0 || name.size() == 4 || !std::isdigit(static_cast<unsigned char>(name[4]))) {
+                continue;
+            }
+
+            std::ifstream cpuList(entry.path() / "cpulist");
+            std::string   list;
+            std::getline(cpuList, list);
+            auto cpus = ParseCpuList(list);
+            if (!cpus.empty()) {
+                topology.nodeIds.push_back(static_cast<unsigned>(std::stoul(name.substr(4))));
+                topology.cpus.push_back(std::move(cpus));
+            }
+        }
+
+        // Node order of the directory listing is not guaranteed
+        std::vector<size_t> order(topology.nodeIds.size());
+        for (size_t i{}; i < order.size(); i++) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return topology.nodeIds[lhs] < topology.nodeIds[rhs]; });
+        Topology sorted;
+        for (size_t i : order) {
+            sorted.nodeIds.push_back(topology.nodeIds[i]);
+            sorted.cpus.push_back(std::move(topology.cpus[i]));
+        }
+
+        if (sorted.nodeIds.empty()) {
+            sorted.nodeIds.push_back(0);
+            sorted.cpus.emplace_back();
+            unsigned cpuCount = std::max(1u, std::thread::hardware_concurrency());
+            for (unsigned cpu{}; cpu < cpuCount; cpu++) {
+                sorted.cpus.back().push_back(cpu);
+            }
+        }
+        return sorted;
+    }
+
+    void BindCurrentThread(Topology const& topology, unsigned node) {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (unsigned cpu : topology.cpus.at(node)) {
+            CPU_SET(cpu, &set);
+        }
+        if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+            throw std::runtime_error(fmt::format("replicated_bvh: failed to bind to node {}: {}", topology.nodeIds.at(node), std::strerror(errno)));
+        }
+    }
+
+    ReplicatedBvh::ReplicatedBvh(Topology topology, bool replicate) :
+        mTopology(std::move(topology)),
+        mReplicate(replicate),
+        mReplicas(mTopology.NodeCount()) {
+    }
+
+    uint64_t ReplicatedBvh::Update(void const* flatBvh, size_t size) {
+        if (!FlatBvhView::IsValid(flatBvh, size)) {
+            throw std::runtime_error("replicated_bvh: invalid flattened Bvh");
+        }
+
+        uint64_t generation;
+        {
+            std::lock_guard lock(mMutex);
+            generation = ++mGeneration;
+        }
+
+        // Allocated and written from the node itself, so the pages are local to it
+        unsigned                                    copies = mReplicate ? mTopology.NodeCount() : 1u;
+        std::vector<std::shared_ptr<Replica const>> replicas(copies);
+        std::vector<std::thread>                    threads;
+        std::exception_ptr                          failure;
+        std::mutex                                  failureMutex;
+        for (unsigned node{}; node < copies; node++) {
+            threads.emplace_back([&, node]() {
+                try {
+                    BindCurrentThread(mTopology, node);
+                    auto replica        = std::make_shared<Replica>();
+                    replica->storage.resize((size + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+                    std::memcpy(replica->storage.data(), flatBvh, size);
+                    replica->view       = FlatBvhView(replica->storage.data(), size);
+                    replica->generation = generation;
+                    replicas[node]      = std::move(replica);
+                } catch (...) {
+                    std::lock_guard lock(failureMutex);
+                    failure = std::current_exception();
+                }
+            });
+        }
+        for (auto& thread : threads) {
+            thread.join();
+        }
+        if (failure) {
+            std::rethrow_exception(failure);
+        }
+
+        std::lock_guard lock(mMutex);
+        for (unsigned node{}; node < mTopology.NodeCount(); node++) {
+            mReplicas[node] = replicas[mReplicate ? node : 0u];
+        }
+        return generation;
+    }
+
+    std::shared_ptr<Replica const> ReplicatedBvh::Acquire(unsigned node) const {
+        std::lock_guard lock(mMutex);
+        return mReplicas.at(node);
+    }
+}
@@ -0,0 +1,125 @@
+/**
+ * @file
+ *  replicated_bvh.hpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/19
+ * @brief
+ *  NUMA aware copies of a flattened Bvh for multi-socket query servers.
+ *
+ *  The topology is read from /sys/devices/system/node, so no libnuma is needed. Each replica is
+ *  allocated and written by a thread bound to the cpus of its node: with the default first touch
+ *  policy the pages end up in that node local memory. Query workers bind themselves to a node
+ *  and read the replica of that node. Machines without NUMA information are seen as one node.
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef REPLICATED_BVH_HPP
+#define REPLICATED_BVH_HPP
+
+#include "flat_bvh.hpp"
+
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace CS350::Numa {
+
+    /**
+     * @brief
+     *  Cpus of every NUMA node with at least one cpu
+     */
+    struct Topology {
+        std::vector<unsigned>              nodeIds; // Kernel ids, may have gaps
+        std::vector<std::vector<unsigned>> cpus;    // Same order as nodeIds
+
+        unsigned NodeCount() const { return static_cast<unsigned>(nodeIds.size()); }
+    };
+
+    /**
+     * @brief
+     *  Reads the NUMA topology of the machine, a single node with every cpu if it is not available
+     */
+    Topology DetectTopology();
+
+    /**
+     * @brief
+     *  Restricts the calling thread to the cpus of a node. Throws on failure.
+     * @param topology
+     *  Topology returned by DetectTopology
+     * @param node
+     *  Index in the topology, not the kernel id
+     */
+    void BindCurrentThread(Topology const& topology, unsigned node);
+
+    /**
+     * @brief
+     *  Read only flattened Bvh living in the memory of one node
+     */
+    struct Replica {
+        std::vector<uint64_t> storage; // 8 byte aligned flattened tree
+        FlatBvhView           view;
+        uint64_t              generation = 0;
+    };
+
+    /**
+     * @brief
+     *  One replica of the same tree per NUMA node. Updates build new replicas and swap them in,
+     *  workers holding an older one keep using it until they acquire again.
+     */
+    class ReplicatedBvh {
+      public:
+        /**
+         * @brief
+         *  Creates an empty set of replicas
+         * @param topology
+         *  Nodes to replicate on
+         * @param replicate
+         *  False keeps a single copy on the first node shared by every worker, to compare against
+         */
+        explicit ReplicatedBvh(Topology topology, bool replicate = true);
+
+        /**
+         * @brief
+         *  Flattens the Bvh and copies it to every node. Call it after any rebuild or Refit.
+         * @return
+         *  Generation of the new replicas
+         */
+        template <typename T> uint64_t Update(Bvh<T> const& bvh);
+
+        /**
+         * @brief
+         *  Copies an already flattened tree to every node
+         */
+        uint64_t Update(void const* flatBvh, size_t size);
+
+        /**
+         * @brief
+         *  Latest replica of the node, nullptr before the first update
+         * @param node
+         *  Index in the topology of the node the caller is bound to
+         */
+        std::shared_ptr<Replica const> Acquire(unsigned node) const;
+
+        Topology const& topology() const { return mTopology; }
+        bool            replicated() const { return mReplicate; }
+
+      private:
+        Topology                                    mTopology;
+        bool                                        mReplicate;
+        uint64_t                                    mGeneration = 0;
+        mutable std::mutex                          mMutex; // Guards the pointers only, never held while querying
+        std::vector<std::shared_ptr<Replica const>> mReplicas;
+    };
+
+    template <typename T>
+    uint64_t ReplicatedBvh::Update(Bvh<T> const& bvh) {
+        std::vector<uint64_t> staging((FlatBvhSize(bvh) + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+        size_t                size = FlattenBvh(bvh, staging.data(), staging.size() * sizeof(uint64_t));
+        return Update(staging.data(), size);
+    }
+}
+
+#endif // REPLICATED_BVH_HPP
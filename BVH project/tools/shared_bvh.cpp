@@ -0,0 +1,192 @@
+/**
+ * @file
+ *  shared_bvh.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/16
+ * @brief
+ *  Shared memory segment and publication protocol of the shared Bvh
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "shared_bvh.hpp"
+#include "logging.hpp"
+
+#include <cerrno>
+#include <new>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace CS350::SharedBvh {
+
+    namespace {
+        constexpr size_t cSlotAlignment = 64;
+
+        size_t AlignUp(size_t value, size_t alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    Mapping::~Mapping() {
+        Reset();
+    }
+
+    Mapping::Mapping(Mapping&& rhs) noexcept {
+        *this = std::move(rhs);
+    }
+
+    Mapping& Mapping::operator=(Mapping&& rhs) noexcept {
+        if (this != &rhs) {
+            Reset();
+            mName      = std::move(rhs.mName);
+            mData      = rhs.mData;
+            mSize      = rhs.mSize;
+            mOwner     = rhs.mOwner;
+            rhs.mData  = nullptr;
+            rhs.mSize  = 0;
+            rhs.mOwner = false;
+        }
+        return *this;
+    }
+
+    void Mapping::Reset() {
+        if (mData != nullptr) {
+            munmap(mData, mSize);
+        }
+        if (mOwner) {
+            shm_unlink(mName.c_str());
+        }
+        mData  = nullptr;
+        mSize  = 0;
+        mOwner = false;
+    }
+
+    Mapping Mapping::Create(std::string const& name, size_t size) {
+        // A crashed publisher may have left the segment behind
+        shm_unlink(name.c_str());
+
+        int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+        if (fd < 0) {
+            throw std::runtime_error(fmt::format("shared_bvh: shm_open {} failed: {}", name, std::strerror(errno)));
+        }
+        if (ftruncate(fd, static_cast<off_t>(size)) != 0) {
+            close(fd);
+            shm_unlink(name.c_str());
+            throw std::runtime_error(fmt::format("shared_bvh: ftruncate {} failed: {}", name, std::strerror(errno)));
+        }
+        void* memory = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) {
+            shm_unlink(name.c_str());
+            throw std::runtime_error(fmt::format("shared_bvh: mmap {} failed: {}", name, std::strerror(errno)));
+        }
+
+        Mapping mapping;
+        mapping.mName  = name;
+        mapping.mData  = static_cast<std::byte*>(memory);
+        mapping.mSize  = size;
+        mapping.mOwner = true;
+        return mapping;
+    }
+
+    Mapping Mapping::OpenReadOnly(std::string const& name) {
+        int fd = shm_open(name.c_str(), O_RDONLY, 0);
+        if (fd < 0) {
+            throw std::runtime_error(fmt::format("shared_bvh: shm_open {} failed: {}", name, std::strerror(errno)));
+        }
+        struct stat info {};
+        if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(SegmentHeader)) {
+            close(fd);
+            throw std::runtime_error(fmt::format("shared_bvh: {} is not a shared Bvh segment", name));
+        }
+        size_t size   = static_cast<size_t>(info.st_size);
+        void*  memory = mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (memory == MAP_FAILED) {
+            throw std::runtime_error(fmt::format("shared_bvh: mmap {} failed: {}", name, std::strerror(errno)));
+        }
+
+        Mapping mapping;
+        mapping.mName = name;
+        mapping.mData = static_cast<std::byte*>(memory);
+        mapping.mSize = size;
+        return mapping;
+    }
+
+    Publisher::Publisher(std::string const& name, size_t slotCapacity) {
+        slotCapacity         = AlignUp(slotCapacity, cSlotAlignment);
+        size_t headerSize    = AlignUp(sizeof(SegmentHeader), cSlotAlignment);
+        mMapping             = Mapping::Create(name, headerSize + slotCapacity * cSlotCount);
+
+        // The segment is zero filled, atomics are constructed in place
+        auto* header         = new (mMapping.data()) SegmentHeader{};
+        header->magic        = cMagic;
+        header->version      = cVersion;
+        header->slotCapacity = slotCapacity;
+        for (unsigned i{}; i < cSlotCount; i++) {
+            header->slots[i].offset = headerSize + slotCapacity * i;
+        }
+        header->activeSlot.store(0, std::memory_order_relaxed);
+        header->generation.store(0, std::memory_order_release);
+    }
+
+    unsigned Publisher::BeginWrite() {
+        SegmentHeader* header = Header();
+        unsigned       slot   = (header->activeSlot.load(std::memory_order_relaxed) + 1) % cSlotCount;
+
+        // Odd sequence, readers still on this slot will retry
+        header->slots[slot].sequence.fetch_add(1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        return slot;
+    }
+
+    uint64_t Publisher::EndWrite(unsigned slot, size_t size) {
+        SegmentHeader* header   = Header();
+        uint64_t       gen      = header->generation.load(std::memory_order_relaxed) + 1;
+        SlotHeader&    target   = header->slots[slot];
+        target.generation       = gen;
+        target.size             = size;
+        target.sequence.fetch_add(1, std::memory_order_release);
+
+        header->activeSlot.store(slot, std::memory_order_release);
+        header->generation.store(gen, std::memory_order_release);
+        return gen;
+    }
+
+    Reader::Reader(std::string const& name) :
+        mMapping(Mapping::OpenReadOnly(name)) {
+        SegmentHeader const* header = Header();
+        if (header->magic != cMagic || header->version != cVersion) {
+            throw std::runtime_error(fmt::format("shared_bvh: {} has version {}, expected {}", name, header->version, cVersion));
+        }
+        size_t headerSize = AlignUp(sizeof(SegmentHeader), cSlotAlignment);
+        if (mMapping.size() < headerSize + header->slotCapacity * cSlotCount) {
+            throw std::runtime_error(fmt::format("shared_bvh: {} is truncated", name));
+        }
+    }
+
+    unsigned Reader::BeginRead(uint64_t& sequence) const {
+        SegmentHeader const* header = Header();
+        for (;;) {
+            if (header->generation.load(std::memory_order_acquire) == 0) {
+                return cSlotCount;
+            }
+            unsigned slot = header->activeSlot.load(std::memory_order_acquire) % cSlotCount;
+            sequence      = header->slots[slot].sequence.load(std::memory_order_acquire);
+            if ((sequence & 1u) == 0) {
+                return slot;
+            }
+        }
+    }
+
+    bool Reader::EndRead(unsigned slot, uint64_t sequence) const {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return Header()->slots[slot].sequence.load(std::memory_order_relaxed) == sequence;
+    }
+}
@@ -0,0 +1,230 @@
+/**
+ * @file
+ *  shared_bvh.hpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/16
+ * @brief
+ *  Flattened Bvh shared between processes through POSIX shared memory.
+ *
+ *  One publisher builds the Bvh and flattens it into a segment, any number of readers map the
+ *  segment read only and query it in place. The segment holds two slots: a new tree is always
+ *  written into the slot readers are not directed to, then becomes the active one. Each slot is
+ *  guarded by a sequence counter (odd while it is written), readers check it before and after a
+ *  query and retry on the new active slot if the tree changed under them. Readers never write to
+ *  the segment and the publisher never waits for them.
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef SHARED_BVH_HPP
+#define SHARED_BVH_HPP
+
+#include "flat_bvh.hpp"
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+namespace CS350::SharedBvh {
+
+    constexpr uint32_t    cMagic       = 0x31535343; // "CSS1"
+    constexpr uint16_t    cVersion     = 1;          // Segment layout, the tree layout is versioned by cFlatBvhVersion
+    constexpr char const* cDefaultName = "/cs350-shared-bvh";
+    constexpr unsigned    cSlotCount   = 2;
+
+    struct SlotHeader {
+        std::atomic<uint64_t> sequence;   // Odd while the slot is being written
+        uint64_t              generation; // Generation of the tree stored in the slot
+        uint64_t              offset;     // From the start of the segment
+        uint64_t              size;       // Bytes of the flattened tree
+    };
+
+    /**
+     * @brief
+     *  Start of the segment
+     */
+    struct SegmentHeader {
+        uint32_t              magic;
+        uint16_t              version;
+        uint16_t              reserved;
+        uint64_t              slotCapacity;
+        std::atomic<uint64_t> generation; // Latest published tree, 0 before the first one
+        std::atomic<uint32_t> activeSlot;
+        SlotHeader            slots[cSlotCount];
+    };
+    static_assert(std::atomic<uint64_t>::is_always_lock_free, "Sequence counters must be lock free to be shared between processes");
+    static_assert(std::atomic<uint32_t>::is_always_lock_free, "Sequence counters must be lock free to be shared between processes");
+
+    /**
+     * @brief
+     *  Mapping of a shared memory segment, unmapped on destruction
+     */
+    class Mapping {
+      public:
+        Mapping() = default;
+        ~Mapping();
+        Mapping(Mapping const&)            = delete;
+        Mapping& operator=(Mapping const&) = delete;
+        Mapping(Mapping&& rhs) noexcept;
+        Mapping& operator=(Mapping&& rhs) noexcept;
+
+        /**
+         * @brief
+         *  Creates a new segment, replacing any stale one with the same name. Unlinked on destruction.
+         */
+        static Mapping Create(std::string const& name, size_t size);
+
+        /**
+         * @brief
+         *  Maps an existing segment read only
+         */
+        static Mapping OpenReadOnly(std::string const& name);
+
+        std::byte*         data() const { return mData; }
+        size_t             size() const { return mSize; }
+        std::string const& name() const { return mName; }
+
+      private:
+        void Reset();
+
+        std::string mName;
+        std::byte*  mData  = nullptr;
+        size_t      mSize  = 0;
+        bool        mOwner = false;
+    };
+
+    /**
+     * @brief
+     *  Writer side, owns the segment
+     */
+    class Publisher {
+      public:
+        /**
+         * @brief
+         *  Creates the segment
+         * @param name
+         *  POSIX shared memory name, starting with '/'
+         * @param slotCapacity
+         *  Largest flattened tree that can be published, in bytes
+         */
+        Publisher(std::string const& name, size_t slotCapacity);
+
+        /**
+         * @brief
+         *  Flattens the Bvh into the inactive slot and makes it the active one.
+         *  Throws if the tree does not fit in a slot.
+         * @return
+         *  Generation of the published tree
+         */
+        template <typename T> uint64_t Publish(Bvh<T> const& bvh);
+
+        uint64_t generation() const { return Header()->generation.load(std::memory_order_relaxed); }
+
+      private:
+        SegmentHeader* Header() const { return reinterpret_cast<SegmentHeader*>(mMapping.data()); }
+
+        /**
+         * @brief
+         *  Marks the inactive slot as being written
+         * @return
+         *  Index of the slot
+         */
+        unsigned BeginWrite();
+
+        /**
+         * @brief
+         *  Finishes the write started by BeginWrite and directs readers to the slot
+         */
+        uint64_t EndWrite(unsigned slot, size_t size);
+
+        Mapping mMapping;
+    };
+
+    /**
+     * @brief
+     *  Reader side, maps the segment read only
+     */
+    class Reader {
+      public:
+        /**
+         * @brief
+         *  Maps the segment of a running publisher. Throws if it does not exist or has another version.
+         */
+        explicit Reader(std::string const& name = cDefaultName);
+
+        /**
+         * @brief
+         *  Runs `func` on a consistent view of the latest tree. `func` may run more than once if the
+         *  tree is replaced while it runs, only the result of the last run is returned.
+         * @param func
+         *  Callable of type R(FlatBvhView const& view)
+         */
+        template <typename Fn> auto Read(Fn func) const;
+
+        /**
+         * @brief
+         *  Generation of the latest published tree, 0 if nothing was published yet
+         */
+        uint64_t generation() const { return Header()->generation.load(std::memory_order_acquire); }
+
+      private:
+        SegmentHeader const* Header() const { return reinterpret_cast<SegmentHeader const*>(mMapping.data()); }
+
+        /**
+         * @brief
+         *  Starts reading the active slot
+         * @param sequence
+         *  Slot sequence to validate the read with
+         * @return
+         *  Index of the slot, cSlotCount if nothing was published yet
+         */
+        unsigned BeginRead(uint64_t& sequence) const;
+
+        /**
+         * @brief
+         *  True if the slot was not rewritten since BeginRead
+         */
+        bool EndRead(unsigned slot, uint64_t sequence) const;
+
+        Mapping mMapping;
+    };
+
+    template <typename T>
+    uint64_t Publisher::Publish(Bvh<T> const& bvh) {
+        size_t size = FlatBvhSize(bvh);
+        if (size > Header()->slotCapacity) {
+            throw std::runtime_error(fmt::format("shared_bvh: tree of {} bytes does not fit in slots of {} bytes", size, Header()->slotCapacity));
+        }
+
+        unsigned slot = BeginWrite();
+        FlattenBvh(bvh, mMapping.data() + Header()->slots[slot].offset, Header()->slotCapacity);
+        return EndWrite(slot, size);
+    }
+
+    template <typename Fn>
+    auto Reader::Read(Fn func) const {
+        for (;;) {
+            uint64_t sequence = 0;
+            unsigned slot     = BeginRead(sequence);
+            if (slot == cSlotCount) {
+                return func(FlatBvhView());
+            }
+
+            // A torn header means the publisher is rewriting the slot, the sequence check catches it
+            SlotHeader const& slotHeader = Header()->slots[slot];
+            std::byte const*  tree       = mMapping.data() + slotHeader.offset;
+            if (FlatBvhView::IsValid(tree, Header()->slotCapacity)) {
+                auto result = func(FlatBvhView(tree, Header()->slotCapacity));
+                if (EndRead(slot, sequence)) {
+                    return result;
+                }
+            } else if (EndRead(slot, sequence)) {
+                throw std::runtime_error("shared_bvh: published tree has an incompatible layout");
+            }
+        }
+    }
+}
+
+#endif // SHARED_BVH_HPP
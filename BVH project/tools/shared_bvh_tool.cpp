@@ -0,0 +1,132 @@
+/**
+ * @file
+ *  shared_bvh_tool.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/16
+ * @brief
+ *  Publishes a scene Bvh to shared memory, or queries one published by another process.
+ *
+ *  Usage:
+ *      cs350-shared-bvh publish [segment name] [republish period ms] [scene file] [asset pattern]
+ *      cs350-shared-bvh query   [segment name] [query count]
+ *
+ *  The publisher rebuilds and republishes the tree periodically, alternating between the top-down
+ *  and the insertion builders, to exercise the swap while readers keep querying.
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "shared_bvh.hpp"
+#include "tool_scene.hpp"
+#include "utils.hpp"
+#include "PRNG.h"
+
+#include <chrono>
+#include <csignal>
+#include <thread>
+
+namespace {
+    using namespace CS350;
+
+    volatile std::sig_atomic_t gRunning = 1;
+
+    void Stop(int /*signal*/) {
+        gRunning = 0;
+    }
+
+    int Publish(std::string const& name, unsigned periodMs, std::string const& sceneFile, std::string const& assetPattern) {
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+
+        Tools::SceneBvh bvh;
+        bvh.BuildTopDown(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+
+        // Insertion usually produces the larger tree, leave room for either builder
+        size_t                slotCapacity = FlatBvhSize(bvh) * 4;
+        SharedBvh::Publisher  publisher(name, slotCapacity);
+        fmt::print("Publishing {} objects to {} ({} bytes per slot)\n", scene.objects.size(), name, slotCapacity);
+
+        std::signal(SIGINT, Stop);
+        std::signal(SIGTERM, Stop);
+
+        for (unsigned rebuild{}; gRunning; rebuild++) {
+            Tools::Stopwatch watch;
+            if (rebuild > 0) {
+                bvh.Clear();
+                if (rebuild % 2 == 0) {
+                    bvh.BuildTopDown(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+                } else {
+                    bvh.Insert(scene.objects.begin(), scene.objects.end(), Tools::cToolTopDownConfig);
+                }
+            }
+            double   buildMs    = watch.ElapsedMs();
+            uint64_t generation = publisher.Publish(bvh);
+            fmt::print("Generation {}: {} nodes, built in {:.02f}ms, published in {:.02f}ms\n",
+                       generation, bvh.Size(), buildMs, watch.ElapsedMs() - buildMs);
+
+            if (periodMs == 0) {
+                while (gRunning) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+                }
+                break;
+            }
+            std::this_thread::sleep_for(std::chrono::milliseconds(periodMs));
+        }
+        return 0;
+    }
+
+    int Query(std::string const& name, unsigned count) {
+        SharedBvh::Reader reader(name);
+
+        CS170::Utils::srand(5, 5);
+        size_t           ids          = 0;
+        uint64_t         firstSeen    = reader.generation();
+        Tools::Stopwatch watch;
+        for (unsigned q{}; q < count; q++) {
+            vec3 a = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+            vec3 b = vec3(CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f), CS170::Utils::Random(-100.0f, 100.0f));
+
+            ids += reader.Read([&](FlatBvhView const& view) -> size_t {
+                switch (q % 3) {
+                    case 0: {
+                        mat4 viewMatrix = glm::lookAt(a, b * 0.1f, vec3(0, 1, 0));
+                        mat4 proj       = glm::perspective(glm::radians(50.0f), 1920.0f / 1080.0f, 0.01f, 1000.0f);
+                        return view.Query(Frustum(proj * viewMatrix)).size();
+                    }
+                    case 1: return view.Query(Ray(a * 2.0f, b - a * 2.0f)) ? 1u : 0u;
+                    default: return view.Query(Aabb(glm::min(a, b), glm::min(a, b) + vec3(20.0f))).size();
+                }
+            });
+        }
+        double elapsedUs = watch.ElapsedUs();
+
+        fmt::print("{} queries, {} ids, {:.0f} queries/s, generations {} to {}\n",
+                   count, ids, static_cast<double>(count) / (elapsedUs * 1e-6), firstSeen, reader.generation());
+        return 0;
+    }
+}
+
+int main(int argc, char** argv) {
+    std::string mode = argc > 1 ? argv[1] : "";
+    std::string name = argc > 2 ? argv[2] : SharedBvh::cDefaultName;
+
+    try {
+        if (mode == "publish") {
+            CS350::ChangeWorkdir();
+            unsigned    periodMs     = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 0u;
+            std::string sceneFile    = argc > 4 ? argv[4] : Tools::cSceneNormal;
+            std::string assetPattern = argc > 5 ? argv[5] : Tools::cAssetPath;
+            return Publish(name, periodMs, sceneFile, assetPattern);
+        }
+        if (mode == "query") {
+            unsigned count = argc > 3 ? static_cast<unsigned>(std::stoul(argv[3])) : 100000u;
+            return Query(name, count);
+        }
+        fmt::print(stderr, "Usage: {} publish|query [segment name] ...\n", argv[0]);
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+    }
+    return 1;
+}
@@ -0,0 +1,118 @@
+/**
+ * @file
+ *  tool_scene.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/14
+ * @brief
+ *  Definition of the scene loading helpers shared by the command line tools
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "tool_scene.hpp"
+#include "logging.hpp"
+
+#include <stdexcept>
+
+namespace CS350::Tools {
+
+    void LoadScene(Scene& scene, std::string const& assetPattern, std::string const& sceneFile) {
+        // Load all models, identical ones are shared
+        std::vector<int> fileToPrimitive;
+        scene.primitives = LoadCS350Primitives(assetPattern, fileToPrimitive, &scene.loadStats);
+        if (scene.primitives.empty()) {
+            throw std::runtime_error(fmt::format("tool_scene: no assets found with pattern {}", assetPattern));
+        }
+
+        // Load the scene
+        scene.sceneObjects = LoadCS350Scene(sceneFile);
+        RemapCS350Scene(scene.sceneObjects, fileToPrimitive);
+
+        // World bvs
+        scene.storage.clear();
+        scene.objects.clear();
+        scene.sceneIndices.clear();
+        scene.storage.reserve(scene.sceneObjects.size());
+        scene.objects.reserve(scene.sceneObjects.size());
+        for (auto const& sceneObject : scene.sceneObjects) {
+            auto const& primitive = scene.primitives.at(static_cast<size_t>(sceneObject.primitiveIndex));
+
+            auto object = std::make_unique<SceneObject>();
+            object->id  = static_cast<unsigned>(scene.objects.size());
+            object->bv  = Aabb(primitive.bvMin, primitive.bvMax).transform(sceneObject.m2w);
+            scene.sceneIndices.push_back(object->id);
+            scene.objects.push_back(object.get());
+            scene.storage.push_back(std::move(object));
+        }
+    }
+
+    void ReplicateScene(Scene& scene, unsigned copies) {
+        if (scene.objects.empty() || copies <= 1) {
+            return;
+        }
+
+        // Smallest cube of copies that holds them all, with a small gap between copies
+        Aabb sceneBv = scene.objects.front()->bv;
+        for (auto const* object : scene.objects) {
+            sceneBv = Aabb(sceneBv, object->bv);
+        }
+        vec3     spacing = sceneBv.get_extents() * 1.1f;
+        unsigned side    = 1;
+        while (side * side * side < copies) {
+            side++;
+        }
+
+        size_t originalCount = scene.objects.size();
+        scene.storage.reserve(originalCount * copies);
+        scene.objects.reserve(originalCount * copies);
+        scene.sceneObjects.reserve(originalCount * copies);
+        scene.sceneIndices.reserve(originalCount * copies);
+        for (unsigned copy = 1; copy < copies; copy++) {
+            vec3 offset = spacing * vec3(static_cast<float>(copy % side), static_cast<float>(copy / side % side), static_cast<float>(copy / (side * side)));
+            for (size_t i = 0; i < originalCount; i++) {
+                CS350SceneObject sceneObject = scene.sceneObjects[i];
+                sceneObject.m2w.translate(offset);
+
+                auto object = std::make_unique<SceneObject>();
+                object->id  = static_cast<unsigned>(scene.objects.size());
+                object->bv  = Aabb(scene.objects[i]->bv.min + offset, scene.objects[i]->bv.max + offset);
+                scene.objects.push_back(object.get());
+                scene.storage.push_back(std::move(object));
+                scene.sceneObjects.push_back(sceneObject);
+                scene.sceneIndices.push_back(scene.sceneIndices[i]);
+            }
+        }
+    }
+
+    void MortonOrderScene(Scene& scene) {
+        std::vector<Aabb> bvs;
+        bvs.reserve(scene.objects.size());
+        for (auto const* object : scene.objects) {
+            bvs.push_back(object->bv);
+        }
+        std::vector<unsigned> order = MortonOrder(bvs);
+
+        // New allocations in the new order, not only a permutation of the pointers
+        std::vector<CS350SceneObject>             sceneObjects;
+        std::vector<std::unique_ptr<SceneObject>> storage;
+        std::vector<unsigned>                     sceneIndices;
+        sceneObjects.reserve(order.size());
+        storage.reserve(order.size());
+        sceneIndices.reserve(order.size());
+        scene.objects.clear();
+        for (unsigned index : order) {
+            auto object = std::make_unique<SceneObject>();
+            object->id  = static_cast<unsigned>(scene.objects.size());
+            object->bv  = bvs[index];
+            scene.objects.push_back(object.get());
+            storage.push_back(std::move(object));
+            sceneObjects.push_back(scene.sceneObjects[index]);
+            sceneIndices.push_back(scene.sceneIndices[index]);
+        }
+        scene.storage      = std::move(storage);
+        scene.sceneObjects = std::move(sceneObjects);
+        scene.sceneIndices = std::move(sceneIndices);
+    }
+}
@@ -0,0 +1,114 @@
+/**
+ * @file
+ *  tool_scene.hpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/14
+ * @brief
+ *  Scene loading and timing helpers shared by the command line tools
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#ifndef TOOL_SCENE_HPP
+#define TOOL_SCENE_HPP
+
+#include "bvh.hpp"
+#include "cs350_loader.hpp"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace CS350::Tools {
+
+    constexpr char const* cAssetPath   = "assets/cs350/gam400s20-mirlo/mirlo_{}.cs350_binary"; // To be used with fmt
+    constexpr char const* cSceneNormal = "assets/cs350/gam400s20-mirlo/scene.txt";
+
+    const BvhBuildConfig cToolTopDownConfig = {
+        std::numeric_limits<unsigned>::max(), // max_depth
+        20,                                   // min_objects
+        250.0f,                               // min_volume
+    };
+
+    struct SceneObject;
+    using SceneBvh     = Bvh<SceneObject*>;
+    using SceneBvhNode = SceneBvh::Node;
+
+    // Scene objects, same layout the Bvh expects
+    struct SceneObject {
+        unsigned id{}; // Object identification
+        Aabb     bv{}; // Bounding volume of the object
+
+        // Bvh information
+        struct {
+            SceneObject*  next = nullptr; // Next object in the Bvh node
+            SceneObject*  prev = nullptr; // Previous object in the Bvh node
+            SceneBvhNode* node = nullptr; // The node it belongs to
+        } bvhInfo;
+    };
+
+    /**
+     * @brief
+     *  All the data a tool needs from a cs350 scene
+     */
+    struct Scene {
+        std::vector<CS350PrimitiveData>           primitives;
+        std::vector<CS350SceneObject>             sceneObjects;
+        std::vector<std::unique_ptr<SceneObject>> storage;
+        std::vector<SceneObject*>                 objects;      // Same order as sceneObjects, id == index
+        std::vector<unsigned>                     sceneIndices; // Object id -> object of the scene file it comes from
+        CS350LoadStats                            loadStats;    // Of the primitives, duplicated files are shared
+    };
+
+    /**
+     * @brief
+     *  Loads every primitive matching the asset pattern and the scene file, computing world bounding volumes
+     * @param scene
+     *  Output scene
+     * @param assetPattern
+     *  fmt pattern of the primitive files, indexed from 0
+     * @param sceneFile
+     *  Scene file path
+     */
+    void LoadScene(Scene& scene, std::string const& assetPattern, std::string const& sceneFile);
+
+    /**
+     * @brief
+     *  Tiles copies of the loaded scene side by side, to get trees that do not fit in the cache
+     * @param scene
+     *  Loaded scene, every object is replicated
+     * @param copies
+     *  Total amount of copies, including the original
+     */
+    void ReplicateScene(Scene& scene, unsigned copies);
+
+    /**
+     * @brief
+     *  Reallocates the objects in Morton order of their bv centers, so objects close in space are
+     *  close in memory. Ids are reassigned to the new order, sceneIndices maps them back.
+     * @param scene
+     *  Loaded scene, after any ReplicateScene and before building trees
+     */
+    void MortonOrderScene(Scene& scene);
+
+    /**
+     * @brief
+     *  Simple wall clock stopwatch
+     */
+    class Stopwatch {
+      public:
+        Stopwatch() : mStart(std::chrono::steady_clock::now()) {}
+
+        void   Restart() { mStart = std::chrono::steady_clock::now(); }
+        double ElapsedUs() const { return std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - mStart).count(); }
+        double ElapsedMs() const { return ElapsedUs() * 1e-3; }
+
+      private:
+        std::chrono::steady_clock::time_point mStart;
+    };
+}
+
+#endif // TOOL_SCENE_HPP
@@ -0,0 +1,99 @@
+/**
+ * @file
+ *  transform_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  World bounds of every instance of a replicated scene recomputed from transforms stored as mat4,
+ *  Affine and QuantizedTrs. The mat4 and Affine bounds must match exactly, the quantized ones are
+ *  reported with their largest error.
+ *
+ *  Usage: cs350-transform-bench [scene copies] [repetitions] [scene file] [asset pattern]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+namespace {
+    using namespace CS350;
+
+    /**
+     * @brief
+     *  Recomputes the world bounds of every instance from its local bounds and transform
+     * @return
+     *  Milliseconds per pass
+     */
+    template <typename Transform, typename Fn>
+    double Measure(char const* label, std::vector<Transform> const& transforms, std::vector<Aabb> const& localBvs, unsigned repetitions, std::vector<Aabb>& worldBvs, Fn&& transform) {
+        worldBvs.resize(transforms.size());
+        Tools::Stopwatch watch;
+        for (unsigned r{}; r < repetitions; r++) {
+            for (size_t i = 0; i < transforms.size(); i++) {
+                worldBvs[i] = transform(localBvs[i], transforms[i]);
+            }
+        }
+        double elapsedMs = watch.ElapsedMs() / repetitions;
+        double megabytes = static_cast<double>(transforms.size() * sizeof(Transform)) / (1024.0 * 1024.0);
+        fmt::print("{:<14} {:>3} bytes {:>8.02f}MB {:>9.03f}ms per pass {:>8.02f}GB/s\n", label, sizeof(Transform), megabytes, elapsedMs, megabytes / 1024.0 / (elapsedMs * 1e-3));
+        return elapsedMs;
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned    copies       = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 250u;
+    unsigned    repetitions  = argc > 2 ? static_cast<unsigned>(std::stoul(argv[2])) : 10u;
+    std::string sceneFile    = argc > 3 ? argv[3] : Tools::cSceneNormal;
+    std::string assetPattern = argc > 4 ? argv[4] : Tools::cAssetPath;
+
+    try {
+        CS350::ChangeWorkdir();
+
+        Tools::Scene scene;
+        Tools::LoadScene(scene, assetPattern, sceneFile);
+        Tools::ReplicateScene(scene, copies);
+
+        // One entry per instance in each layout, local bounds gathered so only the transforms differ
+        std::vector<Aabb>         localBvs;
+        std::vector<mat4>         matrices;
+        std::vector<Affine>       affines;
+        std::vector<QuantizedTrs> quantized;
+        for (auto const& sceneObject : scene.sceneObjects) {
+            auto const& primitive = scene.primitives.at(static_cast<size_t>(sceneObject.primitiveIndex));
+            localBvs.emplace_back(primitive.bvMin, primitive.bvMax);
+            matrices.push_back(sceneObject.m2w.matrix());
+            affines.push_back(sceneObject.m2w);
+            quantized.emplace_back(sceneObject.m2w);
+        }
+        fmt::print("{} instances, {} primitives of {} files, {:.01f}KB shared, loaded in {:.02f}ms\n",
+                   scene.sceneObjects.size(),
+                   scene.loadStats.primitives,
+                   scene.loadStats.files,
+                   static_cast<double>(scene.loadStats.bytesSaved) / 1024.0,
+                   scene.loadStats.loadMs);
+
+        std::vector<Aabb> fromMatrices, fromAffines, fromQuantized;
+        Measure("mat4", matrices, localBvs, repetitions, fromMatrices, [](Aabb const& bv, mat4 const& m2w) { return bv.transform(m2w); });
+        Measure("Affine", affines, localBvs, repetitions, fromAffines, [](Aabb const& bv, Affine const& m2w) { return bv.transform(m2w); });
+        Measure("QuantizedTrs", quantized, localBvs, repetitions, fromQuantized, [](Aabb const& bv, QuantizedTrs const& m2w) { return bv.transform(m2w.affine()); });
+
+        float maxError = 0.0f;
+        for (size_t i = 0; i < fromMatrices.size(); i++) {
+            if (fromMatrices[i].min != fromAffines[i].min || fromMatrices[i].max != fromAffines[i].max) {
+                fmt::print(stderr, "Instance {}: Affine bounds differ from the mat4 ones\n", i);
+                return 1;
+            }
+            vec3 extents = fromMatrices[i].get_extents();
+            vec3 error   = glm::max(glm::abs(fromQuantized[i].min - fromMatrices[i].min), glm::abs(fromQuantized[i].max - fromMatrices[i].max));
+            maxError     = std::max(maxError, std::max({ error.x, error.y, error.z }) / std::max({ extents.x, extents.y, extents.z }));
+        }
+        fmt::print("QuantizedTrs largest bounds error: {:.06f} of the instance size\n", maxError);
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,97 @@
+/**
+ * @file
+ *  weld_bench.cpp
+ * @author
+ *  Jaz Winn Ng, 670001224, jazwinn.ng@digipen.edu
+ * @date
+ *  2025/07/24
+ * @brief
+ *  Vertex welding of non indexed meshes: memory before and after, weld time with one thread and
+ *  with every cpu, and vertex reuse of the triangles through a small FIFO cache, as a GPU or a
+ *  triangle gather would fetch them. Both welds must give the same mesh.
+ *
+ *  Usage: cs350-weld-bench [max threads, 0 for every cpu] [mesh files...]
+ * @copyright
+ *  Copyright (C) 2025 DigiPen Institute of Technology.
+ */
+
+#include "tool_scene.hpp"
+#include "utils.hpp"
+
+#include <deque>
+#include <thread>
+
+namespace {
+    using namespace CS350;
+
+    constexpr size_t cFetchCacheSize = 32;
+
+    /**
+     * @brief
+     *  Average vertex fetches per triangle through a FIFO cache of cFetchCacheSize vertices, 3 when
+     *  nothing is reused
+     */
+    double FetchesPerTriangle(CS350PrimitiveData const& mesh) {
+        if (mesh.polygons.empty()) {
+            return 3.0;
+        }
+        std::deque<int> cache;
+        size_t          fetches = 0;
+        for (auto const& face : mesh.polygons) {
+            for (int vertex : face) {
+                if (std::find(cache.begin(), cache.end(), vertex) == cache.end()) {
+                    fetches++;
+                    cache.push_back(vertex);
+                    if (cache.size() > cFetchCacheSize) {
+                        cache.pop_front();
+                    }
+                }
+            }
+        }
+        return static_cast<double>(fetches) / static_cast<double>(mesh.polygons.size());
+    }
+}
+
+int main(int argc, char** argv) {
+    unsigned                 maxThreads = argc > 1 ? static_cast<unsigned>(std::stoul(argv[1])) : 0u;
+    std::vector<std::string> meshFiles(argv + std::min(argc, 2), argv + argc);
+    if (meshFiles.empty()) {
+        meshFiles = { "assets/cs350/dragon.cs350_binary", "assets/cs350/bunny-dense.cs350_binary", "assets/cs350/bunny.cs350_binary", "assets/cs350/suzanne.cs350_binary" };
+    }
+    if (maxThreads == 0) {
+        maxThreads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    try {
+        CS350::ChangeWorkdir();
+
+        for (auto const& meshFile : meshFiles) {
+            CS350PrimitiveData serial   = LoadCS350Binary(meshFile);
+            CS350PrimitiveData parallel = serial;
+            double             before   = FetchesPerTriangle(serial);
+            CS350WeldStats     stats    = WeldCS350Primitive(serial, 1);
+            double             serialMs = stats.weldMs;
+            stats                       = WeldCS350Primitive(parallel, maxThreads);
+            if (serial.positions != parallel.positions || serial.polygons != parallel.polygons) {
+                fmt::print(stderr, "{}: welds with 1 and {} threads differ\n", meshFile, maxThreads);
+                return 1;
+            }
+
+            fmt::print("{}: {} corners -> {} vertices, {:.02f}MB -> {:.02f}MB, {:.02f}ms with 1 thread, {:.02f}ms with {}, {:.02f} -> {:.02f} fetches per triangle\n",
+                       meshFile,
+                       stats.corners,
+                       stats.vertices,
+                       static_cast<double>(stats.bytesBefore) / (1024.0 * 1024.0),
+                       static_cast<double>(stats.bytesAfter) / (1024.0 * 1024.0),
+                       serialMs,
+                       stats.weldMs,
+                       maxThreads,
+                       before,
+                       FetchesPerTriangle(serial));
+        }
+    } catch (std::exception const& ex) {
+        fmt::print(stderr, "{}\n", ex.what());
+        return 1;
+    }
+    return 0;
+}